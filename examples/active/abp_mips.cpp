@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG        10000
+#define NITER      40001
+#define OUTPUT      4000
+// cells of the local packing fraction, and bins of its histogram
+#define CELL         4.0
+#define NBINS         20
+
+#define DELTAT     0.005
+#define SPEED        1.0
+#define MOBILITY     1.0
+#define STIFFNESS  100.0
+#define DIAMETER     1.0
+// PECLET = SPEED / (DIAMETER * D_ROT) is given at compilation (see Makefile)
+#define D_ROT       ( SPEED / (DIAMETER * PECLET) )
+// packing fraction of the discs
+#define PACKING      0.6
+#define BOX_SIZE    sqrt( NAG * M_PI * DIAMETER * DIAMETER / 4. / PACKING )
+
+int main(int argc, char* argv[]){
+    int iter, i, bin, ncells, cx, cy ;
+    int* count ;
+    double histo[NBINS], phi ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* pos ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Packing fraction  %f\n# Speed             %f\n# Peclet number     %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, PACKING, SPEED, (double) PECLET, DELTAT, BOX_SIZE, seed) ;
+
+    /* The Behavior (and its Metric interaction) is only there
+     * to start the community, the Langevin integrator moves the
+     * agents. The slots of the grid are tuned to the range of
+     * the force (see Community::sense_forces).
+     */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Metric interaction = Metric( DIAMETER , &g) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, 0.0) ;
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid grid = Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.set_grid_tuning( 100 ) ;
+    pos = com.get_pos() ;
+
+    /* Active Brownian discs with soft-core repulsion,
+     * without translational noise.
+     */
+    SoftCore force = SoftCore( STIFFNESS, DIAMETER, &g ) ;
+    ActiveBrownian abp = ActiveBrownian( &com, &force, SPEED, MOBILITY, D_ROT, 0.0 ) ;
+
+    ncells = (int) ( BOX_SIZE / CELL ) ;
+    count = (int*) malloc( ncells * ncells * sizeof(int) ) ;
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            /* Histogram of the packing fraction in cells
+             * of side about CELL: one peak in the homogeneous
+             * phase, and two (gas and dense clusters) with
+             * motility-induced phase separation.
+             */
+            for(i=0; i< ncells*ncells; i++)
+                count[i] = 0 ;
+            for(i=0; i< NAG; i++){
+                cx = (int) ( pos[i*2] / BOX_SIZE * ncells ) % ncells ;
+                cy = (int) ( pos[i*2 + 1] / BOX_SIZE * ncells ) % ncells ;
+                count[cx * ncells + cy] += 1 ;
+            }
+            for(bin=0; bin< NBINS; bin++)
+                histo[bin] = 0.0 ;
+            for(i=0; i< ncells*ncells; i++){
+                phi = count[i] * M_PI * DIAMETER * DIAMETER / 4. / pow(BOX_SIZE / ncells, 2) ;
+                bin = (int) ( phi * NBINS ) ;
+                histo[bin < NBINS ? bin : NBINS-1] += 1.0 / (ncells * ncells) ;
+            }
+            printf("#Iteration: %i\tTime: %f\tPolarization: %f\n", iter, iter*DELTAT, abp.order_parameter(SPEED)) ;
+            for(bin=0; bin< NBINS; bin++)
+                printf("%f\t%f\n", (bin+0.5)/NBINS, histo[bin]) ;
+            printf("\n\n") ;
+        }
+        abp.sense_velocities( DELTAT, v2 ) ;
+        com.update_velocities( v2 ) ;
+        com.periodic_move( DELTAT ) ;
+    }
+    free(count) ;
+    return 0;
+}
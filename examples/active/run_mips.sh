@@ -0,0 +1,10 @@
+#!/bin/bash
+# Active Brownian particles with soft-core repulsion
+# for several Peclet numbers: homogeneous at low Pe and
+# motility-induced phase separation at high Pe.
+
+mkdir -p logs
+for pe in 10 50 200 ; do
+    make abp_mips pe=$pe -B
+    ./abp_mips $RANDOM > logs/mips_pe${pe}.res
+done
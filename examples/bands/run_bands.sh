@@ -0,0 +1,9 @@
+#!/bin/bash
+# Density and velocity fields of the Vicsek model with metric
+# interaction near the transition, where bands form.
+
+mkdir -p logs
+for eta in 0.40 0.45 0.50 ; do
+    make vicsek_bands eta=$eta -B
+    ./vicsek_bands $RANDOM logs/fields_n${eta}.bin > logs/bands_n${eta}.res
+done
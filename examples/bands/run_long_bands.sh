@@ -0,0 +1,9 @@
+#!/bin/bash
+# Density profile along an elongated box of the Vicsek model with
+# metric interaction near the transition, where bands form.
+
+mkdir -p logs
+for eta in 0.40 0.45 0.50 ; do
+    make vicsek_bands_long eta=$eta -B
+    ./vicsek_bands_long $RANDOM > logs/long_bands_n${eta}.res
+done
@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG        20000
+#define NITER      20001
+#define TRANSIENT  10000
+#define OUTPUT       100
+// cells per dimension of the mesh for the fields (power of 2),
+// and 1 for cloud in cell deposit, 0 for nearest cell
+#define MESH_SIZE     64
+#define CIC            1
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.5
+#define DENSITY     2.
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+// if 3d:
+// #define  BOX_SIZE    pow( NAG / DENSITY , 1./3.)
+
+int main(int argc, char* argv[]){
+    int iter, c ;
+    double rho_max ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+
+    /* Set the random seed and output file */
+    long int seed ;
+    const char* fname = "fields.bin" ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    if(argc>2){ fname = argv[2] ; }
+    spp_set_seed( seed ) ;
+    FILE* out = fopen(fname, "wb") ;
+    if(out == NULL){
+        fprintf(stderr, "Cannot open %s\n", fname) ;
+        return 1 ;
+    }
+
+    /* Define behavior of agents */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Metric interaction = Metric( RADIUS , &g ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community, with a grid for the neighbors */
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid grid = Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.set_grid_tuning( 100 ) ;
+
+    /* Mesh and space for the fields */
+    Mesh mesh = Mesh( MESH_SIZE, BOX_SIZE ) ;
+    double* density = new double[mesh.get_num_cells()] ;
+    double* velocity = new double[mesh.get_num_cells() * 3] ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n# Mesh size         %i\n# Fields in         %s\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, seed, mesh.get_size(), fname) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            com.fields( &mesh, CIC, density, velocity) ;
+            mesh.write_frame( out, iter, density, velocity) ;
+            rho_max = 0.0 ;
+            for(c=0; c<mesh.get_num_cells(); c++)
+                rho_max = density[c] > rho_max ? density[c] : rho_max ;
+            printf("#Iteration: %i\tOrderpar: %f\tMax density: %f\n",iter,com.order_parameter(SPEED),rho_max) ;
+        }
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    fclose(out) ;
+    return 0;
+}
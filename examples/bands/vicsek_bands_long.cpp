@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG        20000
+#define NITER      20001
+#define TRANSIENT  10000
+#define OUTPUT      1000
+// bins of the density profile along the long side
+#define NBINS        200
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.5
+#define DENSITY     2.
+// the box is ASPECT times longer along x than along the other dimensions
+#define ASPECT      8.
+#define DIMENSION   2
+#define WIDTH       pow( NAG / DENSITY / ASPECT , 1./DIMENSION )
+// if 3d:
+// #define DIMENSION   3
+
+int main(int argc, char* argv[]){
+    int iter, i, bin ;
+    double lengths[3] = { ASPECT * WIDTH, WIDTH, WIDTH } ;
+    double meanvel[3] ;
+    double profile[NBINS] ;
+    double bin_volume = lengths[0] / NBINS ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    for(i=1; i<DIMENSION; i++)
+        bin_volume *= lengths[i] ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Define behavior of agents */
+    CartesianPeriodic g = CartesianPeriodic( lengths ) ;
+    Metric interaction = Metric( RADIUS , &g ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community in the rectangular box, with a grid for the neighbors */
+    Community com = spp_community_autostart( NAG , SPEED, lengths, &behavior ) ;
+    Grid grid = Grid( lengths , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.set_grid_tuning( 100 ) ;
+    com.tune_grid() ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f x %f\n# Random seed       %li\n# Grid slots        %i x %i\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, lengths[0], lengths[1], seed, grid.get_nslots(0), grid.get_nslots(1)) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            com.mean_velocity( meanvel ) ;
+            printf("#Iteration: %i\tOrderpar: %f\tMean vx: %f\n",iter,com.order_parameter(SPEED),meanvel[0]) ;
+            /* Density profile along the long side */
+            for(bin=0; bin< NBINS; bin++)
+                profile[bin] = 0.0 ;
+            for(i=0; i< NAG; i++){
+                bin = (int) ( com.get_pos()[i*DIMENSION] / lengths[0] * NBINS ) ;
+                profile[bin < NBINS ? bin : NBINS-1] += 1.0 ;
+            }
+            for(bin=0; bin< NBINS; bin++)
+                printf("%f\t%f\n", (bin+0.5)*lengths[0]/NBINS, profile[bin]/bin_volume) ;
+            printf("\n\n") ;
+        }
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    return 0;
+}
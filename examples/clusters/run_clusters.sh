@@ -0,0 +1,9 @@
+#!/bin/bash
+# Flock size distribution of the Vicsek model with metric
+# interaction for a few noise levels.
+
+mkdir -p logs
+for eta in 0.10 0.30 0.50 0.70 ; do
+    make vicsek_clusters eta=$eta -B
+    ./vicsek_clusters $RANDOM > logs/clusters_n${eta}.res
+done
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG         5000
+#define NITER       2001
+#define TRANSIENT   1000
+#define OUTPUT        10
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.05
+#define DENSITY     0.5
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+// if 3d:
+// #define  BOX_SIZE    pow( NAG / DENSITY , 1./3.)
+
+int main(int argc, char* argv[]){
+    int iter, s, num_clusters, largest ;
+    long int samples = 0 ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    int* labels     = new int[NAG] ;
+    int* sizes      = new int[NAG] ;
+    int* histo      = new int[NAG+1] ;
+    double* histo_sum = new double[NAG+1] ;
+    for(s=0; s<=NAG; s++) histo_sum[s] = 0.0 ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Define behavior of agents */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Metric interaction = Metric( RADIUS , &g ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community, with a grid for the neighbors */
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid grid = Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.set_grid_tuning( 100 ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, seed) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            /* Flocks: connected agents of the interaction network */
+            num_clusters = com.clusters(labels, sizes) ;
+            com.cluster_size_histo(num_clusters, sizes, histo) ;
+            largest = 0 ;
+            for(s=0; s<=NAG; s++){
+                histo_sum[s] += histo[s] ;
+                if(histo[s] > 0) largest = s ;
+            }
+            samples += 1 ;
+            printf("#Iteration: %i\tOrderpar: %f\tClusters: %i\tLargest: %i\n",iter,com.order_parameter(SPEED),num_clusters,largest) ;
+        }
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* Mean number of clusters of each size */
+    printf("\n# Size\tClusters\n") ;
+    for(s=1; s<=NAG; s++)
+        if(histo_sum[s] > 0)
+            printf("%i\t%f\n", s, histo_sum[s] / samples) ;
+    return 0;
+}
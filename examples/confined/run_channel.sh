@@ -0,0 +1,9 @@
+#!/bin/bash
+# Vicsek model with metric interaction in a channel,
+# periodic along x and with walls along y.
+
+mkdir -p logs
+for eta in 0.10 0.30 0.50 ; do
+    make vicsek_channel eta=$eta -B
+    ./vicsek_channel $RANDOM > logs/channel_n${eta}.res
+done
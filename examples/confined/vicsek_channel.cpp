@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG         4000
+#define NITER      20001
+#define TRANSIENT  10000
+#define OUTPUT      1000
+// bins of the density and velocity profiles across the channel
+#define NBINS         40
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.1
+#define DENSITY     2.
+// the channel is ASPECT times longer (x, periodic) than wide (y, walls)
+#define ASPECT      4.
+#define WIDTH       sqrt( NAG / DENSITY / ASPECT )
+
+int main(int argc, char* argv[]){
+    int iter, i, bin ;
+    double lengths[2] = { ASPECT * WIDTH, WIDTH } ;
+    int periodic[2] = { 1, 0 } ;
+    double meanvel[2] ;
+    double density[NBINS], flow[NBINS] ;
+    double bin_area = lengths[0] * lengths[1] / NBINS ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* pos ;
+    spp_real* vel ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Define behavior of agents, with the walls in the geometry */
+    CartesianWalled g = CartesianWalled( lengths, periodic ) ;
+    Metric interaction = Metric( RADIUS , &g ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community in the channel, with a grid for the neighbors */
+    Community com = spp_community_autostart( NAG , SPEED, lengths, &behavior ) ;
+    com.set_boundaries( periodic ) ;
+    Grid grid = Grid( lengths , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.set_grid_tuning( 100 ) ;
+    com.tune_grid() ;
+    pos = com.get_pos() ;
+    vel = com.get_vel() ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Channel           %f x %f\n# Random seed       %li\n# Grid slots        %i x %i\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, lengths[0], lengths[1], seed, grid.get_nslots(0), grid.get_nslots(1)) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.walled_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            com.mean_velocity( meanvel ) ;
+            printf("#Iteration: %i\tOrderpar: %f\tMean vx: %f\n",iter,com.order_parameter(SPEED),meanvel[0]) ;
+            /* Density and mean velocity along the channel
+             * as a function of the distance to the wall y=0
+             */
+            for(bin=0; bin< NBINS; bin++){
+                density[bin] = 0.0 ;
+                flow[bin] = 0.0 ;
+            }
+            for(i=0; i< NAG; i++){
+                bin = (int) ( pos[i*2 + 1] / lengths[1] * NBINS ) ;
+                bin = bin < NBINS ? bin : NBINS-1 ;
+                density[bin] += 1.0 ;
+                flow[bin] += vel[i*2] ;
+            }
+            for(bin=0; bin< NBINS; bin++)
+                printf("%f\t%f\t%f\n", (bin+0.5)*lengths[1]/NBINS, density[bin]/bin_area,
+                        density[bin] > 0 ? flow[bin]/density[bin] : 0.0) ;
+            printf("\n\n") ;
+        }
+        com.walled_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    return 0;
+}
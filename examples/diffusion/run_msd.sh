@@ -0,0 +1,10 @@
+#!/bin/bash
+# Mean squared displacement and velocity autocorrelation
+# of the Vicsek model with metric interaction for a few
+# noise levels.
+
+mkdir -p logs
+for eta in 0.10 0.30 0.50 0.70 ; do
+    make vicsek_msd eta=$eta -B
+    ./vicsek_msd $RANDOM > logs/msd_n${eta}.res
+done
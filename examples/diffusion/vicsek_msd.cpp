@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG         2000
+#define NITER       20001
+#define TRANSIENT   2000
+// lags up to MAX_LAG steps, NUM_LAGS of them logarithmically
+// spaced, with a time origin every ORIGIN_INTERVAL steps
+#define MAX_LAG          10000
+#define NUM_LAGS            40
+#define ORIGIN_INTERVAL    100
+#define MAX_ORIGINS (MAX_LAG / ORIGIN_INTERVAL + 1)
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.05
+#define DENSITY     4.
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+// if 3d:
+// #define  BOX_SIZE    pow( NAG / DENSITY , 1./3.)
+
+int main(int argc, char* argv[]){
+    int iter ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    int* images     = new int[NAG * 3] ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Define behavior of agents */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Metric interaction = Metric( RADIUS , &g ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community, with a grid for the neighbors */
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid grid = Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.set_grid_tuning( 100 ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, seed) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* Count the periodic images from now on */
+    com.setup_images( images ) ;
+    MSDTracker msd = MSDTracker( NAG, MAX_LAG, NUM_LAGS, ORIGIN_INTERVAL, MAX_ORIGINS ) ;
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        msd.add( &com ) ;
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    /* Lags in steps of DELTAT */
+    msd.print(stdout) ;
+    return 0;
+}
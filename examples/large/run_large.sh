@@ -0,0 +1,9 @@
+#!/bin/bash
+# Order parameter of a swarm of 10^6 agents (metric interaction)
+# for a few noise levels, each one using all the cores.
+
+mkdir -p logs
+for eta in 0.10 0.30 0.50 0.70 ; do
+    make vicsek_large eta=$eta -B
+    ./vicsek_large $RANDOM > logs/large_n${eta}.res
+done
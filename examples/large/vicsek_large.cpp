@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <thread>
+#include <libspp.h>
+
+#define NAG       1000000
+#define NITER        2001
+#define TRANSIENT    1000
+#define OUTPUT         50
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.05
+#define DENSITY     4.
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+// if 3d:
+// #define  BOX_SIZE    pow( NAG / DENSITY , 1./3.)
+
+int main(int argc, char* argv[]){
+    int iter, d ;
+
+    /* Set the random seed and number of domains (threads) */
+    long int seed ;
+    int num_domains ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    if(argc>2){ num_domains = atoi( argv[2]); }else{ num_domains = std::thread::hardware_concurrency() ; }
+    if(num_domains < 1) num_domains = 1 ;
+
+    /* Define behavior of agents, one per domain */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Behavior** behaviors = new Behavior*[num_domains] ;
+    for(d=0; d<num_domains; d++){
+        Metric* interaction = new Metric( RADIUS , &g ) ;
+        behaviors[d] = new Vicsek_consensus(interaction, SPEED, NOISE) ;
+    }
+
+    /* Create the domains, each with a pinned thread */
+    DomainCommunity com = DomainCommunity( NAG , BOX_SIZE, RADIUS, num_domains, behaviors, seed, 1) ;
+    com.randomize() ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n# Domains           %i\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, seed, com.get_num_domains()) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    com.run( TRANSIENT, DELTAT) ;
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter+=OUTPUT){
+        printf("#Iteration: %i\tOrderpar: %f\n",iter,com.order_parameter(SPEED)) ;
+        com.run( OUTPUT, DELTAT) ;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <mpi.h>
+#include <libspp.h>
+
+#define NAG       1000000
+#define NITER        2001
+#define TRANSIENT    1000
+#define OUTPUT         50
+#define N_BINS        100
+// the correlations are computed with the agents whose id is a
+// multiple of SAMPLE, NAG/SAMPLE of them, in O((NAG/SAMPLE)^2)
+#define SAMPLE        100
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.05
+#define DENSITY     4.
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+// if 3d:
+// #define  BOX_SIZE    pow( NAG / DENSITY , 1./3.)
+
+int main(int argc, char* argv[]){
+    int iter, i ;
+    double op ;
+    MPI_Init(&argc, &argv) ;
+
+    /* Set the random seed, the same in all the ranks */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    MPI_Bcast(&seed, 1, MPI_LONG, 0, MPI_COMM_WORLD) ;
+
+    /* Define behavior of agents */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Metric interaction = Metric( RADIUS , &g ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create the slab of this rank */
+    DistributedCommunity com = DistributedCommunity( NAG , BOX_SIZE, RADIUS, &behavior, seed) ;
+    com.randomize() ;
+    int root = com.get_rank() == 0 ;
+
+    /* Printout comments */
+    if(root)
+        printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n# Ranks             %i\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, seed, com.get_num_ranks()) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    com.run( TRANSIENT, DELTAT) ;
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter+=OUTPUT){
+        op = com.order_parameter(SPEED) ;
+        if(root)
+            printf("#Iteration: %i\tOrderpar: %f\n",iter,op) ;
+        com.run( OUTPUT, DELTAT) ;
+    }
+
+    /* Correlation of the final state, with a sample of the
+     * agents: all the pairs would take O(NAG^2) operations.
+     */
+    double* totalcorr = new double[N_BINS] ;
+    long* count = new long[N_BINS] ;
+    com.correlation_histo(N_BINS, SPEED, totalcorr, count, SAMPLE) ;
+    if(root){
+        printf("\n# Distance\tCorrelation\tCount\n") ;
+        for(i=0; i<N_BINS; i++)
+            printf("%f\t%f\t%li\n", (i+0.5)*com.max_distance()/N_BINS, totalcorr[i], count[i]) ;
+    }
+
+    MPI_Finalize() ;
+    return 0;
+}
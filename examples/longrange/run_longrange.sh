@@ -0,0 +1,9 @@
+#!/bin/bash
+# Vicsek model with alignment with all the agents, decaying
+# as a power law of the distance, for several exponents.
+
+mkdir -p logs
+for alpha in 1.0 2.0 3.0 4.0 ; do
+    make vicsek_longrange alpha=$alpha -B
+    ./vicsek_longrange $RANDOM > logs/longrange_a${alpha}.res
+done
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG         4096
+#define NITER       3001
+#define TRANSIENT   1000
+#define OUTPUT       100
+
+#define DELTAT      1.0
+#define SPEED       0.1
+#define NOISE       0.6
+#define DENSITY     1.
+#define DIMENSION   2
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+// the weight of an agent at distance r is (1 + (r/SCALE)^2)^(-EXPONENT/2).
+// EXPONENT is given at compilation (see Makefile)
+#define SCALE       1.0
+// opening parameter of the tree (0 for the exact sum)
+#define THETA       0.5
+
+int main(int argc, char* argv[]){
+    int iter, i, d ;
+    double mean_order = 0.0 ;
+    double err, max_err = 0.0 ;
+    int samples = 0 ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* v_exact = spp_community_alloc_space( NAG) ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Exponent          %f\n# Scale             %f\n# Theta             %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, (double) EXPONENT, SCALE, THETA, SPEED, NOISE, DELTAT, BOX_SIZE, seed) ;
+
+    /* The Behavior starts the community and adds the noise,
+     * the alignment is sensed with all the agents.
+     */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Metric interaction = Metric( SCALE , &g) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    LongRangeAlignment align = LongRangeAlignment( &com, &g, SPEED, SCALE, EXPONENT, THETA ) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        align.sense_velocities(v2) ;
+        behavior.add_noise(NAG, v2) ;
+        com.update_velocities(v2) ;
+        com.periodic_move( DELTAT) ;
+    }
+
+    /* Check the tree against the exact sum over all the
+     * pairs (theta = 0), with the nearest periodic images.
+     */
+    align.sense_velocities(v2) ;
+    align.set_theta(0.0) ;
+    align.sense_velocities(v_exact) ;
+    align.set_theta(THETA) ;
+    for(i=0; i< NAG; i++){
+        err = 0.0 ;
+        for(d=0; d< DIMENSION; d++)
+            err += (v2[i*DIMENSION + d] - v_exact[i*DIMENSION + d]) * (v2[i*DIMENSION + d] - v_exact[i*DIMENSION + d]) ;
+        err = sqrt(err) / SPEED ;
+        max_err = err > max_err ? err : max_err ;
+    }
+    printf("# Largest error of the tree  %f\n", max_err) ;
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            mean_order += com.order_parameter(SPEED) ;
+            samples += 1 ;
+            printf("%i\t%f\t%f\n", iter, com.order_parameter(SPEED), align.mean_terms()) ;
+        }
+        align.sense_velocities(v2) ;
+        behavior.add_noise(NAG, v2) ;
+        com.update_velocities(v2) ;
+        com.periodic_move( DELTAT) ;
+    }
+    printf("# Mean order parameter  %f\n", mean_order / samples) ;
+    return 0;
+}
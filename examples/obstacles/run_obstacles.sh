@@ -0,0 +1,9 @@
+#!/bin/bash
+# Vicsek model with metric interaction in a periodic
+# box with a square lattice of pillars to avoid.
+
+mkdir -p logs
+for eta in 0.10 0.30 0.50 ; do
+    make vicsek_obstacles eta=$eta -B
+    ./vicsek_obstacles $RANDOM > logs/obstacles_n${eta}.res
+done
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG         4000
+#define NITER      20001
+#define TRANSIENT  10000
+#define OUTPUT      1000
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.1
+// square lattice of NPILLARS x NPILLARS circular pillars
+#define NPILLARS       8
+#define SPACING       8.
+#define PILLAR        2.5
+// distance at which the agents see the pillars, and how
+// strongly they turn away from them. The pillars are not
+// periodic, so they are kept farther than AVOID_RANGE from
+// the boundaries of the box: SPACING/2 - PILLAR >= AVOID_RANGE
+#define AVOID_RANGE   1.5
+#define AVOID_WEIGHT  1.0
+#define BOX_SIZE    ( NPILLARS * SPACING )
+
+int main(int argc, char* argv[]){
+    int iter, i, j, near ;
+    double center[2], normal[2] ;
+    double meanvel[2] ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* pos ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Pillars           %i x %i, radius %f\n# Random seed       %li\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, NPILLARS, NPILLARS, PILLAR, seed) ;
+
+    /* Pillars in the middle of a square lattice */
+    Obstacles obstacles = Obstacles( NPILLARS * NPILLARS, AVOID_RANGE ) ;
+    for(i=0; i< NPILLARS; i++){
+        for(j=0; j< NPILLARS; j++){
+            center[0] = (i + 0.5) * SPACING ;
+            center[1] = (j + 0.5) * SPACING ;
+            obstacles.add_sphere( center, PILLAR ) ;
+        }
+    }
+
+    /* Define behavior of agents, that avoid the pillars */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Metric interaction = Metric( RADIUS , &g) ;
+    Vicsek_avoider behavior = Vicsek_avoider(&interaction, SPEED, NOISE, &obstacles, AVOID_WEIGHT) ;
+
+    /* Create community, with a grid for the neighbors.
+     * The agents placed inside a pillar are moved out of
+     * it in the first step, and bounce off the pillars
+     * when they reach them.
+     */
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid grid = Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.tune_grid() ;
+    com.setup_obstacles( &obstacles ) ;
+    pos = com.get_pos() ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            /* Agents that see some pillar */
+            near = 0 ;
+            for(i=0; i< NAG; i++)
+                if( obstacles.nearest( pos + i*2, normal) < AVOID_RANGE )
+                    near += 1 ;
+            com.mean_velocity( meanvel ) ;
+            printf("%i\t%f\t%f\t%f\t%f\n", iter, com.order_parameter(SPEED), meanvel[0], meanvel[1], (double) near / NAG) ;
+        }
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+# Vicsek model with metric interaction in open space,
+# with a hashed grid for the neighbors.
+
+mkdir -p logs
+for eta in 0.10 0.30 0.50 ; do
+    make vicsek_open eta=$eta -B
+    ./vicsek_open $RANDOM > logs/open_n${eta}.res
+done
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG       100000
+#define NITER       5001
+#define OUTPUT       100
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.1
+#define DENSITY     1.
+// size of the initial (square) swarm
+#define INIT_SIZE   sqrt( NAG / DENSITY )
+#define DIMENSION   2
+// if 3d:
+// #define  INIT_SIZE   pow( NAG / DENSITY , 1./3.)
+// #define  DIMENSION   3
+
+int main(int argc, char* argv[]){
+    int iter, i, d ;
+    double center[3], r2 ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* pos ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Initial size      %f\n# Random seed       %li\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, INIT_SIZE, seed) ;
+
+    /* Define behavior of agents, in open space */
+    Cartesian g = Cartesian( INIT_SIZE ) ;
+    Metric interaction = Metric( RADIUS , &g) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community, starting in a square, with a hashed
+     * grid for the neighbors, with cells as large as the range
+     * of the interaction wherever the agents go.
+     */
+    Community com = spp_community_autostart( NAG , SPEED, INIT_SIZE, &behavior ) ;
+    HashGrid grid = HashGrid( RADIUS , NAG ) ;
+    com.setup_grid( &grid ) ;
+    pos = com.get_pos() ;
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            /* Radius of gyration of the swarm */
+            com.mean_position( center ) ;
+            r2 = 0.0 ;
+            for(i=0; i< NAG; i++)
+                for(d=0; d< DIMENSION; d++)
+                    r2 += (pos[i*DIMENSION + d] - center[d]) * (pos[i*DIMENSION + d] - center[d]) ;
+            printf("%i\t%f\t%f\t%f\n", iter, com.order_parameter(SPEED), sqrt(r2 / NAG), grid.get_cell_size()) ;
+        }
+        com.move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    return 0;
+}
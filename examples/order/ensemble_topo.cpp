@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <libspp.h>
+
+/* Same calculation as vicsek_topo but with the number of agents,
+ * noise and seed of each run read at runtime from a parameter file,
+ * and all the runs done in a single process with a pool of threads.
+ * Usage:
+ *      ./ensemble_topo params.txt logs/topo_ [num_threads]
+ * Each line of params.txt is
+ *      seed    num_agents    noise
+ * and the result of line i is written to logs/topo_i.res
+ */
+
+#define NITER       10001
+// the transient ends when the order parameter is stationary,
+// after at least MIN_TRANSIENT and at most TRANSIENT iterations
+#define MIN_TRANSIENT    200
+#define TRANSIENT      20000
+#define OUTPUT         10
+
+#define DELTAT      1.0
+#define OUTDEGREE   7
+#define SHELL       16
+#define SPEED       0.05
+#define DENSITY     4.
+
+void run_topo(Replica* rep){
+    int iter ;
+    int nag = rep->num_agents ;
+    double box_size = sqrt( nag / DENSITY ) ;
+    // if 3d:
+    // double box_size = pow( nag / DENSITY , 1./3.) ;
+    spp_real* v2    = spp_community_alloc_space( nag) ;
+    spp_real* dist2 = spp_community_alloc_space( nag) ;
+
+    /* Define behavior of agents */
+    CartesianPeriodic g = CartesianPeriodic( box_size ) ;
+    Topologic interaction = Topologic( OUTDEGREE , &g , dist2) ;
+    if(SHELL > 0) interaction.setup_reuse( nag, SHELL ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, rep->noise) ;
+
+    /* Create community */
+    Community com = spp_community_autostart( nag , SPEED, box_size, &behavior ) ;
+
+    /* Printout comments */
+    fprintf(rep->out, "# Number of agents  %i\n# Outdegree         %i\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", nag, OUTDEGREE, SPEED, rep->noise, DELTAT, box_size, rep->seed) ;
+
+    /* Run until the order parameter is stationary
+     * to pass the transient state.
+     */
+    TransientDetector transient = TransientDetector( 5 ) ;
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+        transient.add( com.order_parameter(SPEED) ) ;
+        if( iter >= MIN_TRANSIENT && iter % 100 == 0 && transient.stationary() )
+            break ;
+    }
+    fprintf(rep->out, "# Transient         %i (equilibration time %li)\n", iter, transient.equilibration_time()) ;
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 )
+            fprintf(rep->out, "#Iteration: %i\tOrderpar: %f\n",iter,com.order_parameter(SPEED)) ;
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    /* the replicas run one after the other in each thread */
+    if(SHELL > 0) interaction.stop_reuse() ;
+    spp_community_free( &com ) ;
+    delete[] v2 ;
+    delete[] dist2 ;
+}
+
+int main(int argc, char* argv[]){
+    if(argc < 3){
+        fprintf(stderr, "Usage: %s param_file out_prefix [num_threads]\n", argv[0]) ;
+        return 1 ;
+    }
+    int num_threads = argc > 3 ? atoi(argv[3]) : 0 ;
+    Ensemble ens = Ensemble( argv[1], argv[2] ) ;
+    printf("# Running %i replicas\n", ens.get_num_replicas()) ;
+    int done = ens.run( run_topo, num_threads ) ;
+    printf("# Done %i replicas\n", done) ;
+    return 0;
+}
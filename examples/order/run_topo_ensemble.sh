@@ -0,0 +1,19 @@
+# Same as run_topo_serial.sh but all the noise levels
+# are run by a single executable using all the cores.
+#Location where to put the results
+outdir=$(pwd)/logs/
+mkdir -p $outdir
+# Number of threads (0 = as many as cores)
+nthreads=0
+
+nag=5000
+nois=`seq 0.05 0.05 1.0`
+
+params=${outdir}/topo_params.txt
+echo '# seed num_agents noise' > $params
+for noi in $nois ; do
+        echo $RANDOM$RANDOM $nag $noi >> $params
+done
+
+make ensemble_topo
+./ensemble_topo $params ${outdir}/topo_ $nthreads
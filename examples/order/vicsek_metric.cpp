@@ -6,8 +6,15 @@
 
 #define NAG         5000
 #define NITER       10001
-#define TRANSIENT    1000
+// the transient ends when the order parameter is stationary,
+// after at least MIN_TRANSIENT and at most TRANSIENT iterations
+#define MIN_TRANSIENT    200
+#define TRANSIENT      20000
 #define OUTPUT         10
+// autocorrelation window, and error of the mean order
+// parameter at which to stop (0 = always run NITER)
+#define MAX_LAG      1000
+#define TARGET_ERROR  0.0
 
 #define DELTAT      1.0
 #define RADIUS      1.0
@@ -19,7 +26,8 @@
 
 int main(int argc, char* argv[]){
     int iter ;
-    double* v2    = spp_community_alloc_space( NAG) ;
+    double op ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
 
     /* Set the random seed */
     long int seed ;
@@ -37,24 +45,36 @@ int main(int argc, char* argv[]){
     /* Printout comments */
     printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, seed) ;
 
-    /* Run some iterations to pass the
-     * transient state.
+    /* Run until the order parameter is stationary
+     * to pass the transient state.
      */
+    TransientDetector transient = TransientDetector( 5 ) ;
     for(iter=0; iter< TRANSIENT; iter++){
         com.periodic_move( DELTAT) ;
         com.sense_noisy_velocities(v2) ;
         com.update_velocities(v2) ;
+        transient.add( com.order_parameter(SPEED) ) ;
+        if( iter >= MIN_TRANSIENT && iter % 100 == 0 && transient.stationary() )
+            break ;
     }
+    printf("# Transient         %i (equilibration time %li)\n", iter, transient.equilibration_time()) ;
 
     /* MAIN LOOP */
+    OnlineStats stats = OnlineStats( MAX_LAG ) ;
     for(iter=0; iter< NITER; iter++){
+        op = com.order_parameter(SPEED) ;
+        stats.add(op) ;
         if( iter % OUTPUT == 0 ){
-            printf("#Iteration: %i\tOrderpar: %f\n",iter,com.order_parameter(SPEED)) ;
+            printf("#Iteration: %i\tOrderpar: %f\n",iter,op) ;
             //com.print_posvel() ;
+            if( TARGET_ERROR > 0 && stats.converged(TARGET_ERROR) )
+                break ;
         }
         com.periodic_move( DELTAT) ;
         com.sense_noisy_velocities(v2) ;
         com.update_velocities(v2) ;
     }
+    printf("\n") ;
+    stats.print(stdout) ;
     return 0;
 }
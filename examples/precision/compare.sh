@@ -0,0 +1,31 @@
+# Compare the order parameter statistics of the double and
+# single precision builds of libspp for a few noise values.
+# Each noise value is run with NSEEDS different seeds for each
+# precision, and the mean order parameter of every run is
+# used to compute the mean and standard error per precision.
+# The difference between both means should be compatible with
+# zero within the errors.
+#
+# Requires the single precision libraries:
+#   cd ../../src/ && make single
+#
+outdir=$(pwd)/logs/
+mkdir -p $outdir
+
+nois="0.10 0.30 0.50 0.70"
+seeds=`seq 1 5`
+
+printf "#noise\tmean_double\terr_double\tmean_single\terr_single\tdiff/err\n"
+for noi in $nois ; do
+    make -s vicsek_double eta=$noi
+    make -s vicsek_single eta=$noi
+    for prec in double single ; do
+        for seed in $seeds ; do
+            ./vicsek_$prec $seed > $outdir/${prec}_n${noi}_s${seed}.res
+        done
+    done
+    rm vicsek_double vicsek_single
+    for prec in double single ; do
+        cat $outdir/${prec}_n${noi}_s*.res | awk '/#Mean:/{s+=$2; s2+=$2*$2; n+=1} END{m=s/n; printf "%f %f ", m, sqrt((s2/n-m*m)/(n-1))}'
+    done | awk -v noi=$noi '{e=sqrt($2*$2+$4*$4); printf "%s\t%f\t%f\t%f\t%f\t%f\n", noi, $1, $2, $3, $4, (e>0)?($1-$3)/e:0}'
+done
@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG         1024
+#define NITER       10001
+#define TRANSIENT    2000
+#define OUTPUT         10
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.05
+#define DENSITY     2.
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+
+
+int main(int argc, char* argv[]){
+    int iter ;
+    double op ;
+    /* Only the mean and the spread are needed,
+     * so the autocorrelation is not computed.
+     */
+    OnlineStats stats = OnlineStats( 0 ) ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Define behavior of agents */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Metric interaction = Metric( RADIUS , &g) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community */
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid* grid = new Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( grid) ;
+    com.set_grid_tuning( 100 ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n# Precision         %s\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, seed, sizeof(spp_real)==sizeof(float)?"single":"double") ;
+
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            op = com.order_parameter(SPEED) ;
+            stats.add(op) ;
+            printf("#Iteration: %i\tOrderpar: %f\n",iter,op) ;
+        }
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    printf("#Mean: %f\tStd: %f\n", stats.mean(), sqrt(stats.variance())) ;
+    return 0;
+}
@@ -19,7 +19,7 @@
 
 int main(int argc, char* argv[]){
     int iter ;
-    double* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
     int death, avoidance_time = 0;
 
     /* Set the random seed */
@@ -39,27 +39,33 @@ int main(int argc, char* argv[]){
 
     /* Create community */
     HostileEnvironment com = spp_hostile_autostart( NAG , SPEED, BOX_SIZE, &prey_beh , 1 , &pred_beh ) ;
-    int nslots = (int) BOX_SIZE / RADIUS ;
-    Grid* grid ;
-    if( nslots > 3 ){
-        try{
-            grid = new Grid( nslots , BOX_SIZE , NAG ) ;
-            com.setup_grid( grid) ;
-            printf("# Using grid with %i slots/dim.\n", nslots) ;
-        }catch(...){
-        printf("# Failed to use grid with %i slots/dim.\n", nslots) ;
-        }
-    }else{
-        printf("# Too few slots per dimension (%i).\n", nslots) ;
-    }
+    /* Use grid, with slots as small as the interaction range */
+    Grid* grid = new Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( grid) ;
+    com.set_grid_tuning( 100 ) ;
+    printf("# Using grid with %i slots/dim.\n", com.tune_grid()) ;
     
     for(iter=0; iter< TRANSIENT; iter++){
         com.periodic_move( DELTAT) ;
         com.sense_noisy_velocities(v2) ;
         com.update_velocities(v2) ;
     }
+
+    /* Optionally, log the events of the attack (kills, preys
+     * that start fleeing and changes of target) to argv[2].
+     */
+    FILE* evfile = NULL ;
+    EventLog* events = NULL ;
+    if(argc>2){
+        evfile = fopen( argv[2], "wb") ;
+        if(!evfile){ fprintf(stderr,"Could not open %s.\n", argv[2]); abort() ;}
+        events = new EventLog( evfile, 4096 ) ;
+        com.setup_events( events ) ;
+    }
  
     for(iter=0; iter< NITER; iter++){
+        if(events)
+            events->set_step( iter ) ;
         if( iter % OUTPUT == 0 ){
             printf("#Iteration: %i\tNum agents: %i\n", iter, com.get_num_agents() ) ;
         }
@@ -74,5 +80,9 @@ int main(int argc, char* argv[]){
         com.sense_noisy_velocities_danger(v2) ;
         com.update_velocities(v2) ;
     }
+    if(events){
+        events->flush() ;
+        fclose( evfile ) ;
+    }
     return 0;
 }
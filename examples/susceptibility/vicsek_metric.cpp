@@ -7,7 +7,10 @@
 #define NAG         1024
 #define NITER       750000
 #define OUTPUT        1000
-#define TRANSIENT    20000
+// the transient ends when the order parameter is stationary,
+// after at least MIN_TRANSIENT and at most TRANSIENT iterations
+#define MIN_TRANSIENT   2000
+#define TRANSIENT     200000
 
 #define DELTAT      1.0
 #define SPEED       0.04
@@ -16,10 +19,13 @@
 #define NOISE       0.05
 
 #define NBINS       200
+// cells per dimension of the mesh to compute the correlations
+// with FFTs (power of 2), or 0 to use all the pairs of agents
+#define MESH_SIZE     0
 
 int main(int argc, char* argv[]){
     int iter, bin ;
-    double* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
     double totalcorr[NBINS] ;
     int count[NBINS] ;
     double maxdis ;
@@ -39,33 +45,37 @@ int main(int argc, char* argv[]){
     /* Create community */
     Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior) ;
     maxdis = com.max_distance() ;
-    /* Use grid */
-    int nslots = (int) BOX_SIZE / RADIUS ;
-    if (nslots > 50 )
-        nslots = 50 ; // Above 50 slots there's little speed gain in the calculation.
-    Grid* grid ;
-    if( nslots > 3 ){
-        try{
-            grid = new Grid( nslots , BOX_SIZE , NAG ) ;
-            com.setup_grid( grid) ;
-            printf("# Using grid with %i slots/dim.\n", nslots) ;
-        }catch(...){
-        printf("# Failed to use grid with %i slots/dim.\n", nslots) ;
-        }
-    }else{
-        printf("# Too few slots per dimension (%i).\n", nslots) ;
-    }
+    /* Use grid, with slots as small as the interaction range */
+    Grid* grid = new Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( grid) ;
+    com.set_grid_tuning( 100 ) ;
+    printf("# Using grid with %i slots/dim.\n", com.tune_grid()) ;
 
+    /* Run until the order parameter is stationary
+     * to pass the transient state.
+     */
+    TransientDetector transient = TransientDetector( 5 ) ;
     for(iter=0; iter< TRANSIENT; iter++){
         com.periodic_move( DELTAT) ;
         com.sense_noisy_velocities(v2) ;
         com.update_velocities(v2) ;
+        transient.add( com.order_parameter(SPEED) ) ;
+        if( iter >= MIN_TRANSIENT && iter % 100 == 0 && transient.stationary() )
+            break ;
     }
+    printf("# Transient         %i (equilibration time %li)\n", iter, transient.equilibration_time()) ;
+
+    Mesh* mesh = NULL ;
+    if( MESH_SIZE > 0 )
+        mesh = new Mesh( MESH_SIZE , BOX_SIZE ) ;
 
     for(iter=0; iter< NITER; iter++){
         if( iter % OUTPUT == 0 ){
             printf("#Iteration: %i\tOrderpar: %f\n",iter,com.order_parameter(SPEED)) ;
-            com.correlation_histo(NBINS, SPEED, totalcorr, count) ;
+            if( MESH_SIZE > 0 )
+                com.correlation_histo_fft(NBINS, SPEED, mesh, totalcorr, count) ;
+            else
+                com.correlation_histo(NBINS, SPEED, totalcorr, count) ;
             for(bin=0; bin< NBINS; bin++)
                 printf("%f\t%f\t%i\n", (bin+0.5)*maxdis/NBINS ,totalcorr[bin], count[bin]) ;
             printf("\n\n") ;
@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+/* Same as vicsek_metric but running NREP independent replicas at once
+ * with ReplicaCommunity. The output of replica r, in the same format as
+ * vicsek_metric, is written to <prefix>r.res (prefix given as second
+ * argument, "replica_" by default), so each file can be processed with
+ * get_chis.sh .
+ */
+
+#define NAG         1024
+#define NREP        8
+#define NITER       750000
+#define OUTPUT        1000
+#define TRANSIENT    20000
+
+#define DELTAT      1.0
+#define SPEED       0.04
+#define DENSITY     1.
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+#define NOISE       0.05
+
+#define NBINS       200
+
+int main(int argc, char* argv[]){
+    int iter, bin, r ;
+    spp_real* pos = spp_replica_alloc_space( NAG, NREP) ;
+    spp_real* vel = spp_replica_alloc_space( NAG, NREP) ;
+    spp_real* v2  = spp_replica_alloc_space( NAG, NREP) ;
+    double totalcorr[NBINS*NREP] ;
+    int count[NBINS*NREP] ;
+    double op[NREP] ;
+    double maxdis ;
+    long int seeds[NREP] ;
+    FILE* out[NREP] ;
+    char name[256] ;
+
+    /* Set the random seed of each replica */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    const char* prefix = argc>2 ? argv[2] : "replica_" ;
+    for(r=0; r<NREP; r++)
+        seeds[r] = seed + r ;
+
+    ReplicaCommunity com = ReplicaCommunity( NAG, NREP, BOX_SIZE, pos, vel, RADIUS, SPEED, NOISE) ;
+    com.set_seeds(seeds) ;
+    com.randomize_positions() ;
+    com.randomize_directions(SPEED) ;
+    maxdis = com.max_distance() ;
+
+    /* Printout comments */
+    for(r=0; r<NREP; r++){
+        sprintf(name, "%s%i.res", prefix, r) ;
+        out[r] = fopen(name, "w") ;
+        fprintf(out[r], "# Number of agents  %i\n# Metric radius     %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n# Replica           %i of %i\n\n", NAG, RADIUS, SPEED, NOISE, DELTAT, BOX_SIZE, seeds[r], r, NREP) ;
+    }
+
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            com.order_parameter(SPEED, op) ;
+            com.correlation_histo(NBINS, SPEED, totalcorr, count) ;
+            for(r=0; r<NREP; r++){
+                fprintf(out[r], "#Iteration: %i\tOrderpar: %f\n",iter,op[r]) ;
+                for(bin=0; bin< NBINS; bin++)
+                    fprintf(out[r], "%f\t%f\t%i\n", (bin+0.5)*maxdis/NBINS ,totalcorr[r*NBINS+bin], count[r*NBINS+bin]) ;
+                fprintf(out[r], "\n\n") ;
+            }
+        }
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    for(r=0; r<NREP; r++)
+        fclose(out[r]) ;
+    return 0;
+}
@@ -7,7 +7,10 @@
 #define NAG         1024
 #define NITER      5000001
 #define OUTPUT       10000
-#define TRANSIENT    20000
+// the transient ends when the order parameter is stationary,
+// after at least MIN_TRANSIENT and at most TRANSIENT iterations
+#define MIN_TRANSIENT   2000
+#define TRANSIENT     200000
 
 #define DELTAT      1.0
 #define SPEED       0.04
@@ -18,7 +21,7 @@
 #define NBINS       200
 int main(int argc, char* argv[]){
     int iter, bin ;
-    double* v2    = spp_community_alloc_space(NAG ) ;
+    spp_real* v2    = spp_community_alloc_space(NAG ) ;
     double totalcorr[NBINS] ;
     int count[NBINS] ;
     double maxdis ;
@@ -49,10 +52,18 @@ int main(int argc, char* argv[]){
     /* Printout comments */
     printf("# Number of agents  %i\n# Grid connections  %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, mean_neis, SPEED, NOISE, DELTAT, BOX_SIZE, seed) ;
 
+    /* Run until the order parameter is stationary
+     * to pass the transient state.
+     */
+    TransientDetector transient = TransientDetector( 5 ) ;
     for(iter=0; iter< TRANSIENT; iter++){
         com.sense_noisy_velocities(v2) ;
         com.update_velocities(v2) ;
+        transient.add( com.order_parameter(SPEED) ) ;
+        if( iter >= MIN_TRANSIENT && iter % 100 == 0 && transient.stationary() )
+            break ;
     }
+    printf("# Transient         %i (equilibration time %li)\n", iter, transient.equilibration_time()) ;
 
     for(iter=0; iter< NITER; iter++){
         if( iter % OUTPUT == 0 ){
@@ -7,7 +7,10 @@
 #define NAG         1024
 #define NITER       300000
 #define OUTPUT        1000
-#define TRANSIENT    10000
+// the transient ends when the order parameter is stationary,
+// after at least MIN_TRANSIENT and at most TRANSIENT iterations
+#define MIN_TRANSIENT   2000
+#define TRANSIENT     100000
 
 #define DELTAT      1.0
 #define SPEED       0.04
@@ -18,8 +21,8 @@
 #define NBINS       200
 int main(int argc, char* argv[]){
     int iter, bin ;
-    double* v2    = spp_community_alloc_space( NAG) ;
-    double* dist2 = spp_community_alloc_space( NAG) ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* dist2 = spp_community_alloc_space( NAG) ;
     double totalcorr[NBINS] ;
     int count[NBINS] ;
     double maxdis ;
@@ -39,28 +42,27 @@ int main(int argc, char* argv[]){
     /* Create community */
     Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior) ;
     maxdis = com.max_distance() ;
-    /* Use grid */
-    int nslots = (int) sqrt( (0.5 * NAG ) / OUTDEGREE ) ;
-    if (nslots > 50 )
-        nslots = 50 ; // Above 50 slots there's little speed gain in the calculation.
-    Grid* grid ;
-    if( nslots > 3 ){
-        try{
-            grid = new Grid( nslots , BOX_SIZE , NAG ) ;
-            com.setup_grid( grid) ;
-            printf("# Using grid with %i slots/dim.\n", nslots) ;
-        }catch(...){
-        printf("# Failed to use grid with %i slots/dim.\n", nslots) ;
-        }
-    }else{
-        printf("# Too few slots per dimension (%i).\n", nslots) ;
-    }
+    /* Use grid, with slots tuned to the distance to the
+     * farthest neighbor as the swarm evolves.
+     */
+    Grid* grid = new Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( grid) ;
+    com.set_grid_tuning( 100 ) ;
 
+    /* Run until the order parameter is stationary
+     * to pass the transient state.
+     */
+    TransientDetector transient = TransientDetector( 5 ) ;
     for(iter=0; iter< TRANSIENT; iter++){
         com.periodic_move( DELTAT) ;
         com.sense_noisy_velocities(v2) ;
         com.update_velocities(v2) ;
+        transient.add( com.order_parameter(SPEED) ) ;
+        if( iter >= MIN_TRANSIENT && iter % 100 == 0 && transient.stationary() )
+            break ;
     }
+    printf("# Transient         %i (equilibration time %li)\n", iter, transient.equilibration_time()) ;
+    printf("# Using grid with %i slots/dim.\n", grid->get_nslots()) ;
 
     for(iter=0; iter< NITER; iter++){
         if( iter % OUTPUT == 0 ){
@@ -0,0 +1,9 @@
+#!/bin/bash
+# Vicsek model with metric interaction and a blind
+# cone behind the agents, for several blind angles.
+
+mkdir -p logs
+for blind in 0 60 120 180 240 ; do
+    make vicsek_vision blind=$blind -B
+    ./vicsek_vision $RANDOM > logs/vision_b${blind}.res
+done
@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG         4096
+#define NITER      10001
+#define TRANSIENT   5000
+#define OUTPUT       500
+
+#define DELTAT      1.0
+#define RADIUS      1.0
+#define SPEED       0.1
+#define NOISE       0.3
+#define DENSITY     2.
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+// total angle of the blind cone behind the agents, in degrees.
+// BLIND_DEG is given at compilation (see Makefile)
+#define BLIND       ( BLIND_DEG / 180. * M_PI )
+
+int main(int argc, char* argv[]){
+    int iter ;
+    double mean_order = 0.0 ;
+    int samples = 0 ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Blind angle       %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, RADIUS, BLIND, SPEED, NOISE, DELTAT, BOX_SIZE, seed) ;
+
+    /* Define behavior of agents, that only see the
+     * agents closer than RADIUS in their field of view.
+     */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    MetricCone interaction = MetricCone( RADIUS , BLIND, &g) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community, with a grid for the neighbors */
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid grid = Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.set_grid_tuning( 100 ) ;
+    com.tune_grid() ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            mean_order += com.order_parameter(SPEED) ;
+            samples += 1 ;
+            printf("%i\t%f\t%i\n", iter, com.order_parameter(SPEED), grid.get_nslots()) ;
+        }
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    printf("# Mean order parameter  %f\n", mean_order / samples) ;
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+// Check of the neighbors of MetricCone and TopologicCone found
+// in the neighborhoods of a Grid skipping the slots behind the
+// agents against those found testing all the candidates, in a
+// periodic box and in a box with walls. Then the time per step
+// of Metric, MetricCone, Topologic and TopologicCone with a Grid.
+#define NAG         4096
+#define NSTEPS       200
+#define RADIUS      1.0
+#define SPEED       0.1
+#define NOISE       0.3
+#define DENSITY     2.
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+#define KNEIS       6
+// total angle of the blind cone behind the agents
+#define BLIND       ( M_PI / 2. )
+
+/* Return the number of agents whose neighbors differ skipping
+ * the slots or not, after a few steps of the Community.
+ */
+int check(Interaction* inter, int* periodic){
+    int i, j, k, n, nn, nn_grid, found, errors = 0 ;
+    Agent* neighborhood ;
+    Agent** neis      = new Agent*[NAG] ;
+    Agent** neis_grid = new Agent*[NAG] ;
+    spp_real* v2 = spp_community_alloc_space( NAG ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(inter, SPEED, NOISE) ;
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid grid = Grid( BOX_SIZE , NAG ) ;
+    Agent* ags = com.get_agents() ;
+    com.set_boundaries( periodic ) ;
+    com.setup_grid( &grid ) ;
+    for(i=0; i<20; i++){
+        com.sense_velocities(v2) ;
+        com.update_velocities(v2) ;
+        com.walled_move( 1.0 ) ;
+    }
+    grid.tune( 4.0 * RADIUS , NAG ) ;
+    com.fill_grid() ;
+    for(i=0; i<NAG; i++){
+        neighborhood = grid.get_neighborhood( ags + i, &n ) ;
+        inter->set_grid( NULL ) ;
+        nn = inter->get_neighbors( ags + i, n, neighborhood, neis) ;
+        inter->set_grid( &grid ) ;
+        nn_grid = inter->get_neighbors( ags + i, n, neighborhood, neis_grid) ;
+        found = nn == nn_grid ;
+        for(j=0; j<nn && found; j++){
+            found = 0 ;
+            for(k=0; k<nn_grid; k++)
+                found |= neis[j]->get_pos() == neis_grid[k]->get_pos() ;
+        }
+        errors += !found ;
+    }
+    delete[] neis ;
+    delete[] neis_grid ;
+    return errors ;
+}
+
+/* Return the time per step (ms) of the Vicsek model with *inter*. */
+double time_steps(Interaction* inter){
+    clock_t t0 = clock() ;
+    spp_real* v2 = spp_community_alloc_space( NAG ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(inter, SPEED, NOISE) ;
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+    Grid grid = Grid( BOX_SIZE , NAG ) ;
+    com.setup_grid( &grid ) ;
+    com.set_grid_tuning( 10 ) ;
+    for(int i=0; i<NSTEPS; i++){
+        if(i == NSTEPS / 2)
+            t0 = clock() ;
+        com.periodic_move( 1.0 ) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    return 1000.0 * (clock() - t0) / CLOCKS_PER_SEC / (NSTEPS - NSTEPS / 2) ;
+}
+
+int main(int argc, char* argv[]){
+    spp_real* dd = new spp_real[NAG] ;
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+    printf("# Number of agents  %i\n# Metric radius     %f\n# Neighbors         %i\n# Blind angle       %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, RADIUS, KNEIS, BLIND, BOX_SIZE, seed) ;
+
+    double lengths[SPP_MAX_DIM] = { BOX_SIZE, BOX_SIZE, BOX_SIZE } ;
+    int periodic[SPP_MAX_DIM] = { 1, 1, 1 } ;
+    int walls[SPP_MAX_DIM] = { 0, 0, 0 } ;
+    CartesianPeriodic gp = CartesianPeriodic( BOX_SIZE ) ;
+    CartesianWalled gw = CartesianWalled( lengths, walls ) ;
+    MetricCone    mc_p = MetricCone( RADIUS , BLIND, &gp) ;
+    MetricCone    mc_w = MetricCone( RADIUS , BLIND, &gw) ;
+    TopologicCone tc_p = TopologicCone( KNEIS , BLIND, &gp, dd) ;
+    TopologicCone tc_w = TopologicCone( KNEIS , BLIND, &gw, dd) ;
+    printf("# agents with different neighbors\n") ;
+    printf("MetricCone periodic\t%i\n", check(&mc_p, periodic)) ;
+    printf("MetricCone walls\t%i\n", check(&mc_w, walls)) ;
+    printf("TopologicCone periodic\t%i\n", check(&tc_p, periodic)) ;
+    printf("TopologicCone walls\t%i\n", check(&tc_w, walls)) ;
+
+    Metric    m = Metric( RADIUS , &gp) ;
+    Topologic t = Topologic( KNEIS , &gp, dd) ;
+    printf("\n# time per step (ms)\n") ;
+    printf("Metric\t%f\n", time_steps(&m)) ;
+    printf("MetricCone\t%f\n", time_steps(&mc_p)) ;
+    printf("Topologic\t%f\n", time_steps(&t)) ;
+    printf("TopologicCone\t%f\n", time_steps(&tc_p)) ;
+    return 0;
+}
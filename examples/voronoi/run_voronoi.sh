@@ -0,0 +1,12 @@
+#!/bin/bash
+# Vicsek model with Voronoi interaction for several
+# numbers of agents at the same density. In the
+# smallest boxes the cells reach further than half
+# the box, and the periodic images of the agents
+# shape them too.
+
+mkdir -p logs
+for nag in 4 16 64 256 ; do
+    make vicsek_voronoi nag=$nag -B
+    ./vicsek_voronoi $RANDOM > logs/voronoi_n${nag}.res
+done
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+// NAG is given at compilation (see Makefile)
+#define NITER       5001
+#define TRANSIENT   2000
+#define OUTPUT       100
+
+#define DELTAT      1.0
+#define SPEED       0.1
+#define NOISE       0.3
+#define DENSITY     0.5
+#define BOX_SIZE    sqrt( NAG / DENSITY )
+
+int main(int argc, char* argv[]){
+    int iter ;
+    double mean_order = 0.0 ;
+    int samples = 0 ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Box size          %f\n# Random seed       %li\n\n", NAG, SPEED, NOISE, DELTAT, BOX_SIZE, seed) ;
+
+    /* Define behavior of agents, that align with
+     * the agents whose Voronoi cell touches their own.
+     */
+    CartesianPeriodic g = CartesianPeriodic( BOX_SIZE ) ;
+    Voronoi interaction = Voronoi( &g , NAG ) ;
+    Vicsek_consensus behavior = Vicsek_consensus(&interaction, SPEED, NOISE) ;
+
+    /* Create community. Without a Grid every agent
+     * is a candidate, which is fine for small swarms.
+     */
+    Community com = spp_community_autostart( NAG , SPEED, BOX_SIZE, &behavior ) ;
+
+    /* Run some iterations to pass the
+     * transient state.
+     */
+    for(iter=0; iter< TRANSIENT; iter++){
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            mean_order += com.order_parameter(SPEED) ;
+            samples += 1 ;
+            printf("%i\t%f\n", iter, com.order_parameter(SPEED)) ;
+        }
+        com.periodic_move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    printf("# Mean order parameter  %f\n", mean_order / samples) ;
+    return 0;
+}
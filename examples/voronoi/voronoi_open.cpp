@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+// Check of the Voronoi neighbors in open space (2D only)
+// against the Delaunay triangulation found by brute force:
+// two agents are connected if they are in a triangle whose
+// circumcircle has no other agent inside.
+#define NAG         40
+#define NCONFIGS    20
+// the agents are spread over a region much larger than
+// the length given to the geometry, which must not matter
+#define SPREAD      10.
+#define LENGTH      1.
+
+/* Return 1 if *d* is inside the circumcircle of a, b, c. */
+int in_circle(spp_real* a, spp_real* b, spp_real* c, spp_real* d){
+    double ax = a[0]-d[0], ay = a[1]-d[1] ;
+    double bx = b[0]-d[0], by = b[1]-d[1] ;
+    double cx = c[0]-d[0], cy = c[1]-d[1] ;
+    double det = (ax*ax + ay*ay) * (bx*cy - cx*by)
+               - (bx*bx + by*by) * (ax*cy - cx*ay)
+               + (cx*cx + cy*cy) * (ax*by - bx*ay) ;
+    double orient = (b[0]-a[0]) * (c[1]-a[1]) - (b[1]-a[1]) * (c[0]-a[0]) ;
+    return orient > 0 ? det > 0 : det < 0 ;
+}
+
+/* Store in *adj* (n x n) the Delaunay edges of the n agents at *pos*. */
+void delaunay(int n, spp_real* pos, int* adj){
+    int i, j, k, l, empty ;
+    for(i=0; i<n*n; i++)
+        adj[i] = 0 ;
+    for(i=0; i<n; i++)
+        for(j=i+1; j<n; j++)
+            for(k=j+1; k<n; k++){
+                empty = 1 ;
+                for(l=0; l<n && empty; l++)
+                    if(l != i && l != j && l != k && in_circle(pos + 2*i, pos + 2*j, pos + 2*k, pos + 2*l))
+                        empty = 0 ;
+                if(empty)
+                    adj[i*n+j] = adj[j*n+i] = adj[i*n+k] = adj[k*n+i] = adj[j*n+k] = adj[k*n+j] = 1 ;
+            }
+}
+
+/* Return the number of pairs of agents where Voronoi and the brute force disagree. */
+int check(int n, spp_real* pos){
+    int i, j, k, nn, found, errors = 0 ;
+    Agent* ags = new Agent[n] ;
+    Agent** neis = new Agent*[n] ;
+    spp_real* vel = new spp_real[2*n] ;
+    int* adj = new int[n*n] ;
+    Cartesian g = Cartesian( LENGTH ) ;
+    Voronoi interaction = Voronoi( &g , n ) ;
+    for(i=0; i<n; i++)
+        ags[i] = Agent(pos + 2*i, vel + 2*i, neis, NULL) ;
+    delaunay(n, pos, adj) ;
+    for(i=0; i<n; i++){
+        nn = interaction.get_neighbors(ags + i, n, ags, neis) ;
+        for(j=0; j<n; j++){
+            if(j == i)
+                continue ;
+            found = 0 ;
+            for(k=0; k<nn; k++)
+                found |= neis[k]->get_pos() == pos + 2*j ;
+            errors += found != adj[i*n+j] ;
+        }
+    }
+    delete[] ags ;
+    delete[] neis ;
+    delete[] vel ;
+    delete[] adj ;
+    return errors ;
+}
+
+int main(int argc, char* argv[]){
+    int ic, i, errors ;
+    spp_real pos[2*NAG] ;
+    /* three agents much further apart than LENGTH */
+    spp_real three[6] = { 0., 0.,   3., 0.,   1.5, 5. } ;
+
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+    printf("# Number of agents  %i\n# Spread            %f\n# Geometry length   %f\n# Random seed       %li\n\n", NAG, SPREAD, LENGTH, seed) ;
+
+    printf("three agents\t%i\n", check(3, three)) ;
+    errors = 0 ;
+    for(ic=0; ic< NCONFIGS; ic++){
+        for(i=0; i<2*NAG; i++)
+            pos[i] = SPREAD * spp_random_uniform() ;
+        errors += check(NAG, pos) ;
+    }
+    printf("%i random configurations\t%i\n", NCONFIGS, errors) ;
+    return 0;
+}
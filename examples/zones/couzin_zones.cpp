@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <libspp.h>
+
+#define NAG          500
+#define NITER       5001
+#define OUTPUT       100
+
+#define DELTAT       0.1
+#define SPEED        3.0
+#define NOISE       0.01
+// width of each zone, in units of the repulsion radius.
+// ORIENTATION is given at compilation (see Makefile)
+#define REPULSION    1.0
+#define ATTRACTION  14.0
+#define R_REP       ( REPULSION )
+#define R_ORI       ( R_REP + ORIENTATION )
+#define R_ATT       ( R_ORI + ATTRACTION )
+// the agents are blind in a cone of 90 degrees behind them
+#define BLIND       ( 0.5 * M_PI )
+// and turn at most 40 degrees per unit time
+#define MAX_TURN    ( 40. / 180. * M_PI * DELTAT )
+// size of the initial (square) swarm
+#define INIT_SIZE   20.
+#define DIMENSION   2
+// if 3d:
+// #define  DIMENSION   3
+
+int main(int argc, char* argv[]){
+    int iter, i, d ;
+    double center[3], rel[3], mom[3], r ;
+    spp_real* v2    = spp_community_alloc_space( NAG) ;
+    spp_real* pos ;
+    spp_real* vel ;
+
+    /* Set the random seed */
+    long int seed ;
+    if(argc>1){ seed = atol( argv[1]); }else{ seed = time(NULL) ; }
+    spp_set_seed( seed ) ;
+
+    /* Printout comments */
+    printf("# Number of agents  %i\n# Zone radii        %f %f %f\n# Blind angle       %f\n# Speed             %f\n# Noise             %f\n# Time step         %f\n# Random seed       %li\n\n", NAG, R_REP, R_ORI, R_ATT, BLIND, SPEED, NOISE, DELTAT, seed) ;
+
+    /* Define behavior of agents, in open space. The Metric
+     * interaction of radius R_ATT gives the range of the zones.
+     */
+    Cartesian g = Cartesian( INIT_SIZE ) ;
+    Metric interaction = Metric( R_ATT , &g) ;
+    Couzin_zones behavior = Couzin_zones(&interaction, SPEED, NOISE, R_REP, R_ORI, R_ATT, BLIND) ;
+    behavior.set_max_turn( MAX_TURN ) ;
+
+    /* Create community, with a hashed grid for the neighbors */
+    Community com = spp_community_autostart( NAG , SPEED, INIT_SIZE, &behavior ) ;
+    HashGrid grid = HashGrid( R_ATT , NAG ) ;
+    com.setup_grid( &grid ) ;
+    pos = com.get_pos() ;
+    vel = com.get_vel() ;
+
+    /* MAIN LOOP */
+    for(iter=0; iter< NITER; iter++){
+        if( iter % OUTPUT == 0 ){
+            /* Milling parameter: mean angular momentum
+             * of the headings around the center.
+             */
+            com.mean_position( center ) ;
+            for(d=0; d< 3; d++)
+                mom[d] = 0.0 ;
+            for(i=0; i< NAG; i++){
+                r = 0.0 ;
+                for(d=0; d< DIMENSION; d++){
+                    rel[d] = pos[i*DIMENSION + d] - center[d] ;
+                    r += rel[d] * rel[d] ;
+                }
+                r = sqrt(r) ;
+#if DIMENSION == 2
+                mom[2] += (rel[0] * vel[i*2 + 1] - rel[1] * vel[i*2]) / r ;
+#else
+                mom[0] += (rel[1] * vel[i*3 + 2] - rel[2] * vel[i*3 + 1]) / r ;
+                mom[1] += (rel[2] * vel[i*3 + 0] - rel[0] * vel[i*3 + 2]) / r ;
+                mom[2] += (rel[0] * vel[i*3 + 1] - rel[1] * vel[i*3 + 0]) / r ;
+#endif
+            }
+            printf("%i\t%f\t%f\n", iter, com.order_parameter(SPEED),
+                    sqrt(mom[0]*mom[0] + mom[1]*mom[1] + mom[2]*mom[2]) / (NAG * SPEED)) ;
+        }
+        com.move( DELTAT) ;
+        com.sense_noisy_velocities(v2) ;
+        com.update_velocities(v2) ;
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+# Couzin zonal model in open space, for several widths of
+# the orientation zone: swarm, mill and parallel groups.
+
+mkdir -p logs
+for dro in 0.0 1.0 3.0 10.0 ; do
+    make couzin_zones dro=$dro -B
+    ./couzin_zones $RANDOM > logs/zones_o${dro}.res
+done
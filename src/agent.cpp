@@ -2,7 +2,7 @@
 #include "behavior.h"
 #include <stdlib.h>
 
-Agent::Agent(double* p , double* v, Agent** ns, Behavior* bb){
+Agent::Agent(spp_real* p , spp_real* v, Agent** ns, Behavior* bb){
     pos = p ;
     vel = v ;
     neis = ns ;
@@ -16,17 +16,17 @@ void Agent::move(double dt){
         pos[i] += vel[i]*dt ;
 }
 
-void Agent::update_vel(double* new_vel){
+void Agent::update_vel(spp_real* new_vel){
     /* copy values, different from vel = new_vel */
     for(int i=0; i<DIM ; i++)
         vel[i] = new_vel[i] ;
 }
 
-double* Agent::get_pos(){
+spp_real* Agent::get_pos(){
     return pos ;
 }
 
-double* Agent::get_vel(){
+spp_real* Agent::get_vel(){
     return vel ;
 }
 
@@ -38,11 +38,11 @@ Behavior* Agent::get_behavior(){
     return beh ;
 }
 
-void Agent::set_pos(double* p){
+void Agent::set_pos(spp_real* p){
     pos = p ;
 }
 
-void Agent::set_vel(double* v){
+void Agent::set_vel(spp_real* v){
     vel = v ;
 }
 
@@ -67,7 +67,7 @@ void Agent::copy(Agent* ag){
 
 // Consensus protocol
 
-double Agent::distance2(double *point){
+spp_real Agent::distance2(spp_real* point){
     return beh->inter->g->distance2( this->pos , point) ;
 }
 
@@ -83,15 +83,15 @@ void Agent::look_around(int n_agents, Agent* ags){
     beh->inter->look_around( this, n_agents, ags);
 }
 
-void Agent::sense_velocity(int num_agents, Agent* ags, double* new_vel){
+void Agent::sense_velocity(int num_agents, Agent* ags, spp_real* new_vel){
     beh->sense_velocity(this, num_agents, ags, new_vel) ;
 }
 
-void Agent::sense_noisy_velocity(int num_agents, Agent* ags, double* new_vel){
+void Agent::sense_noisy_velocity(int num_agents, Agent* ags, spp_real* new_vel){
     beh->sense_noisy_velocity(this, num_agents, ags, new_vel) ;
 }
 
-int Agent::sense_danger(int num_threats, Agent* threats, double* new_vel){
+int Agent::sense_danger(int num_threats, Agent* threats, spp_real* new_vel){
     return beh->sense_danger(this, num_threats, threats, new_vel) ;
 }
 
@@ -1,3 +1,4 @@
+#include "precision.h"
 class Behavior ;
 
 /*
@@ -36,7 +37,7 @@ class Behavior ;
 class Agent {
     public:
         Agent() {} ;
-        Agent(double* pos, double* vel, Agent** nn, Behavior* bb) ;
+        Agent(spp_real* pos, spp_real* vel, Agent** nn, Behavior* bb) ;
         /* Update the agent position according to its velocity,
          *  pos += dt * vel
          */
@@ -44,19 +45,19 @@ class Agent {
         /* Set the velocity of the agent to *new_vel*
          * (copy the values, not the pointer)
          */
-        void update_vel(double* new_vel) ;
+        void update_vel(spp_real* new_vel) ;
         /* Return position */
-        double* get_pos() ;
+        spp_real* get_pos() ;
         /* Return velocity */
-        double* get_vel() ;
+        spp_real* get_vel() ;
         /* Return array of neighbors */
         Agent** get_neis() ;
         /* Return the pointer to the behavior */
         Behavior* get_behavior() ;
         /* Changes the pos pointer of the agent. */
-        void set_pos(double* p) ;
+        void set_pos(spp_real* p) ;
         /* Changes the vel pointer of the agent. */
-        void set_vel(double* v) ;
+        void set_vel(spp_real* v) ;
         /* Changes the behavior of the agent. */
         void set_behavior(Behavior* beh) ;
         /* Turn the agent into a copy
@@ -71,7 +72,7 @@ class Agent {
         void copy(Agent* ag) ;
         /* Get the distance from agent to *point*
          */
-        double distance2(double* point) ;
+        spp_real distance2(spp_real* point) ;
         /* Return 1 if *nei* is a neighbor
          * of the agent.
          */
@@ -88,15 +89,15 @@ class Agent {
         /* Store the sensed velocity in *new_vel*.
          * Defined by the Behavior *beh*.
          */
-        void sense_velocity(int num_agents, Agent* ags, double* new_vel) ;
+        void sense_velocity(int num_agents, Agent* ags, spp_real* new_vel) ;
         /* Same as sense_velocity but using
          * the sense_noisy_velocity function from *beh*.
          */
-        void sense_noisy_velocity(int num_agents, Agent* ags, double* new_vel) ;
+        void sense_noisy_velocity(int num_agents, Agent* ags, spp_real* new_vel) ;
         /* Same as sense_velocity but using
          * the sense_danger function from *beh*.
          */
-        int sense_danger(int num_threats, Agent* threats, double* new_vel) ;
+        int sense_danger(int num_threats, Agent* threats, spp_real* new_vel) ;
         /* Call the sense_victims function in *beh*. */
         int sense_victims(int num_agents, Agent* ags) ;
         /* Call the hunt function in *beh*. */
@@ -105,9 +106,9 @@ class Agent {
         void randomize_velocity() ;
     protected:
         /* position of the agent */
-        double* pos ;
+        spp_real* pos ;
         /* velocity of the agent */
-        double* vel ;
+        spp_real* vel ;
         /* neighbors of the agent */
         Agent** neis ;
         /* behavior (consensus protocol)
@@ -1,6 +1,8 @@
 #include "behavior.h"
 #include "agent.h"
 #include "random.h"
+#include "profile.h"
+#include <typeinfo>
 
 /*
  * Vicsek Consensus
@@ -11,15 +13,16 @@ Vicsek_consensus::Vicsek_consensus(Interaction* ii, double vzero, double ns) {
     noise = ns ;
 }
 
-void Vicsek_consensus::sense_velocity(Agent* ag, int num_agents, Agent* ags, double* new_vel){
+void Vicsek_consensus::sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel){
     int i, j ;
-    double  v2 = 0.0 ;
+    spp_real v2 = 0.0 ;
     int num_neis ;
     Agent** neis = ag->get_neis() ;
 
     for(i=0; i<DIM ; i++)
         new_vel[i] = 0.;
     num_neis = inter->get_neighbors(ag, num_agents, ags, neis) ;
+    SPP_PROFILE_COUNT(neighbors, num_neis) ;
 
     for(j=0; j<num_neis ; j++){
         for(i=0; i<DIM ; i++) new_vel[i] += neis[j]->get_vel()[i];
@@ -29,16 +32,16 @@ void Vicsek_consensus::sense_velocity(Agent* ag, int num_agents, Agent* ags, dou
     for(i=0; i<DIM ; i++) new_vel[i] *= v0/sqrt(v2) ;
 }
 
-void Vicsek_consensus::rotate( double *v){
-    double theta = noise * 2.0 * M_PI * (spp_random_uniform()-0.5) ;
+void Vicsek_consensus::rotate( spp_real* v){
+    spp_real theta = noise * 2.0 * M_PI * (spp_random_uniform()-0.5) ;
 #if DIM==2
-    double tmp ;
+    spp_real tmp ;
     tmp  = cos(theta) * v[0] - sin(theta) * v[1] ;
     v[1] = sin(theta) * v[0] + cos(theta) * v[1] ;
     v[0] = tmp ;
 #elif DIM>2
-    double axis[DIM] ;
-    double av = 0.0; /* = axis*v */
+    spp_real axis[DIM] ;
+    spp_real av = 0.0; /* = axis*v */
     int i ;
     spp_random_vector(axis, 1.0) ; // unitary vector
     for(i=0; i<DIM ; i++) av += v[i]*axis[i] ;
@@ -49,11 +52,107 @@ void Vicsek_consensus::rotate( double *v){
 #endif
 }
 
-void Vicsek_consensus::sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, double* new_vel){
+/* Number of vectors rotated per chunk in rotate_batch.
+ * Small enough for the temporaries to live in the stack
+ * and stay in L1 cache.
+ */
+#define ROTATE_CHUNK 256
+
+void Vicsek_consensus::rotate_batch(int num_vecs, spp_real* vs){
+    spp_real ang[ROTATE_CHUNK], cth[ROTATE_CHUNK], sth[ROTATE_CHUNK] ;
+    int i, ic, nc ;
+    spp_real* v ;
+#if DIM>2
+    const spp_real speed = v0 ;
+    spp_real azi[ROTATE_CHUNK], cph[ROTATE_CHUNK], sph[ROTATE_CHUNK] ;
+    spp_real vx[ROTATE_CHUNK], vy[ROTATE_CHUNK], vz[ROTATE_CHUNK] ;
+    spp_real ux, uy, uz, sign, a, b, e1x, e1y, e1z, e2x, e2y, e2z, px, py, pz ;
+    const spp_real one = 1.0 ;
+#endif
+
+    for(ic=0; ic<num_vecs; ic+=ROTATE_CHUNK){
+        nc = num_vecs - ic < ROTATE_CHUNK ? num_vecs - ic : ROTATE_CHUNK ;
+        v = vs + ic*DIM ;
+        /* Serial part: the random number generator has a state. */
+        for(i=0; i<nc; i++)
+            ang[i] = noise * 2.0 * M_PI * (spp_random_uniform()-0.5) ;
+#if DIM>2
+        for(i=0; i<nc; i++)
+            azi[i] = 2.0 * M_PI * spp_random_uniform() ;
+#endif
+        /* Vectorizable part. The sin and cos loops are kept separate,
+         * otherwise the compiler merges them into a sincos call that
+         * it does not vectorize.
+         */
+        for(i=0; i<nc; i++)
+            sth[i] = sin(ang[i]) ;
+        for(i=0; i<nc; i++)
+            cth[i] = cos(ang[i]) ;
+#if DIM==2
+        spp_real tmp ;
+        for(i=0; i<nc; i++){
+            tmp        = cth[i] * v[2*i] - sth[i] * v[2*i+1] ;
+            v[2*i+1]   = sth[i] * v[2*i] + cth[i] * v[2*i+1] ;
+            v[2*i]     = tmp ;
+        }
+#elif DIM>2
+        for(i=0; i<nc; i++)
+            sph[i] = sin(azi[i]) ;
+        for(i=0; i<nc; i++)
+            cph[i] = cos(azi[i]) ;
+        for(i=0; i<nc; i++){
+            vx[i] = v[3*i] ;
+            vy[i] = v[3*i+1] ;
+            vz[i] = v[3*i+2] ;
+        }
+        for(i=0; i<nc; i++){
+            /* Branchless orthonormal basis (e1,e2) perpendicular to u=v/v0,
+             * Duff et al. J. Comput. Graph. Tech. 6, 1 (2017).
+             */
+            ux = vx[i] / speed ;
+            uy = vy[i] / speed ;
+            uz = vz[i] / speed ;
+            sign = copysign(one, uz) ;
+            a = -one / (sign + uz) ;
+            b = ux * uy * a ;
+            e1x = one + sign * ux * ux * a ;
+            e1y = sign * b ;
+            e1z = -sign * ux ;
+            e2x = b ;
+            e2y = sign + uy * uy * a ;
+            e2z = -uy ;
+            px = cph[i] * e1x + sph[i] * e2x ;
+            py = cph[i] * e1y + sph[i] * e2y ;
+            pz = cph[i] * e1z + sph[i] * e2z ;
+            vx[i] = cth[i] * vx[i] + sth[i] * speed * px ;
+            vy[i] = cth[i] * vy[i] + sth[i] * speed * py ;
+            vz[i] = cth[i] * vz[i] + sth[i] * speed * pz ;
+        }
+        for(i=0; i<nc; i++){
+            v[3*i]   = vx[i] ;
+            v[3*i+1] = vy[i] ;
+            v[3*i+2] = vz[i] ;
+        }
+#endif
+    }
+}
+
+void Vicsek_consensus::sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel){
     this->sense_velocity(ag, num_agents, ags, new_vel) ;
     this->rotate(new_vel) ;
 }
 
+int Vicsek_consensus::separable_noise(){
+    /* A derived class may override sense_noisy_velocity,
+     * which the batched noise would skip.
+     */
+    return typeid(*this) == typeid(Vicsek_consensus) ;
+}
+
+void Vicsek_consensus::add_noise(int num_vels, spp_real* vels){
+    this->rotate_batch(num_vels, vels) ;
+}
+
 void Vicsek_consensus::randomize_velocity(Agent* ag){
     spp_random_vector(ag->get_vel(), v0) ;
 }
@@ -63,12 +162,13 @@ void Vicsek_consensus::randomize_velocity(Agent* ag){
  * Chate Consensus
  * (same as Vicsek but with vectorial noise)
  */
-void Chate_consensus::sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, double* new_vel){
+void Chate_consensus::sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel){
     int i, j ;
-    double  v2 = 0.0 ;
+    spp_real v2 = 0.0 ;
     int num_neis ;
     Agent** neis = ag->get_neis() ;
     num_neis = inter->get_neighbors(ag, num_agents, ags, neis) ;
+    SPP_PROFILE_COUNT(neighbors, num_neis) ;
 
     /* Start the vel to a random vector
      * of norm noise*v0*num_neis */
@@ -83,6 +183,148 @@ void Chate_consensus::sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags
 }
 
 
+/*
+ * Vicsek avoider
+ */
+Vicsek_avoider::Vicsek_avoider(Interaction* ii, double vzero, double ns, Obstacles* obs, double w): Vicsek_consensus(ii, vzero, ns) {
+    obstacles = obs ;
+    weight = w ;
+    /* The queries of sense_velocity only read the index */
+    obstacles->build() ;
+}
+
+int Vicsek_avoider::separable_noise(){
+    return typeid(*this) == typeid(Vicsek_avoider) ;
+}
+
+void Vicsek_avoider::sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel){
+    int i ;
+    double dir[DIM] ;
+    spp_real v2 = 0.0 ;
+    Vicsek_consensus::sense_velocity(ag, num_agents, ags, new_vel) ;
+    if(obstacles->avoidance(ag->get_pos(), dir) == 0)
+        return ;
+    for(i=0; i<DIM ; i++) new_vel[i] += weight * v0 * dir[i] ;
+    for(i=0; i<DIM ; i++) v2 += new_vel[i]*new_vel[i] ;
+    if(v2 > 0.0)
+        for(i=0; i<DIM ; i++) new_vel[i] *= v0/sqrt(v2) ;
+}
+
+/*
+ * Couzin zones
+ */
+Couzin_zones::Couzin_zones(Interaction* ii, double vzero, double ns, double r_rep, double r_ori, double r_att, double blind_angle): Vicsek_consensus(ii, vzero, ns) {
+    rep2 = r_rep * r_rep ;
+    ori2 = r_ori * r_ori ;
+    att2 = r_att * r_att ;
+    cos_blind = -cos(0.5 * blind_angle) ;
+    max_turn = 0.0 ;
+}
+
+int Couzin_zones::separable_noise(){
+    return typeid(*this) == typeid(Couzin_zones) ;
+}
+
+void Couzin_zones::set_max_turn(double angle){
+    max_turn = angle ;
+}
+
+void Couzin_zones::sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel){
+    int i, j ;
+    int n_rep = 0, n_ori = 0, n_att = 0 ;
+    spp_real d_rep[DIM], d_ori[DIM], d_att[DIM], dis[DIM] ;
+    spp_real d2, dv, v2, a2, o2 ;
+    spp_real* pos = ag->get_pos() ;
+    spp_real* vel = ag->get_vel() ;
+    spp_real* vj ;
+    const spp_real vv = sqrt(inter->g->length2(vel)) ;
+
+    for(i=0; i<DIM ; i++){
+        d_rep[i] = 0.0 ;
+        d_ori[i] = 0.0 ;
+        d_att[i] = 0.0 ;
+    }
+    for(j=0; j<num_agents ; j++){
+        inter->g->displacement(pos, ags[j].get_pos(), dis) ;
+        d2 = 0.0 ;
+        dv = 0.0 ;
+        for(i=0; i<DIM ; i++){
+            d2 += dis[i]*dis[i] ;
+            dv += dis[i]*vel[i] ;
+        }
+        /* itself, out of range or in the blind cone */
+        if(d2 == 0.0 || d2 >= att2 || dv < cos_blind * sqrt(d2) * vv)
+            continue ;
+        if(d2 < rep2){
+            for(i=0; i<DIM ; i++) d_rep[i] -= dis[i] / sqrt(d2) ;
+            n_rep += 1 ;
+        }else if(n_rep == 0 && d2 < ori2){
+            vj = ags[j].get_vel() ;
+            v2 = 0.0 ;
+            for(i=0; i<DIM ; i++) v2 += vj[i]*vj[i] ;
+            for(i=0; i<DIM ; i++) d_ori[i] += vj[i] / sqrt(v2) ;
+            n_ori += 1 ;
+        }else if(n_rep == 0){
+            for(i=0; i<DIM ; i++) d_att[i] += dis[i] / sqrt(d2) ;
+            n_att += 1 ;
+        }
+    }
+    SPP_PROFILE_COUNT(neighbors, n_rep + n_ori + n_att) ;
+
+    if(n_rep > 0){
+        for(i=0; i<DIM ; i++) new_vel[i] = d_rep[i] ;
+    }else{
+        /* each of d_ori and d_att normalized */
+        o2 = 0.0 ;
+        a2 = 0.0 ;
+        for(i=0; i<DIM ; i++){
+            o2 += d_ori[i]*d_ori[i] ;
+            a2 += d_att[i]*d_att[i] ;
+        }
+        o2 = o2 > 0.0 ? 1.0/sqrt(o2) : 0.0 ;
+        a2 = a2 > 0.0 ? 1.0/sqrt(a2) : 0.0 ;
+        for(i=0; i<DIM ; i++) new_vel[i] = d_ori[i]*o2 + d_att[i]*a2 ;
+    }
+    v2 = 0.0 ;
+    for(i=0; i<DIM ; i++) v2 += new_vel[i]*new_vel[i] ;
+    if(v2 == 0.0){
+        /* no neighbors, or the sums cancel */
+        for(i=0; i<DIM ; i++) new_vel[i] = vel[i] ;
+        v2 = vv * vv ;
+    }
+    for(i=0; i<DIM ; i++) new_vel[i] *= v0/sqrt(v2) ;
+    if(max_turn > 0.0 && vv > 0.0){
+        /* cosine of the turn, and the new heading as
+         *      cos(max_turn) u + sin(max_turn) w
+         * with u the current heading and w the unit
+         * vector perpendicular to it towards new_vel.
+         */
+        dv = 0.0 ;
+        for(i=0; i<DIM ; i++) dv += vel[i] * new_vel[i] / (vv * v0) ;
+        if(dv >= cos(max_turn))
+            return ;
+        v2 = 0.0 ;
+        for(i=0; i<DIM ; i++){
+            dis[i] = new_vel[i] / v0 - dv * vel[i] / vv ;
+            v2 += dis[i]*dis[i] ;
+        }
+        if(v2 < 1e-12){
+            /* turning back: any perpendicular direction */
+            for(i=0; i<DIM ; i++) dis[i] = 0.0 ;
+            dis[0] = -vel[1] ;
+            dis[1] = vel[0] ;
+            v2 = vel[0]*vel[0] + vel[1]*vel[1] ;
+            if(v2 == 0.0){
+                dis[0] = 1.0 ;
+                v2 = 1.0 ;
+            }
+        }
+        for(i=0; i<DIM ; i++)
+            new_vel[i] = v0 * ( cos(max_turn) * vel[i] / vv + sin(max_turn) * dis[i] / sqrt(v2) ) ;
+    }
+}
+
+
 /*
  * Vicsek Prey
  */
@@ -91,10 +333,14 @@ Vicsek_prey::Vicsek_prey(Interaction* ii, double vzero, double ns, double dradiu
 }
 
 
-int Vicsek_prey::sense_danger(Agent* ag, int num_threats, Agent* threats, double* new_vel) {
+int Vicsek_prey::separable_noise(){
+    return typeid(*this) == typeid(Vicsek_prey) ;
+}
+
+int Vicsek_prey::sense_danger(Agent* ag, int num_threats, Agent* threats, spp_real* new_vel) {
     int it , i;
-    double disp[DIM] ;
-    double dist2 ;
+    spp_real disp[DIM] ;
+    spp_real dist2 ;
     for(it=0 ; it<num_threats ; it++){
         dist2 = inter->g->distance2(threats[it].get_pos() , ag->get_pos() ) ;
         if(dist2 < detection_radius2){
@@ -107,12 +353,86 @@ int Vicsek_prey::sense_danger(Agent* ag, int num_threats, Agent* threats, double
     return 0 ;
 }
 
+/*
+ * Vicsek weighted
+ */
+Vicsek_weighted::Vicsek_weighted(Interaction* ii, double vzero, double ns, int kk, double sc, double ex, spp_real* dd): Vicsek_consensus(ii, vzero, ns) {
+    if(kk != SPP_WEIGHT_GAUSSIAN && kk != SPP_WEIGHT_POWER && kk != SPP_WEIGHT_RANK){
+        fprintf(stderr,"libspp.Vicsek_weighted: ERROR - Unknown kernel %i, using SPP_WEIGHT_GAUSSIAN.\n", kk) ;
+        kk = SPP_WEIGHT_GAUSSIAN ;
+    }
+    kernel = kk ;
+    scale = sc ;
+    exponent = ex ;
+    dists2 = dd ;
+}
+
+int Vicsek_weighted::separable_noise(){
+    return typeid(*this) == typeid(Vicsek_weighted) ;
+}
+
+void Vicsek_weighted::weigh(int num_neis, spp_real* d2, spp_real* w){
+    int j, l, rank ;
+    if(kernel == SPP_WEIGHT_GAUSSIAN){
+        const spp_real a = -0.5 / (scale * scale) ;
+        for(j=0; j<num_neis ; j++)
+            w[j] = exp(a * d2[j]) ;
+    }else if(kernel == SPP_WEIGHT_POWER){
+        const spp_real a = 1.0 / (scale * scale) ;
+        const spp_real b = -0.5 * exponent ;
+        for(j=0; j<num_neis ; j++)
+            w[j] = pow(1 + a * d2[j], b) ;
+    }else{
+        const spp_real b = -exponent ;
+        for(j=0; j<num_neis ; j++){
+            rank = 0 ;
+            for(l=0; l<num_neis ; l++)
+                rank += d2[l] < d2[j] ;
+            w[j] = rank ;
+        }
+        for(j=0; j<num_neis ; j++)
+            w[j] = pow(1 + w[j], b) ;
+    }
+}
+
+void Vicsek_weighted::sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel){
+    int i, j ;
+    spp_real v2 = 0.0 ;
+    int num_neis ;
+    Agent** neis = ag->get_neis() ;
+    spp_real* pos = ag->get_pos() ;
+    spp_real* vel ;
+    /* the weights are stored after the num_agents distances */
+    spp_real* weights = dists2 + num_agents ;
+
+    for(i=0; i<DIM ; i++)
+        new_vel[i] = 0.;
+    num_neis = inter->get_neighbors(ag, num_agents, ags, neis) ;
+    SPP_PROFILE_COUNT(neighbors, num_neis) ;
+
+    for(j=0; j<num_neis ; j++)
+        dists2[j] = inter->g->distance2(pos, neis[j]->get_pos()) ;
+    this->weigh(num_neis, dists2, weights) ;
+    for(j=0; j<num_neis ; j++){
+        vel = neis[j]->get_vel() ;
+        for(i=0; i<DIM ; i++) new_vel[i] += weights[j] * vel[i] ;
+    }
+
+    for(i=0; i<DIM ; i++) v2 += new_vel[i]*new_vel[i] ;
+    for(i=0; i<DIM ; i++) new_vel[i] *= v0/sqrt(v2) ;
+}
+
+
 /*
  * Vicsek Predator
  */
+int Vicsek_predator::separable_noise(){
+    return typeid(*this) == typeid(Vicsek_predator) ;
+}
+
 int Vicsek_predator::sense_victims(Agent* pred, int num_agents, Agent* ags){
     int ia , imin;
-    double tmp, mindist ;
+    spp_real tmp, mindist ;
     imin = 0 ;
     mindist = inter->g->distance2( pred->get_pos(), ags[0].get_pos() ) ;
     for(ia=1; ia<num_agents; ia++){
@@ -126,11 +446,11 @@ int Vicsek_predator::sense_victims(Agent* pred, int num_agents, Agent* ags){
 }
 
 int Vicsek_predator::hunt(Agent* pred, Agent* prey, double dt){
-    double disp[DIM] ;
-    double dist2 ;
+    spp_real disp[DIM] ;
+    spp_real dist2 ;
     int i ;
-    double* pos = pred->get_pos() ;
-    double* vel = pred->get_vel() ;
+    spp_real* pos = pred->get_pos() ;
+    spp_real* vel = pred->get_vel() ;
 
     inter->g->displacement( pos, prey->get_pos() , disp ) ;
     dist2 = inter->g->length2(disp) ;
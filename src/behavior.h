@@ -1,5 +1,6 @@
 class Agent ;
 #include "interaction.h"
+#include "obstacles.h"
 
 /*
  * Abstract Behavior class used as a template
@@ -25,17 +26,33 @@ class Agent ;
 class Behavior {
     public:
         /* pure virtual, must be implemented */
-        virtual void sense_velocity(Agent* ag, int num_agents, Agent* ags, double* new_vel) = 0;
+        virtual void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) = 0;
         /* pure virtual, must be implemented */
-        virtual void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, double* new_vel) = 0;
+        virtual void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) = 0;
         /* pure virtual, must be implemented */
         virtual void randomize_velocity(Agent* ag) = 0;
         /* optional */
-        virtual int sense_danger(Agent* ag, int num_threats, Agent* threats, double* new_vel) {return 0;};
+        virtual int sense_danger(Agent* ag, int num_threats, Agent* threats, spp_real* new_vel) {return 0;};
         /* optional */
         virtual int sense_victims(Agent* ag, int num_agents, Agent* ags) {return 0;} ;
         /* optional */
         virtual int hunt(Agent* ag, Agent* prey, double deltat) {return 0;};
+        /* optional. Return 1 if sense_noisy_velocity is equivalent
+         * to sense_velocity followed by add_noise, so that the noise
+         * of many agents can be added at once (see
+         * Community::sense_noisy_velocities). In that case the
+         * communities never call sense_noisy_velocity, so a class
+         * that overrides sense_noisy_velocity must also override
+         * separable_noise. The library classes only return 1 for
+         * their own exact type (checked with typeid), so that a
+         * derived class is never batched unless it opts in.
+         */
+        virtual int separable_noise() {return 0;} ;
+        /* optional. Add the noise of sense_noisy_velocity to the
+         * *num_vels* velocities stored consecutively in *vels*.
+         * Only used if separable_noise() returns 1.
+         */
+        virtual void add_noise(int num_vels, spp_real* vels) {} ;
         /* Interaction pointer that determines if a
          * given agent is a neighbor of another given
          * agent. See documentation of Interaction
@@ -72,16 +89,36 @@ class Vicsek_consensus : public Behavior {
         /* Store the mean velocity of *ag*'s neighbors in *new_vel*,
          * re-scaled to have a *v0* norm.
          */
-        void sense_velocity(Agent* ag, int num_agents, Agent* ags, double* new_vel) ;
+        void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
         /* Rotate a vector *v* by a random angle between [-noise*pi : noise*pi].
          * For dimensions higher than 2 a random rotation axis is also chosen, which
          * increases considerably the amount of computation required for this.
          */
-        void rotate(double* v) ;
+        void rotate(spp_real* v) ;
+        /* Rotate the *num_vecs* vectors of norm v0 stored consecutively
+         * in *vs*, each one by an independent random angle as in rotate().
+         * The random numbers are drawn first for a chunk of vectors and
+         * the trigonometric functions are then evaluated in a single loop
+         * that the compiler can vectorize.
+         * In 2D the result is identical to calling rotate() on each vector.
+         * In 3D the rotated vector is built as
+         *      cos(theta) v + sin(theta) v0 (cos(phi) e1 + sin(phi) e2)
+         * with (e1, e2) an orthonormal basis perpendicular to *v* and *phi*
+         * uniform in [0:2pi]. This samples the same distribution as rotate()
+         * (uniform angle on the cone around *v*) without the random axis.
+         */
+        void rotate_batch(int num_vecs, spp_real* vs) ;
         /* Sense velocity using sense_velocity() and then rotate the
          * sensed velocity *new_vel* using the rotate() method.
          */
-        void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, double* new_vel) ;
+        void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* The rotation is independent of the neighbors. Returns 1
+         * for Vicsek_consensus itself, 0 for a derived class that
+         * does not override this method.
+         */
+        int separable_noise() ;
+        /* Rotate the *num_vels* velocities in *vels* using rotate_batch(). */
+        void add_noise(int num_vels, spp_real* vels) ;
         /* Sets the velocity of *ag* to a random vector with norm v0. */
         void randomize_velocity(Agent* ag) ;
     protected:
@@ -107,7 +144,9 @@ class Chate_consensus : public Vicsek_consensus {
          * the receipe from:
          *      PHYSICAL REVIEW E 77, 046113  2008
          */
-        void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, double* new_vel) ;
+        void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* The noise depends on the number of neighbors. Returns 0. */
+        int separable_noise() {return 0;} ;
 } ;
 
 /*
@@ -132,7 +171,11 @@ class Vicsek_prey : public Vicsek_consensus {
         /* If a threat is detected, return 1 and store the flee velocity
          * in *new_vel*. Else, do nothing and return 0.
          */
-        int sense_danger(Agent* ag, int num_threats, Agent* threats, double* new_vel) ;
+        int sense_danger(Agent* ag, int num_threats, Agent* threats, spp_real* new_vel) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
     protected:
         /* Square of the maximum distance at which
          * agents are capable of detecting threats.
@@ -145,6 +188,156 @@ class Vicsek_prey : public Vicsek_consensus {
         double detection_radius2 ;
 } ;
 
+/*
+ * Vicsek consensus protocol plus the
+ * avoidance of static obstacles: the
+ * consensus velocity is deviated by
+ *      weight * v0 * dir
+ * where *dir* is the avoidance direction
+ * of Obstacles::avoidance (the outward
+ * normals of the obstacles closer than
+ * their range, stronger when closer),
+ * and then re-scaled to have a *v0* norm.
+ * Far from the obstacles it is the
+ * same as Vicsek_consensus.
+ *
+ */
+class Vicsek_avoider : public Vicsek_consensus {
+    public:
+        Vicsek_avoider() : Vicsek_consensus() {} ;
+        Vicsek_avoider(Interaction* ii, double v0, double noise, Obstacles* obs, double weight) ;
+        /* Store the mean velocity of *ag*'s neighbors plus the
+         * avoidance of the obstacles in *new_vel*, re-scaled
+         * to have a *v0* norm.
+         */
+        void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
+    protected:
+        /* Obstacles to avoid. */
+        Obstacles* obstacles ;
+        /* Strength of the avoidance relative to the consensus. */
+        double weight ;
+} ;
+
+/*
+ * Zonal model of attraction, repulsion and
+ * alignment from Couzin et al. J. Theor. Biol.
+ * 218, 1 (2002). The neighbors of an agent are
+ * split in three concentric zones:
+ *      repulsion:   distance < r_rep
+ *      orientation: r_rep <= distance < r_ori
+ *      attraction:  r_ori <= distance < r_att
+ * If there are neighbors in the repulsion zone
+ * the agent moves away from them, ignoring the
+ * rest. Otherwise it aligns with the headings of
+ * the neighbors in the orientation zone and moves
+ * towards the ones in the attraction zone, with
+ * equal weights if there are both. Without any
+ * neighbor it keeps its heading.
+ * The agents do not see the neighbors in a cone
+ * of total angle *blind_angle* behind them (0 to
+ * see all around).
+ *
+ * The three sums are computed in a single pass
+ * over the candidates, measuring each displacement
+ * once, so the neighbors are not listed through
+ * *inter*, which is only used for its geometry and
+ * its range. It should be a Metric interaction of
+ * radius r_att so that a Grid can be tuned for it.
+ * The noise is the rotation of Vicsek_consensus.
+ *
+ */
+class Couzin_zones : public Vicsek_consensus {
+    public:
+        Couzin_zones() : Vicsek_consensus() {} ;
+        Couzin_zones(Interaction* ii, double v0, double noise, double r_rep, double r_ori, double r_att, double blind_angle) ;
+        /* Store the direction given by the zones of *ag*'s
+         * neighbors in *new_vel*, re-scaled to have a *v0* norm.
+         */
+        void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Limit the angle between the current and the sensed
+         * heading to *angle* (the turning rate times the time
+         * step, as in the original model): the heading turns
+         * by *angle* towards the sensed direction if they differ
+         * more. 0 (the default) turns without limit.
+         */
+        void set_max_turn(double angle) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
+    protected:
+        /* Largest turn in one step, 0 for no limit. */
+        double max_turn ;
+        /* Squares of the outer radius of each zone. */
+        spp_real rep2 ;
+        spp_real ori2 ;
+        spp_real att2 ;
+        /* -cos(blind_angle/2): a neighbor at displacement
+         * *dis* is seen if dis.vel >= cos_blind |dis| |vel|.
+         */
+        spp_real cos_blind ;
+} ;
+
+/* Weight functions of Vicsek_weighted. */
+#define SPP_WEIGHT_GAUSSIAN   0
+#define SPP_WEIGHT_POWER      1
+#define SPP_WEIGHT_RANK       2
+
+/*
+ * Vicsek consensus protocol where each neighbor
+ * has a weight that depends on its distance *r*
+ * to the agent, given by *kernel*:
+ *      SPP_WEIGHT_GAUSSIAN: exp(-r^2 / (2 scale^2))
+ *      SPP_WEIGHT_POWER:    (1 + r^2 / scale^2)^(-exponent/2)
+ *      SPP_WEIGHT_RANK:     (1 + rank)^(-exponent)
+ * where *rank* is the number of neighbors closer
+ * than it (0 for the agent itself). The consensus
+ * velocity is the weighted sum of the velocities
+ * of the neighbors given by *inter*, re-scaled to
+ * have a *v0* norm. The noise is the rotation of
+ * Vicsek_consensus.
+ *
+ * The distances to the neighbors, the weights and
+ * the sum are computed in separate loops over the
+ * neighbors, so that the compiler can vectorize
+ * the exp and pow of the weights. The ranks are
+ * counted with a double loop, which is fast for
+ * the few neighbors of a Topologic interaction.
+ * For a power law over all the agents see
+ * LongRangeAlignment.
+ *
+ */
+class Vicsek_weighted : public Vicsek_consensus {
+    public:
+        Vicsek_weighted() : Vicsek_consensus() {} ;
+        /* *dd* is space for 2 values per agent, e.g.
+         * spp_community_alloc_space(num_agents).
+         */
+        Vicsek_weighted(Interaction* ii, double v0, double noise, int kernel, double scale, double exponent, spp_real* dd) ;
+        /* Store the weighted sum of the velocities of *ag*'s
+         * neighbors in *new_vel*, re-scaled to have a *v0* norm.
+         */
+        void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
+    protected:
+        /* Store in *weights* the weight of each of the
+         * *num_neis* neighbors given their distance2 *dists2*.
+         */
+        void weigh(int num_neis, spp_real* dists2, spp_real* weights) ;
+        int kernel ;
+        double scale ;
+        double exponent ;
+        /* distance2 to the neighbors, followed by their weights */
+        spp_real* dists2 ;
+} ;
+
 /*
  * Vicsek consensus protocol plus a predator
  * behavior where the agent senses victims
@@ -180,4 +373,8 @@ class Vicsek_predator : public Vicsek_consensus {
          * and 0 otherwise.
          */
         int hunt(Agent* pred, Agent* prey, double deltat) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
 } ;
@@ -1,5 +1,8 @@
 #include "community.h"
 #include "grid.h"
+#include "force.h"
+#include "mesh.h"
+#include "profile.h"
 #include "random.h"
 
 /* inlines */
@@ -8,27 +11,60 @@ inline int modulo(int a, int b) {
     return result < 0 ? result+b: result ;
 }
 
-inline double fmodulo(double a, double b) {
-    const double result = fmod(a,b);
+inline spp_real fmodulo(spp_real a, spp_real b) {
+    const spp_real result = fmod(a,b);
     return result < 0. ? result+b: result ;
 }
 
 
 /*----------------------- Community class --------------------------*/
 
-Community::Community(int nags , double L, Agent* ags , double* p, double* v){
+Community::Community(int nags , double L, Agent* ags , spp_real* p, spp_real* v){
+    double ls[DIM] ;
+    for(int i=0; i<DIM; i++)
+        ls[i] = L ;
     num_agents = nags ;
     agents = ags ;
     pos = p ;
     vel = v ;
-    box_size = L ;
+    this->set_box_lengths(ls) ;
+    for(int i=0; i<DIM; i++)
+        periodic[i] = 1 ;
+    all_periodic = true ;
     use_grid = false ;
     grid = NULL ;
+    hash_grid = NULL ;
+    grid_tuning = 0 ;
+    grid_fills = 0 ;
+    grid_tuned = false ;
+    force_range = 0.0 ;
+    images = NULL ;
+    obstacles = NULL ;
 }
 
-double* Community::get_pos(){ return pos ; }
+Community::Community(int nags , double* ls, Agent* ags , spp_real* p, spp_real* v){
+    num_agents = nags ;
+    agents = ags ;
+    pos = p ;
+    vel = v ;
+    this->set_box_lengths(ls) ;
+    for(int i=0; i<DIM; i++)
+        periodic[i] = 1 ;
+    all_periodic = true ;
+    use_grid = false ;
+    grid = NULL ;
+    hash_grid = NULL ;
+    grid_tuning = 0 ;
+    grid_fills = 0 ;
+    grid_tuned = false ;
+    force_range = 0.0 ;
+    images = NULL ;
+    obstacles = NULL ;
+}
+
+spp_real* Community::get_pos(){ return pos ; }
 
-double* Community::get_vel(){ return vel ; }
+spp_real* Community::get_vel(){ return vel ; }
 
 Agent* Community::get_agents(){ return agents ;}
 
@@ -36,27 +72,62 @@ int Community::get_num_agents(){ return num_agents ; }
 
 double Community::get_box_size(){ return box_size ;}
 
+void Community::set_box_lengths(double* ls){
+    box_size = 0.0 ;
+    cubic = true ;
+    for(int i=0; i<DIM; i++){
+        box_lengths[i] = ls[i] ;
+        if(ls[i] > box_size)
+            box_size = ls[i] ;
+        if(ls[i] != ls[0])
+            cubic = false ;
+    }
+}
+
+int Community::check_cubic(const char* name){
+    /* the Mesh wraps around along every dimension */
+    if(cubic && all_periodic)
+        return 1 ;
+    fprintf(stderr,"libspp.Community: ERROR - %s needs a cubic box, periodic along every dimension, like the Mesh.\n", name) ;
+    return 0 ;
+}
+
 // Initialization
 
 void Community::randomize_positions(){
-    for(int i=0; i<DIM*num_agents; i++)
-        pos[i] = spp_random_uniform() * box_size ;
+    for(int ia=0; ia<num_agents; ia++)
+        for(int i=0; i<DIM; i++)
+            pos[ia*DIM + i] = spp_random_uniform() * box_lengths[i] ;
 }
 
 void Community::regular_positions(){
     int i;
     int carry ;
-    int n = ceil(pow(num_agents, 1./DIM)) ; // number of agents per dimension
+    int n[DIM] ; // number of agents per dimension
     int grid_indx[DIM] ;
-    for(i=0; i<DIM; i++)
+    double spacing, volume = 1.0 ;
+    for(i=0; i<DIM; i++){
         grid_indx[i] = 0 ;
+        volume *= box_lengths[i] ;
+    }
+    if(cubic){
+        for(i=0; i<DIM; i++)
+            n[i] = ceil(pow(num_agents, 1./DIM)) ;
+    }else{
+        /* n[i] >= L_i / spacing, so the product is >= num_agents */
+        spacing = pow(volume / num_agents, 1./DIM) ;
+        for(i=0; i<DIM; i++){
+            n[i] = ceil(box_lengths[i] / spacing - 1e-9) ;
+            n[i] = n[i] < 1 ? 1 : n[i] ;
+        }
+    }
 
     for(int ia=0; ia<num_agents; ia++){
         carry = 1 ;
         for(i=0; i<DIM; i++){
-            pos[ia*DIM + i] = (box_size * grid_indx[i]) / n ;
+            pos[ia*DIM + i] = (box_lengths[i] * grid_indx[i]) / n[i] ;
             grid_indx[i] += carry ;
-            if(grid_indx[i]==n){
+            if(grid_indx[i]==n[i]){
                 grid_indx[i] = 0 ;
                 carry = 1 ;
             }else{
@@ -81,57 +152,245 @@ void Community::randomize_directions(double v0){
 // Kinematic
 
 void Community::move(double dt){
+    const spp_real h = dt ;
+    SPP_PROFILE_START(t0) ;
     for(int i=0; i<num_agents*DIM; i++)
-        pos[i] += dt * vel[i] ;
+        pos[i] += h * vel[i] ;
+    if(obstacles)
+        this->collide_obstacles(NULL) ;
+    SPP_PROFILE_STOP(t0, SPP_PHASE_MOVE) ;
 }
 
 void Community::periodic_move(double dt){
-    /* Range [0:box_size] in each direction */
+    /* Range [0:box_lengths[d]] in each direction *d* */
+    const spp_real h = dt ;
+    spp_real l = box_size ;
+    spp_real x ;
+    int i, d, wrap[DIM] ;
+    SPP_PROFILE_START(t0) ;
+    if(images == NULL && cubic){
+        for(i=0; i<num_agents*DIM; i++)
+            pos[i] = fmodulo( pos[i] + h * vel[i] , l );
+    }else if(images == NULL){
+        for(i=0; i<num_agents*DIM; i+=DIM){
+            for(d=0; d<DIM; d++){
+                l = box_lengths[d] ;
+                pos[i+d] = fmodulo( pos[i+d] + h * vel[i+d] , l );
+            }
+        }
+    }else{
+        for(i=0; i<num_agents*DIM; i+=DIM){
+            for(d=0; d<DIM; d++){
+                l = box_lengths[d] ;
+                x = pos[i+d] + h * vel[i+d] ;
+                if(x < 0. || x >= l)
+                    images[i+d] += (int) floor( x / l ) ;
+                pos[i+d] = fmodulo( x , l );
+            }
+        }
+    }
+    if(obstacles){
+        for(d=0; d<DIM; d++)
+            wrap[d] = 1 ;
+        this->collide_obstacles(wrap) ;
+    }
+    SPP_PROFILE_STOP(t0, SPP_PHASE_MOVE) ;
+}
+
+void Community::set_boundaries(int* p){
+    all_periodic = true ;
+    for(int i=0; i<DIM; i++){
+        periodic[i] = p[i] ? 1 : 0 ;
+        if(!periodic[i])
+            all_periodic = false ;
+    }
+    if(grid)
+        grid->set_boundaries(periodic) ;
+}
+
+void Community::walled_move(double dt){
+    /* Range [0:box_lengths[d]] in each direction *d*,
+     * reflecting at the walls.
+     */
+    const spp_real h = dt ;
+    spp_real l, x ;
+    int i, d ;
+    SPP_PROFILE_START(t0) ;
+    for(i=0; i<num_agents*DIM; i+=DIM){
+        for(d=0; d<DIM; d++){
+            l = box_lengths[d] ;
+            x = pos[i+d] + h * vel[i+d] ;
+            if(periodic[d]){
+                if(images && (x < 0. || x >= l))
+                    images[i+d] += (int) floor( x / l ) ;
+                pos[i+d] = fmodulo( x , l ) ;
+            }else{
+                if(x < 0.){
+                    x = -x ;
+                    vel[i+d] = -vel[i+d] ;
+                }else if(x > l){
+                    x = 2. * l - x ;
+                    vel[i+d] = -vel[i+d] ;
+                }
+                /* steps longer than the box */
+                pos[i+d] = x < 0. ? 0. : (x > l ? l : x) ;
+            }
+        }
+    }
+    if(obstacles)
+        this->collide_obstacles(periodic) ;
+    SPP_PROFILE_STOP(t0, SPP_PHASE_MOVE) ;
+}
+
+void Community::setup_obstacles(Obstacles* obs){
+    obstacles = obs ;
+    if(obstacles)
+        obstacles->build() ;
+}
+
+void Community::collide_obstacles(int* wrap){
+    /*
+     * The positions were already brought back to the box,
+     * and reflect may push an agent out of it again.
+     */
+    spp_real l, x ;
+    int i, d ;
+    for(i=0; i<num_agents*DIM; i+=DIM){
+        if(!obstacles->reflect(pos + i, vel + i) || wrap == NULL)
+            continue ;
+        for(d=0; d<DIM; d++){
+            l = box_lengths[d] ;
+            x = pos[i+d] ;
+            if(wrap[d]){
+                if(x < 0. || x >= l){
+                    if(images)
+                        images[i+d] += (int) floor( x / l ) ;
+                    pos[i+d] = fmodulo( x , l ) ;
+                }
+            }else{
+                pos[i+d] = x < 0. ? 0. : (x > l ? l : x) ;
+            }
+        }
+    }
+}
+
+void Community::setup_images(int* img){
+    images = img ;
+    if(images)
+        for(int i=0; i<num_agents*DIM; i++)
+            images[i] = 0 ;
+}
+
+void Community::unwrapped_positions(double* upos){
     for(int i=0; i<num_agents*DIM; i++)
-        pos[i] = fmodulo( pos[i] + dt * vel[i] , box_size );
+        upos[i] = pos[i] + (images ? images[i] * box_lengths[i % DIM] : 0.0) ;
 }
 
 // Consensus protocol
 
-void Community::sense_velocities(double* vel_sensed){
+void Community::sense_velocities(spp_real* vel_sensed){
     /*
      * If using grid, this fills the grid from scratch
      * at every iteration.
      */
     int num_neis ;
     Agent* neis ;
+    prepare_interactions() ;
     if(use_grid){
         fill_grid() ;
+        SPP_PROFILE_START(t0) ;
         for(int i=0; i<num_agents; i++){
-            neis = grid->get_neighborhood(agents+i , &num_neis ) ;
+            neis = this->get_neighborhood(agents+i , &num_neis ) ;
             agents[i].sense_velocity(num_neis , neis , vel_sensed + i*DIM) ;
+            SPP_PROFILE_COUNT(candidates, num_neis) ;
         }
+        SPP_PROFILE_STOP(t0, SPP_PHASE_SENSE) ;
     }else{
+        SPP_PROFILE_START(t0) ;
         for(int i=0; i<num_agents; i++)
             agents[i].sense_velocity(num_agents , agents , vel_sensed + i*DIM) ;
+        SPP_PROFILE_STOP(t0, SPP_PHASE_SENSE) ;
+        SPP_PROFILE_COUNT(candidates, (long int) num_agents * num_agents) ;
     }
+    SPP_PROFILE_COUNT(searches, num_agents) ;
 }
 
-void Community::sense_noisy_velocities(double* vel_sensed){
+void Community::sense_noisy_velocities(spp_real* vel_sensed){
     /*
      * If using grid, this fills the grid from scratch
      * at every iteration.
+     * Consecutive agents sharing a behavior with separable
+     * noise sense the noiseless velocity first, and the noise
+     * is added afterwards to all of them in one batch.
      */
-    int num_neis ;
+    int i, ia, ja, num_neis ;
+    int separable ;
     Agent* neis  ;
-    if (use_grid){
+    Behavior* beh ;
+    prepare_interactions() ;
+    if (use_grid)
         fill_grid() ;
-        for(int i=0; i<num_agents; i++){
-            neis = grid->get_neighborhood(agents+i , &num_neis ) ;
-            agents[i].sense_noisy_velocity(num_neis , neis , vel_sensed + i*DIM) ;
+    for(ia=0; ia<num_agents; ia=ja){
+        beh = agents[ia].get_behavior() ;
+        for(ja=ia+1; ja<num_agents && agents[ja].get_behavior()==beh; ja++) ;
+        separable = beh->separable_noise() ;
+        SPP_PROFILE_START(t0) ;
+        for(i=ia; i<ja; i++){
+            if(use_grid){
+                neis = this->get_neighborhood(agents+i , &num_neis ) ;
+            }else{
+                neis = agents ;
+                num_neis = num_agents ;
+            }
+            if(separable)
+                agents[i].sense_velocity(num_neis , neis , vel_sensed + i*DIM) ;
+            else
+                agents[i].sense_noisy_velocity(num_neis , neis , vel_sensed + i*DIM) ;
+            SPP_PROFILE_COUNT(candidates, num_neis) ;
         }
-    }else{
-        for(int i=0; i<num_agents; i++)
-            agents[i].sense_noisy_velocity(num_agents , agents , vel_sensed + i*DIM) ;
+        SPP_PROFILE_STOP(t0, SPP_PHASE_SENSE) ;
+        SPP_PROFILE_COUNT(searches, ja-ia) ;
+        if(separable){
+            SPP_PROFILE_START(t1) ;
+            beh->add_noise(ja-ia, vel_sensed + ia*DIM) ;
+            SPP_PROFILE_STOP(t1, SPP_PHASE_NOISE) ;
+        }
+    }
+}
+
+void Community::sense_forces(Force* force, spp_real* forces){
+    int i, num_neis ;
+    int n_forces = 0 ;
+    Agent* neis ;
+    if(use_grid){
+        /* the slots must also be as large as the range of the
+         * force, tune again if it changed
+         */
+        if(force->range() != force_range){
+            force_range = force->range() ;
+            grid_tuned = false ;
+        }
+        fill_grid() ;
+    }
+    for(i=0; i<num_agents*DIM; i++)
+        forces[i] = 0.0 ;
+    SPP_PROFILE_START(t0) ;
+    for(i=0; i<num_agents; i++){
+        if(use_grid){
+            neis = this->get_neighborhood(agents+i , &num_neis ) ;
+        }else{
+            neis = agents ;
+            num_neis = num_agents ;
+        }
+        n_forces += force->sum_forces(agents+i, num_neis, neis, forces + i*DIM) ;
+        SPP_PROFILE_COUNT(candidates, num_neis) ;
     }
+    SPP_PROFILE_STOP(t0, SPP_PHASE_SENSE) ;
+    SPP_PROFILE_COUNT(searches, num_agents) ;
+    SPP_PROFILE_COUNT(neighbors, n_forces) ;
 }
 
-void Community::update_velocities(double* vel_sensed){
+void Community::update_velocities(spp_real* vel_sensed){
     for(int i=0; i<num_agents*DIM; i++)
         vel[i] = vel_sensed[i] ;
 }
@@ -177,12 +436,12 @@ void Community::mean_periodic_position(double* meanpos){
     }
     for(ia=0; ia<num_agents; ia++){
         for(i=0; i<DIM; i++){
-            mcos[i] += cos( pos[ia*DIM + i ] * 2. * M_PI / box_size ) ;
-            msin[i] += sin( pos[ia*DIM + i ] * 2. * M_PI / box_size ) ;
+            mcos[i] += cos( pos[ia*DIM + i ] * 2. * M_PI / box_lengths[i] ) ;
+            msin[i] += sin( pos[ia*DIM + i ] * 2. * M_PI / box_lengths[i] ) ;
         }
     }
     for(i=0; i<DIM; i++)
-        meanpos[i] = box_size * ( atan2(-msin[i],-mcos[i]) + M_PI ) / ( 2. * M_PI ) ;
+        meanpos[i] = box_lengths[i] * ( atan2(-msin[i],-mcos[i]) + M_PI ) / ( 2. * M_PI ) ;
 }
 
 double Community::mean_velocity(double* meanvel){
@@ -204,11 +463,13 @@ double Community::mean_velocity(double* meanvel){
 
 double Community::order_parameter(double v0){
     double meanvel[DIM] ;
+    SPP_PROFILE_START(t0) ;
     double mv2 = this->mean_velocity(meanvel) ;
+    SPP_PROFILE_STOP(t0, SPP_PHASE_OBSERVABLES) ;
     return sqrt(mv2)/v0 ;
 }
 
-void Community::velocity_fluctuations(double* fluctuations, double v0){
+void Community::velocity_fluctuations(spp_real* fluctuations, double v0){
     int i,ia ;
     double mv[DIM] ;
     double speed2, norm ;
@@ -241,9 +502,10 @@ void Community::correlation_histo(int n_bins, double v0, double* totalcorr, int*
      */
     int i,ia,ja , bin ;
     double mv[DIM] ;
-    double *v1, *v2 ;
+    spp_real* v1, *v2 ;
     double dist , speed2 , norm ;
     double bindist = n_bins / (this->max_distance() * 1.000001) ;
+    SPP_PROFILE_START(t_obs) ;
 
     for(i=0; i<n_bins; i++)
         totalcorr[i] = 0.0 ;
@@ -266,6 +528,160 @@ void Community::correlation_histo(int n_bins, double v0, double* totalcorr, int*
     }
     for(i=0; i<n_bins; i++)
         totalcorr[i] *= norm ;
+    SPP_PROFILE_STOP(t_obs, SPP_PHASE_OBSERVABLES) ;
+}
+
+void Community::correlation_histo_fft(int n_bins, double v0, Mesh* mesh, double* totalcorr, int* count){
+    /*
+     * The sum over all the pairs of cells at a displacement r of
+     * the products of the fields is the inverse transform of |F(k)|^2.
+     * It includes each pair of agents twice and, at r=0, each
+     * agent with itself, which is removed.
+     * Same bins as in correlation_histo.
+     */
+    if(!this->check_cubic("correlation_histo_fft"))
+        return ;
+    int i, c, d, bin ;
+    int nc = mesh->get_num_cells() ;
+    double a, self = 0.0 ;
+    double bindist = n_bins / (this->max_distance() * 1.000001) ;
+    spp_real* fluct = new spp_real[num_agents * DIM] ;
+    double* power = new double[nc] ;
+    double* pairs = new double[n_bins] ;
+    SPP_PROFILE_START(t_obs) ;
+
+    for(i=0; i<n_bins; i++)
+        totalcorr[i] = 0.0 ;
+
+    this->velocity_fluctuations(fluct, v0) ;
+    for(i=0; i<num_agents*DIM; i++)
+        self += fluct[i] * fluct[i] ;
+    for(c=0; c<nc; c++)
+        power[c] = 0.0 ;
+    for(d=0; d<DIM; d++){
+        mesh->clear() ;
+        mesh->deposit(num_agents, pos, fluct + d, DIM) ;
+        mesh->fft(-1) ;
+        for(c=0; c<nc; c++)
+            power[c] += mesh->re[c] * mesh->re[c] + mesh->im[c] * mesh->im[c] ;
+    }
+    for(c=0; c<nc; c++){
+        mesh->re[c] = power[c] ;
+        mesh->im[c] = 0.0 ;
+    }
+    mesh->fft(1) ;
+    for(c=0; c<nc; c++){
+        a = mesh->re[c] / nc - (c == 0 ? self : 0.0) ;
+        bin = int( mesh->distance(c) * bindist ) ;
+        totalcorr[bin] += 0.5 * a ;
+    }
+
+    /* Same with the density for the number of pairs */
+    mesh->clear() ;
+    mesh->deposit(num_agents, pos, NULL, 1) ;
+    mesh->fft(-1) ;
+    for(c=0; c<nc; c++){
+        mesh->re[c] = mesh->re[c] * mesh->re[c] + mesh->im[c] * mesh->im[c] ;
+        mesh->im[c] = 0.0 ;
+    }
+    mesh->fft(1) ;
+    for(i=0; i<n_bins; i++)
+        pairs[i] = 0.0 ;
+    for(c=0; c<nc; c++){
+        a = mesh->re[c] / nc - (c == 0 ? num_agents : 0.0) ;
+        bin = int( mesh->distance(c) * bindist ) ;
+        pairs[bin] += 0.5 * a ;
+    }
+    for(i=0; i<n_bins; i++)
+        count[i] = (int) floor(pairs[i] + 0.5) ;
+
+    delete[] fluct ;
+    delete[] power ;
+    delete[] pairs ;
+    SPP_PROFILE_STOP(t_obs, SPP_PHASE_OBSERVABLES) ;
+}
+
+void Community::structure_factors(int n_bins, double v0, Mesh* mesh, double* s_density, double* s_velocity, int* num_modes){
+    if(!this->check_cubic("structure_factors"))
+        return ;
+    int i, c, d, bin ;
+    int nc = mesh->get_num_cells() ;
+    double dk = 2.0 * M_PI / box_size ;
+    spp_real* fluct = new spp_real[num_agents * DIM] ;
+    double* power = new double[nc] ;
+    SPP_PROFILE_START(t_obs) ;
+
+    for(i=0; i<n_bins; i++){
+        s_density[i] = 0.0 ;
+        s_velocity[i] = 0.0 ;
+        num_modes[i] = 0 ;
+    }
+
+    this->velocity_fluctuations(fluct, v0) ;
+    for(c=0; c<nc; c++)
+        power[c] = 0.0 ;
+    for(d=0; d<DIM; d++){
+        mesh->clear() ;
+        mesh->deposit(num_agents, pos, fluct + d, DIM) ;
+        mesh->fft(-1) ;
+        for(c=0; c<nc; c++)
+            power[c] += mesh->re[c] * mesh->re[c] + mesh->im[c] * mesh->im[c] ;
+    }
+    mesh->clear() ;
+    mesh->deposit(num_agents, pos, NULL, 1) ;
+    mesh->fft(-1) ;
+    for(c=0; c<nc; c++){
+        bin = int( mesh->wavenumber(c) / dk + 0.5 ) ;
+        if(bin >= n_bins)
+            continue ;
+        s_density[bin] += mesh->re[c] * mesh->re[c] + mesh->im[c] * mesh->im[c] ;
+        s_velocity[bin] += power[c] ;
+        num_modes[bin] += 1 ;
+    }
+    for(i=0; i<n_bins; i++){
+        if(num_modes[i] > 0){
+            s_density[i] /= num_modes[i] * (double) num_agents ;
+            s_velocity[i] /= num_modes[i] * (double) num_agents ;
+        }
+    }
+
+    delete[] fluct ;
+    delete[] power ;
+    SPP_PROFILE_STOP(t_obs, SPP_PHASE_OBSERVABLES) ;
+}
+
+void Community::fields(Mesh* mesh, int cic, double* density, double* velocity){
+    /* Deposit the number of agents and then each component of
+     * their velocity, dividing by the number of agents in the cell.
+     */
+    if(!this->check_cubic("fields"))
+        return ;
+    int c, d ;
+    int nc = mesh->get_num_cells() ;
+    double volume = 1.0 ;
+    SPP_PROFILE_START(t_obs) ;
+    for(d=0; d<DIM; d++)
+        volume *= mesh->get_cell_size() ;
+
+    mesh->clear() ;
+    if(cic)
+        mesh->deposit_cic(num_agents, pos, NULL, 1) ;
+    else
+        mesh->deposit(num_agents, pos, NULL, 1) ;
+    for(c=0; c<nc; c++)
+        density[c] = mesh->re[c] ;
+    for(d=0; d<DIM; d++){
+        mesh->clear() ;
+        if(cic)
+            mesh->deposit_cic(num_agents, pos, vel + d, DIM) ;
+        else
+            mesh->deposit(num_agents, pos, vel + d, DIM) ;
+        for(c=0; c<nc; c++)
+            velocity[c*DIM + d] = density[c] > 1e-12 ? mesh->re[c] / density[c] : 0.0 ;
+    }
+    for(c=0; c<nc; c++)
+        density[c] /= volume ;
+    SPP_PROFILE_STOP(t_obs, SPP_PHASE_OBSERVABLES) ;
 }
 
 
@@ -280,7 +696,15 @@ double Community::max_distance(){
      *  for L_i=L forall i,
      *      d^2 = L * N / 2^2
      */
-    return box_size * sqrt(DIM / 4.) ;
+    double d2 = 0.0 ;
+    if(cubic && all_periodic)
+        return box_size * sqrt(DIM / 4.) ;
+    /* Along a dimension with walls the farthest points
+     * are at both walls, L_i apart.
+     */
+    for(int i=0; i<DIM; i++)
+        d2 += (periodic[i] ? 0.25 : 1.0) * box_lengths[i] * box_lengths[i] ;
+    return sqrt(d2) ;
 }
 
 int Community::build_network(int* num_neis, Agent*** network){
@@ -298,6 +722,7 @@ int Community::build_network(int* num_neis, Agent*** network){
      */
     int jn ;
     int total_nneis = 0;
+    prepare_interactions() ;
     for(int i=0; i<num_agents; i++){
         num_neis[i] = agents[i].get_neighbors(num_agents, agents) ;
         total_nneis += num_neis[i] ;
@@ -308,6 +733,22 @@ int Community::build_network(int* num_neis, Agent*** network){
     return total_nneis ;
 }
 
+void Community::prepare_interactions(){
+    /* Consecutive agents usually share the interaction,
+     * avoid calling prepare more than once for them.
+     */
+    Interaction* inter ;
+    Interaction* last = NULL ;
+    for(int i=0; i<num_agents; i++){
+        inter = agents[i].get_behavior()->inter ;
+        if(inter != last){
+            inter->set_grid(use_grid ? grid : NULL) ;
+            inter->prepare(num_agents, agents) ;
+            last = inter ;
+        }
+    }
+}
+
 void Community::print_network(int* num_neis, Agent*** network){
     int ia, ja ;
     for(ia=0; ia<num_agents; ia++){
@@ -317,21 +758,279 @@ void Community::print_network(int* num_neis, Agent*** network){
     }
 }
 
+// Clusters
+
+/* Union-find with path halving and union by size:
+ * *parent* and *size* of each agent.
+ */
+static int uf_find(int* parent, int i){
+    while(parent[i] != i){
+        parent[i] = parent[parent[i]] ;
+        i = parent[i] ;
+    }
+    return i ;
+}
+
+static void uf_union(int* parent, int* size, int a, int b){
+    a = uf_find(parent, a) ;
+    b = uf_find(parent, b) ;
+    if(a == b)
+        return ;
+    if(size[a] < size[b]){
+        int t = a ; a = b ; b = t ;
+    }
+    parent[b] = a ;
+    size[a] += size[b] ;
+}
+
+/* Turn the union-find in *labels* (parents) and *sizes*
+ * into consecutive labels and their sizes.
+ * Return the number of clusters.
+ */
+static int uf_labels(int n, int* labels, int* sizes){
+    int i, r, nc = 0 ;
+    int* label_of = new int[n] ;
+    /* Roots first (in *sizes*), then the labels */
+    for(i=0; i<n; i++)
+        sizes[i] = uf_find(labels, i) ;
+    for(i=0; i<n; i++)
+        label_of[i] = -1 ;
+    for(i=0; i<n; i++){
+        r = sizes[i] ;
+        if(label_of[r] < 0){
+            label_of[r] = nc ;
+            nc += 1 ;
+        }
+        labels[i] = label_of[r] ;
+    }
+    for(i=0; i<nc; i++)
+        sizes[i] = 0 ;
+    for(i=0; i<n; i++)
+        sizes[labels[i]] += 1 ;
+    delete[] label_of ;
+    return nc ;
+}
+
+int Community::clusters(int* labels, int* sizes){
+    int i, j, n, num_clusters ;
+    Agent* neis ;
+    int num_neis ;
+    for(i=0; i<num_agents; i++){
+        labels[i] = i ;
+        sizes[i] = 1 ;
+    }
+    prepare_interactions() ;
+    if(use_grid)
+        fill_grid() ;
+    SPP_PROFILE_START(t_obs) ;
+    for(i=0; i<num_agents; i++){
+        if(use_grid){
+            neis = this->get_neighborhood(agents+i , &num_neis ) ;
+            n = agents[i].get_neighbors(num_neis, neis) ;
+        }else{
+            n = agents[i].get_neighbors(num_agents, agents) ;
+        }
+        /* The grid copies the agents, use their positions */
+        for(j=0; j<n; j++)
+            uf_union(labels, sizes, i, (agents[i].get_neis()[j]->get_pos() - pos) / DIM) ;
+    }
+    num_clusters = uf_labels(num_agents, labels, sizes) ;
+    SPP_PROFILE_STOP(t_obs, SPP_PHASE_OBSERVABLES) ;
+    return num_clusters ;
+}
+
+int Community::clusters_metric(double radius, int* labels, int* sizes){
+    int i, j, k, c, d, nc, num_cells, idx, num_clusters ;
+    int ncells[DIM], ci[DIM], cn[DIM], off[DIM] ;
+    bool few_cells = false ;
+    double r2 = radius * radius ;
+    SPP_PROFILE_START(t_obs) ;
+    for(i=0; i<num_agents; i++){
+        labels[i] = i ;
+        sizes[i] = 1 ;
+    }
+
+    for(d=0; d<DIM; d++){
+        ncells[d] = (int) (box_lengths[d] / radius) ;
+        if(ncells[d] < 3)
+            few_cells = true ;
+    }
+    if(few_cells){
+        for(i=0; i<num_agents; i++)
+            for(j=i+1; j<num_agents; j++)
+                if(agents[i].distance2(pos + j*DIM) <= r2)
+                    uf_union(labels, sizes, i, j) ;
+        num_clusters = uf_labels(num_agents, labels, sizes) ;
+        SPP_PROFILE_STOP(t_obs, SPP_PHASE_OBSERVABLES) ;
+        return num_clusters ;
+    }
+
+    /* Cell lists: agents of cell c in cell_agents[first[c]:first[c+1]] */
+    num_cells = 1 ;
+    for(d=0; d<DIM; d++)
+        num_cells *= ncells[d] ;
+    int* first = new int[num_cells+1] ;
+    int* cell_agents = new int[num_agents] ;
+    int* agent_cell = new int[num_agents] ;
+    for(c=0; c<=num_cells; c++)
+        first[c] = 0 ;
+    for(i=0; i<num_agents; i++){
+        c = 0 ;
+        for(d=0; d<DIM; d++){
+            k = (int) (pos[i*DIM + d] * ncells[d] / box_lengths[d]) ;
+            k = k < 0 ? 0 : (k >= ncells[d] ? ncells[d]-1 : k) ;
+            c = c * ncells[d] + k ;
+        }
+        agent_cell[i] = c ;
+        first[c+1] += 1 ;
+    }
+    for(c=0; c<num_cells; c++)
+        first[c+1] += first[c] ;
+    for(i=0; i<num_agents; i++)
+        cell_agents[first[agent_cell[i]]++] = i ;
+    for(c=num_cells; c>0; c--)
+        first[c] = first[c-1] ;
+    first[0] = 0 ;
+
+    /* Each agent against the later agents in its cell and the 3^DIM around */
+    for(i=0; i<num_agents; i++){
+        c = agent_cell[i] ;
+        for(d=DIM-1; d>=0; d--){
+            ci[d] = c % ncells[d] ;
+            c /= ncells[d] ;
+        }
+        for(d=0; d<DIM; d++)
+            off[d] = -1 ;
+        for(nc=0; nc<(DIM>2 ? 27 : 9); nc++){
+            idx = 0 ;
+            for(d=0; d<DIM; d++){
+                cn[d] = (ci[d] + off[d] + ncells[d]) % ncells[d] ;
+                idx = idx * ncells[d] + cn[d] ;
+            }
+            for(k=first[idx]; k<first[idx+1]; k++){
+                j = cell_agents[k] ;
+                if(j > i && agents[i].distance2(pos + j*DIM) <= r2)
+                    uf_union(labels, sizes, i, j) ;
+            }
+            /* next offset */
+            for(d=DIM-1; d>=0; d--){
+                off[d] += 1 ;
+                if(off[d] <= 1)
+                    break ;
+                off[d] = -1 ;
+            }
+        }
+    }
+    delete[] first ;
+    delete[] cell_agents ;
+    delete[] agent_cell ;
+    num_clusters = uf_labels(num_agents, labels, sizes) ;
+    SPP_PROFILE_STOP(t_obs, SPP_PHASE_OBSERVABLES) ;
+    return num_clusters ;
+}
+
+void Community::cluster_size_histo(int num_clusters, int* sizes, int* histo){
+    int i ;
+    for(i=0; i<=num_agents; i++)
+        histo[i] = 0 ;
+    for(i=0; i<num_clusters; i++)
+        histo[sizes[i]] += 1 ;
+}
+
 // Optimization related
 
 void Community::setup_grid(Grid *g){
     grid = g ;
+    hash_grid = NULL ;
     use_grid = true ;
+    grid->set_boundaries(periodic) ;
+}
+
+void Community::setup_grid(HashGrid *g){
+    /* There are no boundaries in open space */
+    grid = NULL ;
+    hash_grid = g ;
+    use_grid = true ;
+}
+
+Agent* Community::get_neighborhood(Agent* ag, int* num_neis){
+    /* Chosen per agent with a branch, not a virtual call */
+    if(hash_grid)
+        return hash_grid->get_neighborhood(ag, num_neis) ;
+    return grid->get_neighborhood(ag, num_neis) ;
+}
+
+int Community::tune_grid(){
+    return this->tune_grid(force_range) ;
+}
+
+int Community::tune_grid(double min_range){
+    Interaction* inter ;
+    Interaction* last = NULL ;
+    double r, range = min_range ;
+    if(grid == NULL && hash_grid == NULL)
+        return 0 ;
+    for(int i=0; i<num_agents; i++){
+        inter = agents[i].get_behavior()->inter ;
+        if(inter != last){
+            r = inter->range() ;
+            if(r <= 0.0){
+                grid_tuned = false ;
+                return hash_grid ? hash_grid->tune(0.0, num_agents) : grid->tune(0.0, num_agents) ;
+            }
+            range = r > range ? r : range ;
+            last = inter ;
+        }
+    }
+    grid_tuned = true ;
+    return hash_grid ? hash_grid->tune(range, num_agents) : grid->tune(range, num_agents) ;
+}
+
+void Community::set_grid_tuning(int interval){
+    grid_tuning = interval > 0 ? interval : 0 ;
+    grid_fills = 0 ;
+    grid_tuned = false ;
 }
 
 void Community::fill_grid(){
-    grid->fill_grid( num_agents, agents ) ;
+    if(grid_tuning > 0){
+        if(grid_fills % grid_tuning == 0 || !grid_tuned)
+            this->tune_grid() ;
+        grid_fills += 1 ;
+    }
+    SPP_PROFILE_START(t0) ;
+    if(hash_grid)
+        hash_grid->fill_grid( num_agents, agents ) ;
+    else
+        grid->fill_grid( num_agents, agents ) ;
+    SPP_PROFILE_STOP(t0, SPP_PHASE_GRID_FILL) ;
+    SPP_PROFILE_COUNT(grid_fills, 1) ;
+}
+
+// Profiling
+
+void Community::print_profile(FILE* out){
+    int p ;
+    double total = 0.0 ;
+    long int steps = spp_profile.calls[SPP_PHASE_MOVE] ;
+    fprintf(out, "# Profile of %i agents\n", num_agents) ;
+    spp_profile_print(out) ;
+    if(!spp_profile_enabled() || steps == 0)
+        return ;
+    for(p=0; p<SPP_NUM_PHASES; p++)
+        total += spp_profile.time[p] ;
+    fprintf(out, "# Time per step (s)   %g\n", total / steps) ;
+    fprintf(out, "# Time per agent (s)  %g\n", total / steps / num_agents) ;
+}
+
+void Community::dump_profile(FILE* out){
+    spp_profile_dump(out) ;
 }
 
 /*------------------- End Community class --------------------------*/
 
-double* spp_community_alloc_space(int num_agents){
-    return new double[ num_agents * DIM ] ;
+spp_real* spp_community_alloc_space(int num_agents){
+    return new spp_real[ num_agents * DIM ] ;
 }
 
 Agent* spp_community_alloc_agents(int num_agents){
@@ -342,7 +1041,7 @@ Agent** spp_community_alloc_neighbors(int num_agents){
     return new Agent*[num_agents] ;
 }
 
-Agent* spp_community_build_agents(int num_agents, double* pos, double* vel, Agent** neis, Behavior* behavior){
+Agent* spp_community_build_agents(int num_agents, spp_real* pos, spp_real* vel, Agent** neis, Behavior* behavior){
     /*
      * WARNING: all the agents share the same
      * *behavior* and the same *neis* pointer.
@@ -357,8 +1056,8 @@ Agent* spp_community_build_agents(int num_agents, double* pos, double* vel, Agen
 
 
 Community spp_community_autostart(int num_agents, double speed, double box_size, Behavior* behavior){
-    double* pos  = spp_community_alloc_space(     num_agents) ;
-    double* vel  = spp_community_alloc_space(     num_agents) ;
+    spp_real* pos  = spp_community_alloc_space(     num_agents) ;
+    spp_real* vel  = spp_community_alloc_space(     num_agents) ;
     Agent** neis = spp_community_alloc_neighbors( num_agents) ;
     Agent* ags = spp_community_build_agents(num_agents, pos, vel, neis, behavior) ;
     Community com = Community(num_agents, box_size , ags, pos, vel) ;
@@ -368,3 +1067,25 @@ Community spp_community_autostart(int num_agents, double speed, double box_size,
     com.randomize_directions(speed) ;
     return com ;
 }
+
+Community spp_community_autostart(int num_agents, double speed, double* box_lengths, Behavior* behavior){
+    spp_real* pos  = spp_community_alloc_space(     num_agents) ;
+    spp_real* vel  = spp_community_alloc_space(     num_agents) ;
+    Agent** neis = spp_community_alloc_neighbors( num_agents) ;
+    Agent* ags = spp_community_build_agents(num_agents, pos, vel, neis, behavior) ;
+    Community com = Community(num_agents, box_lengths , ags, pos, vel) ;
+
+    /* Starting positions and velocities */
+    com.randomize_positions() ;
+    com.randomize_directions(speed) ;
+    return com ;
+}
+
+void spp_community_free(Community* com){
+    Agent* ags = com->get_agents() ;
+    if(com->get_num_agents() > 0)
+        delete[] ags[0].get_neis() ;
+    delete[] ags ;
+    delete[] com->get_pos() ;
+    delete[] com->get_vel() ;
+}
@@ -3,6 +3,9 @@
 #include <stdio.h>
 
 class Grid ;
+class HashGrid ;
+class Mesh ;
+class Force ;
 
 /*
  * Community class implemented to easily
@@ -38,9 +41,9 @@ class Community{
          * Inputs:
          *      nags = number of agents in
          *      the community.
-         *      L = size of box. It is fixed
-         *      to be the same in all directions
-         *      for facilitating the use of a Grid.
+         *      L = size of box, the same
+         *      in all directions (see the next
+         *      constructor for a rectangular box).
          *      ags = pointer to the array storing
          *      the *nags* Agent instances.
          *      p = pointer to the array to store
@@ -50,36 +53,51 @@ class Community{
          *      the velocities of agents
          *      (size depens on DIM).
          */
-        Community(int nags , double L, Agent* ags , double* p, double* v) ;
+        Community(int nags , double L, Agent* ags , spp_real* p, spp_real* v) ;
+        /* Same for a rectangular (periodic) box with the DIM
+         * lengths *ls* along each dimension, e.g. an elongated
+         * box to study the bands of the Vicsek model.
+         * The geometry of the interactions (CartesianPeriodic)
+         * and the Grid must be built with the same lengths.
+         */
+        Community(int nags , double* ls, Agent* ags , spp_real* p, spp_real* v) ;
         /* Return the pointer to the position array.
          * The position of agent *i* corresponds to
          * the values
          *      get_pos()[i*DIM : i*DIM + DIM]
          */
-        double* get_pos() ;
-        void set_pos(double* p) {pos=p;} ;
+        spp_real* get_pos() ;
+        void set_pos(spp_real* p) {pos=p;} ;
         /* Return the pointer to the velocity array.
          * The velocity of agent *i* corresponds to
          * the values
          *      get_pos()[i*DIM : i*DIM + DIM]
          */
-        double* get_vel() ;
-        void set_vel(double* v) {vel=v;} ;
+        spp_real* get_vel() ;
+        void set_vel(spp_real* v) {vel=v;} ;
         /* Return the pointer to the array of agents.*/
         Agent* get_agents() ;
         /* Return how many agents are in the community.*/
         int get_num_agents() ;
-        /* Return box size.*/
+        /* Return box size (the largest length if the
+         * box is not cubic).
+         */
         double get_box_size() ;
+        /* Return the pointer to the DIM box lengths. */
+        double* get_box_lengths() {return box_lengths;} ;
+        /* Return true if the box lengths are all the same. */
+        bool is_cubic() {return cubic;} ;
         /* Store random values in the position array *pos*.
-         * The values for each dimension are in the
-         * [0:box_size] range.
+         * The values for each dimension *d* are in the
+         * [0:box_lengths[d]] range.
          */
         void randomize_positions();
         /* Distribute the agents in a regular grid.
-         * The spacing between agents is the same in all dimensions,
-         * and there is ceil(num_agents**(1/dim)) agents per dimension.
-         * If num_agents**(1/dim) is not an integer, the grid will be
+         * The spacing between agents is about the same in all
+         * dimensions: in a cubic box there are ceil(num_agents**(1/dim))
+         * agents per dimension, and in a rectangular box the number
+         * along each dimension is proportional to its length.
+         * If num_agents does not fill the grid, it will be
          * incomplete and the density will not be constant.
          */
         void regular_positions();
@@ -93,8 +111,44 @@ class Community{
         void move(double dt) ;
         /* Move all the agents during *dt* time, assuming
          * periodic boundary conditions in each direction.
+         * If image counters are set (see setup_images), they
+         * count how many times each agent crossed the box.
          */
         void periodic_move(double dt) ;
+        /* Set the boundaries along each dimension: *periodic[i]*
+         * 1 if the dimension *i* is periodic (the default) or 0 if
+         * the box has hard walls at 0 and box_lengths[i] along it,
+         * e.g. {1, 0} for a channel along x. They are used by
+         * walled_move and max_distance, and by the Grid (see
+         * setup_grid). The geometry of the interactions should
+         * have the same boundaries (see CartesianWalled).
+         */
+        void set_boundaries(int* periodic) ;
+        /* Return 1 if the dimension *d* is periodic, 0 if it has walls. */
+        int is_periodic(int d) {return periodic[d];} ;
+        /* Move all the agents during *dt* time with the boundaries
+         * set by set_boundaries: an agent that crosses a wall is
+         * reflected back into the box (specular reflection: its
+         * position is mirrored at the wall and its velocity along
+         * that dimension reversed), and along the periodic dimensions
+         * it moves as in periodic_move, counting the images if set.
+         */
+        void walled_move(double dt) ;
+        /* Start counting the periodic images crossed by each agent
+         * in periodic_move, so that the unwrapped positions
+         *      pos[i] + images[i] * box_lengths[i % DIM]
+         * are known, e.g. for the mean squared displacement.
+         * *img* is an array of num_agents * DIM ints provided by the
+         * user, set to zero here. Pass NULL to stop counting.
+         */
+        void setup_images(int* img) ;
+        /* Return the pointer to the image counters (NULL if not set). */
+        int* get_images() {return images;} ;
+        /* Store in *upos* (num_agents * DIM doubles) the unwrapped
+         * positions of the agents, or the positions in the box if the
+         * image counters are not set.
+         */
+        void unwrapped_positions(double* upos) ;
         /* Sense the consensus velocities using
          * each agent's behavior and store the
          * result in *vel_sensed*.
@@ -104,20 +158,34 @@ class Community{
          * Note: it is not safe to use the class'
          * own *vel* as *vel_sensed*.
          */
-        void sense_velocities(double* vel_sensed) ;
+        void sense_velocities(spp_real* vel_sensed) ;
         /* Same as sense_velocities but calls the
          * Agent->behavior->sense_nosiy_velocity
-         * method.
+         * method. If the behavior has separable noise
+         * (e.g. Vicsek_consensus), the noiseless velocities
+         * are sensed first and the noise is added with a
+         * single call to Behavior::add_noise for all
+         * the consecutive agents sharing that behavior.
          * Note: it is not safe to use the class'
          * own *vel* as *vel_sensed*.
          */
-        void sense_noisy_velocities(double* vel_sensed) ;
+        void sense_noisy_velocities(spp_real* vel_sensed) ;
+        /* Store in *forces* the total force of *force* on each
+         * agent (num_agents * DIM values), using the Grid if set.
+         * The slots of the Grid must be at least as large as
+         * force->range(): with grid tuning (see set_grid_tuning)
+         * the range of the force is used by tune_grid from then on,
+         * otherwise tune the Grid by hand, e.g. calling
+         * tune_grid(force->range()).
+         * Used by the continuous-time integrators (see Langevin).
+         */
+        void sense_forces(Force* force, spp_real* forces) ;
         /* Copy the values in *vel_sensed* to *vel*.
          * This needs to be done separate from the sense_*
          * method to make sure the velocities are
          * updated synchronously.
          */
-        void update_velocities(double* vel_sensed) ;
+        void update_velocities(spp_real* vel_sensed) ;
         /* Print the position and velocity of each
          * agent to stdin. The format used is
          * x    y   vz  vz                  (2D)
@@ -160,7 +228,7 @@ class Community{
          * The array *fluctuations* should be of size num_agents * dim,
          * it can allocated with spp_community_alloc_space.
          */
-        void velocity_fluctuations(double* fluctuations, double v0) ;
+        void velocity_fluctuations(spp_real* fluctuations, double v0) ;
         /* Compute the correlations in velocity fluctuations in the system.
          * Mathematical formulation based on the work by Attanasi et al. in
          *      PLoS Comput Biol 10, e1003697 (2014)
@@ -181,8 +249,45 @@ class Community{
          * have velocity with modulus *v0*.
          */
         void correlation_histo(int n_bins, double v0, double* totalcorr, int* count) ;
+        /* Approximate correlation_histo using the Mesh *mesh*, covering
+         * the same (periodic) box. The velocity fluctuations (see
+         * velocity_fluctuations) are deposited on the mesh and the sum
+         * of their products for all the pairs of cells is computed with
+         * FFTs, in O(M log M) for M cells instead of O(N^2). The distance
+         * between two agents is approximated by the distance between their
+         * cells, so the result is accurate for bins larger than a cell.
+         * The output is the same as in correlation_histo.
+         * The Mesh is cubic and periodic, so the box must be cubic
+         * with no walls too (as for structure_factors and fields);
+         * otherwise an error is printed and nothing is computed.
+         */
+        void correlation_histo_fft(int n_bins, double v0, Mesh* mesh, double* totalcorr, int* count) ;
+        /* Compute the density and velocity structure factors using *mesh*,
+         *      s_density[b] = < |rho(k)|^2 > / N
+         *      s_velocity[b] = < |u(k)|^2 > / N
+         * where rho(k) is the Fourier transform of the density and u(k)
+         * that of the velocity fluctuations (see velocity_fluctuations),
+         * averaged over the *num_modes[b]* wave vectors with modulus in the
+         * bin *b*, of width 2 pi / L centered at b * 2 pi / L. The values
+         * are accurate for wave numbers well below pi / (cell size).
+         */
+        void structure_factors(int n_bins, double v0, Mesh* mesh, double* s_density, double* s_velocity, int* num_modes) ;
+        /* Compute the coarse-grained density and velocity fields on the
+         * cells of *mesh*, e.g. to find the bands of the Vicsek model:
+         *      density[c] = number of agents per unit volume in cell *c*
+         *      velocity[c*DIM + d] = mean velocity along *d* in cell *c*
+         *          (0 in the empty cells)
+         * with *density* of size mesh->get_num_cells() and *velocity*
+         * DIM times larger. If *cic* is not 0 the agents are deposited
+         * with cloud in cell (see Mesh::deposit_cic) instead of in the
+         * cell containing them. The local polarization is the modulus of
+         * the velocity divided by the speed of the agents. The fields can
+         * be written with Mesh::write_frame.
+         */
+        void fields(Mesh* mesh, int cic, double* density, double* velocity) ;
         /* Return the distance between the two farthest points in
-         * the computation box with periodic boundary conditions.
+         * the computation box, with its boundaries (periodic by
+         * default, see set_boundaries).
          */
         double max_distance() ;
         /* Build a "matrix" containing who is connected with whom.
@@ -203,36 +308,128 @@ class Community{
          * seventh.
          */
         void print_network(int* num_neis, Agent*** network) ;
+        /* Find the clusters (flocks) of the interaction network: two
+         * agents are in the same cluster if there is a path of neighbors
+         * between them, regardless of the direction of the links.
+         * Uses the Grid if set up, and a union-find structure so that
+         * the cost is that of finding the neighbors of every agent.
+         * Outputs:
+         *      labels[i] = cluster of agent *i*, numbered from 0 in
+         *          order of appearance, size num_agents.
+         *      sizes[c] = number of agents in the cluster *c*, the
+         *          array must be of size num_agents.
+         * Returns the number of clusters.
+         */
+        int clusters(int* labels, int* sizes) ;
+        /* Same as clusters() but linking the agents at a distance
+         * smaller or equal to *radius*, whatever their interaction.
+         * Uses cell lists of size >= *radius* built on the fly.
+         */
+        int clusters_metric(double radius, int* labels, int* sizes) ;
+        /* Store in *histo* (of size num_agents+1) the number of
+         * clusters of each size, from the *sizes* of the
+         * *num_clusters* clusters found by clusters().
+         */
+        void cluster_size_histo(int num_clusters, int* sizes, int* histo) ;
         /* Start using a Grid to compute
          * the neighbors of each agent.
          * The Grid instance *g* has to
          * be initialized by the user before
-         * calling this function.
+         * calling this function. It gets the
+         * boundaries of the Community (see
+         * set_boundaries).
          */
         void setup_grid(Grid* g) ;
+        /* Same with a HashGrid, for agents in open space,
+         * in place of the Grid.
+         */
+        void setup_grid(HashGrid* g) ;
+        /* Choose the number of slots of the Grid from the range of
+         * the interactions of the agents (see Interaction::range),
+         * the largest one over all the interactions, and the number
+         * of agents (see Grid::tune). Return the number of slots, or
+         * 0 if there is no Grid. If the range of some interaction is
+         * not known (e.g. Topologic before the first step) the Grid
+         * is not changed. The slots are not smaller than the range of
+         * the last Force given to sense_forces either.
+         */
+        int tune_grid() ;
+        /* Same, with slots not smaller than *min_range* either
+         * (instead of the range of the Force).
+         */
+        int tune_grid(double min_range) ;
+        /* Call tune_grid() every *interval* times the grid is filled
+         * (0 to never do it, the default), and every time until the
+         * range of the interactions is known, so that the slots
+         * follow the interaction range as the density changes.
+         */
+        void set_grid_tuning(int interval) ;
+        /* Start bouncing the agents off the obstacles *obs* (see
+         * Obstacles::reflect) at the end of move, periodic_move and
+         * walled_move. Pass NULL to stop it. It builds the index of
+         * *obs* (see Obstacles::build). To also steer the agents
+         * away from them use a Vicsek_avoider behavior.
+         */
+        void setup_obstacles(Obstacles* obs) ;
         /* Fill the grid calling its own
-         * fill_grid method. This method
+         * fill_grid method, tuning it first
+         * if set (see set_grid_tuning). This method
          * does NOT check that if grid has
          * been setup or not.
          */
         void fill_grid() ;
+        /* Call Interaction::prepare (and set_grid with the
+         * Grid in use) for the interaction of every agent, once
+         * per consecutive group of agents sharing it. Called by
+         * the sense_* methods and build_network.
+         */
+        void prepare_interactions() ;
+        /* Print to *out* the time spent in each phase of the step
+         * (grid fill, sensing, neighbor search, noise, move and
+         * observables), the neighbors per search, and the time per
+         * step, counted since the last spp_profile_reset() in the
+         * thread running the community. Requires the library to be
+         * compiled with -DSPP_PROFILE (see profile.h).
+         */
+        void print_profile(FILE* out) ;
+        /* Same as print_profile but in one line of JSON. */
+        void dump_profile(FILE* out) ;
     protected:
         /* Number of agents. */
         int num_agents ;
         /* positions of the agents
          *      Size: num_agents * DIM
          */
-        double* pos ;
+        spp_real* pos ;
         /* velocities of the agents
          *      Size: num_agents * DIM
          */
-        double* vel ;
+        spp_real* vel ;
         /* Array of agents
          *      Size: num_agents
          */
         Agent* agents ;
-        /* Box size, same in all directions. */
+        /* Set the box lengths to the DIM values *ls*,
+         * and *box_size* and *cubic* accordingly.
+         */
+        void set_box_lengths(double* ls) ;
+        /* Return 1 if the box is cubic and periodic along every
+         * dimension, as the Mesh, otherwise print an error for the
+         * method *name* and return 0.
+         */
+        int check_cubic(const char* name) ;
+        /* Box size, the largest of the box lengths. */
         double box_size ;
+        /* Length of the box along each dimension,
+         * and whether they are all the same.
+         */
+        double box_lengths[SPP_MAX_DIM] ;
+        bool cubic ;
+        /* 1 if the dimension is periodic, 0 if it has walls,
+         * and whether all of them are periodic.
+         */
+        int periodic[SPP_MAX_DIM] ;
+        bool all_periodic ;
         /* False by default. Turns to True
          * when a Grid instance is inseted
          * in Community through setup_grid().
@@ -245,15 +442,48 @@ class Community{
          * be set with setup_grid().
          */
         Grid* grid ;
+        /* HashGrid used instead of *grid* (only one of
+         * them is not NULL), see setup_grid().
+         */
+        HashGrid* hash_grid ;
+        /* Return the neighborhood of *ag* in the grid in use
+         * and store its size in *num_neis*.
+         */
+        Agent* get_neighborhood(Agent* ag, int* num_neis) ;
+        /* Fills of the grid between calls to tune_grid
+         * (0 = never), fills since the last call, and
+         * whether it found the range of the interactions.
+         */
+        int grid_tuning ;
+        int grid_fills ;
+        bool grid_tuned ;
+        /* Range of the last Force given to sense_forces,
+         * the smallest size of the slots for tune_grid.
+         */
+        double force_range ;
+        /* Number of times each agent crossed the box in each
+         * direction (positive when going up), or NULL.
+         *      Size: num_agents * DIM
+         */
+        int* images ;
+        /* Obstacles the agents bounce off, or NULL. */
+        Obstacles* obstacles ;
+        /* Reflect the agents that entered an obstacle, and bring
+         * those pushed out of the box back to it: wrapped around
+         * (counting the crossing in *images*) along the dimensions
+         * with *wrap[d]* 1, and kept inside the walls along the
+         * others. *wrap* is NULL in open space.
+         */
+        void collide_obstacles(int* wrap) ;
 } ;
 
 // Utils for automatization of the setup of a Community.
 
 /* Allocate space for storing a vector per agent,
- * i.e. num_agents * DIM doubles, and return the
+ * i.e. num_agents * DIM spp_reals, and return the
  * pointer to the array.
  */
-double* spp_community_alloc_space(int num_agents) ;
+spp_real* spp_community_alloc_space(int num_agents) ;
 /* Allocate space for a vector of Agent instances
  * and return the pointer to the array.
  */
@@ -273,7 +503,7 @@ Agent** spp_community_alloc_neighbors(int num_agents) ;
  *
  * TODO add a spp_community_build_agents_parallel(...)
  */
-Agent* spp_community_build_agents(int num_agents, double* pos, double* vel, Agent** neis, Behavior* behavior) ;
+Agent* spp_community_build_agents(int num_agents, spp_real* pos, spp_real* vel, Agent** neis, Behavior* behavior) ;
 /* Return a Community instance "ready to use" from scratch.
  * Allocate the required space, initialize the agents
  * and randomize their positions and velocities.
@@ -284,3 +514,12 @@ Agent* spp_community_build_agents(int num_agents, double* pos, double* vel, Agen
  * is therefore not thread-safe for parallelization.
  */
 Community spp_community_autostart(int num_agents, double speed, double box_size, Behavior* behavior) ;
+/* Same as spp_community_autostart for a
+ * rectangular box with the DIM lengths *box_lengths*.
+ */
+Community spp_community_autostart(int num_agents, double speed, double* box_lengths, Behavior* behavior) ;
+/* Free the space allocated by spp_community_autostart for *com*:
+ * its agents, positions, velocities and the list of neighbors
+ * they share. The Community must not be used afterwards.
+ */
+void spp_community_free(Community* com) ;
@@ -0,0 +1,365 @@
+#include "distributed_community.h"
+#include "agent.h"
+#include "random.h"
+#include <stdio.h>
+#include <math.h>
+#include <mpi.h>
+
+#ifdef SPP_SINGLE
+#define SPP_MPI_REAL MPI_FLOAT
+#else
+#define SPP_MPI_REAL MPI_DOUBLE
+#endif
+
+/* Each agent in the buffers: DIM positions and DIM velocities */
+#define AGENT_SIZE (2*DIM)
+
+DistributedCommunity::DistributedCommunity(int nags, double L, double range, Behavior* behavior, long int seed){
+    int c, q ;
+    double ncells ;
+    num_agents = nags ;
+    box_size = L ;
+    beh = behavior ;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank) ;
+    MPI_Comm_size(MPI_COMM_WORLD, &num_ranks) ;
+
+    /* Same cells as DomainCommunity */
+    ncx = (int) (box_size / range) ;
+    ncells = pow(ncx, DIM) ;
+    if(ncells > 4.0 * num_agents)
+        ncx = (int) pow(4.0 * num_agents, 1.0/DIM) ;
+    if(ncx < 3)
+        ncx = 1 ;
+    ncy = ncx ;
+    ncz = DIM > 2 ? ncx : 1 ;
+    if(num_ranks > ncx && rank == 0)
+        fprintf(stderr, "libspp.DistributedCommunity: ERROR - Only %i columns of cells for %i ranks, some ranks own no agents.\n", ncx, num_ranks) ;
+
+    rank_cx0 = new int[num_ranks+1] ;
+    for(q=0; q<=num_ranks; q++)
+        rank_cx0[q] = (q * ncx) / num_ranks ;
+    column_owner = new int[ncx] ;
+    for(q=0; q<num_ranks; q++){
+        for(c=rank_cx0[q]; c<rank_cx0[q+1]; c++)
+            column_owner[c] = q ;
+    }
+
+    spp_set_seed(seed + rank) ;
+    domain.setup(rank_cx0[rank], rank_cx0[rank+1], ncx, ncy, ncz, box_size, beh,
+                 (int) (2.0 * num_agents * (rank_cx0[rank+1] - rank_cx0[rank]) / ncx) + 64) ;
+
+    send_capacity = recv_capacity = 0 ;
+    send_buf = recv_buf = NULL ;
+    send_ids = recv_ids = NULL ;
+    send_counts = new int[num_ranks] ;
+    send_displs = new int[num_ranks] ;
+    recv_counts = new int[num_ranks] ;
+    recv_displs = new int[num_ranks] ;
+}
+
+void DistributedCommunity::grow_send(int n){
+    if(n <= send_capacity)
+        return ;
+    send_capacity = 2*send_capacity > n ? 2*send_capacity : n ;
+    delete[] send_buf ;
+    delete[] send_ids ;
+    send_buf = new spp_real[send_capacity*AGENT_SIZE] ;
+    send_ids = new long int[send_capacity] ;
+}
+
+void DistributedCommunity::grow_recv(int n){
+    if(n <= recv_capacity)
+        return ;
+    recv_capacity = 2*recv_capacity > n ? 2*recv_capacity : n ;
+    delete[] recv_buf ;
+    delete[] recv_ids ;
+    recv_buf = new spp_real[recv_capacity*AGENT_SIZE] ;
+    recv_ids = new long int[recv_capacity] ;
+}
+
+void DistributedCommunity::randomize(){
+    /* Each slab gets its share of the agents, uniformly */
+    int cx0 = rank_cx0[rank] ;
+    int cx1 = rank_cx0[rank+1] ;
+    double w = box_size / ncx ;
+    long int id ;
+    long int id0 = ((long int) num_agents * cx0) / ncx ;
+    long int id1 = ((long int) num_agents * cx1) / ncx ;
+    spp_real p[DIM], v[DIM] ;
+    int k, c ;
+    domain.num_agents = 0 ;
+    for(id=id0; id<id1; id++){
+        p[0] = (cx0 + (cx1 - cx0) * spp_random_uniform()) * w ;
+        for(k=1; k<DIM; k++)
+            p[k] = box_size * spp_random_uniform() ;
+        c = domain.column(p) ;
+        if(c < cx0 || c >= cx1)
+            p[0] = (cx0 + 0.5) * w ;
+        Agent a = Agent(p, v, NULL, beh) ;
+        a.randomize_velocity() ;
+        domain.add_agents(1, p, v, &id) ;
+    }
+    domain.sort_cells() ;
+}
+
+void DistributedCommunity::load(spp_real* p, spp_real* v){
+    long int id ;
+    int c ;
+    domain.num_agents = 0 ;
+    for(id=0; id<num_agents; id++){
+        c = domain.column(p + id*DIM) ;
+        if(c >= domain.cx0 && c < domain.cx1)
+            domain.add_agents(1, p + id*DIM, v + id*DIM, &id) ;
+    }
+    domain.sort_cells() ;
+}
+
+void DistributedCommunity::gather(spp_real* p, spp_real* v){
+    MPI_Datatype agent_type ;
+    int n = domain.num_agents ;
+    int i, j, k, q ;
+    long int id ;
+
+    this->grow_send(n) ;
+    for(i=0; i<n; i++){
+        for(k=0; k<DIM; k++){
+            send_buf[i*AGENT_SIZE + k] = domain.pos[i*DIM + k] ;
+            send_buf[i*AGENT_SIZE + DIM + k] = domain.vel[i*DIM + k] ;
+        }
+        send_ids[i] = domain.ids[i] ;
+    }
+    MPI_Gather(&n, 1, MPI_INT, recv_counts, 1, MPI_INT, 0, MPI_COMM_WORLD) ;
+    if(rank == 0){
+        j = 0 ;
+        for(q=0; q<num_ranks; q++){
+            recv_displs[q] = j ;
+            j += recv_counts[q] ;
+        }
+        this->grow_recv(j) ;
+    }
+    MPI_Type_contiguous(AGENT_SIZE, SPP_MPI_REAL, &agent_type) ;
+    MPI_Type_commit(&agent_type) ;
+    MPI_Gatherv(send_buf, n, agent_type, recv_buf, recv_counts, recv_displs, agent_type, 0, MPI_COMM_WORLD) ;
+    MPI_Gatherv(send_ids, n, MPI_LONG, recv_ids, recv_counts, recv_displs, MPI_LONG, 0, MPI_COMM_WORLD) ;
+    MPI_Type_free(&agent_type) ;
+    if(rank == 0){
+        for(j=0; j<num_agents; j++){
+            id = recv_ids[j] ;
+            for(k=0; k<DIM; k++){
+                p[id*DIM + k] = recv_buf[j*AGENT_SIZE + k] ;
+                v[id*DIM + k] = recv_buf[j*AGENT_SIZE + DIM + k] ;
+            }
+        }
+    }
+}
+
+void DistributedCommunity::exchange_migrants(){
+    /* All-to-all, so that agents can move any distance. */
+    MPI_Datatype agent_type ;
+    int i, j, k, q, nrecv ;
+    for(q=0; q<num_ranks; q++)
+        send_counts[q] = 0 ;
+    for(i=0; i<domain.num_out; i++)
+        send_counts[column_owner[domain.out_col[i]]] += 1 ;
+    j = 0 ;
+    for(q=0; q<num_ranks; q++){
+        send_displs[q] = j ;
+        j += send_counts[q] ;
+    }
+    this->grow_send(domain.num_out) ;
+    for(i=0; i<domain.num_out; i++){
+        j = send_displs[column_owner[domain.out_col[i]]]++ ;
+        for(k=0; k<DIM; k++){
+            send_buf[j*AGENT_SIZE + k] = domain.out_pos[i*DIM + k] ;
+            send_buf[j*AGENT_SIZE + DIM + k] = domain.out_vel[i*DIM + k] ;
+        }
+        send_ids[j] = domain.out_ids[i] ;
+    }
+    for(q=0; q<num_ranks; q++)
+        send_displs[q] -= send_counts[q] ;
+
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, MPI_COMM_WORLD) ;
+    nrecv = 0 ;
+    for(q=0; q<num_ranks; q++){
+        recv_displs[q] = nrecv ;
+        nrecv += recv_counts[q] ;
+    }
+    this->grow_recv(nrecv) ;
+    MPI_Type_contiguous(AGENT_SIZE, SPP_MPI_REAL, &agent_type) ;
+    MPI_Type_commit(&agent_type) ;
+    MPI_Alltoallv(send_buf, send_counts, send_displs, agent_type,
+                  recv_buf, recv_counts, recv_displs, agent_type, MPI_COMM_WORLD) ;
+    MPI_Alltoallv(send_ids, send_counts, send_displs, MPI_LONG,
+                  recv_ids, recv_counts, recv_displs, MPI_LONG, MPI_COMM_WORLD) ;
+    MPI_Type_free(&agent_type) ;
+    for(j=0; j<nrecv; j++)
+        domain.add_agents(1, recv_buf + j*AGENT_SIZE, recv_buf + j*AGENT_SIZE + DIM, recv_ids + j) ;
+}
+
+void DistributedCommunity::exchange_halo(){
+    /*
+     * The halo of rank q are the columns before (tag 0) and
+     * after (tag 1) its slab. Each one is sent by its owner as
+     * a block of positions followed by a block of velocities.
+     */
+    MPI_Request* reqs = new MPI_Request[2*num_ranks] ;
+    MPI_Status st ;
+    int q, t, c, cs[2], first, n, nsend, off, total, cnt, k, o ;
+    for(t=0; t<2; t++){
+        total = 0 ;
+        for(q=0; q<num_ranks; q++){
+            if(q == rank)
+                continue ;
+            cs[0] = (rank_cx0[q] - 1 + ncx) % ncx ;
+            cs[1] = rank_cx0[q+1] % ncx ;
+            for(k=0; k<2; k++){
+                c = cs[k] ;
+                if((k == 1 && c == cs[0]) || column_owner[c] != rank)
+                    continue ;
+                domain.column_range(c, &first, &n) ;
+                if(t == 0){
+                    total += n ;
+                }else{
+                    for(int i=0; i<n*DIM; i++){
+                        send_buf[off + i] = domain.pos[first*DIM + i] ;
+                        send_buf[off + n*DIM + i] = domain.vel[first*DIM + i] ;
+                    }
+                    MPI_Isend(send_buf + off, 2*n*DIM, SPP_MPI_REAL, q, k, MPI_COMM_WORLD, reqs + nsend) ;
+                    nsend += 1 ;
+                    off += 2*n*DIM ;
+                }
+            }
+        }
+        if(t == 0){
+            this->grow_send(total) ;
+            nsend = off = 0 ;
+        }
+    }
+
+    cs[0] = (domain.cx0 - 1 + ncx) % ncx ;
+    cs[1] = domain.cx1 % ncx ;
+    for(k=0; k<2; k++){
+        c = cs[k] ;
+        o = column_owner[c] ;
+        if((k == 1 && c == cs[0]) || o == rank)
+            continue ;
+        MPI_Probe(o, k, MPI_COMM_WORLD, &st) ;
+        MPI_Get_count(&st, SPP_MPI_REAL, &cnt) ;
+        n = cnt / (2*DIM) ;
+        this->grow_recv(n) ;
+        MPI_Recv(recv_buf, cnt, SPP_MPI_REAL, o, k, MPI_COMM_WORLD, MPI_STATUS_IGNORE) ;
+        domain.add_halo(c, n, recv_buf, recv_buf + n*DIM) ;
+    }
+    MPI_Waitall(nsend, reqs, MPI_STATUSES_IGNORE) ;
+    delete[] reqs ;
+}
+
+void DistributedCommunity::run(int num_steps, double dt){
+    for(int s=0; s<num_steps; s++){
+        domain.move(dt) ;
+        this->exchange_migrants() ;
+        domain.sort_cells() ;
+        this->exchange_halo() ;
+        domain.sense() ;
+    }
+}
+
+double DistributedCommunity::mean_velocity(double* meanvel){
+    int k ;
+    double mv2 = 0.0 ;
+    for(k=0; k<DIM; k++)
+        meanvel[k] = 0.0 ;
+    domain.sum_velocity(meanvel) ;
+    MPI_Allreduce(MPI_IN_PLACE, meanvel, DIM, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD) ;
+    for(k=0; k<DIM; k++){
+        meanvel[k] /= num_agents ;
+        mv2 += meanvel[k] * meanvel[k] ;
+    }
+    return mv2 ;
+}
+
+double DistributedCommunity::order_parameter(double v0){
+    double meanvel[DIM] ;
+    double mv2 = this->mean_velocity(meanvel) ;
+    return sqrt(mv2)/v0 ;
+}
+
+double DistributedCommunity::max_distance(){
+    /* See Community::max_distance */
+    return box_size * sqrt(DIM / 4.) ;
+}
+
+/* Add to the histograms the pairs between the *n1* agents in *b1*
+ * and the *n2* in *b2* (all the pairs i<j if *same*), with the
+ * layout of the buffers (positions and velocities of each agent).
+ */
+static void correlation_pairs(int n1, spp_real* b1, int n2, spp_real* b2, int same,
+                              double L, double bindist, double* mv, double* totalcorr, long* count){
+    int i, j, k, bin ;
+    double dx, d2, corr ;
+    for(i=0; i<n1; i++){
+        for(j=(same ? i+1 : 0); j<n2; j++){
+            d2 = 0.0 ;
+            corr = 0.0 ;
+            for(k=0; k<DIM; k++){
+                dx = fabs(b1[i*AGENT_SIZE + k] - b2[j*AGENT_SIZE + k]) ;
+                dx = dx > 0.5*L ? L - dx : dx ;
+                d2 += dx * dx ;
+                corr += (b1[i*AGENT_SIZE + DIM + k] - mv[k]) * (b2[j*AGENT_SIZE + DIM + k] - mv[k]) ;
+            }
+            bin = int( sqrt(d2) * bindist ) ;
+            count[bin] += 1 ;
+            totalcorr[bin] += corr ;
+        }
+    }
+}
+
+void DistributedCommunity::correlation_histo(int n_bins, double v0, double* totalcorr, long* count, int stride){
+    /* See Community::correlation_histo for the binning. */
+    int i, k, s, src, dst, nsrc ;
+    int n = 0 ;
+    double mv[DIM] ;
+    double speed2, norm ;
+    double bindist = n_bins / (this->max_distance() * 1.000001) ;
+
+    for(i=0; i<n_bins; i++)
+        totalcorr[i] = 0.0 ;
+    for(i=0; i<n_bins; i++)
+        count[i] = 0 ;
+    speed2 = this->mean_velocity(mv) ;
+    norm = 1.0 / ( v0 * v0 - speed2 ) ;
+
+    /* The agents of the sample, with an id multiple of stride */
+    stride = stride > 1 ? stride : 1 ;
+    this->grow_send(domain.num_agents) ;
+    for(i=0; i<domain.num_agents; i++){
+        if(domain.ids[i] % stride != 0)
+            continue ;
+        for(k=0; k<DIM; k++){
+            send_buf[n*AGENT_SIZE + k] = domain.pos[i*DIM + k] ;
+            send_buf[n*AGENT_SIZE + DIM + k] = domain.vel[i*DIM + k] ;
+        }
+        n += 1 ;
+    }
+    correlation_pairs(n, send_buf, n, send_buf, 1, box_size, bindist, mv, totalcorr, count) ;
+
+    /* At shift *s* take the slab of rank-s. The pairs with rank+s
+     * are done there, except for s = num_ranks/2 (even num_ranks),
+     * which both ranks get: only the lower rank counts it.
+     */
+    for(s=1; s<=num_ranks/2; s++){
+        dst = (rank + s) % num_ranks ;
+        src = (rank - s + num_ranks) % num_ranks ;
+        MPI_Sendrecv(&n, 1, MPI_INT, dst, 0, &nsrc, 1, MPI_INT, src, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE) ;
+        this->grow_recv(nsrc) ;
+        MPI_Sendrecv(send_buf, n*AGENT_SIZE, SPP_MPI_REAL, dst, 1,
+                     recv_buf, nsrc*AGENT_SIZE, SPP_MPI_REAL, src, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE) ;
+        if(2*s == num_ranks && rank > src)
+            continue ;
+        correlation_pairs(n, send_buf, nsrc, recv_buf, 0, box_size, bindist, mv, totalcorr, count) ;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, totalcorr, n_bins, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD) ;
+    MPI_Allreduce(MPI_IN_PLACE, count, n_bins, MPI_LONG, MPI_SUM, MPI_COMM_WORLD) ;
+    for(i=0; i<n_bins; i++)
+        totalcorr[i] *= norm ;
+}
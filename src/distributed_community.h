@@ -0,0 +1,111 @@
+#include "domain_community.h"
+
+/*
+ * DistributedCommunity class implemented to simulate swarms too
+ * large for the memory of a single machine with MPI. The periodic
+ * box is split along x in one slab per rank (see Domain), and every
+ * step each rank moves its agents, sends the ones that leave its slab
+ * to the rank owning their new position, exchanges the halo with the
+ * ranks owning the neighbor columns of cells, and senses the velocities
+ * of its agents. The result is the same as with a Community or a
+ * DomainCommunity.
+ *
+ * All the ranks of MPI_COMM_WORLD take part, and every method is
+ * collective (must be called by all the ranks). MPI must be initialized
+ * before creating the class. The observables are reduced across the
+ * ranks, and every rank gets the result.
+ *
+ * The geometry is CartesianPeriodic with box size *L*, and the
+ * interaction must have a finite *range* (see DomainCommunity).
+ * The random number generator of each rank is seeded with *seed*
+ * plus the rank.
+ *
+ * This class is only available in the MPI libraries, see `make mpi`.
+ */
+class DistributedCommunity {
+    public:
+        /* Create the slab of this rank for a swarm of *num_agents*
+         * agents using *behavior*. If there are more ranks than
+         * columns of cells, the extra ranks own no agents.
+         */
+        DistributedCommunity(int num_agents, double L, double range, Behavior* behavior, long int seed) ;
+        /* Place the agents randomly in the box, with random
+         * directions (see Behavior::randomize_velocity).
+         */
+        void randomize() ;
+        /* Set the positions and velocities of the agents from the
+         * arrays *pos* and *vel* of size num_agents*DIM, which must
+         * be the same in all the ranks. The agent stored in pos[i*DIM]
+         * has id *i*.
+         */
+        void load(spp_real* pos, spp_real* vel) ;
+        /* Store the positions and velocities of all the agents in
+         * *pos* and *vel* of rank 0, of size num_agents*DIM, ordered
+         * by id. They are not used in the other ranks.
+         */
+        void gather(spp_real* pos, spp_real* vel) ;
+        /* Advance *num_steps* steps of *dt*, each of them equivalent
+         * to calling periodic_move, sense_noisy_velocities and
+         * update_velocities of a Community.
+         */
+        void run(int num_steps, double dt) ;
+        /* Store the mean velocity in *meanvel*.
+         * Return the norm^2 of the mean.
+         */
+        double mean_velocity(double* meanvel) ;
+        /* Return the order parameter (see Community::order_parameter). */
+        double order_parameter(double v0) ;
+        /* Compute the correlations in velocity fluctuations as in
+         * Community::correlation_histo, with the pairs of the agents
+         * whose id is a multiple of *stride* (1 for all the pairs),
+         * which takes O((N/stride)^2) operations. Each rank receives
+         * the sample of half of the other ranks, so that each pair
+         * of agents is counted once, and the histograms are then
+         * added up. The counts are long, since there can be more
+         * than 2^31 pairs per bin with all the agents.
+         */
+        void correlation_histo(int n_bins, double v0, double* totalcorr, long* count, int stride) ;
+        /* Return the distance between the two farthest points in
+         * the computation box with periodic boundary conditions.
+         */
+        double max_distance() ;
+        /* Return the number of agents in the whole box. */
+        int get_num_agents() {return num_agents;} ;
+        /* Return the number of agents in this rank. */
+        int get_local_agents() {return domain.num_agents;} ;
+        /* Return the rank and the number of ranks. */
+        int get_rank() {return rank;} ;
+        int get_num_ranks() {return num_ranks;} ;
+        /* Return the box size. */
+        double get_box_size() {return box_size;} ;
+    protected:
+        /* Send the agents that left the slab in the last move
+         * to their new owners and add the ones received.
+         */
+        void exchange_migrants() ;
+        /* Send the columns of the slab that are in the halo of
+         * other ranks and fill the halo with the ones received.
+         */
+        void exchange_halo() ;
+        /* Make room for *n* agents (DIM positions, DIM velocities
+         * and the id of each) in the send or receive buffers.
+         */
+        void grow_send(int n) ;
+        void grow_recv(int n) ;
+        int num_agents ;
+        double box_size ;
+        int ncx, ncy, ncz ;
+        int rank, num_ranks ;
+        /* First column of each rank (and ncx at the end),
+         * and the rank owning each column.
+         */
+        int* rank_cx0 ;
+        int* column_owner ;
+        Domain domain ;
+        Behavior* beh ;
+        /* Buffers and counts for the exchanges. */
+        int send_capacity, recv_capacity ;
+        spp_real *send_buf, *recv_buf ;
+        long int *send_ids, *recv_ids ;
+        int *send_counts, *send_displs, *recv_counts, *recv_displs ;
+} ;
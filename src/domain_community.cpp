@@ -0,0 +1,611 @@
+#include "domain_community.h"
+#include "agent.h"
+#include "random.h"
+#include "profile.h"
+#include <stdio.h>
+#include <math.h>
+#include <sched.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* Make room for *n* values in *arr*, keeping
+ * the first *keep* ones.
+ */
+template <class T>
+static void grow_array(T** arr, int keep, int n){
+    T* tmp = new T[n] ;
+    for(int i=0; i<keep; i++)
+        tmp[i] = (*arr)[i] ;
+    delete[] *arr ;
+    *arr = tmp ;
+}
+
+/*
+ * Domain
+ */
+void Domain::setup(int c0, int c1, int nx, int ny, int nz, double L, Behavior* b, int cap){
+    int c, ncols ;
+    cx0 = c0 ;
+    cx1 = c1 ;
+    ncx = nx ;
+    ncy = ny ;
+    ncz = nz ;
+    box_size = L ;
+    beh = b ;
+    ncols = cx1 - cx0 ;
+
+    lx_of = new int[ncx] ;
+    for(c=0; c<ncx; c++)
+        lx_of[c] = -1 ;
+    if(ncols < ncx){
+        lx_of[(cx0 - 1 + ncx) % ncx] = 0 ;
+        if(lx_of[cx1 % ncx] < 0)
+            lx_of[cx1 % ncx] = ncols + 1 ;
+    }
+    for(c=cx0; c<cx1; c++)
+        lx_of[c] = c - cx0 + 1 ;
+    num_cells = (ncols + 2) * ncy * ncz ;
+    cell_first = new int[num_cells] ;
+    cell_num   = new int[num_cells] ;
+    for(c=0; c<num_cells; c++){
+        cell_first[c] = 0 ;
+        cell_num[c] = 0 ;
+    }
+
+    num_agents = num_halo = num_out = 0 ;
+    capacity = cap ;
+    pos = new spp_real[capacity*DIM] ;
+    vel = new spp_real[capacity*DIM] ;
+    ids = new long int[capacity] ;
+    tmp_pos = new spp_real[capacity*DIM] ;
+    tmp_vel = new spp_real[capacity*DIM] ;
+    tmp_ids = new long int[capacity] ;
+    agent_cell = new int[capacity] ;
+    vel_sensed = new spp_real[capacity*DIM] ;
+    halo_capacity = cap / (ncols > 1 ? ncols : 1) + 64 ;
+    halo_pos  = new spp_real[halo_capacity*DIM] ;
+    halo_vel  = new spp_real[halo_capacity*DIM] ;
+    halo_cell = new int[halo_capacity] ;
+    out_capacity = 64 ;
+    out_pos = new spp_real[out_capacity*DIM] ;
+    out_vel = new spp_real[out_capacity*DIM] ;
+    out_ids = new long int[out_capacity] ;
+    out_col = new int[out_capacity] ;
+    agents_capacity = capacity + halo_capacity ;
+    agents = new Agent[agents_capacity] ;
+    cands  = new Agent[agents_capacity] ;
+    neis   = new Agent*[agents_capacity] ;
+}
+
+Domain::~Domain(){
+    if(lx_of == NULL)
+        return ;
+    delete[] lx_of ;
+    delete[] cell_first ;
+    delete[] cell_num ;
+    delete[] pos ;
+    delete[] vel ;
+    delete[] ids ;
+    delete[] tmp_pos ;
+    delete[] tmp_vel ;
+    delete[] tmp_ids ;
+    delete[] agent_cell ;
+    delete[] vel_sensed ;
+    delete[] halo_pos ;
+    delete[] halo_vel ;
+    delete[] halo_cell ;
+    delete[] out_pos ;
+    delete[] out_vel ;
+    delete[] out_ids ;
+    delete[] out_col ;
+    delete[] agents ;
+    delete[] cands ;
+    delete[] neis ;
+}
+
+void Domain::grow(int n){
+    if(n <= capacity)
+        return ;
+    int cap = 2*capacity > n ? 2*capacity : n ;
+    grow_array(&pos, num_agents*DIM, cap*DIM) ;
+    grow_array(&vel, num_agents*DIM, cap*DIM) ;
+    grow_array(&ids, num_agents, cap) ;
+    grow_array(&tmp_pos, 0, cap*DIM) ;
+    grow_array(&tmp_vel, 0, cap*DIM) ;
+    grow_array(&tmp_ids, 0, cap) ;
+    grow_array(&agent_cell, 0, cap) ;
+    grow_array(&vel_sensed, 0, cap*DIM) ;
+    capacity = cap ;
+}
+
+void Domain::grow_halo(int nh){
+    if(nh <= halo_capacity)
+        return ;
+    int cap = 2*halo_capacity > nh ? 2*halo_capacity : nh ;
+    grow_array(&halo_pos, num_halo*DIM, cap*DIM) ;
+    grow_array(&halo_vel, num_halo*DIM, cap*DIM) ;
+    grow_array(&halo_cell, num_halo, cap) ;
+    halo_capacity = cap ;
+}
+
+void Domain::grow_out(int no){
+    if(no <= out_capacity)
+        return ;
+    int cap = 2*out_capacity > no ? 2*out_capacity : no ;
+    grow_array(&out_pos, num_out*DIM, cap*DIM) ;
+    grow_array(&out_vel, num_out*DIM, cap*DIM) ;
+    grow_array(&out_ids, num_out, cap) ;
+    grow_array(&out_col, num_out, cap) ;
+    out_capacity = cap ;
+}
+
+int Domain::column(spp_real* p){
+    int cx = (int) (p[0] * ncx / box_size) ;
+    return cx < 0 ? 0 : (cx >= ncx ? ncx-1 : cx) ;
+}
+
+int Domain::local_cell(spp_real* p){
+    int lx = lx_of[column(p)] ;
+    int cy, cz = 0 ;
+    if(lx < 0)
+        return -1 ;
+    cy = (int) (p[1] * ncy / box_size) ;
+    cy = cy < 0 ? 0 : (cy >= ncy ? ncy-1 : cy) ;
+#if DIM>2
+    cz = (int) (p[2] * ncz / box_size) ;
+    cz = cz < 0 ? 0 : (cz >= ncz ? ncz-1 : cz) ;
+#endif
+    return (lx*ncy + cy)*ncz + cz ;
+}
+
+void Domain::add_agents(int n, spp_real* p, spp_real* v, long int* id){
+    int i ;
+    this->grow(num_agents + n) ;
+    for(i=0; i<n*DIM; i++){
+        pos[num_agents*DIM + i] = p[i] ;
+        vel[num_agents*DIM + i] = v[i] ;
+    }
+    for(i=0; i<n; i++)
+        ids[num_agents + i] = id[i] ;
+    num_agents += n ;
+}
+
+void Domain::add_halo(int cx, int n, spp_real* p, spp_real* v){
+    /* The agents come sorted by cell (see column_range),
+     * so each cell of the column is a contiguous range.
+     */
+    int i, lc ;
+    this->grow_halo(num_halo + n) ;
+    for(i=0; i<n*DIM; i++){
+        halo_pos[num_halo*DIM + i] = p[i] ;
+        halo_vel[num_halo*DIM + i] = v[i] ;
+    }
+    for(i=num_halo; i<num_halo+n; i++){
+        lc = this->local_cell(halo_pos + i*DIM) ;
+        halo_cell[i] = lc ;
+        if(cell_num[lc] == 0)
+            cell_first[lc] = num_agents + i ;
+        cell_num[lc] += 1 ;
+    }
+    num_halo += n ;
+}
+
+void Domain::move(double dt){
+    const spp_real h = dt ;
+    const spp_real l = box_size ;
+    spp_real x ;
+    int i, k, c ;
+    num_out = 0 ;
+    i = 0 ;
+    while(i < num_agents){
+        for(k=i*DIM; k<(i+1)*DIM; k++){
+            x = pos[k] + h * vel[k] ;
+            x = x <  0 ? x + l : x ;
+            x = x >= l ? x - l : x ;
+            pos[k] = x ;
+        }
+        c = this->column(pos + i*DIM) ;
+        if(c >= cx0 && c < cx1){
+            i++ ;
+            continue ;
+        }
+        /* Out of the slab: store it and put the
+         * last agent (not moved yet) in its place.
+         */
+        this->grow_out(num_out + 1) ;
+        for(k=0; k<DIM; k++){
+            out_pos[num_out*DIM + k] = pos[i*DIM + k] ;
+            out_vel[num_out*DIM + k] = vel[i*DIM + k] ;
+        }
+        out_ids[num_out] = ids[i] ;
+        out_col[num_out] = c ;
+        num_out += 1 ;
+        num_agents -= 1 ;
+        for(k=0; k<DIM; k++){
+            pos[i*DIM + k] = pos[num_agents*DIM + k] ;
+            vel[i*DIM + k] = vel[num_agents*DIM + k] ;
+        }
+        ids[i] = ids[num_agents] ;
+    }
+}
+
+void Domain::sort_cells(){
+    /* Counting sort by local cell. Empties the halo. */
+    int i, j, k, c ;
+    spp_real* tmp ;
+    long int* tmpi ;
+    for(c=0; c<num_cells; c++)
+        cell_num[c] = 0 ;
+    for(i=0; i<num_agents; i++){
+        c = this->local_cell(pos + i*DIM) ;
+        agent_cell[i] = c ;
+        cell_num[c] += 1 ;
+    }
+    j = 0 ;
+    for(c=0; c<num_cells; c++){
+        cell_first[c] = j ;
+        j += cell_num[c] ;
+    }
+    for(i=0; i<num_agents; i++){
+        j = cell_first[agent_cell[i]]++ ;
+        for(k=0; k<DIM; k++){
+            tmp_pos[j*DIM + k] = pos[i*DIM + k] ;
+            tmp_vel[j*DIM + k] = vel[i*DIM + k] ;
+        }
+        tmp_ids[j] = ids[i] ;
+    }
+    for(c=0; c<num_cells; c++)
+        cell_first[c] -= cell_num[c] ;
+    tmp = pos ; pos = tmp_pos ; tmp_pos = tmp ;
+    tmp = vel ; vel = tmp_vel ; tmp_vel = tmp ;
+    tmpi = ids ; ids = tmp_ids ; tmp_ids = tmpi ;
+    num_halo = 0 ;
+}
+
+void Domain::column_range(int cx, int* first, int* n){
+    int lc0 = lx_of[cx] * ncy * ncz ;
+    int lc1 = lc0 + ncy * ncz ;
+    *first = cell_first[lc0] ;
+    *n = cell_first[lc1-1] + cell_num[lc1-1] - *first ;
+}
+
+int Domain::gather_candidates(int lc){
+    int cz = lc % ncz ;
+    int cy = (lc / ncz) % ncy ;
+    int lx = lc / (ncz * ncy) ;
+    int cx = cx0 + lx - 1 ;
+    int ox, oy, oz, lxn, cyn, czn, c, j ;
+    int n = 0 ;
+    int rx = ncx >= 3 ? 1 : 0 ;
+    int ry = ncy >= 3 ? 1 : 0 ;
+    int rz = ncz >= 3 ? 1 : 0 ;
+    for(ox=-rx; ox<=rx; ox++){
+        lxn = lx_of[(cx + ox + ncx) % ncx] ;
+        for(oy=-ry; oy<=ry; oy++){
+            cyn = (cy + oy + ncy) % ncy ;
+            for(oz=-rz; oz<=rz; oz++){
+                czn = (cz + oz + ncz) % ncz ;
+                c = (lxn*ncy + cyn)*ncz + czn ;
+                for(j=cell_first[c]; j<cell_first[c]+cell_num[c]; j++){
+                    cands[n] = agents[j] ;
+                    n += 1 ;
+                }
+            }
+        }
+    }
+    return n ;
+}
+
+void Domain::sense(){
+    int n_local = num_agents + num_halo ;
+    int i, c, lc, nc, separable ;
+    if(n_local > agents_capacity){
+        agents_capacity = 2*n_local ;
+        grow_array(&agents, 0, agents_capacity) ;
+        grow_array(&cands, 0, agents_capacity) ;
+        grow_array(&neis, 0, agents_capacity) ;
+    }
+    for(i=0; i<num_agents; i++)
+        agents[i] = Agent(pos + i*DIM, vel + i*DIM, neis, beh) ;
+    for(i=0; i<num_halo; i++)
+        agents[num_agents + i] = Agent(halo_pos + i*DIM, halo_vel + i*DIM, neis, beh) ;
+
+    /* Cells of the slab: all except the halo columns */
+    separable = beh->separable_noise() ;
+    for(lc=ncy*ncz; lc<num_cells-ncy*ncz; lc++){
+        if(cell_num[lc] == 0)
+            continue ;
+        nc = this->gather_candidates(lc) ;
+        for(c=cell_first[lc]; c<cell_first[lc]+cell_num[lc]; c++){
+            if(separable)
+                agents[c].sense_velocity(nc, cands, vel_sensed + c*DIM) ;
+            else
+                agents[c].sense_noisy_velocity(nc, cands, vel_sensed + c*DIM) ;
+        }
+        SPP_PROFILE_COUNT(searches, cell_num[lc]) ;
+        SPP_PROFILE_COUNT(candidates, (long int) nc * cell_num[lc]) ;
+    }
+    if(separable)
+        beh->add_noise(num_agents, vel_sensed) ;
+    for(i=0; i<num_agents*DIM; i++)
+        vel[i] = vel_sensed[i] ;
+}
+
+void Domain::sum_velocity(double* sum){
+    for(int i=0; i<num_agents; i++){
+        for(int k=0; k<DIM; k++)
+            sum[k] += vel[i*DIM + k] ;
+    }
+}
+
+
+/*
+ * DomainCommunity
+ */
+
+/* Jobs for the worker threads */
+#define DOMAIN_JOB_INIT      0
+#define DOMAIN_JOB_RANDOMIZE 1
+#define DOMAIN_JOB_LOAD      2
+#define DOMAIN_JOB_RUN       3
+#define DOMAIN_JOB_VELOCITY  4
+
+/* Worker threads, waiting for jobs, and a barrier for them. */
+struct DomainPool {
+    std::thread* threads ;
+    std::mutex m ;
+    std::condition_variable cv_job, cv_done ;
+    int generation, done, stop ;
+    std::mutex bm ;
+    std::condition_variable bcv ;
+    int bcount, bgeneration ;
+} ;
+
+DomainCommunity::DomainCommunity(int nags, double L, double range, int nd, Behavior** behs, long int s, int p){
+    int d ;
+    double ncells ;
+    num_agents = nags ;
+    box_size = L ;
+    behaviors = behs ;
+    seed = s ;
+    pin = p ;
+
+    /* Cells at least as large as the range, and not
+     * many more cells than agents.
+     */
+    ncx = (int) (box_size / range) ;
+    ncells = pow(ncx, DIM) ;
+    if(ncells > 4.0 * num_agents)
+        ncx = (int) pow(4.0 * num_agents, 1.0/DIM) ;
+    if(ncx < 3)
+        ncx = 1 ;
+    ncy = ncx ;
+    ncz = DIM > 2 ? ncx : 1 ;
+    if(nd > ncx){
+        fprintf(stderr, "libspp.DomainCommunity: WARNING - Only %i columns of cells for %i domains, using %i domains.\n", ncx, nd, ncx) ;
+        nd = ncx ;
+    }
+    num_domains = nd ;
+    column_owner = new int[ncx] ;
+    domains = new Domain[num_domains] ;
+    for(d=0; d<num_domains; d++){
+        domains[d].cx0 = (d * ncx) / num_domains ;
+        domains[d].cx1 = ((d+1) * ncx) / num_domains ;
+        for(int c=domains[d].cx0; c<domains[d].cx1; c++)
+            column_owner[c] = d ;
+    }
+    partial_vel = new double[num_domains*DIM] ;
+    /* Seeded before the threads start (see spp_rng_seed). */
+    for(d=0; d<num_domains; d++)
+        spp_rng_seed(&domains[d].rng, seed + d) ;
+
+    /* Start the threads, each one waits for jobs for its domain. */
+    DomainPool* dp = new DomainPool ;
+    dp->generation = dp->done = dp->stop = 0 ;
+    dp->bcount = dp->bgeneration = 0 ;
+    pool = dp ;
+    dp->threads = new std::thread[num_domains] ;
+    for(d=0; d<num_domains; d++){
+        dp->threads[d] = std::thread([this, dp, d](){
+            int gen = 0 ;
+            spp_use_rng(&this->domains[d].rng) ;
+            if(pin){
+                cpu_set_t set ;
+                int ncores = std::thread::hardware_concurrency() ;
+                CPU_ZERO(&set) ;
+                CPU_SET(d % (ncores > 0 ? ncores : 1), &set) ;
+                if(sched_setaffinity(0, sizeof(set), &set) != 0)
+                    fprintf(stderr, "libspp.DomainCommunity: WARNING - Could not pin thread %i.\n", d) ;
+            }
+            for(;;){
+                {
+                    std::unique_lock<std::mutex> lk(dp->m) ;
+                    dp->cv_job.wait(lk, [&]{return dp->stop || dp->generation != gen;}) ;
+                    if(dp->stop)
+                        return ;
+                    gen = dp->generation ;
+                }
+                this->work(d) ;
+                {
+                    std::lock_guard<std::mutex> lk(dp->m) ;
+                    dp->done += 1 ;
+                    if(dp->done == num_domains)
+                        dp->cv_done.notify_one() ;
+                }
+            }
+        }) ;
+    }
+    this->submit(DOMAIN_JOB_INIT) ;
+}
+
+DomainCommunity::~DomainCommunity(){
+    DomainPool* dp = (DomainPool*) pool ;
+    {
+        std::lock_guard<std::mutex> lk(dp->m) ;
+        dp->stop = 1 ;
+    }
+    dp->cv_job.notify_all() ;
+    for(int d=0; d<num_domains; d++)
+        dp->threads[d].join() ;
+    delete[] dp->threads ;
+    delete dp ;
+    delete[] domains ;
+    delete[] column_owner ;
+    delete[] partial_vel ;
+}
+
+void DomainCommunity::submit(int type){
+    DomainPool* dp = (DomainPool*) pool ;
+    std::unique_lock<std::mutex> lk(dp->m) ;
+    job_type = type ;
+    dp->done = 0 ;
+    dp->generation += 1 ;
+    dp->cv_job.notify_all() ;
+    dp->cv_done.wait(lk, [&]{return dp->done == num_domains;}) ;
+}
+
+void DomainCommunity::barrier(){
+    DomainPool* dp = (DomainPool*) pool ;
+    std::unique_lock<std::mutex> lk(dp->bm) ;
+    int gen = dp->bgeneration ;
+    dp->bcount += 1 ;
+    if(dp->bcount == num_domains){
+        dp->bcount = 0 ;
+        dp->bgeneration += 1 ;
+        dp->bcv.notify_all() ;
+    }else{
+        dp->bcv.wait(lk, [&]{return dp->bgeneration != gen;}) ;
+    }
+}
+
+void DomainCommunity::work(int d){
+    Domain* dom = domains + d ;
+    Domain* o ;
+    int i, k, s, od, first, n, hl, hr ;
+    long int id, id0, id1 ;
+    spp_real p[DIM], v[DIM] ;
+    double w ;
+
+    switch(job_type){
+    case DOMAIN_JOB_INIT:
+        /* Allocated (and first touched) by the thread using it */
+        dom->setup(dom->cx0, dom->cx1, ncx, ncy, ncz, box_size, behaviors[d],
+                   (int) (2.0 * num_agents * (dom->cx1 - dom->cx0) / ncx) + 64) ;
+        break ;
+    case DOMAIN_JOB_RANDOMIZE:
+        /* Each slab gets its share of the agents, uniformly */
+        dom->num_agents = 0 ;
+        w = box_size / ncx ;
+        id0 = ((long int) num_agents * dom->cx0) / ncx ;
+        id1 = ((long int) num_agents * dom->cx1) / ncx ;
+        for(id=id0; id<id1; id++){
+            p[0] = (dom->cx0 + (dom->cx1 - dom->cx0) * spp_random_uniform()) * w ;
+            for(k=1; k<DIM; k++)
+                p[k] = box_size * spp_random_uniform() ;
+            i = dom->column(p) ;
+            if(i < dom->cx0 || i >= dom->cx1)
+                p[0] = (dom->cx0 + 0.5) * w ;
+            Agent a = Agent(p, v, NULL, behaviors[d]) ;
+            a.randomize_velocity() ;
+            dom->add_agents(1, p, v, &id) ;
+        }
+        dom->sort_cells() ;
+        break ;
+    case DOMAIN_JOB_LOAD:
+        dom->num_agents = 0 ;
+        for(id=0; id<num_agents; id++){
+            i = dom->column(job_pos + id*DIM) ;
+            if(i >= dom->cx0 && i < dom->cx1)
+                dom->add_agents(1, job_pos + id*DIM, job_vel + id*DIM, &id) ;
+        }
+        dom->sort_cells() ;
+        break ;
+    case DOMAIN_JOB_RUN:
+        hl = (dom->cx0 - 1 + ncx) % ncx ;
+        hr = dom->cx1 % ncx ;
+        for(s=0; s<job_steps; s++){
+            dom->move(job_dt) ;
+            this->barrier() ;
+            /* Take the agents that entered the slab */
+            for(od=0; od<num_domains; od++){
+                o = domains + od ;
+                for(k=0; k<o->num_out; k++){
+                    if(column_owner[o->out_col[k]] == d)
+                        dom->add_agents(1, o->out_pos + k*DIM, o->out_vel + k*DIM, o->out_ids + k) ;
+                }
+            }
+            dom->sort_cells() ;
+            this->barrier() ;
+            /* Copy the halo columns from their owners */
+            if(column_owner[hl] != d){
+                o = domains + column_owner[hl] ;
+                o->column_range(hl, &first, &n) ;
+                dom->add_halo(hl, n, o->pos + first*DIM, o->vel + first*DIM) ;
+            }
+            if(hr != hl && column_owner[hr] != d){
+                o = domains + column_owner[hr] ;
+                o->column_range(hr, &first, &n) ;
+                dom->add_halo(hr, n, o->pos + first*DIM, o->vel + first*DIM) ;
+            }
+            this->barrier() ;
+            dom->sense() ;
+        }
+        break ;
+    case DOMAIN_JOB_VELOCITY:
+        for(k=0; k<DIM; k++)
+            partial_vel[d*DIM + k] = 0.0 ;
+        dom->sum_velocity(partial_vel + d*DIM) ;
+        break ;
+    }
+}
+
+void DomainCommunity::randomize(){
+    this->submit(DOMAIN_JOB_RANDOMIZE) ;
+}
+
+void DomainCommunity::load(spp_real* p, spp_real* v){
+    job_pos = p ;
+    job_vel = v ;
+    this->submit(DOMAIN_JOB_LOAD) ;
+}
+
+void DomainCommunity::gather(spp_real* p, spp_real* v){
+    int d, i, k ;
+    long int id ;
+    for(d=0; d<num_domains; d++){
+        for(i=0; i<domains[d].num_agents; i++){
+            id = domains[d].ids[i] ;
+            for(k=0; k<DIM; k++){
+                p[id*DIM + k] = domains[d].pos[i*DIM + k] ;
+                v[id*DIM + k] = domains[d].vel[i*DIM + k] ;
+            }
+        }
+    }
+}
+
+void DomainCommunity::run(int num_steps, double dt){
+    job_steps = num_steps ;
+    job_dt = dt ;
+    this->submit(DOMAIN_JOB_RUN) ;
+}
+
+double DomainCommunity::mean_velocity(double* meanvel){
+    int d, k ;
+    double mv2 = 0.0 ;
+    this->submit(DOMAIN_JOB_VELOCITY) ;
+    for(k=0; k<DIM; k++){
+        meanvel[k] = 0.0 ;
+        for(d=0; d<num_domains; d++)
+            meanvel[k] += partial_vel[d*DIM + k] ;
+        meanvel[k] /= num_agents ;
+        mv2 += meanvel[k] * meanvel[k] ;
+    }
+    return mv2 ;
+}
+
+double DomainCommunity::order_parameter(double v0){
+    double meanvel[DIM] ;
+    double mv2 = this->mean_velocity(meanvel) ;
+    return sqrt(mv2)/v0 ;
+}
@@ -0,0 +1,243 @@
+#include "behavior.h"
+#include "random.h"
+
+/*
+ * Domain class with the agents in a slab of the periodic
+ * box, used by DomainCommunity (and DistributedCommunity)
+ * to split a very large swarm in pieces.
+ *
+ * The box is divided in *ncx* x *ncy* (x *ncz*) cells at
+ * least as large as the interaction range, and the domain
+ * owns the agents in the columns of cells cx0 <= cx < cx1
+ * (a slab along x). To find the neighbors of its agents
+ * it also keeps a copy of the agents in the column just
+ * before and after the slab (the halo), provided by the
+ * owners of those columns.
+ *
+ * Each step:
+ *      move() moves the agents and takes out of the slab
+ *          the ones that left it (to be given to the owner
+ *          of their new column with add_agents()).
+ *      sort_cells() sorts the agents by cell, after which
+ *          the agents of each column are contiguous (see
+ *          column_range()) and can be copied to the halo of
+ *          the neighbor domains with add_halo().
+ *      sense() senses the noisy velocities of all the
+ *          agents in the slab with the domain's Behavior,
+ *          using only the agents in the surrounding cells as
+ *          candidates, and updates the velocities.
+ *
+ * All the arrays are allocated by the domain and grow as
+ * needed, and every agent has an *id* that does not change
+ * when it moves from one domain to another.
+ */
+class Domain {
+    public:
+        Domain() {lx_of = NULL;} ;
+        /* Free the arrays allocated by setup. */
+        ~Domain() ;
+        /* Setup the domain owning the columns *cx0* to *cx1*-1
+         * out of *ncx*, with *ncy* (and *ncz*, 1 in 2D) cells
+         * in the other directions, in a periodic box of size *L*.
+         * The agents use the behavior *beh*, and space for
+         * *capacity* agents is allocated initially.
+         */
+        void setup(int cx0, int cx1, int ncx, int ncy, int ncz, double L, Behavior* beh, int capacity) ;
+        /* Add *n* agents to the slab, with positions *p*,
+         * velocities *v* and ids *id*.
+         */
+        void add_agents(int n, spp_real* p, spp_real* v, long int* id) ;
+        /* Add *n* agents with positions *p* and velocities *v*,
+         * all in the column *cx*, to the halo.
+         */
+        void add_halo(int cx, int n, spp_real* p, spp_real* v) ;
+        /* Move the agents during *dt* with periodic boundary
+         * conditions and move the agents that left the slab to
+         * the outgoing arrays *out_pos*, *out_vel*, *out_ids*,
+         * storing their new column in *out_col*.
+         */
+        void move(double dt) ;
+        /* Sort the agents of the slab by cell, and empty the halo. */
+        void sort_cells() ;
+        /* Store in *first* and *n* the range of agents of the
+         * column *cx* of the slab. Requires sort_cells().
+         */
+        void column_range(int cx, int* first, int* n) ;
+        /* Sense the noisy velocities of the agents of the slab
+         * and update their velocities.
+         */
+        void sense() ;
+        /* Add the sum of the velocities of the agents
+         * of the slab to *sum*.
+         */
+        void sum_velocity(double* sum) ;
+        /* Return the column of the position *p*. */
+        int column(spp_real* p) ;
+        /* Columns owned, cx0 <= cx < cx1. */
+        int cx0, cx1 ;
+        /* Stream of random numbers of the domain. */
+        spp_rng rng ;
+        /* Agents of the slab: positions, velocities and ids. */
+        int num_agents ;
+        spp_real* pos ;
+        spp_real* vel ;
+        long int* ids ;
+        /* Agents that left the slab in the last move(). */
+        int num_out ;
+        spp_real* out_pos ;
+        spp_real* out_vel ;
+        long int* out_ids ;
+        int* out_col ;
+    protected:
+        /* Return the local cell of the position *p*,
+         * or -1 if its column is not owned nor halo.
+         */
+        int local_cell(spp_real* p) ;
+        /* Make room for *n* agents in the slab,
+         * *nh* in the halo or *no* outgoing ones.
+         */
+        void grow(int n) ;
+        void grow_halo(int nh) ;
+        void grow_out(int no) ;
+        /* Gather the agents in the cells around the local cell
+         * *lc* into *cands*. Return how many.
+         */
+        int gather_candidates(int lc) ;
+        int ncx, ncy, ncz ;
+        double box_size ;
+        Behavior* beh ;
+        int capacity, halo_capacity, out_capacity ;
+        /* Local x-index of each column: 1..cx1-cx0 for the owned
+         * ones, 0 and cx1-cx0+1 for the halo columns before and
+         * after the slab, -1 for the rest.
+         */
+        int* lx_of ;
+        /* Number of local cells and for each one the first agent
+         * and how many, the agents of the slab first (indices
+         * < num_agents) followed by the halo.
+         */
+        int num_cells ;
+        int* cell_first ;
+        int* cell_num ;
+        /* Halo: positions and velocities. */
+        int num_halo ;
+        spp_real* halo_pos ;
+        spp_real* halo_vel ;
+        int* halo_cell ;
+        /* Scratch for the sorting, the cell of each agent
+         * and space for the sensed velocities.
+         */
+        spp_real *tmp_pos, *tmp_vel ;
+        long int* tmp_ids ;
+        int* agent_cell ;
+        spp_real* vel_sensed ;
+        /* Agents (slab and halo) pointing to pos/vel and halo_pos/halo_vel,
+         * candidates (copies) and space for the neighbors.
+         */
+        Agent* agents ;
+        Agent* cands ;
+        Agent** neis ;
+        int agents_capacity ;
+} ;
+
+/*
+ * DomainCommunity class implemented to simulate very large
+ * swarms on a shared memory machine. The periodic box is split
+ * along x in *num_domains* slabs (see Domain), each one owned by
+ * a worker thread that moves its agents, exchanges with the
+ * neighbor slabs the agents that cross the boundaries and the
+ * copies of the agents in the halo, and senses their velocities.
+ * The threads synchronize with barriers between these phases, so
+ * the result is the same as a synchronous update of all the agents.
+ *
+ * Each worker thread can be pinned to one core, and allocates and
+ * initializes the memory of its slab, so that with first-touch
+ * allocation the data lives in the memory node of the core that
+ * uses it.
+ *
+ * The geometry is CartesianPeriodic with box size *L*, and the
+ * interaction must have a finite *range*, e.g. the radius of a
+ * Metric interaction (for a Topologic one, a conservative bound of
+ * the distance to the k-th neighbor). Each domain needs its own
+ * Behavior, with its own Interaction, because some keep state
+ * while sensing (e.g. Topologic, which here does not reuse the
+ * neighbors between steps). The thread of each domain draws its
+ * random numbers from the stream of the domain (see spp_use_rng),
+ * seeded with *seed* plus the domain index.
+ *
+ * This class is not copyable. The destructor stops the threads
+ * and frees the slabs.
+ */
+class DomainCommunity {
+    public:
+        /* Create *num_domains* slabs and their threads for
+         * *num_agents* agents. *behaviors* must contain one
+         * Behavior per domain. If *pin* is not 0, the thread of
+         * domain d is pinned to core d (modulo the number of cores).
+         * The number of domains is reduced if the box has less than
+         * num_domains columns of cells.
+         */
+        DomainCommunity(int num_agents, double L, double range, int num_domains, Behavior** behaviors, long int seed, int pin) ;
+        ~DomainCommunity() ;
+        /* Place the agents randomly in the box, with random
+         * directions (see Behavior::randomize_velocity).
+         */
+        void randomize() ;
+        /* Set the positions and velocities of the agents from the
+         * arrays *pos* and *vel* of size num_agents*DIM. The agent
+         * stored in pos[i*DIM] has id *i*.
+         */
+        void load(spp_real* pos, spp_real* vel) ;
+        /* Store the positions and velocities of the agents in *pos*
+         * and *vel*, of size num_agents*DIM, ordered by id.
+         */
+        void gather(spp_real* pos, spp_real* vel) ;
+        /* Advance *num_steps* steps of *dt*, each of them equivalent
+         * to calling periodic_move, sense_noisy_velocities and
+         * update_velocities of a Community.
+         */
+        void run(int num_steps, double dt) ;
+        /* Store the mean velocity in *meanvel*.
+         * Return the norm^2 of the mean.
+         */
+        double mean_velocity(double* meanvel) ;
+        /* Return the order parameter (see Community::order_parameter). */
+        double order_parameter(double v0) ;
+        /* Return the number of agents in the whole box. */
+        int get_num_agents() {return num_agents;} ;
+        /* Return the number of domains. */
+        int get_num_domains() {return num_domains;} ;
+        /* Return the number of agents in the domain *d*. */
+        int get_domain_agents(int d) {return domains[d].num_agents;} ;
+        /* Return the box size. */
+        double get_box_size() {return box_size;} ;
+    protected:
+        /* Run the job *job_type* in all the domains and wait. */
+        void submit(int type) ;
+        /* What each worker thread does for the current job. */
+        void work(int d) ;
+        /* Wait until all the workers get here. */
+        void barrier() ;
+        int num_agents ;
+        int num_domains ;
+        double box_size ;
+        int ncx, ncy, ncz ;
+        /* Domain owning each column of cells. */
+        int* column_owner ;
+        Domain* domains ;
+        Behavior** behaviors ;
+        long int seed ;
+        int pin ;
+        /* Current job and its parameters. */
+        int job_type ;
+        int job_steps ;
+        double job_dt ;
+        spp_real* job_pos ;
+        spp_real* job_vel ;
+        double* partial_vel ;
+        /* Threads and synchronization (see domain_community.cpp). */
+        void* pool ;
+    private:
+        DomainCommunity(const DomainCommunity&) ;
+        DomainCommunity& operator=(const DomainCommunity&) ;
+} ;
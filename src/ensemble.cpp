@@ -0,0 +1,130 @@
+#include "ensemble.h"
+#include "random.h"
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+
+#define ENSEMBLE_LINE 4096
+
+/* Return 1 if *line* has no parameters (empty or comment). */
+static int skip_line(char* line){
+    while(*line == ' ' || *line == '\t') line++ ;
+    return *line == '#' || *line == '\n' || *line == '\r' || *line == '\0' ;
+}
+
+Ensemble::Ensemble(const char* param_file, const char* prefix){
+    char line[ENSEMBLE_LINE] ;
+    char* p ;
+    int nread, ir ;
+    double par ;
+    Replica* rep ;
+    FILE* f ;
+
+    num_replicas = 0 ;
+    replicas = NULL ;
+    strncpy(out_prefix, prefix, sizeof(out_prefix)-1) ;
+    out_prefix[sizeof(out_prefix)-1] = '\0' ;
+
+    f = fopen(param_file, "r") ;
+    if(f == NULL){
+        fprintf(stderr, "libspp.Ensemble: ERROR - Could not open %s\n", param_file) ;
+        return ;
+    }
+    /* First count the replicas, then read them */
+    while(fgets(line, ENSEMBLE_LINE, f) != NULL){
+        if(!skip_line(line))
+            num_replicas += 1 ;
+    }
+    replicas = new Replica[num_replicas] ;
+    rewind(f) ;
+    ir = 0 ;
+    while(ir < num_replicas && fgets(line, ENSEMBLE_LINE, f) != NULL){
+        if(skip_line(line))
+            continue ;
+        rep = replicas + ir ;
+        rep->id = ir ;
+        rep->out = NULL ;
+        rep->num_params = 0 ;
+        if(sscanf(line, "%li %i %lf%n", &rep->seed, &rep->num_agents, &rep->noise, &nread) < 3){
+            fprintf(stderr, "libspp.Ensemble: ERROR - Replica %i needs at least seed, num_agents and noise:\n\t%s", ir, line) ;
+            rep->num_agents = 0 ;
+            ir += 1 ;
+            continue ;
+        }
+        p = line + nread ;
+        while(sscanf(p, "%lf%n", &par, &nread) == 1){
+            if(rep->num_params == SPP_ENSEMBLE_MAX_PARAMS){
+                fprintf(stderr, "libspp.Ensemble: ERROR - Replica %i has more than %i parameters, ignoring the rest.\n", ir, SPP_ENSEMBLE_MAX_PARAMS) ;
+                break ;
+            }
+            rep->params[rep->num_params] = par ;
+            rep->num_params += 1 ;
+            p += nread ;
+        }
+        ir += 1 ;
+    }
+    fclose(f) ;
+}
+
+Ensemble::~Ensemble(){
+    delete[] replicas ;
+}
+
+int Ensemble::get_num_replicas(){
+    return num_replicas ;
+}
+
+Replica* Ensemble::get_replica(int i){
+    return replicas + i ;
+}
+
+int Ensemble::run_one(spp_replica_function run_replica, Replica* rep){
+    char name[512] ;
+    if(rep->num_agents <= 0)
+        return 0 ;
+    snprintf(name, sizeof(name), "%s%i.res", out_prefix, rep->id) ;
+    rep->out = fopen(name, "w") ;
+    if(rep->out == NULL){
+        fprintf(stderr, "libspp.Ensemble: ERROR - Could not open %s, skipping replica %i.\n", name, rep->id) ;
+        return 0 ;
+    }
+    spp_use_rng(&rep->rng) ;
+    run_replica(rep) ;
+    spp_use_rng(NULL) ;
+    fclose(rep->out) ;
+    rep->out = NULL ;
+    return 1 ;
+}
+
+int Ensemble::run(spp_replica_function run_replica, int num_threads){
+    /* Each worker takes the next replica from the shared counter. */
+    std::atomic<int> next(0) ;
+    std::atomic<int> done(0) ;
+    std::thread* workers ;
+    int it ;
+
+    if(num_threads <= 0)
+        num_threads = std::thread::hardware_concurrency() ;
+    if(num_threads <= 0)
+        num_threads = 1 ;
+    if(num_threads > num_replicas)
+        num_threads = num_replicas ;
+    /* Seeded here, before the workers start (see spp_rng_seed). */
+    for(it=0; it<num_replicas; it++)
+        spp_rng_seed(&replicas[it].rng, replicas[it].seed) ;
+
+    auto work = [&](){
+        int ir ;
+        while((ir = next.fetch_add(1)) < num_replicas)
+            done += this->run_one(run_replica, replicas + ir) ;
+    } ;
+
+    workers = new std::thread[num_threads] ;
+    for(it=0; it<num_threads; it++)
+        workers[it] = std::thread(work) ;
+    for(it=0; it<num_threads; it++)
+        workers[it].join() ;
+    delete[] workers ;
+    return done ;
+}
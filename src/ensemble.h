@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include "random.h"
+
+/* Maximum number of extra parameters per replica. */
+#define SPP_ENSEMBLE_MAX_PARAMS 16
+
+/*
+ * Replica class holding the parameters of one
+ * independent simulation of an Ensemble and the
+ * stream where it writes its results.
+ * The parameters are read from one line of the
+ * parameter file of the Ensemble, in the format
+ *      seed    num_agents    noise    [p0 p1 ...]
+ * where the optional *params* p0, p1, ... can be
+ * used for anything else that changes between
+ * replicas (speed, density, outdegree...).
+ */
+class Replica {
+    public:
+        /* Position of the replica in the parameter file
+         * (0 for the first one), used to name its output.
+         */
+        int id ;
+        /* Seed for the random number generator. */
+        long int seed ;
+        /* Stream of random numbers of the replica, seeded
+         * with *seed* and used by the thread running it.
+         */
+        spp_rng rng ;
+        /* Number of agents. */
+        int num_agents ;
+        /* Noise level. */
+        double noise ;
+        /* Extra parameters: *num_params* values in *params*. */
+        int num_params ;
+        double params[SPP_ENSEMBLE_MAX_PARAMS] ;
+        /* Stream where the replica writes its results,
+         * opened by Ensemble::run() before running it.
+         */
+        FILE* out ;
+} ;
+
+/* Function running the simulation of one replica.
+ * It is called from a worker thread, so it must only
+ * use its own Community, Behavior, Interaction and
+ * buffers (allocate them inside the function), and
+ * write to *rep->out* instead of stdout.
+ * When it is called, the spp_random_* functions of the
+ * thread already draw from *rep->rng*, seeded with
+ * *rep->seed*.
+ */
+typedef void (*spp_replica_function)(Replica* rep) ;
+
+/*
+ * Ensemble class implemented to run many independent
+ * simulations (replicas) with different parameters
+ * concurrently in a single process, instead of compiling
+ * and running one executable per set of parameters.
+ *
+ * The parameters are read at runtime from a text file
+ * with one replica per line (see Replica). Empty lines
+ * and lines starting with '#' are ignored.
+ * Each replica writes to its own file
+ *      <out_prefix><id>.res
+ * so that the results do not depend on the order in
+ * which the replicas are run.
+ *
+ * The replicas are run in a pool of threads, each thread
+ * taking the next replica not yet started when it finishes
+ * one, so that replicas of different cost are balanced.
+ * Each replica draws its random numbers from its own
+ * stream (see spp_use_rng) seeded with its seed, so that
+ * the result of a replica only depends on its parameters.
+ * The shared generator of spp_set_seed is not used.
+ * Programs using Ensemble must be linked with -pthread.
+ *
+ * This class is not copyable.
+ */
+class Ensemble {
+    public:
+        /* Read the parameters of the replicas from the
+         * file *param_file*. The output of replica i
+         * will be written to <out_prefix>i.res .
+         */
+        Ensemble(const char* param_file, const char* out_prefix) ;
+        ~Ensemble() ;
+        /* Return the number of replicas read. */
+        int get_num_replicas() ;
+        /* Return the pointer to the replica *i*. */
+        Replica* get_replica(int i) ;
+        /* Run *run_replica* for each replica using *num_threads*
+         * threads (<=0 to use as many as cores available) and
+         * wait for all of them to finish.
+         * Return the number of replicas run.
+         */
+        int run(spp_replica_function run_replica, int num_threads) ;
+    private:
+        /* Open the output of *rep*, make the thread use its
+         * random number stream and call *run_replica*.
+         * Return 1 if the replica was run.
+         */
+        int run_one(spp_replica_function run_replica, Replica* rep) ;
+        int num_replicas ;
+        Replica* replicas ;
+        char out_prefix[256] ;
+        Ensemble(const Ensemble&) ;
+        Ensemble& operator=(const Ensemble&) ;
+} ;
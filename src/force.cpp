@@ -0,0 +1,34 @@
+#include "force.h"
+#include "agent.h"
+#include "interaction.h"
+
+/*
+ * Soft-core
+ */
+SoftCore::SoftCore(double kk, double s, Geometry* gg){
+    k = kk ;
+    sigma = s ;
+    g = gg ;
+}
+
+int SoftCore::sum_forces(Agent* a0, int n_agents, Agent* ags, spp_real* f){
+    int ia, i ;
+    int n_forces = 0 ;
+    spp_real dis[DIM] ;
+    spp_real d2, r, fr ;
+    spp_real* pos = a0->get_pos() ;
+    const spp_real sigma2 = sigma * sigma ;
+    for(ia=0; ia < n_agents ; ia++){
+        g->displacement(pos, (ags+ia)->get_pos(), dis) ;
+        d2 = 0.0 ;
+        for(i=0; i<DIM ; i++) d2 += dis[i]*dis[i] ;
+        if(d2 >= sigma2 || d2 == 0.0)
+            continue ;
+        /* dis points to the other agent: push away from it */
+        r = sqrt(d2) ;
+        fr = k * (sigma - r) / r ;
+        for(i=0; i<DIM ; i++) f[i] -= fr * dis[i] ;
+        n_forces += 1 ;
+    }
+    return n_forces ;
+}
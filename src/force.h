@@ -0,0 +1,59 @@
+#include "precision.h"
+#include <math.h>
+class Agent ;
+class Geometry ;
+
+/*
+ * Abstract Force class used as a template for
+ * different pairwise forces between the agents,
+ * used by the continuous-time integrators (see
+ * Langevin). Every implementation must implement:
+ *
+ *      sum_forces: add to *f* the total force on
+ *          the agent *a0* from the *n_agents* agents
+ *          stored in *ags*, measuring the displacements
+ *          with the geometry *g*. Return the number
+ *          of agents that exert a force on *a0*.
+ *      range: the distance beyond which the force
+ *          vanishes, used to choose the size of the
+ *          slots of a Grid.
+ *
+ * The loop over the agents is in the implementation,
+ * so that the force law is inlined in it.
+ * An agent at distance 0 from *a0* is taken as *a0*
+ * itself and exerts no force.
+ */
+class Force {
+    public:
+        /* pure virtual, must be implemented */
+        virtual int sum_forces(Agent* a0, int n_agents, Agent* ags, spp_real* f) = 0 ;
+        /* pure virtual, must be implemented */
+        virtual double range() = 0 ;
+        /* Geometry used to measure the displacements. */
+        Geometry* g ;
+} ;
+
+// Implementations of Force
+
+/*
+ * Soft-core repulsion: two agents closer than a
+ * diameter *sigma* repel each other with a force
+ *      F = k (sigma - r)
+ * along the line joining them, derived from the
+ * harmonic potential k (sigma - r)^2 / 2. Used for
+ * active Brownian particles since the force is
+ * bounded and a large time step can be used.
+ */
+class SoftCore : public Force {
+    public:
+        SoftCore(double k, double sigma, Geometry* g) ;
+        /* Add the repulsion from the agents in *ags* closer than
+         * *sigma* to *a0* to *f*. Return how many there are.
+         */
+        int sum_forces(Agent* a0, int n_agents, Agent* ags, spp_real* f) ;
+        /* Return the diameter sigma. */
+        double range() {return sigma;} ;
+    protected:
+        spp_real k ;
+        spp_real sigma ;
+} ;
@@ -1,92 +1,400 @@
 #include "grid.h"
 
 #if DIM==2
-#define NSLOTSD  ( nslots * nslots )
+#define NADJ     9
 #elif DIM==3
-#define NSLOTSD  ( nslots * nslots * nslots )
+#define NADJ     27
 #endif
 
 Grid::Grid( int ns , double bs , int max_agents){
+    for(int d=0 ; d<DIM ; d++)
+        lengths[d] = bs ;
+    this->init(max_agents) ;
+    this->set_nslots(ns) ;
+}
+
+Grid::Grid( double bs , int max_agents){
+    for(int d=0 ; d<DIM ; d++)
+        lengths[d] = bs ;
+    this->init(max_agents) ;
+}
+
+Grid::Grid( double* ls , int max_agents){
+    for(int d=0 ; d<DIM ; d++)
+        lengths[d] = ls[d] ;
+    this->init(max_agents) ;
+}
+
+void Grid::init(int max_agents){
+    for(int d=0 ; d<DIM ; d++)
+        periodic[d] = 1 ;
+    capacity = NADJ * (max_agents > 0 ? max_agents : 1) ;
+    grid = new Agent[ capacity ] ;
+    agent_capacity = max_agents > 0 ? max_agents : 1 ;
+    by_slot    = new int[ agent_capacity ] ;
+    agent_slot = new int[ agent_capacity ] ;
+    first = NULL ;
+    occupation = NULL ;
+    this->set_nslots(3) ;
+}
+
+void Grid::set_nslots(int ns){
+    int nss[DIM] ;
+    for(int d=0 ; d<DIM ; d++)
+        nss[d] = ns ;
+    this->set_nslots(nss) ;
+}
+
+void Grid::set_nslots(int* ns){
     /*
-     * Note that if ns<=3 this prints an error and
-     * doesn't allocate memory but it does not
-     * raise an exception.
-     * Erratic behavior can occur if called with ns<=3.
+     * With less than 3 slots along a periodic dimension the
+     * adjacent slots of a slot are not all different, and an
+     * agent would be stored twice in the same neighborhood.
      */
-    int is ;
-    if( ns <= 3){
-        fprintf(stderr,"libspp.Grid: ERROR - Invalid number of slots %i\n", ns) ;
-        return ;
-    }else if(ns > 50){
-        fprintf(stderr,"libspp.Grid: WARNING - Number of slots (%i) is probably too big.\n", ns) ;
-    }
-    nslots = ns ;
-    box_size = bs ;
-    occupation = new int[ NSLOTSD ] ;
-    grid       = new Agent*[ NSLOTSD ] ;
-    for(is=0; is< NSLOTSD ; is++){
+    int is, d, ns_min ;
+    num_slots = 1 ;
+    for(d=0 ; d<DIM ; d++){
+        nslots[d] = ns[d] ;
+        ns_min = periodic[d] ? 3 : 1 ;
+        if( nslots[d] < ns_min){
+            fprintf(stderr,"libspp.Grid: WARNING - Invalid number of slots %i, using %i.\n", nslots[d], ns_min) ;
+            nslots[d] = ns_min ;
+        }
+        num_slots *= nslots[d] ;
+    }
+    if(occupation){
+        delete[] occupation ;
+        delete[] first ;
+        delete[] blocks ;
+        delete[] slot_first ;
+    }
+    occupation = new int[ num_slots ] ;
+    first      = new int[ num_slots + 1 ] ;
+    blocks     = new int[ num_slots * (NADJ + 1) ] ;
+    slot_first = new int[ num_slots + 1 ] ;
+    for(is=0; is< num_slots ; is++){
         occupation[is] = 0 ;
-        grid[is] = new Agent[ max_agents ] ;
+        first[is] = 0 ;
     }
+    first[num_slots] = 0 ;
+    for(is=0; is< num_slots * (NADJ + 1) ; is++)
+        blocks[is] = 0 ;
 }
 
-void Grid::grid_index(double* pos, int *ind){
-    for(int i=0 ; i<DIM ; i++)
-        ind[i] = floor( pos[i] / box_size * nslots ) ;
+void Grid::set_boundaries(int* p){
+    /* The number of slots is set again to check it
+     * for the new boundaries.
+     */
+    int ns[DIM] ;
+    for(int d=0 ; d<DIM ; d++){
+        periodic[d] = p[d] ? 1 : 0 ;
+        ns[d] = nslots[d] ;
+    }
+    this->set_nslots(ns) ;
+}
+
+int Grid::tune(double range, int num_agents){
+    /*
+     * No more slots than agents: along dimension d at most
+     *      ( num_agents * L_d^DIM / volume )^(1/DIM)
+     * whose product over the dimensions is num_agents.
+     */
+    int d, ns[DIM], ns_max, changed = 0 ;
+    double ld, volume = 1.0 ;
+    if(range <= 0.0)
+        return nslots[0] ;
+    for(d=0 ; d<DIM ; d++)
+        volume *= lengths[d] ;
+    for(d=0 ; d<DIM ; d++){
+        ns[d] = (int) floor( lengths[d] / range ) ;
+        ld = 1.0 ;
+        for(int e=0 ; e<DIM ; e++)
+            ld *= lengths[d] ;
+        ns_max = (int) floor( pow( num_agents * (ld / volume) , 1.0 / DIM ) + 1e-9 ) ;
+        ns[d] = ns[d] < ns_max ? ns[d] : ns_max ;
+        ns[d] = ns[d] < 3 && periodic[d] ? 3 : ns[d] ;
+        ns[d] = ns[d] < 1 ? 1 : ns[d] ;
+        if(ns[d] != nslots[d])
+            changed = 1 ;
+    }
+    if(changed)
+        this->set_nslots(ns) ;
+    return nslots[0] ;
+}
+
+void Grid::grid_index(spp_real* pos, int *ind){
+    for(int i=0 ; i<DIM ; i++){
+        ind[i] = floor( pos[i] / lengths[i] * nslots[i] ) ;
+        /* positions rounded to 0 or the box length */
+        ind[i] = ind[i] < 0 ? 0 : (ind[i] < nslots[i] ? ind[i] : nslots[i]-1) ;
+    }
 }
 
-int Grid::serial_index(double* pos){
+int Grid::serial_index(spp_real* pos){
+    int ind[DIM] ;
+    this->grid_index(pos, ind) ;
 #if DIM==2
-    return floor( pos[0] / box_size * nslots ) * nslots +
-           floor( pos[1] / box_size * nslots ) ;
+    return ind[0] * nslots[1] + ind[1] ;
 #elif DIM==3
-    return floor( pos[0] / box_size * nslots ) * nslots * nslots +
-           floor( pos[1] / box_size * nslots ) * nslots +
-           floor( pos[2] / box_size * nslots ) ;
+    return ( ind[0] * nslots[1] + ind[1] ) * nslots[2] + ind[2] ;
 #endif
 }
 
+int Grid::adjacent_slots(int* ind, int* adj, int* off){
+    /*
+     * Along a periodic dimension the slots -1 and nslots are
+     * those at the other side of the box, along a dimension with
+     * walls there is nothing beyond the first and last slots.
+     * The offsets are visited in increasing order of
+     *      (i - ind[0] + 1) * 3 + (j - ind[1] + 1)   (2D)
+     */
+    int n = 0 ;
+    const int ni = nslots[0] ;
+    const int nj = nslots[1] ;
+#if DIM==2
+    for(int i=ind[0]-1 ; i<=ind[0]+1 ; i++){
+        if( (i<0 || i>=ni) && !periodic[0] )
+            continue ;
+        for(int j=ind[1]-1 ; j<=ind[1]+1 ; j++){
+            if( (j<0 || j>=nj) && !periodic[1] )
+                continue ;
+            adj[n] = (i<0?i+ni:i%ni) * nj +
+                     (j<0?j+nj:j%nj) ;
+            off[n] = (i - ind[0] + 1) * 3 + (j - ind[1] + 1) ;
+            n += 1 ;
+        }
+    }
+#elif DIM==3
+    const int nk = nslots[2] ;
+    for(int i=ind[0]-1 ; i<=ind[0]+1 ; i++){
+        if( (i<0 || i>=ni) && !periodic[0] )
+            continue ;
+        for(int j=ind[1]-1 ; j<=ind[1]+1 ; j++){
+            if( (j<0 || j>=nj) && !periodic[1] )
+                continue ;
+            for(int k=ind[2]-1 ; k<=ind[2]+1 ; k++){
+                if( (k<0 || k>=nk) && !periodic[2] )
+                    continue ;
+                adj[n] = (i<0?i+ni:i%ni) * nj * nk +
+                         (j<0?j+nj:j%nj) * nk +
+                         (k<0?k+nk:k%nk) ;
+                off[n] = ((i - ind[0] + 1) * 3 + (j - ind[1] + 1)) * 3 + (k - ind[2] + 1) ;
+                n += 1 ;
+            }
+        }
+    }
+#endif
+    return n ;
+}
+
 void Grid::fill_grid(int num_agents, Agent* agents){
     /*
-     * Put every agent in its cell and all
+     * Put every agent in its slot and all
      * the adjacent ones, meaning all that have an
-     * n-dimensioanl index with compoenents equal or
-     * +-1 different from the cell.
-     *
+     * n-dimensional index with components equal or
+     * +-1 different from the slot.
+     * First sort the agents by slot (counting how many
+     * there are in each one), and then build the list of
+     * each slot copying those of its adjacent slots, one
+     * after the other, so that each of them is a block
+     * of the list (see get_blocks).
      */
-    int  serial_ind, ind[DIM] ;
-    for(int is=0 ; is < NSLOTSD ; is++)
-        occupation[is] = 0 ;
-
-    for(int ia=0 ; ia < num_agents ; ia++){
-        grid_index( agents[ia].get_pos(), ind ) ;
+    int is, ia, n, o, q, count, nadj, ind[DIM], adj[NADJ], off[NADJ] ;
+    int* blk ;
+    Agent* list ;
+    if(num_agents * NADJ > capacity){
+        delete[] grid ;
+        capacity = num_agents * NADJ ;
+        grid = new Agent[ capacity ] ;
+    }
+    if(num_agents > agent_capacity){
+        delete[] by_slot ;
+        delete[] agent_slot ;
+        agent_capacity = num_agents ;
+        by_slot    = new int[ agent_capacity ] ;
+        agent_slot = new int[ agent_capacity ] ;
+    }
+    for(is=0 ; is <= num_slots ; is++)
+        slot_first[is] = 0 ;
+    for(ia=0 ; ia < num_agents ; ia++){
+        agent_slot[ia] = this->serial_index( agents[ia].get_pos() ) ;
+        slot_first[agent_slot[ia] + 1] += 1 ;
+    }
+    for(is=0 ; is < num_slots ; is++){
+        slot_first[is+1] += slot_first[is] ;
+        occupation[is] = slot_first[is] ;
+    }
+    for(ia=0 ; ia < num_agents ; ia++)
+        by_slot[ occupation[agent_slot[ia]]++ ] = ia ;
+    first[0] = 0 ;
+    for(is=0 ; is < num_slots ; is++){
 #if DIM==2
-        for(int i=ind[0]-1 ; i<=ind[0]+1 ; i++){
-            for(int j=ind[1]-1 ; j<=ind[1]+1 ; j++){
-                serial_ind = (i<0?i+nslots:i%nslots) * nslots +
-                             (j<0?j+nslots:j%nslots) ;
-                grid[serial_ind][occupation[serial_ind]] = agents[ia] ;
-                occupation[serial_ind] += 1 ;
+        ind[0] = is / nslots[1] ;
+        ind[1] = is % nslots[1] ;
+#elif DIM==3
+        ind[0] = is / (nslots[1] * nslots[2]) ;
+        ind[1] = (is / nslots[2]) % nslots[1] ;
+        ind[2] = is % nslots[2] ;
+#endif
+        nadj = this->adjacent_slots( ind, adj, off ) ;
+        blk  = blocks + is * (NADJ + 1) ;
+        list = grid + first[is] ;
+        count = 0 ;
+        for(n=0, o=0 ; o < NADJ ; o++){
+            blk[o] = count ;
+            if(n < nadj && off[n] == o){
+                for(q=slot_first[adj[n]] ; q < slot_first[adj[n]+1] ; q++)
+                    list[count++] = agents[ by_slot[q] ] ;
+                n += 1 ;
             }
         }
+        blk[NADJ] = count ;
+        occupation[is] = count ;
+        first[is+1] = first[is] + count ;
+    }
+}
+
+Agent* Grid::get_neighborhood(Agent* ag, int* num_neis ){
+    int index = this->serial_index( ag->get_pos() ) ;
+    *num_neis = occupation[index] ;
+    return grid + first[index] ;
+}
+
+int* Grid::get_blocks(spp_real* pos, Agent* ags, int num_neis, int* ind){
+    int is ;
+    this->grid_index(pos, ind) ;
+#if DIM==2
+    is = ind[0] * nslots[1] + ind[1] ;
 #elif DIM==3
-        for(int i=ind[0]-1 ; i<=ind[0]+1 ; i++){
-            for(int j=ind[1]-1 ; j<=ind[1]+1 ; j++){
-                for(int k=ind[2]-1 ; k<=ind[2]+1 ; k++){
-                    serial_ind = (i<0?i+nslots:i%nslots) * nslots * nslots +
-                                 (j<0?j+nslots:j%nslots) * nslots +
-                                 (k<0?k+nslots:k%nslots) ;
-                    grid[serial_ind][occupation[serial_ind]] = agents[ia] ;
-                    occupation[serial_ind] += 1 ;
+    is = ( ind[0] * nslots[1] + ind[1] ) * nslots[2] + ind[2] ;
+#endif
+    if(ags != grid + first[is] || num_neis != occupation[is])
+        return NULL ;
+    return blocks + is * (NADJ + 1) ;
+}
+
+
+/*
+ * HashGrid
+ */
+HashGrid::HashGrid(double cs, int max_agents){
+    int is, ts = 1 ;
+    cell_size = cs ;
+    /* a power of 2, at least twice the number of agents */
+    while(ts < 2 * max_agents)
+        ts *= 2 ;
+    num_slots = ts ;
+    capacity = NADJ * (max_agents > 0 ? max_agents : 1) ;
+    grid = new Agent[ capacity ] ;
+    occupation = new int[ num_slots ] ;
+    first      = new int[ num_slots + 1 ] ;
+    stamp      = new int[ num_slots ] ;
+    for(is=0; is< num_slots ; is++){
+        occupation[is] = 0 ;
+        first[is] = 0 ;
+        stamp[is] = 0 ;
+    }
+    first[num_slots] = 0 ;
+    current_stamp = 0 ;
+}
+
+int HashGrid::tune(double range, int num_agents){
+    if(range > 0.0)
+        cell_size = range ;
+    return num_slots ;
+}
+
+void HashGrid::grid_index(spp_real* pos, int *ind){
+    for(int i=0 ; i<DIM ; i++)
+        ind[i] = cell_size > 0.0 ? (int) floor( pos[i] / cell_size ) : 0 ;
+}
+
+int HashGrid::hash(int* ind){
+    /* num_slots is a power of 2 */
+    unsigned int h = (unsigned int) ind[0] * 73856093u ^
+                     (unsigned int) ind[1] * 19349663u ;
+#if DIM==3
+    h ^= (unsigned int) ind[2] * 83492791u ;
+#endif
+    return (int) ( h & (unsigned int) (num_slots - 1) ) ;
+}
+
+int HashGrid::serial_index(spp_real* pos){
+    int ind[DIM] ;
+    this->grid_index(pos, ind) ;
+    return this->hash(ind) ;
+}
+
+int HashGrid::adjacent_slots(int* ind, int* adj){
+    /*
+     * Two adjacent cells may share a slot, which
+     * must get a single copy of the agent.
+     */
+    int n = 0, s, cell[DIM] ;
+    current_stamp += 1 ;
+    if(current_stamp == 0x7fffffff){
+        for(s=0 ; s<num_slots ; s++)
+            stamp[s] = 0 ;
+        current_stamp = 1 ;
+    }
+    for(cell[0]=ind[0]-1 ; cell[0]<=ind[0]+1 ; cell[0]++){
+        for(cell[1]=ind[1]-1 ; cell[1]<=ind[1]+1 ; cell[1]++){
+#if DIM==3
+            for(cell[2]=ind[2]-1 ; cell[2]<=ind[2]+1 ; cell[2]++){
+#endif
+                s = this->hash(cell) ;
+                if(stamp[s] != current_stamp){
+                    stamp[s] = current_stamp ;
+                    adj[n] = s ;
+                    n += 1 ;
                 }
+#if DIM==3
             }
-        }
 #endif
+        }
     }
+    return n ;
 }
 
-Agent* Grid::get_neighborhood(Agent* ag, int* num_neis ){
+void HashGrid::fill_grid(int num_agents, Agent* agents){
+    /*
+     * Put every agent in the slots of its cell and of
+     * the adjacent ones. First count the agents of each
+     * slot to know where its list starts, and then copy
+     * them, in the order of *agents*.
+     */
+    int is, ia, n, nadj, ind[DIM], adj[NADJ] ;
+    if(num_agents * NADJ > capacity){
+        delete[] grid ;
+        capacity = num_agents * NADJ ;
+        grid = new Agent[ capacity ] ;
+    }
+    for(is=0 ; is < num_slots ; is++)
+        occupation[is] = 0 ;
+    for(ia=0 ; ia < num_agents ; ia++){
+        this->grid_index( agents[ia].get_pos(), ind ) ;
+        nadj = this->adjacent_slots( ind, adj ) ;
+        for(n=0 ; n < nadj ; n++)
+            occupation[adj[n]] += 1 ;
+    }
+    first[0] = 0 ;
+    for(is=0 ; is < num_slots ; is++){
+        first[is+1] = first[is] + occupation[is] ;
+        occupation[is] = 0 ;
+    }
+    for(ia=0 ; ia < num_agents ; ia++){
+        this->grid_index( agents[ia].get_pos(), ind ) ;
+        nadj = this->adjacent_slots( ind, adj ) ;
+        for(n=0 ; n < nadj ; n++){
+            is = adj[n] ;
+            grid[first[is] + occupation[is]] = agents[ia] ;
+            occupation[is] += 1 ;
+        }
+    }
+}
+
+Agent* HashGrid::get_neighborhood(Agent* ag, int* num_neis ){
     int index = this->serial_index( ag->get_pos() ) ;
     *num_neis = occupation[index] ;
-    return grid[index] ;
+    return grid + first[index] ;
 }
@@ -31,40 +31,107 @@
  * one has to choose a number of slots conservative enough so the
  * probability of an agent having a neighbor two slots away is
  * neglibigle.
+ * The number of slots can be chosen by the Community from the
+ * range of the interaction and re-tuned as the swarm evolves
+ * (see Community::tune_grid), instead of by hand.
+ *
+ * The box can be rectangular, with a different length and
+ * number of slots along each dimension, so that the slots are
+ * about as wide as the interaction range along all of them.
+ *
+ * By default the box is periodic along every dimension, but it
+ * can have walls along some of them (see set_boundaries): the slots
+ * next to a wall are then not adjacent to those at the other side
+ * of the box, so a slot has less than 3^DIM adjacent slots.
+ *
+ * The copies of the agents of all the slots are stored in a single
+ * array, with *3^DIM* copies of each agent, which grows as needed.
+ * The list of each slot holds the agents of its adjacent slots one
+ * slot after the other, and the Grid keeps where each of them starts
+ * (see get_blocks), so that an Interaction can skip whole slots,
+ * e.g. those behind the agent for MetricCone and TopologicCone.
+ *
+ * For agents in open space, with no box, see HashGrid.
  *
  */
 class Grid{
     public:
-        /* Construct grid and allocate all the space it needs,
-         * approximately (nslots^dimension)*max_agents*sizeof(Agent).
-         * If nslots <= 3 this will print an error to stderr and
-         * not allocate space, but it does NOT raise an exception.
+        /* Construct grid and allocate the space it needs,
+         * approximately (3^dimension)*max_agents*sizeof(Agent).
+         * If nslots < 3 it uses 3 slots, so that the neighborhood
+         * of every slot is the whole box.
          * Inputs:
          *      ns = nslots
          *      bs = box_size
-         *      max_agents = Max number of agents that can be
-         *          stored in each slot. This will affect the
-         *          size allocated for grid (or rather, for
-         *          each grid[i]).
+         *      max_agents = Number of agents expected. More
+         *          space is allocated if fill_grid is called
+         *          with more agents.
          */
         Grid(int ns , double bs, int max_agents) ;
+        /* Construct a grid with 3 slots per dimension, to be
+         * tuned by the Community (see Community::tune_grid).
+         */
+        Grid(double bs, int max_agents) ;
+        /* Same for a rectangular box with the DIM lengths *ls*. */
+        Grid(double* ls, int max_agents) ;
+        /* Return the number of slots per dimension
+         * (along the first one if they are different).
+         */
+        int get_nslots() {return nslots[0];} ;
+        /* Return the number of slots along dimension *d*. */
+        int get_nslots(int d) {return nslots[d];} ;
+        /* Return the total number of slots. */
+        int get_num_slots() {return num_slots;} ;
+        /* Return the size of a slot (along the first dimension). */
+        double get_slot_size() {return lengths[0] / nslots[0];} ;
+        /* Return the size of a slot along dimension *d*. */
+        double get_slot_size(int d) {return lengths[d] / nslots[d];} ;
+        /* Change the number of slots to *ns* along every dimension
+         * (3 at least along the periodic ones, 1 along those with
+         * walls). The grid must be filled again.
+         */
+        void set_nslots(int ns) ;
+        /* Change the number of slots along each dimension to the
+         * DIM values *ns* (same limits). The grid must be filled again.
+         */
+        void set_nslots(int* ns) ;
+        /* Set the boundaries along each dimension: *periodic[i]* 1
+         * if the dimension *i* is periodic (the default) or 0 if it
+         * has walls. Called by Community::setup_grid with the
+         * boundaries of the Community. The grid must be filled again.
+         */
+        void set_boundaries(int* periodic) ;
+        /* Return 1 if dimension *d* is periodic, 0 if it has walls. */
+        int is_periodic(int d) {return periodic[d];} ;
+        /* Choose the number of slots for an interaction *range*
+         * and *num_agents* agents: along each dimension the largest
+         * one with slots not smaller than *range*, but with no more
+         * slots than agents (with the same proportion of slots along
+         * each dimension as the box lengths when capped).
+         * Change to it (see set_nslots) if it is different from the
+         * current one, and return it (see get_nslots).
+         * If *range* <= 0 nothing changes.
+         */
+        int tune(double range, int num_agents) ;
         /* Store in *ind* the n-dimensional index (i,j) or (i,j,k)
          * corresponding to a given position *pos*.
          * Inputs:
          *      pos = pointer with an n-dim position
          *      ind = pointer to store the n-dim index
          */
-        void grid_index(double* pos , int *ind ) ;
+        void grid_index(spp_real* pos , int *ind ) ;
         /* Return the serial index corresponding to the
          * position *pos*. This value gives the index
          * of grid[] corresponding to that position.
          */
-        int  serial_index(double* pos ) ;
+        int  serial_index(spp_real* pos ) ;
         /* Copy the *num_agents* contained in *ags*
          * to their corresponding slots in *grid*.
          * Each agent *ag* is _copied_ to its own
          * slot *serial_index(ag.pos)* and to all
          * the adjacent ones (8 for 2D and 26 for 3D).
+         * The agents of each adjacent slot are kept
+         * together, in the order of *ags*.
          */
         void fill_grid(int num_agents, Agent* ags) ;
         /* Return a list of agents containing the
@@ -74,19 +141,141 @@ class Grid{
          * last *fill_grid* call.
          */
         Agent* get_neighborhood(Agent* ag, int* num_neis ) ;
+        /* If the *num_neis* agents *ags* are the neighborhood of
+         * the slot of *pos* in the last fill_grid (as returned by
+         * get_neighborhood), store the n-dim index of the slot in
+         * *ind* and return the 3^DIM+1 offsets in *ags*
+         * where the agents of each adjacent slot start: those of
+         * the slot ind + (i,j,k) - (1,1,1), with i,j,k in 0..2, are
+         *      ags[blocks[n] : blocks[n+1]],  n = (i*3 + j)*3 + k
+         * (n = i*3 + j in 2D), none beyond a wall.
+         * Otherwise return NULL.
+         */
+        int* get_blocks(spp_real* pos, Agent* ags, int num_neis, int* ind) ;
     protected:
-        /* Number of slots per dimension. */
-        int nslots ;
-        /* Size of the computation box */
-        double box_size ;
-        /* List containing a list of Agents for each slot.
-         * The Grid may represent a two- or three-dimesional
-         * array but grid is serialized,
-         *  grid[i] = list of all agents in slot *i* and adjacent.
-         */
-        Agent** grid ;
+        /* Store in *adj* the serial indices of the (up to 3^DIM)
+         * slots adjacent to the slot of n-dim index *ind*
+         * (including itself), in *off* their positions n in the
+         * blocks of get_blocks, in increasing order, and return
+         * how many there are.
+         */
+        int adjacent_slots(int* ind, int* adj, int* off) ;
+        /* Allocate *grid* for *max_agents* and 3 slots
+         * per dimension, with the box lengths already set.
+         */
+        void init(int max_agents) ;
+        /* Number of slots along each dimension, and in total. */
+        int nslots[SPP_MAX_DIM] ;
+        int num_slots ;
+        /* Length of the computation box along each dimension. */
+        double lengths[SPP_MAX_DIM] ;
+        /* 1 if the dimension is periodic, 0 if it has walls. */
+        int periodic[SPP_MAX_DIM] ;
+        /* Copies of the agents of all the slots. The Grid may
+         * represent a two- or three-dimesional array but it is
+         * serialized,
+         *  grid[first[i] : first[i] + occupation[i]] = list of all
+         *      agents in slot *i* and adjacent.
+         * *capacity* is the number of agents that fit in *grid*.
+         */
+        Agent* grid ;
+        int capacity ;
+        int* first ;
         /* List with number of agents contained in each
-         * entry of *grid*
+         * slot of *grid*
+         */
+        int* occupation ;
+        /* Offsets of the adjacent slots in the list of each
+         * slot, 3^DIM+1 per slot (see get_blocks).
          */
+        int* blocks ;
+        /* Agents sorted by slot while filling the grid: those
+         * of slot *i* are *by_slot[slot_first[i] : slot_first[i+1]]*
+         * (indices in the agents), and the slot of each agent.
+         * *agent_capacity* is the number of agents that fit.
+         */
+        int* slot_first ;
+        int* by_slot ;
+        int* agent_slot ;
+        int agent_capacity ;
+} ;
+
+/*
+ * Cell list for agents in open space (Cartesian geometry), with no
+ * box: space is divided in cubic cells of side *cell_size*,
+ * with integer coordinates (i,j) or (i,j,k) of any value, and
+ * each cell is mapped to one of the *table_size* slots of the
+ * Grid with the hash function
+ *      h(i,j,k) = (i*73856093 ^ j*19349663 ^ k*83492791) mod table_size
+ * (Teschner et al. 2003). Each agent is copied to the slots of its
+ * cell and of the 3^DIM - 1 adjacent ones, as in Grid, so the
+ * neighborhood of an agent holds all the agents in the adjacent
+ * cells, wherever the swarm goes, plus the agents of the cells that
+ * share their slots (collisions), which are discarded by the
+ * Interaction as too far. The grid is filled from scratch at every
+ * step, in O(N), and the neighbors found are the same as without
+ * a grid as long as *cell_size* is not smaller than the range of
+ * the interaction.
+ *
+ * The cell size can be tuned by the Community to the range of
+ * the interaction (see Community::tune_grid), and the table has
+ * about twice as many slots as *max_agents*, so that collisions
+ * are rare. The space needed is that of a Grid. Note that the range
+ * of Topologic is that of the farthest k-th neighbor of all the
+ * agents, so a few agents far from the swarm make all the cells large.
+ *
+ * It is a separate class from Grid, with the same fill_grid and
+ * get_neighborhood methods, so that neither of them pays a virtual
+ * call per agent. The Community takes either (see setup_grid).
+ */
+class HashGrid {
+    public:
+        /* Construct a hash grid with cells of side *cs* for
+         * about *max_agents* agents. If *cs* <= 0 all the agents
+         * are in the same cell until the grid is tuned, which is
+         * needed with interactions whose range is only known after
+         * the first step, such as Topologic.
+         */
+        HashGrid(double cs, int max_agents) ;
+        /* Return the side of the cells. */
+        double get_cell_size() {return cell_size;} ;
+        /* Return the number of slots of the table. */
+        int get_table_size() {return num_slots;} ;
+        /* Set the side of the cells to *cs*. The grid must be filled again. */
+        void set_cell_size(double cs) {cell_size = cs;} ;
+        /* Set the side of the cells to the interaction *range*, and
+         * return the number of slots of the table. If *range* <= 0
+         * nothing changes.
+         */
+        int tune(double range, int num_agents) ;
+        /* Store in *ind* the coordinates of the cell that contains
+         * the position *pos*.
+         */
+        void grid_index(spp_real* pos , int *ind ) ;
+        /* Return the slot of the cell that contains *pos*. */
+        int  serial_index(spp_real* pos ) ;
+        /* Same as Grid::fill_grid, with the slots of the cells. */
+        void fill_grid(int num_agents, Agent* ags) ;
+        /* Same as Grid::get_neighborhood. */
+        Agent* get_neighborhood(Agent* ag, int* num_neis ) ;
+    protected:
+        /* Store in *adj* the (different) slots of the 3^DIM cells
+         * adjacent to the cell *ind*, and return how many there are.
+         */
+        int adjacent_slots(int* ind, int* adj) ;
+        /* Slot of the cell *ind*. */
+        int hash(int* ind) ;
+        double cell_size ;
+        /* Number of slots of the table, a power of 2. */
+        int num_slots ;
+        /* Copies of the agents of all the slots, as in Grid. */
+        Agent* grid ;
+        int capacity ;
+        int* first ;
         int* occupation ;
+        /* Last call to adjacent_slots that used each slot,
+         * to skip the slots shared by two adjacent cells.
+         */
+        int* stamp ;
+        int current_stamp ;
 } ;
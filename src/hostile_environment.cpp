@@ -8,38 +8,136 @@ inline int modulo(int a, int b) {
     return result < 0 ? result+b: result ;
 }
 
-inline double fmodulo(double a, double b) {
-    const double result = fmod(a,b);
+inline spp_real fmodulo(spp_real a, spp_real b) {
+    const spp_real result = fmod(a,b);
     return result < 0. ? result+b: result ;
 }
 
+/*----------------------- Event log ------------------------------*/
+EventLog::EventLog(FILE* o, int cap){
+    int dim = DIM ;
+    int size = sizeof(spp_event) ;
+    out = o ;
+    step = 0 ;
+    capacity = cap > 0 ? cap : 1 ;
+    num_buffered = 0 ;
+    num_events = 0 ;
+    buffer = new spp_event[capacity] ;
+    if(out == NULL){
+        fprintf(stderr,"libspp.hostile_environment: ERROR - EventLog needs an open FILE*, the events will be discarded.\n") ;
+        return ;
+    }
+    if(fwrite("SPPE", 1, 4, out) + fwrite(&dim, sizeof(int), 1, out) + fwrite(&size, sizeof(int), 1, out) != 6)
+        fprintf(stderr,"libspp.EventLog: ERROR - Could not write the header.\n") ;
+}
+
+void EventLog::add(int type, int a, int b, spp_real* x){
+    if(num_buffered == capacity)
+        this->flush() ;
+    spp_event* e = buffer + num_buffered ;
+    e->type = type ;
+    e->step = step ;
+    e->a = a ;
+    e->b = b ;
+    for(int i=0; i<SPP_MAX_DIM; i++)
+        e->x[i] = (x && i < DIM) ? (float) x[i] : 0.0f ;
+    num_buffered += 1 ;
+    num_events += 1 ;
+}
+
+int EventLog::flush(){
+    int n = num_buffered ;
+    num_buffered = 0 ;
+    if(out == NULL)
+        return -1 ;
+    if(n > 0 && (int) fwrite(buffer, sizeof(spp_event), n, out) != n){
+        fprintf(stderr,"libspp.EventLog: ERROR - Could not write %i events.\n", n) ;
+        return -1 ;
+    }
+    fflush(out) ;
+    return 0 ;
+}
+
+
 /*----------------------- Hostile class --------------------------*/
-HostileEnvironment::HostileEnvironment(int nags , double L, Agent* ags , double* p, double* v, int npreds , Agent* preds) : Community(nags, L, ags, p, v) {
+HostileEnvironment::HostileEnvironment(int nags , double L, Agent* ags , spp_real* p, spp_real* v, int npreds , Agent* preds) : Community(nags, L, ags, p, v) {
     num_predators = npreds ;
     predators = preds ;
+    ids = new int[nags > 0 ? nags : 1] ;
+    for(int ia=0; ia<nags; ia++)
+        ids[ia] = ia ;
+    next_id = nags ;
+    events = NULL ;
+    fled = NULL ;
+    targets = NULL ;
+}
+
+void HostileEnvironment::setup_events(EventLog* ev){
+    int ia, ip ;
+    events = ev ;
+    if(events && !fled){
+        fled = new char[num_agents > 0 ? num_agents : 1] ;
+        targets = new int[num_predators > 0 ? num_predators : 1] ;
+    }
+    if(events){
+        for(ia=0; ia<num_agents; ia++)
+            fled[ia] = 0 ;
+        for(ip=0; ip<num_predators; ip++)
+            targets[ip] = -1 ;
+    }
+}
+
+void HostileEnvironment::log_flee(int ia, int fleeing){
+    int ip, ipmin = -1 ;
+    spp_real d2, d2min = 0.0 ;
+    Geometry* g ;
+    if(fleeing && !fled[ia]){
+        g = agents[ia].get_behavior()->inter->g ;
+        for(ip=0; ip<num_predators; ip++){
+            d2 = g->distance2(agents[ia].get_pos(), predators[ip].get_pos()) ;
+            if(ipmin < 0 || d2 < d2min){
+                d2min = d2 ;
+                ipmin = ip ;
+            }
+        }
+        events->add(SPP_EVENT_FLEE, ids[ia], ipmin, agents[ia].get_pos()) ;
+    }
+    fled[ia] = fleeing ;
 }
 
 Agent* HostileEnvironment::get_predators(){
     return predators ;
 }
 
-int HostileEnvironment::sense_velocities_danger(double* vel_sensed){
-    int ia , fleeing = 0;
+int HostileEnvironment::sense_velocities_danger(spp_real* vel_sensed){
+    int ia , f , fleeing = 0;
 
     this->sense_velocities(vel_sensed) ;
 
-    for(ia=0; ia<num_agents; ia++)
-        fleeing += agents[ia].sense_danger(num_predators, predators, vel_sensed + ia*DIM) ;
+    for(ia=0; ia<num_agents; ia++){
+        f = agents[ia].sense_danger(num_predators, predators, vel_sensed + ia*DIM) ;
+        fleeing += f ;
+        if(events)
+            this->log_flee(ia, f) ;
+    }
+    if(events)
+        events->add(SPP_EVENT_FLEEING, fleeing, num_agents, NULL) ;
     return fleeing ;
 }
 
-int HostileEnvironment::sense_noisy_velocities_danger(double* vel_sensed){
-    int ia , fleeing = 0 ;
+int HostileEnvironment::sense_noisy_velocities_danger(spp_real* vel_sensed){
+    int ia , f , fleeing = 0 ;
 
     this->sense_noisy_velocities(vel_sensed) ;
 
-    for(ia=0; ia<num_agents; ia++)
-        fleeing += agents[ia].sense_danger(num_predators, predators, vel_sensed + ia*DIM) ;
+    for(ia=0; ia<num_agents; ia++){
+        f = agents[ia].sense_danger(num_predators, predators, vel_sensed + ia*DIM) ;
+        fleeing += f ;
+        if(events)
+            this->log_flee(ia, f) ;
+    }
+    if(events)
+        events->add(SPP_EVENT_FLEEING, fleeing, num_agents, NULL) ;
     return fleeing ;
 }
 
@@ -47,9 +145,15 @@ int HostileEnvironment::hunt(double dt){
     int ip , iprey , deaths = 0 , kill;
     for(ip=0; ip<num_predators; ip++){
         iprey = predators[ip].sense_victims(num_agents, agents) ;
+        if(events && ids[iprey] != targets[ip]){
+            targets[ip] = ids[iprey] ;
+            events->add(SPP_EVENT_TARGET, ip, ids[iprey], predators[ip].get_pos()) ;
+        }
         kill  = predators[ip].hunt( agents+iprey , dt) ;
         if(kill){
             deaths +=1 ;
+            if(events)
+                events->add(SPP_EVENT_KILL, ip, ids[iprey], agents[iprey].get_pos()) ;
             //this->replace_dead(iprey) ;
             this->remove_dead(iprey) ;
         }
@@ -69,6 +173,12 @@ void HostileEnvironment::remove_dead(int ia){
      */
     num_agents -= 1 ;
     agents[ia].copy( agents + num_agents )  ;
+    ids[ia] = ids[num_agents] ;
+    if(fled)
+        fled[ia] = fled[num_agents] ;
+    if(images)
+        for(int i=0; i<DIM; i++)
+            images[ia*DIM + i] = images[num_agents*DIM + i] ;
 }
 
 void HostileEnvironment::replace_dead(int ia){
@@ -78,10 +188,15 @@ void HostileEnvironment::replace_dead(int ia){
      */
     int i ;
     /* displace the agent to the opposite end of the box */
-    for(i=ia*DIM; i<(ia+1)*DIM; i++)
-        pos[i] = fmodulo( pos[i] + 0.5*box_size , box_size );
+    for(i=0; i<DIM; i++)
+        pos[ia*DIM + i] = fmodulo( pos[ia*DIM + i] + 0.5*box_lengths[i] , box_lengths[i] );
     /* set the velocity to the sensed velocity in the new location */
     agents[ia].randomize_velocity() ;
+    /* it is a new prey */
+    ids[ia] = next_id ;
+    next_id += 1 ;
+    if(fled)
+        fled[ia] = 0 ;
 }
 
 void HostileEnvironment::print_predators_posvel(){
@@ -100,13 +215,13 @@ void HostileEnvironment::print_predators_posvel(){
 
 HostileEnvironment spp_hostile_autostart(int num_agents, double speed, double box_size, Behavior* agsbeh, int num_predators, Behavior* predsbeh){
     /* Agents (preys) */
-    double* pos  = spp_community_alloc_space(     num_agents) ;
-    double* vel  = spp_community_alloc_space(     num_agents) ;
+    spp_real* pos  = spp_community_alloc_space(     num_agents) ;
+    spp_real* vel  = spp_community_alloc_space(     num_agents) ;
     Agent** neis = spp_community_alloc_neighbors( num_agents) ;
     Agent* ags = spp_community_build_agents(num_agents, pos, vel, neis, agsbeh) ;
     /* Predators */
-    double* ppos = spp_community_alloc_space( num_predators ) ;
-    double* pvel = spp_community_alloc_space( num_predators ) ;
+    spp_real* ppos = spp_community_alloc_space( num_predators ) ;
+    spp_real* pvel = spp_community_alloc_space( num_predators ) ;
     Agent* preds = spp_community_build_agents(num_predators, ppos, pvel, neis, predsbeh) ;
 
     HostileEnvironment hos = HostileEnvironment(num_agents, box_size , ags, pos, vel, num_predators, preds) ;
@@ -1,5 +1,83 @@
 #include "community.h"
 
+/* Kinds of events of an EventLog. */
+#define SPP_EVENT_KILL      0
+#define SPP_EVENT_FLEE      1
+#define SPP_EVENT_FLEEING   2
+#define SPP_EVENT_TARGET    3
+
+/*
+ * One record of an EventLog, 28 bytes in both 2D and 3D
+ * (x always has SPP_MAX_DIM floats):
+ *      type    SPP_EVENT_*
+ *      step    step set with EventLog::set_step
+ *      a, b    identifiers, depending on the type
+ *      x       a position (only DIM values are used)
+ */
+typedef struct {
+    int type ;
+    int step ;
+    int a ;
+    int b ;
+    float x[SPP_MAX_DIM] ;
+} spp_event ;
+
+/*
+ * Binary stream of the events of a HostileEnvironment
+ * (see HostileEnvironment::setup_events), with the
+ * agents identified by the index they had when the
+ * HostileEnvironment was created (see get_ids):
+ *      SPP_EVENT_KILL      a = predator, b = prey,
+ *          x = position of the prey when caught.
+ *      SPP_EVENT_FLEE      a = prey, b = closest predator
+ *          (-1 if there are none), x = position of the prey,
+ *          when the prey starts fleeing (it did not the
+ *          step before).
+ *      SPP_EVENT_FLEEING   a = number of fleeing preys,
+ *          b = number of preys, once per step.
+ *      SPP_EVENT_TARGET    a = predator, b = new prey,
+ *          x = position of the predator, when the
+ *          predator chases a different prey.
+ *
+ * The events are stored in a buffer of *capacity*
+ * records that is written to the file when full, so
+ * logging an event only copies one record. The stream
+ * starts with the header, in the native byte order,
+ *      "SPPE"          4 chars
+ *      DIM             int (4 bytes)
+ *      record size     int (4 bytes)
+ * followed by the records, which can be read with
+ * numpy as a structured array of 4 int32 and
+ * SPP_MAX_DIM float32 fields.
+ * Call flush() at the end to write the last events.
+ */
+class EventLog {
+    public:
+        /* Write the header to *out*, already open for
+         * writing, and allocate space for *capacity* events.
+         * If *out* is NULL an error is printed and the
+         * events are discarded (flush returns -1).
+         */
+        EventLog(FILE* out, int capacity) ;
+        /* Set the step of the next events. */
+        void set_step(int s) {step = s;} ;
+        /* Add an event, with *x* NULL to leave the position at 0. */
+        void add(int type, int a, int b, spp_real* x) ;
+        /* Write the events in the buffer to the file.
+         * Returns 0 on success, -1 if the writing failed.
+         */
+        int flush() ;
+        /* Return the number of events added. */
+        long get_num_events() {return num_events;} ;
+    protected:
+        FILE* out ;
+        int step ;
+        int capacity ;
+        int num_buffered ;
+        long num_events ;
+        spp_event* buffer ;
+} ;
+
 /*
  * Extension of Community to handle
  * systems containing two kinds of agents:
@@ -40,7 +118,7 @@ class HostileEnvironment : public Community{
          *      the *npred* Agent instances
          *      (predators).
          */
-        HostileEnvironment(int nags , double L, Agent* ags , double* p, double* v, int npreds , Agent* preds) ;
+        HostileEnvironment(int nags , double L, Agent* ags , spp_real* p, spp_real* v, int npreds , Agent* preds) ;
         /* Return the pointer to the array of agents (predators).*/
         Agent* get_predators() ;
         /* Same as Community::sense_velocity but also
@@ -48,11 +126,11 @@ class HostileEnvironment : public Community{
          * Returns the number of agents fleeing from
          * a predator.
          */
-        int sense_velocities_danger(double* vel_sensed) ;
+        int sense_velocities_danger(spp_real* vel_sensed) ;
         /* same as sense_velocities_danger() but using
          * sense_noisy_velocity() instead of sense_velocity().
          */
-        int sense_noisy_velocities_danger(double* vel_sensed) ;
+        int sense_noisy_velocities_danger(spp_real* vel_sensed) ;
         /* Move the predator towards the closest prey. If
          * the predator can catch the prey, remove the prey
          * from the community using the remove_dead() function.
@@ -75,13 +153,42 @@ class HostileEnvironment : public Community{
          * the position and velocity of the predators.
          */
         void print_predators_posvel() ;
+        /* Log the kills, the fleeing preys and the changes
+         * of target of the predators in *events* (see
+         * EventLog), or stop logging if it is NULL.
+         */
+        void setup_events(EventLog* events) ;
+        /* Return the identifier of each prey: the index it
+         * had when the HostileEnvironment was created, which
+         * remove_dead keeps as the preys are rearranged.
+         * New preys of replace_dead get new identifiers.
+         *      Size: num_agents
+         */
+        int* get_ids() {return ids;} ;
     protected:
+        /* Log the prey *ia* if it starts fleeing, given
+         * the result *fleeing* of its sense_danger. The
+         * predator it flees from is taken to be the
+         * closest one.
+         */
+        void log_flee(int ia, int fleeing) ;
         /* Number of predators. */
         int num_predators ;
         /* Array of predator agents
          *      Size: num_predators
          */
         Agent* predators ;
+        /* Identifier of each prey and the next new one. */
+        int* ids ;
+        int next_id ;
+        /* Events, or NULL. */
+        EventLog* events ;
+        /* Whether each prey fled in the last step, and
+         * the identifier of the prey chased by each
+         * predator (-1 for none), for the events.
+         */
+        char* fled ;
+        int* targets ;
 } ;
 
 /* Similar as spp_community_autostart.
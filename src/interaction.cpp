@@ -1,32 +1,58 @@
 #include "interaction.h"
-#include "agent.h"
+#include "grid.h"
+#include <stdio.h>
 
 /*
  * Geometry
  */
-double Geometry::length2(double* vect){
-    double l2 = 0. ;
+Geometry::Geometry(){
+    L = 0.0 ;
+    for(int i=0 ; i<SPP_MAX_DIM ; i++)
+        lengths[i] = 0.0 ;
+    cubic = 1 ;
+}
+
+Geometry::Geometry(double l){
+    L = l ;
+    for(int i=0 ; i<SPP_MAX_DIM ; i++)
+        lengths[i] = i < DIM ? l : 0.0 ;
+    cubic = 1 ;
+}
+
+spp_real Geometry::length2(spp_real* vect){
+    spp_real l2 = 0. ;
     int i ;
     for(i=0 ; i<DIM ; i++)
         l2 += vect[i]*vect[i] ;
     return l2 ;
 }
 
+void Geometry::set_lengths(double* ls){
+    L = 0.0 ;
+    cubic = 1 ;
+    for(int i=0 ; i<DIM ; i++){
+        lengths[i] = ls[i] ;
+        if(ls[i] > L)
+            L = ls[i] ;
+        if(ls[i] != ls[0])
+            cubic = 0 ;
+    }
+}
+
 
 /*
  * Cartesian
  */
-Cartesian::Cartesian(double l ){
-    L = l ;
+Cartesian::Cartesian(double l ) : Geometry(l) {
 }
 
-void Cartesian::displacement(double* x0, double* x1, double* dis){
+void Cartesian::displacement(spp_real* x0, spp_real* x1, spp_real* dis){
     for(int i=0 ; i<DIM ; i++)
        dis[i] = x1[i] - x0[i] ;
 }
 
-double Cartesian::distance2(double* x0, double* x1){
-    double dis = 0. ;
+spp_real Cartesian::distance2(spp_real* x0, spp_real* x1){
+    spp_real dis = 0. ;
     for(int i=0 ; i<DIM ; i++)
        dis += (x1[i] - x0[i])*(x1[i] - x0[i]) ;
    return dis ;
@@ -36,20 +62,78 @@ double Cartesian::distance2(double* x0, double* x1){
 /*
  * Cartesian Periodic
  */
-CartesianPeriodic::CartesianPeriodic(double l ){
-    L = l ;
+CartesianPeriodic::CartesianPeriodic(double l ) : Geometry(l) {
 }
 
-void CartesianPeriodic::displacement(double* x0, double* x1, double* dis){
+CartesianPeriodic::CartesianPeriodic(double* ls ){
+    set_lengths(ls) ;
+}
+
+void CartesianPeriodic::displacement(spp_real* x0, spp_real* x1, spp_real* dis){
+    spp_real l ;
+    if(cubic){
+        l = L ;
+        for(int i=0 ; i<DIM ; i++)
+            dis[i] = (x1[i] - x0[i]) - rint( (x1[i] - x0[i])/l ) * l ;
+        return ;
+    }
+    for(int i=0 ; i<DIM ; i++){
+        l = lengths[i] ;
+        dis[i] = (x1[i] - x0[i]) - rint( (x1[i] - x0[i])/l ) * l ;
+    }
+}
+
+spp_real CartesianPeriodic::distance2(spp_real* x0, spp_real* x1){
+    spp_real l ;
+    spp_real dis = 0. ;
+    spp_real tmp ;
+    if(cubic){
+        l = L ;
+        for(int i=0 ; i<DIM ; i++){
+            tmp = (x1[i] - x0[i]) - rint( (x1[i] - x0[i])/l ) * l ;
+            dis += tmp * tmp ;
+        }
+        return dis ;
+    }
+    for(int i=0 ; i<DIM ; i++){
+        l = lengths[i] ;
+        tmp = (x1[i] - x0[i]) - rint( (x1[i] - x0[i])/l ) * l ;
+        dis += tmp * tmp ;
+    }
+   return dis ;
+}
+
+
+/*
+ * Cartesian Walled
+ */
+CartesianWalled::CartesianWalled(double* ls, int* p){
+    set_lengths(ls) ;
     for(int i=0 ; i<DIM ; i++)
-        dis[i] = (x1[i] - x0[i]) - rint( (x1[i] - x0[i])/L ) * L ;
+        periodic[i] = p[i] ;
 }
 
-double CartesianPeriodic::distance2(double* x0, double* x1){
-    double dis = 0. ;
-    double tmp ;
+void CartesianWalled::displacement(spp_real* x0, spp_real* x1, spp_real* dis){
+    spp_real l ;
     for(int i=0 ; i<DIM ; i++){
-        tmp = (x1[i] - x0[i]) - rint( (x1[i] - x0[i])/L ) * L ;
+        dis[i] = x1[i] - x0[i] ;
+        if(periodic[i]){
+            l = lengths[i] ;
+            dis[i] -= rint( dis[i]/l ) * l ;
+        }
+    }
+}
+
+spp_real CartesianWalled::distance2(spp_real* x0, spp_real* x1){
+    spp_real l ;
+    spp_real dis = 0. ;
+    spp_real tmp ;
+    for(int i=0 ; i<DIM ; i++){
+        tmp = x1[i] - x0[i] ;
+        if(periodic[i]){
+            l = lengths[i] ;
+            tmp -= rint( tmp/l ) * l ;
+        }
         dis += tmp * tmp ;
     }
    return dis ;
@@ -77,7 +161,7 @@ int Metric::is_neighbor(Agent* a0 , Agent* a1){
 int Metric::get_neighbors(Agent* a0, int n_agents, Agent* ags, Agent** neis){
     int ia ;
     int n_neis = 0 ;
-    double* pos = a0->get_pos() ;
+    spp_real* pos = a0->get_pos() ;
     for(ia=0; ia < n_agents ; ia++){
         if(g->distance2( pos , (ags+ia)->get_pos()) <= rad2){
             neis[n_neis] = ags + ia ;
@@ -94,11 +178,17 @@ double Metric::radius(){
 /*
  * Topologic
  */
-Topologic::Topologic(int kk, Geometry* gg, double* dd){
+Topologic::Topologic(int kk, Geometry* gg, spp_real* dd){
     k = kk ;
     g = gg ;
     rad2 = 0.0 ;
+    max_rad2 = 0.0 ;
+    last_max_rad2 = 0.0 ;
     dists2 = dd ;
+    shell = 0 ;
+    max_agents = 0 ;
+    num_agents = 0 ;
+    agents = NULL ;
 }
 
 int Topologic::is_neighbor(Agent* a0 , Agent* a1){
@@ -110,12 +200,40 @@ int Topologic::is_neighbor(Agent* a0 , Agent* a1){
 int Topologic::get_neighbors(Agent* a0, int n_agents, Agent* ags, Agent** neis){
     int ia ;
     int n_neis = 0 ;
-    double* pos = a0->get_pos() ;
+    spp_real* pos = a0->get_pos() ;
+
+    if(shell > 0 && num_agents > 0){
+        int i0 = (pos - agents[0].get_pos()) / DIM ;
+        if(i0 >= 0 && i0 < num_agents && agents[i0].get_pos() == pos){
+            int* cc = cands + i0*(k+shell) ;
+            int nc = num_cands[i0] ;
+            spp_real r2 ;
+            if(drift_ref[i0] >= 0.0 && nc > k){
+                for(ia=0; ia < nc ; ia++)
+                    cand_dists2[ia] = g->distance2( pos , agents[cc[ia]].get_pos()) ;
+                r2 = quickselect(cand_dists2, nc, k ) ;
+                /* Nobody out of the list can be closer than r_out - 2*drift */
+                if(sqrt(r2) + 2.0*(drift - drift_ref[i0]) < r_out[i0]){
+                    rad2 = r2 ;
+                    max_rad2 = rad2 > max_rad2 ? rad2 : max_rad2 ;
+                    for(ia=0; ia < nc ; ia++){
+                        if(g->distance2( pos , agents[cc[ia]].get_pos()) <= rad2){
+                            neis[n_neis] = agents + cc[ia] ;
+                            n_neis += 1 ;
+                        }
+                    }
+                    return n_neis ;
+                }
+            }
+            return full_search(i0, a0, n_agents, ags, neis) ;
+        }
+    }
 
     /* determine the effective radius */
     for(ia=0; ia < n_agents ; ia++)
         dists2[ia] = g->distance2( pos , (ags+ia)->get_pos()) ;
     rad2 = quickselect(dists2, n_agents, k ) ;
+    max_rad2 = rad2 > max_rad2 ? rad2 : max_rad2 ;
 
     for(ia=0; ia < n_agents ; ia++){
         if(g->distance2( pos , (ags+ia)->get_pos()) <= rad2){
@@ -128,13 +246,864 @@ int Topologic::get_neighbors(Agent* a0, int n_agents, Agent* ags, Agent** neis){
 
 void Topologic::look_around(Agent* a0, int n_agents, Agent* ags){
     int ia ;
-    double* pos = a0->get_pos() ;
+    spp_real* pos = a0->get_pos() ;
 
     /* determine the effective radius */
     for(ia=0; ia < n_agents ; ia++)
         dists2[ia] = g->distance2( pos , (ags+ia)->get_pos()) ;
     rad2 = quickselect(dists2, n_agents, k ) ;
+    max_rad2 = rad2 > max_rad2 ? rad2 : max_rad2 ;
+}
+
+int Topologic::full_search(int i0, Agent* a0, int n_agents, Agent* ags, Agent** neis){
+    int ia ;
+    int n_neis = 0 ;
+    int m = k + shell ;
+    int* cc = cands + i0*m ;
+    int nc = 0 ;
+    spp_real d2, rout2 ;
+    spp_real* pos = a0->get_pos() ;
+    spp_real* pos0 = agents[0].get_pos() ;
+
+    for(ia=0; ia < n_agents ; ia++)
+        dists2[ia] = g->distance2( pos , (ags+ia)->get_pos()) ;
+    rad2 = quickselect(dists2, n_agents, k ) ;
+    /* Distance2 to the first agent left out of the list */
+    if(n_agents > m){
+        rout2 = quickselect(dists2, n_agents, m ) ;
+        r_out[i0] = sqrt(rout2) ;
+        max_rad2 = rout2 > max_rad2 ? rout2 : max_rad2 ;
+    }else{
+        rout2 = HUGE_VAL ;
+        r_out[i0] = HUGE_VAL ;
+    }
+    max_rad2 = rad2 > max_rad2 ? rad2 : max_rad2 ;
+
+    for(ia=0; ia < n_agents ; ia++){
+        d2 = g->distance2( pos , (ags+ia)->get_pos()) ;
+        if(d2 <= rad2){
+            neis[n_neis] = ags + ia ;
+            n_neis += 1 ;
+        }
+        if(d2 < rout2 && nc < m){
+            /* ags may be copies (Grid), use the position to find the index */
+            cc[nc] = ((ags+ia)->get_pos() - pos0) / DIM ;
+            nc += 1 ;
+        }
+    }
+    num_cands[i0] = nc ;
+    drift_ref[i0] = drift ;
+    full_searches += 1 ;
+    return n_neis ;
+}
+
+void Topologic::setup_reuse(int ma, int sh){
+    if(sh < 1){
+        fprintf(stderr, "libspp.Topologic: ERROR - The shell for reuse must be >0, got %i.\n", sh) ;
+        return ;
+    }
+    this->stop_reuse() ;
+    shell = sh ;
+    max_agents = ma ;
+    num_agents = 0 ;
+    agents = NULL ;
+    cands       = new int[max_agents * (k+shell)] ;
+    num_cands   = new int[max_agents] ;
+    r_out       = new spp_real[max_agents] ;
+    drift_ref   = new double[max_agents] ;
+    prev_pos    = new spp_real[max_agents * DIM] ;
+    cand_dists2 = new spp_real[k+shell] ;
+    drift = 0.0 ;
+    full_searches = 0 ;
+    this->invalidate() ;
+}
+
+void Topologic::stop_reuse(){
+    if(shell == 0)
+        return ;
+    delete[] cands ;
+    delete[] num_cands ;
+    delete[] r_out ;
+    delete[] drift_ref ;
+    delete[] prev_pos ;
+    delete[] cand_dists2 ;
+    shell = 0 ;
+    max_agents = 0 ;
+    num_agents = 0 ;
+    agents = NULL ;
+}
+
+void Topologic::invalidate(){
+    for(int ia=0; ia < max_agents ; ia++)
+        drift_ref[ia] = -1.0 ;
+}
+
+void Topologic::prepare(int n_agents, Agent* ags){
+    int ia, i ;
+    spp_real disp[DIM] ;
+    spp_real d2, maxd2 = 0.0 ;
+    spp_real* pos ;
+    /* New step for range() */
+    last_max_rad2 = max_rad2 ;
+    max_rad2 = 0.0 ;
+    if(shell == 0)
+        return ;
+    if(n_agents > max_agents){
+        fprintf(stderr, "libspp.Topologic: ERROR - Reuse setup for %i agents, got %i. Not reusing.\n", max_agents, n_agents) ;
+        num_agents = 0 ;
+        return ;
+    }
+    if(ags != agents || n_agents != num_agents){
+        /* New community or agents removed: start from scratch */
+        agents = ags ;
+        num_agents = n_agents ;
+        this->invalidate() ;
+        for(ia=0; ia < num_agents ; ia++){
+            pos = agents[ia].get_pos() ;
+            for(i=0; i<DIM; i++)
+                prev_pos[ia*DIM+i] = pos[i] ;
+        }
+        return ;
+    }
+    for(ia=0; ia < num_agents ; ia++){
+        pos = agents[ia].get_pos() ;
+        g->displacement(prev_pos + ia*DIM, pos, disp) ;
+        d2 = g->length2(disp) ;
+        if(d2 > maxd2)
+            maxd2 = d2 ;
+        for(i=0; i<DIM; i++)
+            prev_pos[ia*DIM+i] = pos[i] ;
+    }
+    drift += sqrt(maxd2) ;
+}
+
+double Topologic::range(){
+    spp_real r2 = max_rad2 > last_max_rad2 ? max_rad2 : last_max_rad2 ;
+    return SPP_TOPOLOGIC_RANGE_MARGIN * sqrt(r2) ;
+}
+
+/*
+ * Field of view
+ */
+
+/* Return 1 if the displacement *dis* from an agent with velocity
+ * *vel* (|vel|^2 = *v2*) is out of its blind cone, i.e. if
+ *      dis.vel >= c |dis| |vel|
+ * with *d2* = |dis|^2, comparing the squares.
+ */
+static inline int in_view(spp_real* dis, spp_real* vel, spp_real d2, spp_real v2, spp_real c){
+    spp_real dv = 0.0 ;
+    for(int i=0; i<DIM; i++)
+        dv += dis[i] * vel[i] ;
+    /* without branches, as it is used in the inner loops */
+    const spp_real s = dv * dv - c * c * d2 * v2 ;
+    if(c >= 0.0)
+        return (dv >= 0.0) & (s >= 0.0) ;
+    return (dv >= 0.0) | (s <= 0.0) ;
+}
+
+/* Largest coordinate given to the walls of the box when testing the
+ * corners of the slots, as the first and last slots along a dimension
+ * with walls also hold the agents rounded to them (see Grid::grid_index).
+ */
+#define BLIND_SLOTS_FAR 1e30
+/* Slots adjacent to a slot of a Grid, as in grid.cpp. */
+#if DIM==2
+#define NADJ     9
+#elif DIM==3
+#define NADJ     27
+#endif
+/* Candidates per slot below which testing the corners costs
+ * more than the candidates skipped (as for MetricCone with slots
+ * as large as its radius).
+ */
+#define BLIND_SLOTS_MIN 8
+
+/* If *grid* is set and *ags* is the neighborhood of the slot of *pos*
+ * in it, store in *blocks* the offsets of its adjacent slots (see
+ * Grid::get_blocks) and return a mask with bit n set if the slot of
+ * the block n lies entirely in the blind cone of an agent at *pos*
+ * with velocity *vel*. Return 0 if no slot can be skipped.
+ */
+static int blind_slots(Grid* grid, spp_real* pos, spp_real* vel, double c, int n_agents, Agent* ags, int** blocks){
+    int d, m, n, o, ind[DIM], hidden[1 << (2*DIM)], mask = 0 ;
+    double x, dv[DIM][4], d2[DIM][4], v2 = 0.0 ;
+    /* the blind cone is empty or not convex */
+    if(grid == NULL || c >= 0.0 || c <= -1.0 || n_agents < BLIND_SLOTS_MIN * NADJ)
+        return 0 ;
+    for(d=0; d<DIM; d++){
+        v2 += (double) vel[d] * vel[d] ;
+        if(grid->is_periodic(d) && grid->get_nslots(d) < 4)
+            return 0 ;
+    }
+    if(v2 == 0.0)
+        return 0 ;
+    *blocks = grid->get_blocks(pos, ags, n_agents, ind) ;
+    if(*blocks == NULL)
+        return 0 ;
+    /* the 4 planes of the 3 adjacent slots along each dimension */
+    for(d=0; d<DIM; d++){
+        for(m=0; m<4; m++){
+            x = (ind[d] + m - 1) * grid->get_slot_size(d) - pos[d] ;
+            if(!grid->is_periodic(d) && ind[d] + m - 1 == 0)
+                x = -BLIND_SLOTS_FAR ;
+            if(!grid->is_periodic(d) && ind[d] + m - 1 == grid->get_nslots(d))
+                x = BLIND_SLOTS_FAR ;
+            dv[d][m] = x * vel[d] ;
+            d2[d][m] = x * x ;
+        }
+    }
+    /* the corners, as in in_view with c < 0 */
+    for(n=0; n < (1 << (2*DIM)); n++){
+        double cdv = 0.0, cd2 = 0.0 ;
+        for(d=0; d<DIM; d++){
+            m = (n >> (2*d)) & 3 ;
+            cdv += dv[d][m] ;
+            cd2 += d2[d][m] ;
+        }
+        hidden[n] = (cdv < 0.0) & (cdv * cdv > c * c * cd2 * v2) ;
+    }
+    /* block n = (i*3 + j)*3 + k has the corners i..i+1, j..j+1, k..k+1 */
+#if DIM==2
+    for(o=0; o<9; o++){
+        n = (o / 3) | ((o % 3) << 2) ;
+        if(hidden[n] & hidden[n+1] & hidden[n+4] & hidden[n+5])
+            mask |= 1 << o ;
+    }
+#elif DIM==3
+    for(o=0; o<27; o++){
+        n = (o / 9) | (((o / 3) % 3) << 2) | ((o % 3) << 4) ;
+        if(hidden[n] & hidden[n+1] & hidden[n+4] & hidden[n+5] &
+           hidden[n+16] & hidden[n+17] & hidden[n+20] & hidden[n+21])
+            mask |= 1 << o ;
+    }
+#endif
+    return mask ;
+}
+
+MetricCone::MetricCone(double r, double blind_angle, Geometry* gg){
+    rad2 = r*r ;
+    cos_blind = -cos(0.5 * blind_angle) ;
+    g = gg ;
+    grid = NULL ;
+}
+
+int MetricCone::get_neighbors(Agent* a0, int n_agents, Agent* ags, Agent** neis){
+    /* the runs of blocks not skipped are searched */
+    int b, e ;
+    int n_neis = 0 ;
+    int* blocks ;
+    int skip = blind_slots(grid, a0->get_pos(), a0->get_vel(), cos_blind, n_agents, ags, &blocks) ;
+    if(skip == 0)
+        return this->search(a0, n_agents, ags, neis) ;
+    for(b=0; b < NADJ; b=e){
+        for(e=b; e < NADJ && !((skip >> e) & 1); e++) ;
+        if(e > b)
+            n_neis += this->search(a0, blocks[e] - blocks[b], ags + blocks[b], neis + n_neis) ;
+        for(; e < NADJ && ((skip >> e) & 1); e++) ;
+    }
+    return n_neis ;
+}
+
+int MetricCone::search(Agent* a0, int n_agents, Agent* ags, Agent** neis){
+    int ia, i ;
+    int n_neis = 0 ;
+    spp_real dis[2][DIM] ;
+    spp_real d2 ;
+    spp_real* pos = a0->get_pos() ;
+    spp_real* vel = a0->get_vel() ;
+    const spp_real v2 = g->length2(vel) ;
+    if(n_agents > 0)
+        g->displacement( pos , ags->get_pos(), dis[0]) ;
+    for(ia=0; ia < n_agents ; ia++){
+        /* the next displacement is computed before using this one */
+        spp_real* d = dis[ia & 1] ;
+        if(ia + 1 < n_agents)
+            g->displacement( pos , (ags+ia+1)->get_pos(), dis[(ia+1) & 1]) ;
+        d2 = 0.0 ;
+        for(i=0; i<DIM; i++)
+            d2 += d[i] * d[i] ;
+        /* stored always, kept only if a neighbor */
+        neis[n_neis] = ags + ia ;
+        n_neis += (d2 <= rad2) & in_view(d, vel, d2, v2, cos_blind) ;
+    }
+    return n_neis ;
+}
+
+int MetricCone::is_neighbor(Agent* a0 , Agent* a1){
+    spp_real dis[DIM] ;
+    spp_real d2 ;
+    g->displacement( a0->get_pos() , a1->get_pos(), dis) ;
+    d2 = g->length2(dis) ;
+    if(d2 <= rad2 && in_view(dis, a0->get_vel(), d2, g->length2(a0->get_vel()), cos_blind))
+        return 1 ;
+    return 0 ;
+}
+
+/* Distance2 given to the agents out of view, larger than any other. */
+#define TOPOLOGIC_CONE_HIDDEN 1e30
+
+TopologicCone::TopologicCone(int kk, double blind_angle, Geometry* gg, spp_real* dd){
+    k = kk ;
+    g = gg ;
+    rad2 = 0.0 ;
+    max_rad2 = 0.0 ;
+    last_max_rad2 = 0.0 ;
+    dists2 = dd ;
+    cos_blind = -cos(0.5 * blind_angle) ;
+    grid = NULL ;
+    seen = NULL ;
+    seen_size = 0 ;
+}
+
+int TopologicCone::visible_dists2(Agent* a0, int n_agents, Agent* ags){
+    /* the slots skipped are out of view */
+    int b, ia ;
+    int n_vis = 0 ;
+    int* blocks ;
+    int skip = blind_slots(grid, a0->get_pos(), a0->get_vel(), cos_blind, n_agents, ags, &blocks) ;
+    if(n_agents > seen_size){
+        if(seen)
+            delete[] seen ;
+        seen_size = n_agents ;
+        seen = new spp_real[seen_size] ;
+    }
+    if(skip == 0)
+        return this->visible_dists2(a0, 0, n_agents, ags) ;
+    for(b=0; b < NADJ; b++){
+        if((skip >> b) & 1){
+            for(ia=blocks[b]; ia < blocks[b+1]; ia++)
+                dists2[ia] = seen[ia] = TOPOLOGIC_CONE_HIDDEN ;
+        }else{
+            n_vis += this->visible_dists2(a0, blocks[b], blocks[b+1], ags) ;
+        }
+    }
+    return n_vis ;
+}
+
+int TopologicCone::visible_dists2(Agent* a0, int i0, int i1, Agent* ags){
+    int ia, i, vis ;
+    int n_vis = 0 ;
+    spp_real dis[2][DIM] ;
+    spp_real d2 ;
+    spp_real* pos = a0->get_pos() ;
+    spp_real* vel = a0->get_vel() ;
+    const spp_real v2 = g->length2(vel) ;
+    if(i1 > i0)
+        g->displacement( pos , (ags+i0)->get_pos(), dis[0]) ;
+    for(ia=i0; ia < i1 ; ia++){
+        /* as in MetricCone::search */
+        spp_real* d = dis[(ia-i0) & 1] ;
+        if(ia + 1 < i1)
+            g->displacement( pos , (ags+ia+1)->get_pos(), dis[(ia+1-i0) & 1]) ;
+        d2 = 0.0 ;
+        for(i=0; i<DIM; i++)
+            d2 += d[i] * d[i] ;
+        /* the agents out of view are put after all the others */
+        vis = in_view(d, vel, d2, v2, cos_blind) ;
+        dists2[ia] = seen[ia] = vis ? d2 : TOPOLOGIC_CONE_HIDDEN ;
+        n_vis += vis ;
+    }
+    return n_vis ;
+}
+
+void TopologicCone::look_around(Agent* a0, int n_agents, Agent* ags){
+    int ia ;
+    int n_vis = this->visible_dists2(a0, n_agents, ags) ;
+    /* the k-th closest after itself, or the farthest */
+    if(n_vis > k){
+        rad2 = quickselect(dists2, n_agents, k ) ;
+    }else{
+        rad2 = 0.0 ;
+        for(ia=0; ia < n_agents ; ia++)
+            rad2 = seen[ia] > rad2 && seen[ia] < TOPOLOGIC_CONE_HIDDEN ? seen[ia] : rad2 ;
+    }
+    max_rad2 = rad2 > max_rad2 ? rad2 : max_rad2 ;
+}
+
+int TopologicCone::get_neighbors(Agent* a0, int n_agents, Agent* ags, Agent** neis){
+    /* *seen* still holds the distances, in the order of *ags* */
+    int ia ;
+    int n_neis = 0 ;
+    this->look_around(a0, n_agents, ags) ;
+    for(ia=0; ia < n_agents ; ia++){
+        neis[n_neis] = ags + ia ;
+        n_neis += seen[ia] <= rad2 ;
+    }
+    return n_neis ;
+}
+
+int TopologicCone::is_neighbor(Agent* a0 , Agent* a1){
+    spp_real dis[DIM] ;
+    spp_real d2 ;
+    g->displacement( a0->get_pos() , a1->get_pos(), dis) ;
+    d2 = g->length2(dis) ;
+    if(d2 <= rad2 && in_view(dis, a0->get_vel(), d2, g->length2(a0->get_vel()), cos_blind))
+        return 1 ;
+    return 0 ;
+}
+
+void TopologicCone::prepare(int n_agents, Agent* ags){
+    last_max_rad2 = max_rad2 ;
+    max_rad2 = 0.0 ;
+}
+
+double TopologicCone::range(){
+    spp_real r2 = max_rad2 > last_max_rad2 ? max_rad2 : last_max_rad2 ;
+    return SPP_TOPOLOGIC_RANGE_MARGIN * sqrt(r2) ;
+}
+
+/*
+ * Voronoi
+ */
+
+/* Maximum number of edges of a 2D cell, faces of a 3D cell,
+ * and vertices of each 3D face. A Voronoi cell in a random
+ * configuration has ~6 edges in 2D and ~15 faces in 3D.
+ */
+#define VORO_MAXV   128
+#define VORO_MAXF   128
+#define VORO_MAXFV  64
+/* Along the dimensions that are not periodic the starting
+ * cell reaches this many times further than the farthest
+ * candidate. The face between two agents at the edge of the
+ * swarm starts at the circumcenter of their Delaunay triangle,
+ * which is far away when it is flat: with twice the extent
+ * about one pair per swarm of 40 agents is missed, with 4096
+ * times none in the checks of examples/voronoi/voronoi_open.cpp.
+ * The vertices are doubles.
+ */
+#define VORO_OPEN_SIZE 4096.0
+
+/* Heap of candidate indices ordered by dists2 (smallest on top). */
+static void heap_sift_down(int* heap, spp_real* key, int n, int i){
+    int child, tmp ;
+    for(;;){
+        child = 2*i + 1 ;
+        if(child >= n) return ;
+        if(child + 1 < n && key[heap[child+1]] < key[heap[child]])
+            child += 1 ;
+        if(key[heap[i]] <= key[heap[child]]) return ;
+        tmp = heap[i] ; heap[i] = heap[child] ; heap[child] = tmp ;
+        i = child ;
+    }
+}
+
+Voronoi::Voronoi(Geometry* gg, int ma){
+    g = gg ;
+    max_agents = ma ;
+    dists2    = new spp_real[max_agents] ;
+    heap      = new int[max_agents] ;
+    cell_neis = new int[max_agents] ;
+    nei_pos   = new spp_real*[max_agents] ;
+    num_cell_neis = 0 ;
+#if DIM==2
+    tags      = new int[VORO_MAXV] ;
+    tmp_tags  = new int[VORO_MAXV] ;
+    verts     = new double[VORO_MAXV * 2] ;
+    tmp_verts = new double[VORO_MAXV * 2] ;
+    cap = NULL ;
+    fnverts = tmp_fnverts = NULL ;
+#elif DIM==3
+    tags        = new int[VORO_MAXF] ;
+    tmp_tags    = new int[VORO_MAXF] ;
+    fnverts     = new int[VORO_MAXF] ;
+    tmp_fnverts = new int[VORO_MAXF] ;
+    verts       = new double[VORO_MAXF * VORO_MAXFV * 3] ;
+    tmp_verts   = new double[VORO_MAXF * VORO_MAXFV * 3] ;
+    cap         = new double[VORO_MAXF * 2 * 3] ;
+#endif
+}
+
+int Voronoi::is_neighbor(Agent* a0 , Agent* a1){
+    for(int in=0; in<num_cell_neis; in++){
+        if(nei_pos[in] == a1->get_pos())
+            return 1 ;
+    }
+    return 0 ;
+}
+
+int Voronoi::get_neighbors(Agent* a0, int n_agents, Agent* ags, Agent** neis){
+    int n_neis = build_cell(a0, n_agents, ags) ;
+    for(int in=0; in<n_neis; in++)
+        neis[in] = ags + cell_neis[in] ;
+    return n_neis ;
+}
+
+void Voronoi::look_around(Agent* a0, int n_agents, Agent* ags){
+    build_cell(a0, n_agents, ags) ;
+}
+
+int Voronoi::build_cell(Agent* a0, int n_agents, Agent* ags){
+    int ia, i, j, n_heap, self, tag, images ;
+    int n_neis = 0 ;
+    double n[DIM] ;
+    spp_real disp[DIM] ;
+    spp_real* pos = a0->get_pos() ;
+    double h[DIM] ;
+    int open = 0 ;
+
+    if(n_agents > max_agents){
+        fprintf(stderr,"libspp.Voronoi: ERROR - %i candidates, but space only for %i.\n", n_agents, max_agents) ;
+        n_agents = max_agents ;
+    }
+    /* Half the box along the periodic dimensions. Along the
+     * others there is no box (or the walls do not matter):
+     * VORO_OPEN_SIZE times the extent of the candidates
+     * around the agent.
+     */
+    for(i=0; i<DIM; i++){
+        h[i] = g->is_periodic(i) ? 0.5 * g->length(i) : 0.0 ;
+        open |= !g->is_periodic(i) ;
+    }
+    self = -1 ;
+    for(ia=0; ia<n_agents; ia++){
+        dists2[ia] = g->distance2( pos , ags[ia].get_pos()) ;
+        heap[ia] = ia ;
+        if(ags[ia].get_pos() == pos)
+            self = ia ;
+        if(open){
+            g->displacement(pos, ags[ia].get_pos(), disp) ;
+            for(i=0; i<DIM; i++)
+                if(!g->is_periodic(i) && VORO_OPEN_SIZE * fabs(disp[i]) > h[i])
+                    h[i] = VORO_OPEN_SIZE * fabs(disp[i]) ;
+        }
+    }
+    for(i=0; i<DIM; i++)
+        if(h[i] <= 0.0)
+            h[i] = 1.0 ;
+
+    /* Starting cell: the box centered at the agent. */
+#if DIM==2
+    double box[8] = { -h[0], -h[1],   h[0], -h[1],   h[0], h[1],   -h[0], h[1] } ;
+    nverts = 4 ;
+    for(i=0; i<8; i++)
+        verts[i] = box[i] ;
+    for(i=0; i<4; i++)
+        tags[i] = -1 ;
+#elif DIM==3
+    /* Vertices of the 6 faces of the cube, face f is
+     * perpendicular to axis f/2. */
+    int f, v, corner ;
+    int faces[6][4] = { {0,2,6,4}, {1,5,7,3}, {0,4,5,1}, {2,3,7,6}, {0,1,3,2}, {4,6,7,5} } ;
+    nfaces = 6 ;
+    for(f=0; f<6; f++){
+        tags[f] = -1 ;
+        fnverts[f] = 4 ;
+        for(v=0; v<4; v++){
+            corner = faces[f][v] ;
+            verts[(f*VORO_MAXFV + v)*3 + 0] = (corner & 4) ? h[0] : -h[0] ;
+            verts[(f*VORO_MAXFV + v)*3 + 1] = (corner & 2) ? h[1] : -h[1] ;
+            verts[(f*VORO_MAXFV + v)*3 + 2] = (corner & 1) ? h[2] : -h[2] ;
+        }
+    }
+#endif
+    maxr2 = 0.0 ;
+    for(i=0; i<DIM; i++)
+        maxr2 += h[i] * h[i] ;
+
+    /* Sort the candidates lazily: heapify in O(m) and
+     * only pop the few that are actually tested. */
+    n_heap = n_agents ;
+    for(ia=n_heap/2-1; ia>=0; ia--)
+        heap_sift_down(heap, dists2, n_heap, ia) ;
+
+    while(n_heap > 0){
+        ia = heap[0] ;
+        heap[0] = heap[n_heap-1] ;
+        n_heap -= 1 ;
+        heap_sift_down(heap, dists2, n_heap, 0) ;
+        if(dists2[ia] > 4.0 * maxr2)
+            break ;
+        if(ia == self || dists2[ia] <= 0.0)
+            continue ;
+        /* Bisector: x*disp <= |disp|^2 / 2 */
+        g->displacement(pos, ags[ia].get_pos(), disp) ;
+        for(i=0; i<DIM; i++)
+            n[i] = disp[i] ;
+        clip(n, 0.5 * dists2[ia], ia) ;
+    }
+    images = clip_images(pos, n_agents, ags, self) ;
+
+    if(self >= 0){
+        cell_neis[n_neis] = self ;
+        n_neis += 1 ;
+    }
+#if DIM==2
+    for(i=0; i<nverts; i++){
+        tag = tags[i] ;
+#elif DIM==3
+    for(f=0; f<nfaces; f++){
+        tag = tags[f] ;
+#endif
+        if(tag < 0)
+            continue ;
+        /* With images, an agent may give several faces. */
+        for(j=0; images && j<n_neis && cell_neis[j] != tag; j++) ;
+        if(images && j<n_neis)
+            continue ;
+        cell_neis[n_neis] = tag ;
+        n_neis += 1 ;
+    }
+    for(i=0; i<n_neis; i++)
+        nei_pos[i] = ags[cell_neis[i]].get_pos() ;
+    num_cell_neis = n_neis ;
+    return n_neis ;
+}
+
+int Voronoi::clip_images(spp_real* pos, int n_agents, Agent* ags, int self){
+    int ia, i, im, nimg, rem ;
+    int kmax[DIM], k[DIM] ;
+    double n[DIM], r2, h2min = -1.0 ;
+    spp_real disp[DIM] ;
+    /* Every image but the nearest one is at least half a
+     * box length away along some periodic dimension. */
+    for(i=0; i<DIM; i++){
+        if(g->is_periodic(i) && (h2min < 0.0 || 0.25 * g->length(i) * g->length(i) < h2min))
+            h2min = 0.25 * g->length(i) * g->length(i) ;
+    }
+    if(h2min < 0.0 || 4.0 * maxr2 <= h2min)
+        return 0 ;
+    nimg = 1 ;
+    for(i=0; i<DIM; i++){
+        kmax[i] = g->is_periodic(i) ? (int) ceil( (2.0 * sqrt(maxr2) + 0.5 * g->length(i)) / g->length(i)) : 0 ;
+        nimg *= 2 * kmax[i] + 1 ;
+    }
+    for(ia=0; ia<n_agents; ia++){
+        /* The images of the agent itself give the faces of the box. */
+        if(ia == self)
+            continue ;
+        g->displacement(pos, ags[ia].get_pos(), disp) ;
+        for(im=0; im<nimg; im++){
+            rem = im ;
+            for(i=0; i<DIM; i++){
+                k[i] = rem % (2 * kmax[i] + 1) - kmax[i] ;
+                rem /= 2 * kmax[i] + 1 ;
+            }
+            r2 = 0.0 ;
+            for(i=0; i<DIM; i++){
+                n[i] = disp[i] + k[i] * g->length(i) ;
+                r2 += n[i] * n[i] ;
+            }
+            /* k = 0 is the nearest image, already clipped. */
+            if(r2 >= 4.0 * maxr2 || r2 <= 0.0 || im == nimg / 2)
+                continue ;
+            clip(n, 0.5 * r2, ia) ;
+        }
+    }
+    return 1 ;
+}
+
+#if DIM==2
+int Voronoi::clip(double* n, double c, int tag){
+    /* Sutherland-Hodgman clipping of a convex polygon by
+     * a half-plane. The edge leaving each output vertex keeps
+     * the tag of the edge it lies on, the edge along the
+     * bisector gets the new *tag*.
+     * The intersection point is always computed from the inside
+     * vertex to the outside one.
+     */
+    int i, j, nout = 0 ;
+    int cut = 0 ;
+    double s[VORO_MAXV] ;
+    double t, r2 ;
+    double *p, *q ;
+
+    for(i=0; i<nverts; i++){
+        s[i] = verts[2*i] * n[0] + verts[2*i+1] * n[1] - c ;
+        if(s[i] > 0.0)
+            cut = 1 ;
+    }
+    if(!cut)
+        return 0 ;
+    for(i=0; i<nverts; i++){
+        j = (i+1) % nverts ;
+        p = verts + 2*i ;
+        q = verts + 2*j ;
+        if(nout + 2 > VORO_MAXV){
+            fprintf(stderr,"libspp.Voronoi: ERROR - cell with too many edges.\n") ;
+            return 0 ;
+        }
+        if(s[i] <= 0.0){
+            tmp_verts[2*nout]   = p[0] ;
+            tmp_verts[2*nout+1] = p[1] ;
+            tmp_tags[nout] = tags[i] ;
+            nout += 1 ;
+            if(s[j] > 0.0){
+                t = s[i] / (s[i] - s[j]) ;
+                tmp_verts[2*nout]   = p[0] + t * (q[0] - p[0]) ;
+                tmp_verts[2*nout+1] = p[1] + t * (q[1] - p[1]) ;
+                tmp_tags[nout] = tag ;
+                nout += 1 ;
+            }
+        }else if(s[j] <= 0.0){
+            t = s[j] / (s[j] - s[i]) ;
+            tmp_verts[2*nout]   = q[0] + t * (p[0] - q[0]) ;
+            tmp_verts[2*nout+1] = q[1] + t * (p[1] - q[1]) ;
+            tmp_tags[nout] = tags[i] ;
+            nout += 1 ;
+        }
+    }
+    nverts = nout ;
+    maxr2 = 0.0 ;
+    for(i=0; i<nverts; i++){
+        verts[2*i]   = tmp_verts[2*i] ;
+        verts[2*i+1] = tmp_verts[2*i+1] ;
+        tags[i] = tmp_tags[i] ;
+        r2 = verts[2*i] * verts[2*i] + verts[2*i+1] * verts[2*i+1] ;
+        if(r2 > maxr2)
+            maxr2 = r2 ;
+    }
+    return 1 ;
+}
+#elif DIM==3
+int Voronoi::clip(double* n, double c, int tag){
+    /* Clip each face as a polygon (see the 2D version) and
+     * collect the intersection points, which are the vertices
+     * of the new face on the bisector plane. These are sorted
+     * by angle around their centroid to form the new face.
+     */
+    int f, i, j, k, nv, nout, nf = 0, ncap = 0, dup ;
+    int cut = 0 ;
+    double s[VORO_MAXFV] ;
+    double t, r2, ang[2*VORO_MAXF], u[3], w[3], cen[3], d[3], nn, tmp ;
+    double *p, *q, *out, *fv ;
+
+    for(f=0; f<nfaces && !cut; f++){
+        fv = verts + f*VORO_MAXFV*3 ;
+        for(i=0; i<fnverts[f]; i++){
+            if(fv[3*i] * n[0] + fv[3*i+1] * n[1] + fv[3*i+2] * n[2] > c){
+                cut = 1 ;
+                break ;
+            }
+        }
+    }
+    if(!cut)
+        return 0 ;
+
+    for(f=0; f<nfaces; f++){
+        fv = verts + f*VORO_MAXFV*3 ;
+        nv = fnverts[f] ;
+        for(i=0; i<nv; i++)
+            s[i] = fv[3*i] * n[0] + fv[3*i+1] * n[1] + fv[3*i+2] * n[2] - c ;
+        out = tmp_verts + nf*VORO_MAXFV*3 ;
+        nout = 0 ;
+        for(i=0; i<nv && nout+2 <= VORO_MAXFV; i++){
+            j = (i+1) % nv ;
+            p = fv + 3*i ;
+            q = fv + 3*j ;
+            if(s[i] <= 0.0){
+                for(k=0; k<3; k++)
+                    out[3*nout + k] = p[k] ;
+                nout += 1 ;
+                if(s[j] > 0.0){
+                    t = s[i] / (s[i] - s[j]) ;
+                    for(k=0; k<3; k++)
+                        out[3*nout + k] = p[k] + t * (q[k] - p[k]) ;
+                    if(ncap < 2*VORO_MAXF){
+                        for(k=0; k<3; k++)
+                            cap[3*ncap + k] = out[3*nout + k] ;
+                        ncap += 1 ;
+                    }
+                    nout += 1 ;
+                }
+            }else if(s[j] <= 0.0){
+                t = s[j] / (s[j] - s[i]) ;
+                for(k=0; k<3; k++)
+                    out[3*nout + k] = q[k] + t * (p[k] - q[k]) ;
+                if(ncap < 2*VORO_MAXF){
+                    for(k=0; k<3; k++)
+                        cap[3*ncap + k] = out[3*nout + k] ;
+                    ncap += 1 ;
+                }
+                nout += 1 ;
+            }
+        }
+        if(nout >= 3){
+            tmp_fnverts[nf] = nout ;
+            tmp_tags[nf] = tags[f] ;
+            nf += 1 ;
+        }
+    }
+
+    /* Remove the duplicated intersection points (each
+     * cut edge is shared by two faces). */
+    nv = 0 ;
+    for(i=0; i<ncap; i++){
+        dup = 0 ;
+        for(j=0; j<nv && !dup; j++){
+            tmp = 0.0 ;
+            for(k=0; k<3; k++)
+                tmp += (cap[3*i+k] - cap[3*j+k]) * (cap[3*i+k] - cap[3*j+k]) ;
+            if(tmp <= 1e-20 * maxr2)
+                dup = 1 ;
+        }
+        if(!dup){
+            for(k=0; k<3; k++)
+                cap[3*nv + k] = cap[3*i + k] ;
+            nv += 1 ;
+        }
+    }
+    if(nv >= 3 && nf < VORO_MAXF){
+        /* Orthonormal basis (u,w) of the plane. */
+        for(k=0; k<3; k++)
+            cen[k] = 0.0 ;
+        for(i=0; i<nv; i++)
+            for(k=0; k<3; k++)
+                cen[k] += cap[3*i + k] / nv ;
+        if(fabs(n[0]) < fabs(n[1])){
+            u[0] = 0.0 ; u[1] = n[2] ; u[2] = -n[1] ;
+        }else{
+            u[0] = n[2] ; u[1] = 0.0 ; u[2] = -n[0] ;
+        }
+        nn = sqrt(u[0]*u[0] + u[1]*u[1] + u[2]*u[2]) ;
+        for(k=0; k<3; k++)
+            u[k] /= nn ;
+        w[0] = n[1]*u[2] - n[2]*u[1] ;
+        w[1] = n[2]*u[0] - n[0]*u[2] ;
+        w[2] = n[0]*u[1] - n[1]*u[0] ;
+        for(i=0; i<nv; i++){
+            for(k=0; k<3; k++)
+                d[k] = cap[3*i + k] - cen[k] ;
+            ang[i] = atan2(d[0]*w[0] + d[1]*w[1] + d[2]*w[2],
+                           d[0]*u[0] + d[1]*u[1] + d[2]*u[2]) ;
+        }
+        /* Insertion sort, there are only a few points. */
+        out = tmp_verts + nf*VORO_MAXFV*3 ;
+        for(i=0; i<nv && i<VORO_MAXFV; i++){
+            for(j=i; j>0 && ang[j-1] > ang[j]; j--){
+                tmp = ang[j] ; ang[j] = ang[j-1] ; ang[j-1] = tmp ;
+                for(k=0; k<3; k++){
+                    tmp = cap[3*j+k] ; cap[3*j+k] = cap[3*(j-1)+k] ; cap[3*(j-1)+k] = tmp ;
+                }
+            }
+        }
+        for(i=0; i<nv && i<VORO_MAXFV; i++)
+            for(k=0; k<3; k++)
+                out[3*i + k] = cap[3*i + k] ;
+        tmp_fnverts[nf] = nv < VORO_MAXFV ? nv : VORO_MAXFV ;
+        tmp_tags[nf] = tag ;
+        nf += 1 ;
+    }
+
+    /* Swap the new cell in place and update maxr2. */
+    p = verts ; verts = tmp_verts ; tmp_verts = p ;
+    int* ip ;
+    ip = tags ; tags = tmp_tags ; tmp_tags = ip ;
+    ip = fnverts ; fnverts = tmp_fnverts ; tmp_fnverts = ip ;
+    nfaces = nf ;
+    maxr2 = 0.0 ;
+    for(f=0; f<nfaces; f++){
+        fv = verts + f*VORO_MAXFV*3 ;
+        for(i=0; i<fnverts[f]; i++){
+            r2 = fv[3*i]*fv[3*i] + fv[3*i+1]*fv[3*i+1] + fv[3*i+2]*fv[3*i+2] ;
+            if(r2 > maxr2)
+                maxr2 = r2 ;
+        }
+    }
+    return 1 ;
 }
+#endif
 
 /*
  * Network interaction
@@ -191,9 +1160,9 @@ int NoInteraction::get_neighbors(Agent* a0, int n_agents, Agent* ags, Agent** ne
 
 #define SWAP(a,b) { temp=(a);(a)=(b);(b)=temp; }
 
-double quickselect(double *arr, int n, int k) {
+spp_real quickselect(spp_real* arr, int n, int k) {
     int i,ir,j,l,mid;
-    double a,temp;
+    spp_real a,temp;
 
     l=0;
     ir=n-1;
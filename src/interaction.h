@@ -1,5 +1,7 @@
+#include "precision.h"
 #include <math.h>
 class Agent ;
+class Grid ;
 
 /*
  * Abstract Geometry class used as a template
@@ -16,18 +18,49 @@ class Agent ;
 
 class Geometry {
     public:
+        /* Box of unknown size: L and lengths are 0 until set. */
+        Geometry() ;
+        /* Cubic box of size *l*. */
+        Geometry(double l) ;
         /* pure virtual, must be implemented */
-        virtual void  displacement(double* x0, double* x1, double* dis) = 0 ;
+        virtual void  displacement(spp_real* x0, spp_real* x1, spp_real* dis) = 0 ;
         /* pure virtual, must be implemented */
-        virtual double distance2(double* x0, double* x1) = 0 ;
+        virtual spp_real distance2(spp_real* x0, spp_real* x1) = 0 ;
         /* Norm^2 of a vector *vect*.
          * Returns sum_i vect[i]*vect[i].
          */
-        double length2(double* vect) ;
-        /* Size of the computation box.
+        spp_real length2(spp_real* vect) ;
+        /* Set the lengths of the box along each dimension
+         * to the DIM values *ls* (L is set to the largest).
+         */
+        void set_lengths(double* ls) ;
+        /* Return the length of the box along dimension *d*:
+         * lengths[d], or L if the lengths were never set (a
+         * Geometry that only sets L is a cubic box).
+         */
+        double length(int d) {return lengths[d] > 0.0 ? lengths[d] : L;} ;
+        /* Return 1 if the geometry is periodic along
+         * dimension *d*, i.e. if the points have images
+         * at multiples of lengths[d] along it. By default
+         * it returns 0.
+         */
+        virtual int is_periodic(int d) {return 0;} ;
+        /* Size of the computation box, the largest
+         * of *lengths* if the box is not cubic.
          * May be ignored by some implementations.
          */
         double L ;
+        /* Length of the computation box along each
+         * dimension, all equal to L in a cubic box.
+         * May be ignored by some implementations.
+         * Use length() to read them.
+         */
+        double lengths[SPP_MAX_DIM] ;
+    protected:
+        /* 1 if all the lengths are equal to L, so that
+         * the implementations can use L alone.
+         */
+        int cubic ;
 } ;
 
 /*
@@ -66,6 +99,26 @@ class Interaction {
          * By default it does nothing.
          */
         virtual void look_around(Agent* a0 , int n_agents , Agent* ags) {};
+        /* Called by Community once per step, before the agents
+         * sense their neighbors, with the whole array of *n_agents*
+         * agents *ags*. Interactions that keep some state between
+         * steps (see Topologic::setup_reuse) use it to keep track
+         * of how much the agents moved. By default it does nothing.
+         */
+        virtual void prepare(int n_agents , Agent* ags) {};
+        /* Return a distance such that all the neighbors of an
+         * agent are closer than it, used to choose the size of
+         * the slots of a Grid (see Community::tune_grid), or 0
+         * if it is not known. By default it returns 0.
+         */
+        virtual double range() {return 0.0;} ;
+        /* Called by Community with prepare, with the Grid whose
+         * neighborhoods are given to get_neighbors, or NULL if
+         * there is none (or it is a HashGrid). Interactions that
+         * can skip whole slots of a neighborhood (see MetricCone)
+         * keep it. By default it does nothing.
+         */
+        virtual void set_grid(Grid* grid) {};
         /* Geometry used to measure distances between agents.
          */
         Geometry* g ;
@@ -85,17 +138,21 @@ class Cartesian: public Geometry {
         /* Stores the displacement from *x0* to *x1* in *dis*,
          *      dis = x1 - x0
          */
-        void  displacement(double* x0, double* x1, double* dis) ;
+        void  displacement(spp_real* x0, spp_real* x1, spp_real* dis) ;
         /* Returns the square of the distance between *x0* and *x1*.
          *  distance2 = |dis|^2 = sum_i |x1_i - x0_i|^2
          */
-        double distance2(double* x0, double* x1) ;
+        spp_real distance2(spp_real* x0, spp_real* x1) ;
 } ;
 
 /* Same as Cartesian but taking into account
  * periodic boundary conditions of the box.
  * The same boundary conditions apply in
- * all the dimensions.
+ * all the dimensions, but the box can be
+ * rectangular, with a different length
+ * along each dimension. In a cubic box
+ * only L is used, as in the original
+ * implementation.
  * The displacement between two points may
  * be shorter by "going through the wall",
  * i.e. using a mirror copy of either of
@@ -103,7 +160,12 @@ class Cartesian: public Geometry {
  */
 class CartesianPeriodic: public Geometry {
     public:
+        /* Cubic box of size *l*. */
         CartesianPeriodic(double l) ;
+        /* Rectangular box with the DIM
+         * lengths *ls* along each dimension.
+         */
+        CartesianPeriodic(double* ls) ;
         /* The displacement between *x0* and *x1* is
          * stored in *dis*. The displacement between *x0*
          * and *x1* is defined as the vector difference
@@ -113,12 +175,44 @@ class CartesianPeriodic: public Geometry {
          * In practice, it means to compute the x0-x1
          * for each axis and if the number is bigger
          * than L/2 substract L from it, and if it
-         * smaller than -L/2 add L to it.
+         * smaller than -L/2 add L to it, with L the
+         * length of the box along that axis.
          */
-        void  displacement(double* x0, double* x1, double* dis) ;
+        void  displacement(spp_real* x0, spp_real* x1, spp_real* dis) ;
         /* Norm2 of displacement.
          */
-        double distance2(double* x0, double* x1) ;
+        spp_real distance2(spp_real* x0, spp_real* x1) ;
+        /* Periodic along every dimension. Returns 1. */
+        int is_periodic(int d) {return 1;} ;
+} ;
+
+/* Cartesian geometry in a rectangular box with
+ * hard walls along some dimensions and periodic
+ * boundary conditions along the others, e.g.
+ * a channel periodic along x and walled along y.
+ * Along the walled dimensions the displacement
+ * is the vector difference, as in Cartesian, and
+ * along the periodic ones the shortest one, as
+ * in CartesianPeriodic.
+ */
+class CartesianWalled: public Geometry {
+    public:
+        /* Box with the DIM lengths *ls* and
+         * *periodic[i]* 1 if the dimension *i*
+         * is periodic or 0 if it has walls.
+         */
+        CartesianWalled(double* ls, int* periodic) ;
+        /* The displacement from *x0* to *x1* is
+         * stored in *dis* (see above).
+         */
+        void  displacement(spp_real* x0, spp_real* x1, spp_real* dis) ;
+        /* Norm2 of displacement.
+         */
+        spp_real distance2(spp_real* x0, spp_real* x1) ;
+        /* Returns periodic[d]. */
+        int is_periodic(int d) {return periodic[d];} ;
+        /* 1 if the dimension is periodic, 0 if it has walls. */
+        int periodic[SPP_MAX_DIM] ;
 } ;
 
 // Implementations of Interaction
@@ -154,8 +248,10 @@ class Metric : public Interaction {
         int is_neighbor(Agent* a0 , Agent* a1) ;
         /* Return the interaction radius. */
         double radius() ;
+        /* Return the interaction radius. */
+        double range() {return this->radius();} ;
     private:
-        double rad2 ;
+        spp_real rad2 ;
 } ;
 
 /*
@@ -174,11 +270,28 @@ class Metric : public Interaction {
  * to sort the distances and return the k-th
  * smallest.
  *
+ * Optionally, the neighbors can be reused between steps
+ * (see setup_reuse). On each full search the closest
+ * k+shell agents are stored together with the distance
+ * *r_out* to the closest agent left out of the list. If
+ * no agent moved more than *d* since then, the true
+ * neighbors are still in the list as long as the k-th
+ * distance in the list is smaller than r_out - 2d. This
+ * is checked on each call, and only when it fails the
+ * full search is done again, so that the result is always
+ * the same as without reuse.
+ *
+ */
+/* Factor applied to the measured distance to the k-th neighbor
+ * in Topologic::range, as the swarm may become sparser after
+ * the grid is tuned.
  */
+#define SPP_TOPOLOGIC_RANGE_MARGIN 1.25
+
 class Topologic : public Interaction {
     public:
-        Topologic() {};
-        Topologic(int k , Geometry* g, double* dd) ;
+        Topologic() {shell=0; max_rad2=0.0; last_max_rad2=0.0;};
+        Topologic(int k , Geometry* g, spp_real* dd) ;
         /* Copy A POINTER to the *k*
          * agents in *ags* closer to *a0* into *neis*.
          * Return the number of neighbors found
@@ -199,10 +312,304 @@ class Topologic : public Interaction {
         void look_around(Agent* a0 , int n_agents , Agent* ags) ;
         /* Return the outdegree = the number of neighbors. */
         int outdegree(){return k;} ;
+        /* Start reusing the neighbors between steps for a
+         * community of up to *max_agents* agents, keeping
+         * *shell* extra candidates per agent (shell>0).
+         * The larger the shell, the less often a full search
+         * is needed, but the more expensive is each check.
+         * The space for the lists is allocated here.
+         * Only the agents of the array given to prepare() (the
+         * Community's agents) are reused, and the neighbors
+         * returned point to that array. If used with a Grid, the
+         * slots must be large enough for the k+shell closest
+         * agents to be in the neighborhood.
+         */
+        void setup_reuse(int max_agents , int shell) ;
+        /* Stop reusing the neighbors and free the space
+         * allocated by setup_reuse().
+         */
+        void stop_reuse() ;
+        /* Track the maximum displacement of the agents since
+         * the previous call. Community calls this every step
+         * when sensing velocities; if the agents are moved
+         * outside of a Community it must be called by the user
+         * before get_neighbors(), otherwise the reused lists
+         * may be wrong. Does nothing else if reuse is not setup.
+         * It also starts a new step for range().
+         */
+        void prepare(int n_agents , Agent* ags) ;
+        /* Forget all the stored lists, forcing a full
+         * search for every agent in the next step.
+         */
+        void invalidate() ;
+        /* Return the number of full searches done since
+         * setup_reuse() was called.
+         */
+        long num_full_searches(){return full_searches;} ;
+        /* Return the largest distance to the k-th neighbor (or to
+         * the k+shell-th if reusing) found in the searches since the
+         * previous step, times SPP_TOPOLOGIC_RANGE_MARGIN so that it
+         * still holds in the next steps. 0 before the first search.
+         */
+        double range() ;
+    private:
+        /* Full search of the neighbors of *a0*, the agent
+         * *i0* of *agents*, storing its k+shell closest agents.
+         */
+        int full_search(int i0 , Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        int k ;
+        spp_real rad2 ;
+        spp_real* dists2 ;
+        /* Largest *rad2* of the searches of the current
+         * and of the previous step (see prepare).
+         */
+        spp_real max_rad2 ;
+        spp_real last_max_rad2 ;
+        /* Reuse state (see setup_reuse), *shell*=0 means
+         * no reuse. For each agent: the candidates *cands*
+         * (indices in *agents*, up to k+shell per agent)
+         * and how many *num_cands*, the distance to the first
+         * agent out of the list *r_out* and the accumulated
+         * displacement *drift* at the time of the search
+         * *drift_ref* (<0 if there is no valid list).
+         * *prev_pos* holds the positions at the previous step.
+         */
+        int shell ;
+        int max_agents ;
+        int num_agents ;
+        Agent* agents ;
+        int* cands ;
+        int* num_cands ;
+        spp_real* r_out ;
+        double* drift_ref ;
+        double drift ;
+        spp_real* prev_pos ;
+        spp_real* cand_dists2 ;
+        long full_searches ;
+} ;
+
+/*
+ * Metric and Topologic interactions with a limited field
+ * of view: agents do not see the others in a cone of total
+ * angle *blind_angle* behind them, around the direction
+ * opposite to their velocity (e.g. M_PI/2 for a blind cone
+ * of 90 degrees, 0 to see all around). The agent itself is
+ * always seen, and an agent at rest sees all around.
+ *
+ * The cone test uses the dot product of the displacement
+ * *dis* with the velocity *vel* of the agent, compared as
+ *      dis.vel >= c |dis| |vel|,  c = -cos(blind_angle/2)
+ * through the squares of both sides, so it needs no square
+ * root or trigonometric function per pair; |vel|^2 is computed
+ * once per agent. The test is done without branches in the same
+ * loop as the distance, with the displacement to the next
+ * candidate computed before using the current one (reading it
+ * right after it is written stalls the loop).
+ *
+ * With a Grid (given by the Community, see set_grid) the slots
+ * that lie entirely in the blind cone are skipped: the corners of
+ * the 3^DIM adjacent slots are tested once per agent, and a slot
+ * is skipped if all its corners are hidden, which is exact because
+ * the blind cone is convex. This needs blind_angle <= M_PI, and at
+ * least 4 slots along the periodic dimensions (with 3 an agent of
+ * an adjacent slot may be closer through the other side of the
+ * box); otherwise every candidate is tested. The corners are only
+ * tested for neighborhoods with 8 candidates per slot or more, as
+ * for fewer it costs more than it saves. In the checks of
+ * examples/vision/vision_grid.cpp (4096 agents, blind cone of 90
+ * degrees) TopologicCone costs 1.1 to 1.5 times Topologic, instead
+ * of 1.6 to 2.3 times testing every candidate, and MetricCone about
+ * the same as Metric.
+ */
+class MetricCone : public Interaction {
+    public:
+        MetricCone() {grid=NULL;};
+        MetricCone(double r , double blind_angle, Geometry* g) ;
+        /* Copy A POINTER to all the agents in *ags* whose
+         * distance2 to *a0* is less than or equal to *rad2*
+         * and that are out of its blind cone into *neis*.
+         * Return the number of neighbors found.
+         */
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        /* Return 1 if *a1* is within the radius and
+         * out of the blind cone of *a0*.
+         */
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        /* Return the interaction radius. */
+        double radius() {return sqrt(rad2);} ;
+        /* Return the interaction radius. */
+        double range() {return this->radius();} ;
+        /* Keep the Grid to skip the slots behind the agents. */
+        void set_grid(Grid* gr) {grid = gr;} ;
+    private:
+        /* Same as get_neighbors, testing all the candidates. */
+        int search(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        spp_real rad2 ;
+        spp_real cos_blind ;
+        Grid* grid ;
+} ;
+
+class TopologicCone : public Interaction {
+    public:
+        TopologicCone() {max_rad2=0.0; last_max_rad2=0.0; grid=NULL; seen=NULL; seen_size=0;};
+        /* *dd* is space for the distances to the
+         * candidates, as in Topologic.
+         */
+        TopologicCone(int k , double blind_angle, Geometry* g, spp_real* dd) ;
+        /* Copy A POINTER to the *k* agents in *ags* closer to
+         * *a0* out of its blind cone (plus *a0* itself) into
+         * *neis*, or all of them if there are fewer.
+         * Return the number of neighbors found.
+         */
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        /* Return 1 if *a1* is one of the neighbors of *a0*.
+         * WARNING: This requires a call to
+         * look_around() for each *a0*.
+         */
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        /* Computes the distance2 *rad2* to the k-th closest
+         * agent in the field of view of *a0*.
+         */
+        void look_around(Agent* a0 , int n_agents , Agent* ags) ;
+        /* Return the outdegree = the number of neighbors. */
+        int outdegree(){return k;} ;
+        /* Starts a new step for range(). */
+        void prepare(int n_agents , Agent* ags) ;
+        /* Same as Topologic::range. Note that the agents at the
+         * front of a group see few others, far away, so with a
+         * blind cone the range (and the cost of a Grid) can be
+         * much larger than for Topologic.
+         */
+        double range() ;
+        /* Keep the Grid to skip the slots behind the agents. */
+        void set_grid(Grid* gr) {grid = gr;} ;
     private:
+        /* Store in *dists2* and *seen* the distance2 to the
+         * agents in the field of view of *a0*, and a larger value
+         * for the rest (and for the slots skipped), and return
+         * how many are in view.
+         */
+        int visible_dists2(Agent* a0 , int n_agents , Agent* ags) ;
+        /* Same for the candidates *ags[i0:i1]*. */
+        int visible_dists2(Agent* a0 , int i0 , int i1 , Agent* ags) ;
         int k ;
-        double rad2 ;
-        double* dists2 ;
+        spp_real rad2 ;
+        spp_real* dists2 ;
+        spp_real max_rad2 ;
+        spp_real last_max_rad2 ;
+        spp_real cos_blind ;
+        Grid* grid ;
+        /* Copy of *dists2* kept by look_around, which reorders
+         * *dists2*, so that get_neighbors does not compute the
+         * distances again. Grows as needed.
+         */
+        spp_real* seen ;
+        int seen_size ;
+} ;
+
+/*
+ * Voronoi interaction: two agents are neighbors if their
+ * Voronoi cells share a face (an edge in 2D), i.e. if they
+ * are connected in the Delaunay triangulation of the agents'
+ * positions. As in Metric and Topologic, every agent is also
+ * a neighbor of itself.
+ * This interaction is NOT local (see Topologic).
+ *
+ * The Voronoi cell of *a0* is built starting from a cube
+ * (rectangle) centered at *a0*, with the box lengths of the
+ * geometry along its periodic dimensions and many times the
+ * extent of the candidates around *a0* along the others (open
+ * space or walls), and clipping it with the bisector plane
+ * (line) to each candidate agent, taken in order of increasing
+ * distance. The clipping stops as soon as the next candidate
+ * is further than twice the farthest vertex of the cell, since
+ * from there on no candidate can cut the cell. The candidates
+ * are taken at their nearest image, which is the only one
+ * closer than half a box length. If the cell reaches further
+ * than that (a small or sparse periodic box), the cell is also
+ * clipped with the other images of the candidates closer than
+ * twice its farthest vertex, along the dimensions where the
+ * geometry is periodic (see Geometry::is_periodic). The result
+ * is exact in a periodic box; in open space only the faces of
+ * the unbounded cells at the edge of the swarm that lie
+ * entirely beyond the starting cell (between agents aligned to
+ * about one part in a thousand) are missed. The cost per agent
+ * is O(m) for *m* candidates (plus a log(m) for each candidate
+ * actually tested), so that with a Grid a whole step costs O(N).
+ * As with Topologic, a Grid can only be used if the slots are
+ * large enough for all the Voronoi neighbors of an agent to
+ * be in its neighborhood.
+ *
+ * Space for *max_agents* candidates is allocated on
+ * initialization.
+ */
+class Voronoi : public Interaction {
+    public:
+        Voronoi() {};
+        /* Allocate the space to sort up to *max_agents*
+         * candidates and to store the cell.
+         */
+        Voronoi(Geometry* g, int max_agents) ;
+        /* Copy A POINTER to the agents in *ags* whose Voronoi
+         * cell shares a face with the one of *a0* into *neis*.
+         * Return the number of neighbors found.
+         */
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        /* Return 1 if *a1* is a Voronoi neighbor of *a0*.
+         * WARNING: This requires a call to
+         * look_around() for each *a0*.
+         */
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        /* Build the Voronoi cell of *a0* and store its
+         * neighbors so that is_neighbor() can be used.
+         */
+        void look_around(Agent* a0 , int n_agents , Agent* ags) ;
+    private:
+        /* Build the Voronoi cell of *a0* out of the candidates
+         * in *ags* and store the indices (in *ags*) of its
+         * neighbors in *cell_neis*. Return the number of neighbors.
+         */
+        int build_cell(Agent* a0 , int n_agents , Agent* ags) ;
+        /* Clip the current cell with the half-space x*n <= c,
+         * labeling the new face with *tag*. Return 1 if the cell
+         * was cut.
+         */
+        int clip(double* n, double c, int tag) ;
+        /* Clip the cell of the agent at *pos* with the images
+         * of the candidates other than the nearest one, if the
+         * cell is large enough for them to cut it. Return 1 if
+         * they were checked.
+         */
+        int clip_images(spp_real* pos, int n_agents, Agent* ags, int self) ;
+        int max_agents ;
+        /* Distance2 from *a0* to each candidate and
+         * a heap with the candidates' indices.
+         */
+        spp_real* dists2 ;
+        int* heap ;
+        /* Indices of the neighbors found in the last build_cell
+         * and their position pointers (used by is_neighbor).
+         */
+        int* cell_neis ;
+        spp_real** nei_pos ;
+        int num_cell_neis ;
+        /* Current cell, relative to the agent position.
+         * In 2D, a polygon with *nverts* vertices; *tags[i]* is
+         * the agent that generated the edge from vertex i to i+1.
+         * In 3D, *nfaces* polygonal faces, each with a tag and
+         * *fnverts[f]* vertices.
+         * *tmp_* arrays are used to build the clipped cell.
+         */
+        int nverts, nfaces ;
+        int *tags, *fnverts ;
+        double* verts ;
+        int *tmp_tags, *tmp_fnverts ;
+        double* tmp_verts ;
+        double* cap ;
+        /* Squared distance from the agent to the
+         * farthest vertex of the cell.
+         */
+        double maxr2 ;
 } ;
 
 /*
@@ -256,4 +663,4 @@ class NoInteraction : public Interaction {
  * The array *arr* IS modified by
  * this function.
  */
-double quickselect(double *arr, int n, int k) ;
+spp_real quickselect(spp_real* arr, int n, int k) ;
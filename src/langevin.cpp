@@ -0,0 +1,135 @@
+#include "langevin.h"
+#include "force.h"
+#include "random.h"
+
+void Langevin::init(Community* c, Force* f, double mu, double d){
+    com = c ;
+    force = f ;
+    mobility = mu ;
+    diffusion = d ;
+    num_agents = com->get_num_agents() ;
+    prop   = spp_community_alloc_space(num_agents) ;
+    forces = spp_community_alloc_space(num_agents) ;
+    xi     = spp_community_alloc_space(num_agents) ;
+    for(int i=0; i<num_agents*DIM; i++)
+        prop[i] = com->get_vel()[i] ;
+}
+
+void Langevin::sense_velocities(double dt, spp_real* vel_sensed){
+    int i ;
+    const spp_real mu = mobility ;
+    const spp_real amp = sqrt(2.0 * diffusion / dt) ;
+    this->propel(dt) ;
+    com->sense_forces(force, forces) ;
+    if(diffusion > 0.0){
+        for(i=0; i<num_agents; i++)
+            spp_random_normal_vector(xi + i*DIM) ;
+    }else{
+        for(i=0; i<num_agents*DIM; i++)
+            xi[i] = 0.0 ;
+    }
+    for(i=0; i<num_agents*DIM; i++)
+        vel_sensed[i] = prop[i] + mu * forces[i] + amp * xi[i] ;
+}
+
+double Langevin::order_parameter(double v0){
+    double mean[DIM] ;
+    double m2 = 0.0 ;
+    int i, ia ;
+    for(i=0; i<DIM; i++)
+        mean[i] = 0.0 ;
+    for(ia=0; ia<num_agents; ia++)
+        for(i=0; i<DIM; i++)
+            mean[i] += prop[ia*DIM + i] ;
+    for(i=0; i<DIM; i++)
+        m2 += mean[i] * mean[i] ;
+    return sqrt(m2) / num_agents / v0 ;
+}
+
+/*
+ * Active Brownian
+ */
+ActiveBrownian::ActiveBrownian(Community* c, Force* f, double vzero, double mu, double dr, double d){
+    int i, ia ;
+    double n2 ;
+    this->init(c, f, mu, d) ;
+    v0 = vzero ;
+    d_rot = dr ;
+    /* headings of norm v0 */
+    for(ia=0; ia<num_agents; ia++){
+        n2 = 0.0 ;
+        for(i=0; i<DIM; i++)
+            n2 += prop[ia*DIM + i] * prop[ia*DIM + i] ;
+        if(n2 > 0.0)
+            for(i=0; i<DIM; i++)
+                prop[ia*DIM + i] *= v0 / sqrt(n2) ;
+        else
+            spp_random_vector(prop + ia*DIM, v0) ;
+    }
+}
+
+void ActiveBrownian::propel(double dt){
+    int ia ;
+    const spp_real amp = sqrt(2.0 * d_rot * dt) ;
+#if DIM==2
+    spp_real theta, c, s, tmp ;
+    for(ia=0; ia<num_agents; ia++)
+        xi[ia] = amp * spp_random_normal() ;
+    for(ia=0; ia<num_agents; ia++){
+        theta = xi[ia] ;
+        c = cos(theta) ;
+        s = sin(theta) ;
+        tmp = c * prop[ia*2] - s * prop[ia*2 + 1] ;
+        prop[ia*2 + 1] = s * prop[ia*2] + c * prop[ia*2 + 1] ;
+        prop[ia*2] = tmp ;
+    }
+#else
+    int i ;
+    spp_real* e ;
+    spp_real* k ;
+    spp_real ke, k2, a, c, s ;
+    if(v0 == 0.0)
+        return ;
+    for(ia=0; ia<num_agents; ia++)
+        spp_random_normal_vector(xi + ia*DIM) ;
+    for(ia=0; ia<num_agents; ia++){
+        e = prop + ia*DIM ;
+        k = xi + ia*DIM ;
+        /* kick *k* perpendicular to the heading, applied as a
+         * rotation by amp |k| towards it to stay on the sphere
+         */
+        ke = 0.0 ;
+        for(i=0; i<DIM; i++) ke += k[i] * e[i] / v0 ;
+        k2 = 0.0 ;
+        for(i=0; i<DIM; i++){
+            k[i] -= ke * e[i] / v0 ;
+            k2 += k[i] * k[i] ;
+        }
+        if(k2 == 0.0)
+            continue ;
+        a = amp * sqrt(k2) ;
+        c = cos(a) ;
+        s = sin(a) * v0 / sqrt(k2) ;
+        for(i=0; i<DIM; i++) e[i] = c * e[i] + s * k[i] ;
+    }
+#endif
+}
+
+/*
+ * Active Ornstein-Uhlenbeck
+ */
+ActiveOU::ActiveOU(Community* c, Force* f, double vzero, double mu, double t, double d){
+    this->init(c, f, mu, d) ;
+    v0 = vzero ;
+    tau = t ;
+}
+
+void ActiveOU::propel(double dt){
+    int ia, i ;
+    const spp_real decay = exp(- dt / tau) ;
+    const spp_real amp = v0 * sqrt( (1.0 - decay * decay) / DIM ) ;
+    for(ia=0; ia<num_agents; ia++)
+        spp_random_normal_vector(xi + ia*DIM) ;
+    for(i=0; i<num_agents*DIM; i++)
+        prop[i] = decay * prop[i] + amp * xi[i] ;
+}
@@ -0,0 +1,120 @@
+#include "community.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+class Force ;
+
+/*
+ * Abstract Langevin class used as a template for
+ * continuous-time models of active particles in the
+ * overdamped limit, integrated with the Euler-Maruyama
+ * scheme: each agent moves during a time step *dt* with
+ * the velocity
+ *      vel = prop + mobility * F + sqrt(2 diffusion / dt) xi
+ * where *prop* is its self-propulsion velocity, *F* the
+ * total force of the other agents (see Force), and *xi*
+ * a vector of independent normal random numbers (the
+ * translational noise). The update of the self-propulsion
+ * defines the model, and must be implemented in:
+ *
+ *      propel: advance the self-propulsion of all the
+ *          agents during a time *dt*.
+ *
+ * The Langevin instance works on a Community, whose Grid
+ * (if set) is used to compute the forces. The velocities
+ * are sensed and then updated and the agents moved with
+ * the methods of the Community, as in the Vicsek model:
+ *
+ *      lang.sense_velocities(dt, v2) ;
+ *      com.update_velocities(v2) ;
+ *      com.periodic_move(dt) ;
+ *
+ * The Behavior of the agents is not used.
+ */
+class Langevin {
+    public:
+        /* pure virtual, must be implemented */
+        virtual void propel(double dt) = 0 ;
+        /* Advance the self-propulsion during *dt* (propel),
+         * compute the forces and store in *vel_sensed* the
+         * velocity of each agent during the step (see above).
+         * The last loop runs over the num_agents * DIM
+         * components at once, so the compiler can vectorize it.
+         */
+        void sense_velocities(double dt, spp_real* vel_sensed) ;
+        /* Return the array with the self-propulsion velocity
+         * of each agent (num_agents * DIM values).
+         */
+        spp_real* get_propulsion() {return prop;} ;
+        /* Return the array with the force on each agent
+         * computed in the last call to sense_velocities.
+         */
+        spp_real* get_forces() {return forces;} ;
+        /* Return the norm of the mean self-propulsion
+         * divided by *v0*, the polarization of the swarm.
+         */
+        double order_parameter(double v0) ;
+    protected:
+        /* Set the common parameters and allocate the
+         * arrays, with the self-propulsion set to the
+         * current velocities of the agents of *com*.
+         */
+        void init(Community* com, Force* force, double mobility, double diffusion) ;
+        Community* com ;
+        Force* force ;
+        int num_agents ;
+        double mobility ;
+        /* Translational diffusion coefficient. */
+        double diffusion ;
+        /* self-propulsion, forces and random numbers
+         *      Size: num_agents * DIM
+         */
+        spp_real* prop ;
+        spp_real* forces ;
+        spp_real* xi ;
+} ;
+
+/*
+ * Active Brownian particles: each agent moves
+ * with a constant speed *v0* along its heading,
+ * which diffuses on the unit sphere with the
+ * rotational diffusion coefficient *d_rot*, so
+ * that the persistence time is 1/((DIM-1) d_rot).
+ * In 2D the heading turns by a normal random angle
+ * of variance 2 d_rot dt per step; in 3D it turns
+ * towards a random kick with normal components of
+ * that variance perpendicular to it, by the norm
+ * of the kick.
+ * The initial headings are those of the velocities
+ * of the agents.
+ */
+class ActiveBrownian : public Langevin {
+    public:
+        ActiveBrownian(Community* com, Force* force, double v0, double mobility, double d_rot, double diffusion) ;
+        /* Rotate the headings by the rotational diffusion. */
+        void propel(double dt) ;
+    protected:
+        double v0 ;
+        double d_rot ;
+} ;
+
+/*
+ * Active Ornstein-Uhlenbeck particles: the
+ * self-propulsion velocity of each agent is an
+ * Ornstein-Uhlenbeck process with persistence time
+ * *tau* and mean squared norm *v0*^2,
+ *      d prop = - prop dt / tau + v0 sqrt(2 / (DIM tau)) dW
+ * updated with its exact solution over each step, so
+ * that any *dt* can be used. The initial self-propulsion
+ * is the velocities of the agents.
+ */
+class ActiveOU : public Langevin {
+    public:
+        ActiveOU(Community* com, Force* force, double v0, double mobility, double tau, double diffusion) ;
+        /* Advance the Ornstein-Uhlenbeck processes. */
+        void propel(double dt) ;
+    protected:
+        double v0 ;
+        double tau ;
+} ;
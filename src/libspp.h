@@ -0,0 +1,3723 @@
+/*
+ * Floating point type used to store and operate on
+ * positions, velocities and distances in libspp.
+ *
+ * By default it is double. Compiling with -DSPP_SINGLE
+ * (and linking against libspp2df.a or libspp3df.a instead
+ * of libspp2d.a or libspp3d.a) switches it to float, which
+ * halves the memory used by the big arrays and doubles the
+ * number of values per SIMD instruction.
+ * Statistical quantities (means, order parameter,
+ * correlations) are accumulated in double in both cases.
+ *
+ * Arrays meant to be passed to the library should be
+ * declared as spp_real* (e.g. the result of
+ * spp_community_alloc_space) so that the same code compiles
+ * for both precisions.
+ */
+#ifdef SPP_SINGLE
+typedef float spp_real ;
+#else
+typedef double spp_real ;
+#endif
+
+/*
+ * Largest number of dimensions, to size the per-dimension
+ * arrays (e.g. the box lengths) of the classes declared in
+ * the headers, which must not depend on DIM.
+ */
+#define SPP_MAX_DIM 3
+/* Interface to generate random numbers in libspp.
+ * spp_set_seed must be called before getting random
+ * numbers, or one will get a segmentation fault
+ * due to an unallocated pointer.
+ *
+ * The implementation of random numbers is taken from
+ *      http://people.sc.fsu.edu/~jburkardt/c_src/ziggurat/ziggurat.html
+ *  (modifications: remove several functions and change float->double)
+ *
+ * Reference:
+ *      George Marsaglia, Wai Wan Tsang,
+ *      The Ziggurat Method for Generating Random Variables,
+ *      Journal of Statistical Software,
+ *      Volume 5, Number 8, October 2000, seven pages.
+ */
+
+
+
+/* Set the seed value and execute
+ * any pre-computation needed to set
+ * up the random number generator.
+ * This function must be called before
+ * using any of the spp_random_*.
+ * The generator is shared by all the
+ * threads that do not use their own
+ * stream (see spp_use_rng).
+ */
+void spp_set_seed(long int s) ;
+
+/* State of an independent stream of random
+ * numbers (the 32 bits of the shr3 generator),
+ * used to give each of several simulations run
+ * concurrently (e.g. the replicas of an Ensemble)
+ * its own sequence.
+ */
+typedef unsigned int spp_rng ;
+/* Seed the stream *rng* with *s*. The first call
+ * also does the pre-computation of spp_set_seed,
+ * which is shared by all the streams, so it must
+ * not run while other threads generate numbers.
+ */
+void spp_rng_seed(spp_rng* rng, long int s) ;
+/* Make the spp_random_* functions called from
+ * the calling thread draw from the stream *rng*,
+ * or from the shared generator again if *rng* is
+ * NULL (the default in every thread). A stream
+ * must only be used by one thread at a time.
+ */
+void spp_use_rng(spp_rng* rng) ;
+/* Return a normal (gaussian) random
+ * number with mean 0 and standard deviation 1.
+ * Requires the previous execution of spp_set_seed().
+ */
+double spp_random_normal() ;
+/* Return a uniform random number
+ * between 0 and 1.
+ * Requires the previous execution of spp_set_seed().
+ */
+double spp_random_uniform() ;
+/* Set the components of *vec* to a set of
+ * i.i.d. random normal (gaussian) numbers
+ * with mean 0 and standard deviation 1.
+ */
+void spp_random_normal_vector(spp_real* vec) ;
+/* Set the array *vec* to a random vector with
+ * norm *norm* and homogeneous angular distribution.
+ */
+void spp_random_vector(spp_real* vec, double norm) ;
+
+/*
+ * Instrumentation of the hot paths of libspp, to know where the
+ * time of a step goes. It is compiled in only if the library is
+ * compiled with -DSPP_PROFILE (see the Makefile); otherwise the
+ * SPP_PROFILE_* macros are empty and cost nothing.
+ *
+ * The counters are per thread (like the stream of spp_use_rng),
+ * so a Community (or an Ensemble replica) counts the work done in
+ * the thread that runs it. The threads of DomainCommunity keep
+ * their own counters, not reported by the main thread.
+ *
+ * Phases timed (wall time, in seconds):
+ *      SPP_PHASE_GRID_FILL     Community::fill_grid
+ *      SPP_PHASE_SENSE         sensing the velocities (or the
+ *                              forces), including the neighbor
+ *                              search (but not the noise added
+ *                              in batches)
+ *      SPP_PHASE_NOISE         Behavior::add_noise
+ *      SPP_PHASE_MOVE          Community::move and periodic_move
+ *      SPP_PHASE_OBSERVABLES   order parameter, correlations,
+ *                              fields and clusters
+ * Each phase is timed as a whole, never per agent, so that
+ * reading the clock does not add to the time measured.
+ * The neighbor search is not timed apart from SENSE, since
+ * it is interleaved with the rest of the sensing.
+ *
+ * Counted:
+ *      searches        agents that sensed their neighbors
+ *      candidates      agents they checked, e.g. the agents
+ *                      in the neighborhood of the Grid
+ *      neighbors       neighbors accepted
+ *      grid_fills      Grid rebuilds
+ * The searches and candidates are counted by the sensing loops
+ * of Community (and of the domains of DomainCommunity), so they
+ * are right for any Behavior. The neighbors accepted are only
+ * known inside the behavior, and are counted by the behaviors
+ * of the library, by the forces in Community::sense_forces and
+ * by LongRangeAlignment (the terms summed, out of all the
+ * pairs). A Behavior defined outside the library does not count
+ * them. ReplicaCommunity is not instrumented.
+ */
+#define SPP_PHASE_GRID_FILL    0
+#define SPP_PHASE_SENSE        1
+#define SPP_PHASE_NOISE        2
+#define SPP_PHASE_MOVE         3
+#define SPP_PHASE_OBSERVABLES  4
+#define SPP_NUM_PHASES         5
+
+struct SppProfile {
+    double time[SPP_NUM_PHASES] ;
+    long int calls[SPP_NUM_PHASES] ;
+    long int candidates ;
+    long int neighbors ;
+    long int searches ;
+    long int grid_fills ;
+} ;
+
+/* Counters of this thread. */
+extern thread_local SppProfile spp_profile ;
+
+#ifdef SPP_PROFILE
+#define SPP_PROFILE_START(t) double t = spp_profile_clock()
+#define SPP_PROFILE_STOP(t, phase) spp_profile_add(phase, spp_profile_clock() - t)
+#define SPP_PROFILE_COUNT(counter, n) (spp_profile.counter += (n))
+#else
+#define SPP_PROFILE_START(t)
+#define SPP_PROFILE_STOP(t, phase)
+#define SPP_PROFILE_COUNT(counter, n)
+#endif
+
+/* Return 1 if the library was compiled with -DSPP_PROFILE. */
+int spp_profile_enabled() ;
+/* Return a monotonic wall time, in seconds. */
+double spp_profile_clock() ;
+/* Add the time *t* to the phase *phase*, and one call. */
+void spp_profile_add(int phase, double t) ;
+/* Set all the counters of this thread to zero. */
+void spp_profile_reset() ;
+/* Print the counters of this thread to *out* as a table of
+ * comments, with the time per phase, the fraction of the total,
+ * and the neighbors accepted per search and per candidate.
+ */
+void spp_profile_print(FILE* out) ;
+/* Print the counters of this thread to *out* in one line
+ * of JSON, for scripts.
+ */
+void spp_profile_dump(FILE* out) ;
+class Behavior ;
+
+/*
+ * Class describing one self-propagating agent
+ * perfoming multi-agent consensus.
+ * Mostly a placeholder for ease of use, the
+ * algorithms for the consesus protocol are
+ * defined by the Behavior class.
+ *
+ * This class can be used alone to simulate
+ * multi-agent consensus, but for most uses
+ * the class Community is a useful wrapper
+ * to control a large amount of agents.
+ *
+ *      pos =   position of agent.
+ *      vel =   velocity of agent.
+ *      neis =  space to allocate a list
+ *              of neighbors of the agent.
+ *      beh =   Behavior instance containing
+ *              the consensus protocol.
+ *
+ * WARNING: Expanding on Agent by creating a
+ * class that inherits from it can lead to
+ * errors if the size of the new class is
+ * different from Agent. The reason is that
+ * Agent uses a **Agent to store the neighbors,
+ * and an array of pointers don't work very
+ * well with inheriting classes.
+ * For that reason the behavior of Agent is
+ * almost exclusively determined by its
+ * Behavior instance. Creating new behaviors
+ * that inherit from Behavior is perfectly
+ * fine.
+ *
+ */
+class Agent {
+    public:
+        Agent() {} ;
+        Agent(spp_real* pos, spp_real* vel, Agent** nn, Behavior* bb) ;
+        /* Update the agent position according to its velocity,
+         *  pos += dt * vel
+         */
+        void move( double dt) ;
+        /* Set the velocity of the agent to *new_vel*
+         * (copy the values, not the pointer)
+         */
+        void update_vel(spp_real* new_vel) ;
+        /* Return position */
+        spp_real* get_pos() ;
+        /* Return velocity */
+        spp_real* get_vel() ;
+        /* Return array of neighbors */
+        Agent** get_neis() ;
+        /* Return the pointer to the behavior */
+        Behavior* get_behavior() ;
+        /* Changes the pos pointer of the agent. */
+        void set_pos(spp_real* p) ;
+        /* Changes the vel pointer of the agent. */
+        void set_vel(spp_real* v) ;
+        /* Changes the behavior of the agent. */
+        void set_behavior(Behavior* beh) ;
+        /* Turn the agent into a copy
+         * of *ag*. The agent and *ag*
+         * are still independen
+         * The behavior instance is copied.
+         * TODO: Check if that is always safe.
+         * If both agent share the same behavior
+         * that copies to and from the same
+         * memory space.
+         */
+        void copy(Agent* ag) ;
+        /* Get the distance from agent to *point*
+         */
+        spp_real distance2(spp_real* point) ;
+        /* Return 1 if *nei* is a neighbor
+         * of the agent.
+         */
+        int is_neighbor(Agent* nei) ;
+        /* Call the beh->inter->look_around()
+         * method for non-local interactions.
+         */
+        void look_around(int n_agents, Agent* ags) ;
+        /* Copy A POINTER to all the
+         * agents in *ags* that are neighbors
+         * of the agent into *neis*.
+         */
+        int get_neighbors(int n_agents, Agent* ags) ;
+        /* Store the sensed velocity in *new_vel*.
+         * Defined by the Behavior *beh*.
+         */
+        void sense_velocity(int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Same as sense_velocity but using
+         * the sense_noisy_velocity function from *beh*.
+         */
+        void sense_noisy_velocity(int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Same as sense_velocity but using
+         * the sense_danger function from *beh*.
+         */
+        int sense_danger(int num_threats, Agent* threats, spp_real* new_vel) ;
+        /* Call the sense_victims function in *beh*. */
+        int sense_victims(int num_agents, Agent* ags) ;
+        /* Call the hunt function in *beh*. */
+        int hunt(Agent* prey, double deltat) ;
+        /* Call the randomize_velocity in *beh*. */
+        void randomize_velocity() ;
+    protected:
+        /* position of the agent */
+        spp_real* pos ;
+        /* velocity of the agent */
+        spp_real* vel ;
+        /* neighbors of the agent */
+        Agent** neis ;
+        /* behavior (consensus protocol)
+         * of the agent. */
+        Behavior* beh ;
+} ;
+class Agent ;
+class Grid ;
+
+/*
+ * Abstract Geometry class used as a template
+ * for different Geometry implementations.
+ * Every implementation defines a geometry
+ * where the agents move, and must implement:
+ *
+ *      displacement: a rule to determine
+ *          the displacement (vector) between
+ *          two points.
+ *      distance2: a rule to determine the
+ *          distance^2 (scalar) between two points.
+ */
+
+class Geometry {
+    public:
+        /* Box of unknown size: L and lengths are 0 until set. */
+        Geometry() ;
+        /* Cubic box of size *l*. */
+        Geometry(double l) ;
+        /* pure virtual, must be implemented */
+        virtual void  displacement(spp_real* x0, spp_real* x1, spp_real* dis) = 0 ;
+        /* pure virtual, must be implemented */
+        virtual spp_real distance2(spp_real* x0, spp_real* x1) = 0 ;
+        /* Norm^2 of a vector *vect*.
+         * Returns sum_i vect[i]*vect[i].
+         */
+        spp_real length2(spp_real* vect) ;
+        /* Set the lengths of the box along each dimension
+         * to the DIM values *ls* (L is set to the largest).
+         */
+        void set_lengths(double* ls) ;
+        /* Return the length of the box along dimension *d*:
+         * lengths[d], or L if the lengths were never set (a
+         * Geometry that only sets L is a cubic box).
+         */
+        double length(int d) {return lengths[d] > 0.0 ? lengths[d] : L;} ;
+        /* Return 1 if the geometry is periodic along
+         * dimension *d*, i.e. if the points have images
+         * at multiples of lengths[d] along it. By default
+         * it returns 0.
+         */
+        virtual int is_periodic(int d) {return 0;} ;
+        /* Size of the computation box, the largest
+         * of *lengths* if the box is not cubic.
+         * May be ignored by some implementations.
+         */
+        double L ;
+        /* Length of the computation box along each
+         * dimension, all equal to L in a cubic box.
+         * May be ignored by some implementations.
+         * Use length() to read them.
+         */
+        double lengths[SPP_MAX_DIM] ;
+    protected:
+        /* 1 if all the lengths are equal to L, so that
+         * the implementations can use L alone.
+         */
+        int cubic ;
+} ;
+
+/*
+ * Abstract Interaction class used as a template
+ * for different Interaciton implementations.
+ * Each implementation defines a way to determine
+ * which agents are connected or "neighbors",
+ * and must implement:
+ *
+ *      get_neighbors: select the neighbors of
+ *          *a0* out of a list of *n_agents* agents
+ *          stored in *ags*. Store a list of pointers
+ *          to the neighbors (NOT a copy of them)
+ *          in *neis*.
+ *          Return the number of neighbors found.
+ *      is_neighbor: return 1 if *a1* is a neighbor
+ *          of *a0*, 0 otherwise.Note that this relation
+ *          is not symmetric in general.
+ *          A call to look_around() may be needed
+ *          before using this function.
+ *
+ */
+
+class Interaction {
+    public:
+        /* pure virtual, must be implemented */
+        virtual int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) = 0 ;
+        /* pure virtual, must be implemented */
+        virtual int is_neighbor(Agent* a0 , Agent* a1) = 0 ;
+        /* Auxiliary function designed for interactions that
+         * are not local, meaning interactions where
+         * is_neighbor(a,b) does NOT only depend on *a*
+         * and *b*, such as topologic interaction.
+         * This function can be called to setup whatever
+         * is needed for the interaction to work as a local one.
+         * By default it does nothing.
+         */
+        virtual void look_around(Agent* a0 , int n_agents , Agent* ags) {};
+        /* Called by Community once per step, before the agents
+         * sense their neighbors, with the whole array of *n_agents*
+         * agents *ags*. Interactions that keep some state between
+         * steps (see Topologic::setup_reuse) use it to keep track
+         * of how much the agents moved. By default it does nothing.
+         */
+        virtual void prepare(int n_agents , Agent* ags) {};
+        /* Return a distance such that all the neighbors of an
+         * agent are closer than it, used to choose the size of
+         * the slots of a Grid (see Community::tune_grid), or 0
+         * if it is not known. By default it returns 0.
+         */
+        virtual double range() {return 0.0;} ;
+        /* Called by Community with prepare, with the Grid whose
+         * neighborhoods are given to get_neighbors, or NULL if
+         * there is none (or it is a HashGrid). Interactions that
+         * can skip whole slots of a neighborhood (see MetricCone)
+         * keep it. By default it does nothing.
+         */
+        virtual void set_grid(Grid* grid) {};
+        /* Geometry used to measure distances between agents.
+         */
+        Geometry* g ;
+} ;
+
+ //Implementations of Geometry
+
+/* Cartesian geometry, the displacement
+ * between two points is the vector
+ * difference, and the distance2 is the
+ * norm^2 of that vector.
+ * This geometry ignores the box size.
+ */
+class Cartesian: public Geometry {
+    public:
+        Cartesian(double l) ;
+        /* Stores the displacement from *x0* to *x1* in *dis*,
+         *      dis = x1 - x0
+         */
+        void  displacement(spp_real* x0, spp_real* x1, spp_real* dis) ;
+        /* Returns the square of the distance between *x0* and *x1*.
+         *  distance2 = |dis|^2 = sum_i |x1_i - x0_i|^2
+         */
+        spp_real distance2(spp_real* x0, spp_real* x1) ;
+} ;
+
+/* Same as Cartesian but taking into account
+ * periodic boundary conditions of the box.
+ * The same boundary conditions apply in
+ * all the dimensions, but the box can be
+ * rectangular, with a different length
+ * along each dimension. In a cubic box
+ * only L is used, as in the original
+ * implementation.
+ * The displacement between two points may
+ * be shorter by "going through the wall",
+ * i.e. using a mirror copy of either of
+ * the points.
+ */
+class CartesianPeriodic: public Geometry {
+    public:
+        /* Cubic box of size *l*. */
+        CartesianPeriodic(double l) ;
+        /* Rectangular box with the DIM
+         * lengths *ls* along each dimension.
+         */
+        CartesianPeriodic(double* ls) ;
+        /* The displacement between *x0* and *x1* is
+         * stored in *dis*. The displacement between *x0*
+         * and *x1* is defined as the vector difference
+         * between *x0* or any of its mirror copies
+         * and *x1* or any of its mirror copies such that
+         * it yields the minimal distance2.
+         * In practice, it means to compute the x0-x1
+         * for each axis and if the number is bigger
+         * than L/2 substract L from it, and if it
+         * smaller than -L/2 add L to it, with L the
+         * length of the box along that axis.
+         */
+        void  displacement(spp_real* x0, spp_real* x1, spp_real* dis) ;
+        /* Norm2 of displacement.
+         */
+        spp_real distance2(spp_real* x0, spp_real* x1) ;
+        /* Periodic along every dimension. Returns 1. */
+        int is_periodic(int d) {return 1;} ;
+} ;
+
+/* Cartesian geometry in a rectangular box with
+ * hard walls along some dimensions and periodic
+ * boundary conditions along the others, e.g.
+ * a channel periodic along x and walled along y.
+ * Along the walled dimensions the displacement
+ * is the vector difference, as in Cartesian, and
+ * along the periodic ones the shortest one, as
+ * in CartesianPeriodic.
+ */
+class CartesianWalled: public Geometry {
+    public:
+        /* Box with the DIM lengths *ls* and
+         * *periodic[i]* 1 if the dimension *i*
+         * is periodic or 0 if it has walls.
+         */
+        CartesianWalled(double* ls, int* periodic) ;
+        /* The displacement from *x0* to *x1* is
+         * stored in *dis* (see above).
+         */
+        void  displacement(spp_real* x0, spp_real* x1, spp_real* dis) ;
+        /* Norm2 of displacement.
+         */
+        spp_real distance2(spp_real* x0, spp_real* x1) ;
+        /* Returns periodic[d]. */
+        int is_periodic(int d) {return periodic[d];} ;
+        /* 1 if the dimension is periodic, 0 if it has walls. */
+        int periodic[SPP_MAX_DIM] ;
+} ;
+
+// Implementations of Interaction
+
+/*
+ *  Metric interaction: two agents are neighbors
+ *  if the distance2 between their positions
+ *  (defined by the geometry) is less than or
+ *  equal to *rad2*.
+ *  For clarity, a radius *r* is given at
+ *  initialization which is then squared,
+ *  i.e. rad2 = r*r .
+ *  This interaction is local and symmetric.
+ *
+ */
+class Metric : public Interaction {
+    public:
+        Metric() {};
+        /* Initialization reads a radius *r*
+         * and stores its square in *rad2*.
+         */
+        Metric(double r , Geometry* g) ;
+        /* Copy A POINTER to all the
+         * agents in *ags* whose distance2
+         * to *a0* is less than or equal to *rad2*
+         * into *neis*.
+         * Return the number of neighbors found.
+         */
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        /* Return 1 if the distance2 between *a0*
+         * and *a1* is less than or equal to *rad2*.
+         */
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        /* Return the interaction radius. */
+        double radius() ;
+        /* Return the interaction radius. */
+        double range() {return this->radius();} ;
+    private:
+        spp_real rad2 ;
+} ;
+
+/*
+ * Topologic interaction: an agent's neighbors
+ * are the *k*-closest agents as determined
+ * by distance2 from the geometry.
+ * This interaction is NOT local as in NOT
+ * symmetric. Because it is not local, a
+ * call to look_around() is required before
+ * using is_neighbor(a0,a1) for each a0.
+ *
+ * This class requires memory to store the
+ * distances to the agents in *dists2*.
+ * This memory is NOT allocated on initialization.
+ * Also requires a quickselect implementation
+ * to sort the distances and return the k-th
+ * smallest.
+ *
+ * Optionally, the neighbors can be reused between steps
+ * (see setup_reuse). On each full search the closest
+ * k+shell agents are stored together with the distance
+ * *r_out* to the closest agent left out of the list. If
+ * no agent moved more than *d* since then, the true
+ * neighbors are still in the list as long as the k-th
+ * distance in the list is smaller than r_out - 2d. This
+ * is checked on each call, and only when it fails the
+ * full search is done again, so that the result is always
+ * the same as without reuse.
+ *
+ */
+/* Factor applied to the measured distance to the k-th neighbor
+ * in Topologic::range, as the swarm may become sparser after
+ * the grid is tuned.
+ */
+#define SPP_TOPOLOGIC_RANGE_MARGIN 1.25
+
+class Topologic : public Interaction {
+    public:
+        Topologic() {shell=0; max_rad2=0.0; last_max_rad2=0.0;};
+        Topologic(int k , Geometry* g, spp_real* dd) ;
+        /* Copy A POINTER to the *k*
+         * agents in *ags* closer to *a0* into *neis*.
+         * Return the number of neighbors found
+         * (should always be min(k,n_agents) ).
+         */
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        /* Return 1 if *a1* is one of the *k*
+         * closest agents to *a0*.
+         * WARNING: This requires a call to
+         * look_around() for each *a0*.
+         */
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        /* Computes the effective radius *rad2*
+         * of the agent *a0* (the distance2
+         * to the k-th closest agent) so that *is_neighbor*
+         * can work as in the Metric case.
+         */
+        void look_around(Agent* a0 , int n_agents , Agent* ags) ;
+        /* Return the outdegree = the number of neighbors. */
+        int outdegree(){return k;} ;
+        /* Start reusing the neighbors between steps for a
+         * community of up to *max_agents* agents, keeping
+         * *shell* extra candidates per agent (shell>0).
+         * The larger the shell, the less often a full search
+         * is needed, but the more expensive is each check.
+         * The space for the lists is allocated here.
+         * Only the agents of the array given to prepare() (the
+         * Community's agents) are reused, and the neighbors
+         * returned point to that array. If used with a Grid, the
+         * slots must be large enough for the k+shell closest
+         * agents to be in the neighborhood.
+         */
+        void setup_reuse(int max_agents , int shell) ;
+        /* Stop reusing the neighbors and free the space
+         * allocated by setup_reuse().
+         */
+        void stop_reuse() ;
+        /* Track the maximum displacement of the agents since
+         * the previous call. Community calls this every step
+         * when sensing velocities; if the agents are moved
+         * outside of a Community it must be called by the user
+         * before get_neighbors(), otherwise the reused lists
+         * may be wrong. Does nothing else if reuse is not setup.
+         * It also starts a new step for range().
+         */
+        void prepare(int n_agents , Agent* ags) ;
+        /* Forget all the stored lists, forcing a full
+         * search for every agent in the next step.
+         */
+        void invalidate() ;
+        /* Return the number of full searches done since
+         * setup_reuse() was called.
+         */
+        long num_full_searches(){return full_searches;} ;
+        /* Return the largest distance to the k-th neighbor (or to
+         * the k+shell-th if reusing) found in the searches since the
+         * previous step, times SPP_TOPOLOGIC_RANGE_MARGIN so that it
+         * still holds in the next steps. 0 before the first search.
+         */
+        double range() ;
+    private:
+        /* Full search of the neighbors of *a0*, the agent
+         * *i0* of *agents*, storing its k+shell closest agents.
+         */
+        int full_search(int i0 , Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        int k ;
+        spp_real rad2 ;
+        spp_real* dists2 ;
+        /* Largest *rad2* of the searches of the current
+         * and of the previous step (see prepare).
+         */
+        spp_real max_rad2 ;
+        spp_real last_max_rad2 ;
+        /* Reuse state (see setup_reuse), *shell*=0 means
+         * no reuse. For each agent: the candidates *cands*
+         * (indices in *agents*, up to k+shell per agent)
+         * and how many *num_cands*, the distance to the first
+         * agent out of the list *r_out* and the accumulated
+         * displacement *drift* at the time of the search
+         * *drift_ref* (<0 if there is no valid list).
+         * *prev_pos* holds the positions at the previous step.
+         */
+        int shell ;
+        int max_agents ;
+        int num_agents ;
+        Agent* agents ;
+        int* cands ;
+        int* num_cands ;
+        spp_real* r_out ;
+        double* drift_ref ;
+        double drift ;
+        spp_real* prev_pos ;
+        spp_real* cand_dists2 ;
+        long full_searches ;
+} ;
+
+/*
+ * Metric and Topologic interactions with a limited field
+ * of view: agents do not see the others in a cone of total
+ * angle *blind_angle* behind them, around the direction
+ * opposite to their velocity (e.g. M_PI/2 for a blind cone
+ * of 90 degrees, 0 to see all around). The agent itself is
+ * always seen, and an agent at rest sees all around.
+ *
+ * The cone test uses the dot product of the displacement
+ * *dis* with the velocity *vel* of the agent, compared as
+ *      dis.vel >= c |dis| |vel|,  c = -cos(blind_angle/2)
+ * through the squares of both sides, so it needs no square
+ * root or trigonometric function per pair; |vel|^2 is computed
+ * once per agent. The test is done without branches in the same
+ * loop as the distance, with the displacement to the next
+ * candidate computed before using the current one (reading it
+ * right after it is written stalls the loop).
+ *
+ * With a Grid (given by the Community, see set_grid) the slots
+ * that lie entirely in the blind cone are skipped: the corners of
+ * the 3^DIM adjacent slots are tested once per agent, and a slot
+ * is skipped if all its corners are hidden, which is exact because
+ * the blind cone is convex. This needs blind_angle <= M_PI, and at
+ * least 4 slots along the periodic dimensions (with 3 an agent of
+ * an adjacent slot may be closer through the other side of the
+ * box); otherwise every candidate is tested. The corners are only
+ * tested for neighborhoods with 8 candidates per slot or more, as
+ * for fewer it costs more than it saves. In the checks of
+ * examples/vision/vision_grid.cpp (4096 agents, blind cone of 90
+ * degrees) TopologicCone costs 1.1 to 1.5 times Topologic, instead
+ * of 1.6 to 2.3 times testing every candidate, and MetricCone about
+ * the same as Metric.
+ */
+class MetricCone : public Interaction {
+    public:
+        MetricCone() {grid=NULL;};
+        MetricCone(double r , double blind_angle, Geometry* g) ;
+        /* Copy A POINTER to all the agents in *ags* whose
+         * distance2 to *a0* is less than or equal to *rad2*
+         * and that are out of its blind cone into *neis*.
+         * Return the number of neighbors found.
+         */
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        /* Return 1 if *a1* is within the radius and
+         * out of the blind cone of *a0*.
+         */
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        /* Return the interaction radius. */
+        double radius() {return sqrt(rad2);} ;
+        /* Return the interaction radius. */
+        double range() {return this->radius();} ;
+        /* Keep the Grid to skip the slots behind the agents. */
+        void set_grid(Grid* gr) {grid = gr;} ;
+    private:
+        /* Same as get_neighbors, testing all the candidates. */
+        int search(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        spp_real rad2 ;
+        spp_real cos_blind ;
+        Grid* grid ;
+} ;
+
+class TopologicCone : public Interaction {
+    public:
+        TopologicCone() {max_rad2=0.0; last_max_rad2=0.0; grid=NULL; seen=NULL; seen_size=0;};
+        /* *dd* is space for the distances to the
+         * candidates, as in Topologic.
+         */
+        TopologicCone(int k , double blind_angle, Geometry* g, spp_real* dd) ;
+        /* Copy A POINTER to the *k* agents in *ags* closer to
+         * *a0* out of its blind cone (plus *a0* itself) into
+         * *neis*, or all of them if there are fewer.
+         * Return the number of neighbors found.
+         */
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        /* Return 1 if *a1* is one of the neighbors of *a0*.
+         * WARNING: This requires a call to
+         * look_around() for each *a0*.
+         */
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        /* Computes the distance2 *rad2* to the k-th closest
+         * agent in the field of view of *a0*.
+         */
+        void look_around(Agent* a0 , int n_agents , Agent* ags) ;
+        /* Return the outdegree = the number of neighbors. */
+        int outdegree(){return k;} ;
+        /* Starts a new step for range(). */
+        void prepare(int n_agents , Agent* ags) ;
+        /* Same as Topologic::range. Note that the agents at the
+         * front of a group see few others, far away, so with a
+         * blind cone the range (and the cost of a Grid) can be
+         * much larger than for Topologic.
+         */
+        double range() ;
+        /* Keep the Grid to skip the slots behind the agents. */
+        void set_grid(Grid* gr) {grid = gr;} ;
+    private:
+        /* Store in *dists2* and *seen* the distance2 to the
+         * agents in the field of view of *a0*, and a larger value
+         * for the rest (and for the slots skipped), and return
+         * how many are in view.
+         */
+        int visible_dists2(Agent* a0 , int n_agents , Agent* ags) ;
+        /* Same for the candidates *ags[i0:i1]*. */
+        int visible_dists2(Agent* a0 , int i0 , int i1 , Agent* ags) ;
+        int k ;
+        spp_real rad2 ;
+        spp_real* dists2 ;
+        spp_real max_rad2 ;
+        spp_real last_max_rad2 ;
+        spp_real cos_blind ;
+        Grid* grid ;
+        /* Copy of *dists2* kept by look_around, which reorders
+         * *dists2*, so that get_neighbors does not compute the
+         * distances again. Grows as needed.
+         */
+        spp_real* seen ;
+        int seen_size ;
+} ;
+
+/*
+ * Voronoi interaction: two agents are neighbors if their
+ * Voronoi cells share a face (an edge in 2D), i.e. if they
+ * are connected in the Delaunay triangulation of the agents'
+ * positions. As in Metric and Topologic, every agent is also
+ * a neighbor of itself.
+ * This interaction is NOT local (see Topologic).
+ *
+ * The Voronoi cell of *a0* is built starting from a cube
+ * (rectangle) centered at *a0*, with the box lengths of the
+ * geometry along its periodic dimensions and many times the
+ * extent of the candidates around *a0* along the others (open
+ * space or walls), and clipping it with the bisector plane
+ * (line) to each candidate agent, taken in order of increasing
+ * distance. The clipping stops as soon as the next candidate
+ * is further than twice the farthest vertex of the cell, since
+ * from there on no candidate can cut the cell. The candidates
+ * are taken at their nearest image, which is the only one
+ * closer than half a box length. If the cell reaches further
+ * than that (a small or sparse periodic box), the cell is also
+ * clipped with the other images of the candidates closer than
+ * twice its farthest vertex, along the dimensions where the
+ * geometry is periodic (see Geometry::is_periodic). The result
+ * is exact in a periodic box; in open space only the faces of
+ * the unbounded cells at the edge of the swarm that lie
+ * entirely beyond the starting cell (between agents aligned to
+ * about one part in a thousand) are missed. The cost per agent
+ * is O(m) for *m* candidates (plus a log(m) for each candidate
+ * actually tested), so that with a Grid a whole step costs O(N).
+ * As with Topologic, a Grid can only be used if the slots are
+ * large enough for all the Voronoi neighbors of an agent to
+ * be in its neighborhood.
+ *
+ * Space for *max_agents* candidates is allocated on
+ * initialization.
+ */
+class Voronoi : public Interaction {
+    public:
+        Voronoi() {};
+        /* Allocate the space to sort up to *max_agents*
+         * candidates and to store the cell.
+         */
+        Voronoi(Geometry* g, int max_agents) ;
+        /* Copy A POINTER to the agents in *ags* whose Voronoi
+         * cell shares a face with the one of *a0* into *neis*.
+         * Return the number of neighbors found.
+         */
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        /* Return 1 if *a1* is a Voronoi neighbor of *a0*.
+         * WARNING: This requires a call to
+         * look_around() for each *a0*.
+         */
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        /* Build the Voronoi cell of *a0* and store its
+         * neighbors so that is_neighbor() can be used.
+         */
+        void look_around(Agent* a0 , int n_agents , Agent* ags) ;
+    private:
+        /* Build the Voronoi cell of *a0* out of the candidates
+         * in *ags* and store the indices (in *ags*) of its
+         * neighbors in *cell_neis*. Return the number of neighbors.
+         */
+        int build_cell(Agent* a0 , int n_agents , Agent* ags) ;
+        /* Clip the current cell with the half-space x*n <= c,
+         * labeling the new face with *tag*. Return 1 if the cell
+         * was cut.
+         */
+        int clip(double* n, double c, int tag) ;
+        /* Clip the cell of the agent at *pos* with the images
+         * of the candidates other than the nearest one, if the
+         * cell is large enough for them to cut it. Return 1 if
+         * they were checked.
+         */
+        int clip_images(spp_real* pos, int n_agents, Agent* ags, int self) ;
+        int max_agents ;
+        /* Distance2 from *a0* to each candidate and
+         * a heap with the candidates' indices.
+         */
+        spp_real* dists2 ;
+        int* heap ;
+        /* Indices of the neighbors found in the last build_cell
+         * and their position pointers (used by is_neighbor).
+         */
+        int* cell_neis ;
+        spp_real** nei_pos ;
+        int num_cell_neis ;
+        /* Current cell, relative to the agent position.
+         * In 2D, a polygon with *nverts* vertices; *tags[i]* is
+         * the agent that generated the edge from vertex i to i+1.
+         * In 3D, *nfaces* polygonal faces, each with a tag and
+         * *fnverts[f]* vertices.
+         * *tmp_* arrays are used to build the clipped cell.
+         */
+        int nverts, nfaces ;
+        int *tags, *fnverts ;
+        double* verts ;
+        int *tmp_tags, *tmp_fnverts ;
+        double* tmp_verts ;
+        double* cap ;
+        /* Squared distance from the agent to the
+         * farthest vertex of the cell.
+         */
+        double maxr2 ;
+} ;
+
+/*
+ * NetworkInteraction: get the neighbors
+ * from a predefined network loaded on init.
+ */
+class NetworkInteraction : public Interaction {
+    public:
+        NetworkInteraction(Agent* ags, int* nneis, Agent*** net, Geometry* g) ;
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+        int get_agent_index(Agent* a) ;
+    private:
+        Agent* agents ;
+        Agent*** network ;
+        int* num_neis ;
+} ;
+
+/*
+ * NoInteraction interaction: nobody
+ * interacts with anybody. Similar behavior
+ * can be achieved with a Metric of r=0
+ * of Topologic of k=0 but this is much
+ * faster.
+ * Beware of incosistency, a0 is not neighbor
+ * of itself according to is_neighbor()
+ * but it is returned in get_neighbors().
+ * This is a small price to pay for simplicity
+ * and speed: get_neighbors() needs to
+ * return the agent itself for him to
+ * maintain current speed in the Vicsek
+ * protocol, but adding a if to is_neighbor
+ * to check if a0==a1 adds computation
+ * cost for no real benefit.
+ */
+class NoInteraction : public Interaction {
+    public:
+        NoInteraction( Geometry* g) ;
+        int get_neighbors(Agent* a0 , int n_agents , Agent* ags, Agent** neis) ;
+        int is_neighbor(Agent* a0 , Agent* a1) ;
+} ;
+
+// Other functions
+
+/* Return the *k*-th smaller value
+ * out of the *n* values stored in *arr*.
+ * Used by Topologic::look_around().
+ * Based on the algorithm described
+ * in "Numerical Recipes in C".
+ *
+ * The array *arr* IS modified by
+ * this function.
+ */
+spp_real quickselect(spp_real* arr, int n, int k) ;
+
+/* Kinds of obstacles. */
+#define SPP_OBSTACLE_SPHERE   0
+#define SPP_OBSTACLE_BOX      1
+#define SPP_OBSTACLE_SEGMENT  2
+
+/*
+ * Class with a set of static obstacles that the agents avoid
+ * (see Vicsek_avoider) and bounce off (see Community::setup_obstacles):
+ *      - spheres (circles in 2D) with a center and a radius,
+ *      - boxes aligned with the axes, with two opposite corners,
+ *      - thick segments (capsules), the points closer than a
+ *      radius to the segment between two points, e.g. walls
+ *      of any orientation.
+ *
+ * The obstacles are stored in a spatial index: a regular mesh of
+ * cells of side *range* (at least) covering all the obstacles,
+ * where each cell keeps the list of obstacles closer than *range*
+ * to some point of the cell. A query at a position only checks the
+ * obstacles of its cell, so its cost does not depend on the number
+ * of obstacles far from it, and positions farther than *range* from
+ * all the obstacles are answered without checking any.
+ * The index is built by build(), which Community::setup_obstacles
+ * and the Vicsek_avoider constructor call, and it is rebuilt by
+ * every obstacle added after that. The queries only read it, so
+ * they can be made from several threads at once. When the
+ * obstacles are used on their own, call build() after adding
+ * them: before it, the queries find no obstacle.
+ *
+ * The obstacles are not periodic: in a periodic box they are not
+ * seen through the boundaries, so they should not touch them.
+ */
+class Obstacles {
+    public:
+        /* Create an empty set with space for *max_obstacles*
+         * obstacles, that are queried up to a distance *range*
+         * (e.g. the distance at which the agents see them).
+         */
+        Obstacles(int max_obstacles, double range) ;
+        /* Add a sphere of radius *radius* centered at *center*.
+         * Return its index, or -1 if there is no space left.
+         */
+        int add_sphere(double* center, double radius) ;
+        /* Add the box with corners *lo* and *hi* (lo[i] < hi[i]).
+         * Return its index, or -1 if there is no space left.
+         */
+        int add_box(double* lo, double* hi) ;
+        /* Add the points closer than *radius* to the segment from
+         * *a* to *b*. Return its index, or -1 if there is no space left.
+         */
+        int add_segment(double* a, double* b, double radius) ;
+        /* Return the number of obstacles. */
+        int get_num_obstacles() {return num_obstacles;} ;
+        /* Return the query range. */
+        double get_range() {return range;} ;
+        /* Return the signed distance from *pos* to the surface of the
+         * obstacle *io* (negative inside it), and store in *normal*
+         * the unit vector pointing out of the obstacle at *pos*.
+         */
+        double distance(int io, spp_real* pos, double* normal) const ;
+        /* Return the signed distance from *pos* to the closest obstacle
+         * closer than *range*, storing its outward normal in *normal*,
+         * or return *range* with a null normal if there is none.
+         */
+        double nearest(spp_real* pos, double* normal) const ;
+        /* Store in *dir* the direction to avoid the obstacles closer
+         * than *range* to *pos*: the sum of their outward normals, each
+         * weighted by (range - distance) / range, which grows from 0
+         * at *range* to 1 at the surface. Return how many there are.
+         */
+        int avoidance(spp_real* pos, double* dir) const ;
+        /* If *pos* is inside an obstacle, move it to the surface
+         * along the outward normal and reflect the component of the
+         * velocity *vel* that goes into the obstacle (if any), keeping
+         * its norm. This is repeated while it is inside overlapping
+         * obstacles. Return 1 if it was inside an obstacle, 0 otherwise.
+         */
+        int reflect(spp_real* pos, spp_real* vel) const ;
+        /* Build the spatial index with the obstacles added so far.
+         * Once built, it is rebuilt when more obstacles are added.
+         */
+        void build() ;
+    protected:
+        /* Return the cell containing *pos*, or -1 if it is
+         * farther than *range* from all the obstacles or the
+         * index is not built.
+         */
+        int cell(spp_real* pos) const ;
+        int max_obstacles ;
+        int num_obstacles ;
+        double range ;
+        /* Kind of each obstacle (SPP_OBSTACLE_*), and its
+         * parameters: for a sphere the center and radius, for a
+         * box the corners lo and hi, and for a segment the ends a
+         * and b and the radius, SPP_MAX_DIM values each.
+         */
+        int* kind ;
+        double* p0 ;
+        double* p1 ;
+        double* radius ;
+        /* Index: *ncells* cells per dimension of side *cell_size*
+         * from *origin*, and the obstacles of cell *c* in
+         *      cell_obstacles[first[c] : first[c+1]]
+         */
+        bool built ;
+        double origin[SPP_MAX_DIM] ;
+        double cell_size ;
+        int ncells[SPP_MAX_DIM] ;
+        int* first ;
+        int* cell_obstacles ;
+} ;
+class Agent ;
+class Geometry ;
+
+/*
+ * Abstract Force class used as a template for
+ * different pairwise forces between the agents,
+ * used by the continuous-time integrators (see
+ * Langevin). Every implementation must implement:
+ *
+ *      sum_forces: add to *f* the total force on
+ *          the agent *a0* from the *n_agents* agents
+ *          stored in *ags*, measuring the displacements
+ *          with the geometry *g*. Return the number
+ *          of agents that exert a force on *a0*.
+ *      range: the distance beyond which the force
+ *          vanishes, used to choose the size of the
+ *          slots of a Grid.
+ *
+ * The loop over the agents is in the implementation,
+ * so that the force law is inlined in it.
+ * An agent at distance 0 from *a0* is taken as *a0*
+ * itself and exerts no force.
+ */
+class Force {
+    public:
+        /* pure virtual, must be implemented */
+        virtual int sum_forces(Agent* a0, int n_agents, Agent* ags, spp_real* f) = 0 ;
+        /* pure virtual, must be implemented */
+        virtual double range() = 0 ;
+        /* Geometry used to measure the displacements. */
+        Geometry* g ;
+} ;
+
+// Implementations of Force
+
+/*
+ * Soft-core repulsion: two agents closer than a
+ * diameter *sigma* repel each other with a force
+ *      F = k (sigma - r)
+ * along the line joining them, derived from the
+ * harmonic potential k (sigma - r)^2 / 2. Used for
+ * active Brownian particles since the force is
+ * bounded and a large time step can be used.
+ */
+class SoftCore : public Force {
+    public:
+        SoftCore(double k, double sigma, Geometry* g) ;
+        /* Add the repulsion from the agents in *ags* closer than
+         * *sigma* to *a0* to *f*. Return how many there are.
+         */
+        int sum_forces(Agent* a0, int n_agents, Agent* ags, spp_real* f) ;
+        /* Return the diameter sigma. */
+        double range() {return sigma;} ;
+    protected:
+        spp_real k ;
+        spp_real sigma ;
+} ;
+class Agent ;
+
+/*
+ * Abstract Behavior class used as a template
+ * for different Behavior implementations.
+ * Every implementation defines a particular
+ * consensus protocol, i.e. a rule to determine
+ * what velocity the agent should align to given
+ * a set of connected agents or 'neighbors'.
+ * Every behavior must implement at least:
+ *
+ *      sense_velocity: determine the new velocity
+ *          *new_vel* that agent *ag* should align
+ *          to given *num_agents* potential neighbors
+ *          stored in *ags*. Which of them are
+ *          actual neighbors is computed via *inter*.
+ *      sense_noisy_velocity: same as sense_velocity
+ *          with an added random noise.
+ *
+ * The other functions are optional depending on
+ * the desired behavior.
+ *
+ */
+class Behavior {
+    public:
+        /* pure virtual, must be implemented */
+        virtual void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) = 0;
+        /* pure virtual, must be implemented */
+        virtual void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) = 0;
+        /* pure virtual, must be implemented */
+        virtual void randomize_velocity(Agent* ag) = 0;
+        /* optional */
+        virtual int sense_danger(Agent* ag, int num_threats, Agent* threats, spp_real* new_vel) {return 0;};
+        /* optional */
+        virtual int sense_victims(Agent* ag, int num_agents, Agent* ags) {return 0;} ;
+        /* optional */
+        virtual int hunt(Agent* ag, Agent* prey, double deltat) {return 0;};
+        /* optional. Return 1 if sense_noisy_velocity is equivalent
+         * to sense_velocity followed by add_noise, so that the noise
+         * of many agents can be added at once (see
+         * Community::sense_noisy_velocities). In that case the
+         * communities never call sense_noisy_velocity, so a class
+         * that overrides sense_noisy_velocity must also override
+         * separable_noise. The library classes only return 1 for
+         * their own exact type (checked with typeid), so that a
+         * derived class is never batched unless it opts in.
+         */
+        virtual int separable_noise() {return 0;} ;
+        /* optional. Add the noise of sense_noisy_velocity to the
+         * *num_vels* velocities stored consecutively in *vels*.
+         * Only used if separable_noise() returns 1.
+         */
+        virtual void add_noise(int num_vels, spp_real* vels) {} ;
+        /* Interaction pointer that determines if a
+         * given agent is a neighbor of another given
+         * agent. See documentation of Interaction
+         * for more info.
+         */
+        Interaction* inter ;
+    protected:
+        /* Noise level parameter used by sense_noisy_velocity.
+         * Assumed to be in the [0:1] range.
+         */
+        double noise ;
+} ;
+
+/*
+ * Original Vicsek consensus protocol
+ * from Vicsek et al. PRL 75, 1226 (1995).
+ * The consensus velocity is the mean velocity
+ * of all the neighbors scaled to have a
+ * constant norm v0. Noise is introduced as
+ * a random rotation on the computed new
+ * velocity.
+ * The agents in the original model explicitly
+ * include themselves in the mean. Here, the
+ * decision of whether an agent is a neighbor
+ * of itself or not is left to the Interaction
+ * instance *inter*.
+ * (it is, for Metric and Topologic)
+ *
+ */
+class Vicsek_consensus : public Behavior {
+    public:
+        Vicsek_consensus() {} ;
+        Vicsek_consensus(Interaction* ii, double v0, double noise) ;
+        /* Store the mean velocity of *ag*'s neighbors in *new_vel*,
+         * re-scaled to have a *v0* norm.
+         */
+        void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Rotate a vector *v* by a random angle between [-noise*pi : noise*pi].
+         * For dimensions higher than 2 a random rotation axis is also chosen, which
+         * increases considerably the amount of computation required for this.
+         */
+        void rotate(spp_real* v) ;
+        /* Rotate the *num_vecs* vectors of norm v0 stored consecutively
+         * in *vs*, each one by an independent random angle as in rotate().
+         * The random numbers are drawn first for a chunk of vectors and
+         * the trigonometric functions are then evaluated in a single loop
+         * that the compiler can vectorize.
+         * In 2D the result is identical to calling rotate() on each vector.
+         * In 3D the rotated vector is built as
+         *      cos(theta) v + sin(theta) v0 (cos(phi) e1 + sin(phi) e2)
+         * with (e1, e2) an orthonormal basis perpendicular to *v* and *phi*
+         * uniform in [0:2pi]. This samples the same distribution as rotate()
+         * (uniform angle on the cone around *v*) without the random axis.
+         */
+        void rotate_batch(int num_vecs, spp_real* vs) ;
+        /* Sense velocity using sense_velocity() and then rotate the
+         * sensed velocity *new_vel* using the rotate() method.
+         */
+        void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* The rotation is independent of the neighbors. Returns 1
+         * for Vicsek_consensus itself, 0 for a derived class that
+         * does not override this method.
+         */
+        int separable_noise() ;
+        /* Rotate the *num_vels* velocities in *vels* using rotate_batch(). */
+        void add_noise(int num_vels, spp_real* vels) ;
+        /* Sets the velocity of *ag* to a random vector with norm v0. */
+        void randomize_velocity(Agent* ag) ;
+    protected:
+        /* Fixed norm of the agent velocity.
+         */
+        double v0 ;
+} ;
+
+/*
+ * Same as Vicsek consensus but the
+ * noise is implemented as a vector added
+ * to the consensus velocity instead of an
+ * angle rotating the velocity.
+ * The model is discussed in
+ *      Chate et al. Phys. Rev. E 77, 046113  (2008)
+ */
+class Chate_consensus : public Vicsek_consensus {
+    public:
+        Chate_consensus() {} ;
+        Chate_consensus(Interaction* ii, double v0, double noise) : Vicsek_consensus(ii, v0, noise) {} ;
+        /* Sense velocity including a vectorial noise term
+         * proportional to the number of neighbors following
+         * the receipe from:
+         *      PHYSICAL REVIEW E 77, 046113  2008
+         */
+        void sense_noisy_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* The noise depends on the number of neighbors. Returns 0. */
+        int separable_noise() {return 0;} ;
+} ;
+
+/*
+ * Vicsek consensus protocol plus
+ * a prey behavior where the agents
+ * sense danger and if detected act
+ * on it, ignoring the consensus
+ * protocol.
+ * A threat is detected if any of
+ * the *num_threats* agents in *threats*
+ * is at a distance2 less than
+ * *dectection_radius2*. If detected,
+ * the agent proceds to align itself
+ * in order to radially flee from
+ * the first threat detected.
+ *
+ */
+class Vicsek_prey : public Vicsek_consensus {
+    public:
+        Vicsek_prey() : Vicsek_consensus() {} ;
+        Vicsek_prey(Interaction* ii, double v0, double noise, double dradius) ;
+        /* If a threat is detected, return 1 and store the flee velocity
+         * in *new_vel*. Else, do nothing and return 0.
+         */
+        int sense_danger(Agent* ag, int num_threats, Agent* threats, spp_real* new_vel) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
+    protected:
+        /* Square of the maximum distance at which
+         * agents are capable of detecting threats.
+         *
+         * TODO For the sake of generality,
+         * this should be replaced by an
+         * Interaction instance that determines
+         * if the agent detects the threat or not.
+         */
+        double detection_radius2 ;
+} ;
+
+/*
+ * Vicsek consensus protocol plus the
+ * avoidance of static obstacles: the
+ * consensus velocity is deviated by
+ *      weight * v0 * dir
+ * where *dir* is the avoidance direction
+ * of Obstacles::avoidance (the outward
+ * normals of the obstacles closer than
+ * their range, stronger when closer),
+ * and then re-scaled to have a *v0* norm.
+ * Far from the obstacles it is the
+ * same as Vicsek_consensus.
+ *
+ */
+class Vicsek_avoider : public Vicsek_consensus {
+    public:
+        Vicsek_avoider() : Vicsek_consensus() {} ;
+        Vicsek_avoider(Interaction* ii, double v0, double noise, Obstacles* obs, double weight) ;
+        /* Store the mean velocity of *ag*'s neighbors plus the
+         * avoidance of the obstacles in *new_vel*, re-scaled
+         * to have a *v0* norm.
+         */
+        void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
+    protected:
+        /* Obstacles to avoid. */
+        Obstacles* obstacles ;
+        /* Strength of the avoidance relative to the consensus. */
+        double weight ;
+} ;
+
+/*
+ * Zonal model of attraction, repulsion and
+ * alignment from Couzin et al. J. Theor. Biol.
+ * 218, 1 (2002). The neighbors of an agent are
+ * split in three concentric zones:
+ *      repulsion:   distance < r_rep
+ *      orientation: r_rep <= distance < r_ori
+ *      attraction:  r_ori <= distance < r_att
+ * If there are neighbors in the repulsion zone
+ * the agent moves away from them, ignoring the
+ * rest. Otherwise it aligns with the headings of
+ * the neighbors in the orientation zone and moves
+ * towards the ones in the attraction zone, with
+ * equal weights if there are both. Without any
+ * neighbor it keeps its heading.
+ * The agents do not see the neighbors in a cone
+ * of total angle *blind_angle* behind them (0 to
+ * see all around).
+ *
+ * The three sums are computed in a single pass
+ * over the candidates, measuring each displacement
+ * once, so the neighbors are not listed through
+ * *inter*, which is only used for its geometry and
+ * its range. It should be a Metric interaction of
+ * radius r_att so that a Grid can be tuned for it.
+ * The noise is the rotation of Vicsek_consensus.
+ *
+ */
+class Couzin_zones : public Vicsek_consensus {
+    public:
+        Couzin_zones() : Vicsek_consensus() {} ;
+        Couzin_zones(Interaction* ii, double v0, double noise, double r_rep, double r_ori, double r_att, double blind_angle) ;
+        /* Store the direction given by the zones of *ag*'s
+         * neighbors in *new_vel*, re-scaled to have a *v0* norm.
+         */
+        void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Limit the angle between the current and the sensed
+         * heading to *angle* (the turning rate times the time
+         * step, as in the original model): the heading turns
+         * by *angle* towards the sensed direction if they differ
+         * more. 0 (the default) turns without limit.
+         */
+        void set_max_turn(double angle) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
+    protected:
+        /* Largest turn in one step, 0 for no limit. */
+        double max_turn ;
+        /* Squares of the outer radius of each zone. */
+        spp_real rep2 ;
+        spp_real ori2 ;
+        spp_real att2 ;
+        /* -cos(blind_angle/2): a neighbor at displacement
+         * *dis* is seen if dis.vel >= cos_blind |dis| |vel|.
+         */
+        spp_real cos_blind ;
+} ;
+
+/* Weight functions of Vicsek_weighted. */
+#define SPP_WEIGHT_GAUSSIAN   0
+#define SPP_WEIGHT_POWER      1
+#define SPP_WEIGHT_RANK       2
+
+/*
+ * Vicsek consensus protocol where each neighbor
+ * has a weight that depends on its distance *r*
+ * to the agent, given by *kernel*:
+ *      SPP_WEIGHT_GAUSSIAN: exp(-r^2 / (2 scale^2))
+ *      SPP_WEIGHT_POWER:    (1 + r^2 / scale^2)^(-exponent/2)
+ *      SPP_WEIGHT_RANK:     (1 + rank)^(-exponent)
+ * where *rank* is the number of neighbors closer
+ * than it (0 for the agent itself). The consensus
+ * velocity is the weighted sum of the velocities
+ * of the neighbors given by *inter*, re-scaled to
+ * have a *v0* norm. The noise is the rotation of
+ * Vicsek_consensus.
+ *
+ * The distances to the neighbors, the weights and
+ * the sum are computed in separate loops over the
+ * neighbors, so that the compiler can vectorize
+ * the exp and pow of the weights. The ranks are
+ * counted with a double loop, which is fast for
+ * the few neighbors of a Topologic interaction.
+ * For a power law over all the agents see
+ * LongRangeAlignment.
+ *
+ */
+class Vicsek_weighted : public Vicsek_consensus {
+    public:
+        Vicsek_weighted() : Vicsek_consensus() {} ;
+        /* *dd* is space for 2 values per agent, e.g.
+         * spp_community_alloc_space(num_agents).
+         */
+        Vicsek_weighted(Interaction* ii, double v0, double noise, int kernel, double scale, double exponent, spp_real* dd) ;
+        /* Store the weighted sum of the velocities of *ag*'s
+         * neighbors in *new_vel*, re-scaled to have a *v0* norm.
+         */
+        void sense_velocity(Agent* ag, int num_agents, Agent* ags, spp_real* new_vel) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
+    protected:
+        /* Store in *weights* the weight of each of the
+         * *num_neis* neighbors given their distance2 *dists2*.
+         */
+        void weigh(int num_neis, spp_real* dists2, spp_real* weights) ;
+        int kernel ;
+        double scale ;
+        double exponent ;
+        /* distance2 to the neighbors, followed by their weights */
+        spp_real* dists2 ;
+} ;
+
+/*
+ * Vicsek consensus protocol plus a predator
+ * behavior where the agent senses victims
+ * and hunts an agent if it close enough.
+ *
+ *      hunt: if *prey* is closer than *v0*x*deltat*
+ *          to the predator *ag*, then *ag*
+ *          moves to *prey* position and the
+ *          function returns 1. Otherwise,
+ *          move *ag* for *v0*x*deltat* in
+ *          *prey* direction and return 0.
+ *          Note the actual "hunting" is left
+ *          for the user or the HostileEnvironment
+ *          class to do.
+ *
+ */
+class Vicsek_predator : public Vicsek_consensus {
+    public:
+        Vicsek_predator() : Vicsek_consensus() {} ;
+        Vicsek_predator(Interaction* ii, double v0, double noise) : Vicsek_consensus(ii, v0, noise) {} ;
+        /* Find which agent out of the *num_agents*
+         * stored in *ags* is closer to the
+         * predator *pred*.
+         * Return the index of that agent.
+         */
+        int sense_victims(Agent* pred, int num_agents, Agent* ags) ;
+        /* If *pred* can move to *prey*'s position
+         * in a time *deltat* or less, then *pred*
+         * moves to where *prey* is and return 1.
+         * Else, move *pred* in the direction
+         * of *prey* and return 0.
+         * Return 1 if the succesfully hunted
+         * and 0 otherwise.
+         */
+        int hunt(Agent* pred, Agent* prey, double deltat) ;
+        /* Same noise as Vicsek_consensus. Returns 1 for this
+         * exact class only.
+         */
+        int separable_noise() ;
+} ;
+
+/*
+ * Class to store "Verlet lists" with the coarse position
+ * of the agents in boxes.
+ * The aim of this is to speed up calculations by using the
+ * Grid.get_neighborhood() method so that only nearby agents
+ * are used to find the neighbors of an agent.
+ *
+ * The computation box is divided in *nslots* regular slots
+ * PER DIMENSION and a collection of agents is kept
+ * in *grid* to keep track of what agents are potential
+ * neighbors of an agent in a particular slot.
+ * Each entry of *grid* corresponds to a slot.
+ * Each entry contains a list with the agents that are
+ * either in the corresponding slot or any adjacent slot.
+ *
+ * This tecnique makes most computations to run approximately
+ * as O(N) instead of O(N**2). It is commonly used in
+ * molecular dynamics calculations, see e.g.
+ *  http://www.cs.ubbcluj.ro/~alibal/Teaching/Simulation/1_md_allen.pdf
+ *  Sec 3.4 (page 12)
+ *
+ * Note that, tecnically, one can only justify using this when
+ * the interaction has a finite range and the size of each
+ * slot *slot_size* is greater than or equal to the interaction
+ * range. For metric interaction this is the case. For topological,
+ * one has to choose a number of slots conservative enough so the
+ * probability of an agent having a neighbor two slots away is
+ * neglibigle.
+ * The number of slots can be chosen by the Community from the
+ * range of the interaction and re-tuned as the swarm evolves
+ * (see Community::tune_grid), instead of by hand.
+ *
+ * The box can be rectangular, with a different length and
+ * number of slots along each dimension, so that the slots are
+ * about as wide as the interaction range along all of them.
+ *
+ * By default the box is periodic along every dimension, but it
+ * can have walls along some of them (see set_boundaries): the slots
+ * next to a wall are then not adjacent to those at the other side
+ * of the box, so a slot has less than 3^DIM adjacent slots.
+ *
+ * The copies of the agents of all the slots are stored in a single
+ * array, with *3^DIM* copies of each agent, which grows as needed.
+ * The list of each slot holds the agents of its adjacent slots one
+ * slot after the other, and the Grid keeps where each of them starts
+ * (see get_blocks), so that an Interaction can skip whole slots,
+ * e.g. those behind the agent for MetricCone and TopologicCone.
+ *
+ * For agents in open space, with no box, see HashGrid.
+ *
+ */
+class Grid{
+    public:
+        /* Construct grid and allocate the space it needs,
+         * approximately (3^dimension)*max_agents*sizeof(Agent).
+         * If nslots < 3 it uses 3 slots, so that the neighborhood
+         * of every slot is the whole box.
+         * Inputs:
+         *      ns = nslots
+         *      bs = box_size
+         *      max_agents = Number of agents expected. More
+         *          space is allocated if fill_grid is called
+         *          with more agents.
+         */
+        Grid(int ns , double bs, int max_agents) ;
+        /* Construct a grid with 3 slots per dimension, to be
+         * tuned by the Community (see Community::tune_grid).
+         */
+        Grid(double bs, int max_agents) ;
+        /* Same for a rectangular box with the DIM lengths *ls*. */
+        Grid(double* ls, int max_agents) ;
+        /* Return the number of slots per dimension
+         * (along the first one if they are different).
+         */
+        int get_nslots() {return nslots[0];} ;
+        /* Return the number of slots along dimension *d*. */
+        int get_nslots(int d) {return nslots[d];} ;
+        /* Return the total number of slots. */
+        int get_num_slots() {return num_slots;} ;
+        /* Return the size of a slot (along the first dimension). */
+        double get_slot_size() {return lengths[0] / nslots[0];} ;
+        /* Return the size of a slot along dimension *d*. */
+        double get_slot_size(int d) {return lengths[d] / nslots[d];} ;
+        /* Change the number of slots to *ns* along every dimension
+         * (3 at least along the periodic ones, 1 along those with
+         * walls). The grid must be filled again.
+         */
+        void set_nslots(int ns) ;
+        /* Change the number of slots along each dimension to the
+         * DIM values *ns* (same limits). The grid must be filled again.
+         */
+        void set_nslots(int* ns) ;
+        /* Set the boundaries along each dimension: *periodic[i]* 1
+         * if the dimension *i* is periodic (the default) or 0 if it
+         * has walls. Called by Community::setup_grid with the
+         * boundaries of the Community. The grid must be filled again.
+         */
+        void set_boundaries(int* periodic) ;
+        /* Return 1 if dimension *d* is periodic, 0 if it has walls. */
+        int is_periodic(int d) {return periodic[d];} ;
+        /* Choose the number of slots for an interaction *range*
+         * and *num_agents* agents: along each dimension the largest
+         * one with slots not smaller than *range*, but with no more
+         * slots than agents (with the same proportion of slots along
+         * each dimension as the box lengths when capped).
+         * Change to it (see set_nslots) if it is different from the
+         * current one, and return it (see get_nslots).
+         * If *range* <= 0 nothing changes.
+         */
+        int tune(double range, int num_agents) ;
+        /* Store in *ind* the n-dimensional index (i,j) or (i,j,k)
+         * corresponding to a given position *pos*.
+         * Inputs:
+         *      pos = pointer with an n-dim position
+         *      ind = pointer to store the n-dim index
+         */
+        void grid_index(spp_real* pos , int *ind ) ;
+        /* Return the serial index corresponding to the
+         * position *pos*. This value gives the index
+         * of grid[] corresponding to that position.
+         */
+        int  serial_index(spp_real* pos ) ;
+        /* Copy the *num_agents* contained in *ags*
+         * to their corresponding slots in *grid*.
+         * Each agent *ag* is _copied_ to its own
+         * slot *serial_index(ag.pos)* and to all
+         * the adjacent ones (8 for 2D and 26 for 3D).
+         * The agents of each adjacent slot are kept
+         * together, in the order of *ags*.
+         */
+        void fill_grid(int num_agents, Agent* ags) ;
+        /* Return a list of agents containing the
+         * neighborhood of *ag* and store how many
+         * agents this list contain in *num_neis*.
+         * This uses the information stored in the
+         * last *fill_grid* call.
+         */
+        Agent* get_neighborhood(Agent* ag, int* num_neis ) ;
+        /* If the *num_neis* agents *ags* are the neighborhood of
+         * the slot of *pos* in the last fill_grid (as returned by
+         * get_neighborhood), store the n-dim index of the slot in
+         * *ind* and return the 3^DIM+1 offsets in *ags*
+         * where the agents of each adjacent slot start: those of
+         * the slot ind + (i,j,k) - (1,1,1), with i,j,k in 0..2, are
+         *      ags[blocks[n] : blocks[n+1]],  n = (i*3 + j)*3 + k
+         * (n = i*3 + j in 2D), none beyond a wall.
+         * Otherwise return NULL.
+         */
+        int* get_blocks(spp_real* pos, Agent* ags, int num_neis, int* ind) ;
+    protected:
+        /* Store in *adj* the serial indices of the (up to 3^DIM)
+         * slots adjacent to the slot of n-dim index *ind*
+         * (including itself), in *off* their positions n in the
+         * blocks of get_blocks, in increasing order, and return
+         * how many there are.
+         */
+        int adjacent_slots(int* ind, int* adj, int* off) ;
+        /* Allocate *grid* for *max_agents* and 3 slots
+         * per dimension, with the box lengths already set.
+         */
+        void init(int max_agents) ;
+        /* Number of slots along each dimension, and in total. */
+        int nslots[SPP_MAX_DIM] ;
+        int num_slots ;
+        /* Length of the computation box along each dimension. */
+        double lengths[SPP_MAX_DIM] ;
+        /* 1 if the dimension is periodic, 0 if it has walls. */
+        int periodic[SPP_MAX_DIM] ;
+        /* Copies of the agents of all the slots. The Grid may
+         * represent a two- or three-dimesional array but it is
+         * serialized,
+         *  grid[first[i] : first[i] + occupation[i]] = list of all
+         *      agents in slot *i* and adjacent.
+         * *capacity* is the number of agents that fit in *grid*.
+         */
+        Agent* grid ;
+        int capacity ;
+        int* first ;
+        /* List with number of agents contained in each
+         * slot of *grid*
+         */
+        int* occupation ;
+        /* Offsets of the adjacent slots in the list of each
+         * slot, 3^DIM+1 per slot (see get_blocks).
+         */
+        int* blocks ;
+        /* Agents sorted by slot while filling the grid: those
+         * of slot *i* are *by_slot[slot_first[i] : slot_first[i+1]]*
+         * (indices in the agents), and the slot of each agent.
+         * *agent_capacity* is the number of agents that fit.
+         */
+        int* slot_first ;
+        int* by_slot ;
+        int* agent_slot ;
+        int agent_capacity ;
+} ;
+
+/*
+ * Cell list for agents in open space (Cartesian geometry), with no
+ * box: space is divided in cubic cells of side *cell_size*,
+ * with integer coordinates (i,j) or (i,j,k) of any value, and
+ * each cell is mapped to one of the *table_size* slots of the
+ * Grid with the hash function
+ *      h(i,j,k) = (i*73856093 ^ j*19349663 ^ k*83492791) mod table_size
+ * (Teschner et al. 2003). Each agent is copied to the slots of its
+ * cell and of the 3^DIM - 1 adjacent ones, as in Grid, so the
+ * neighborhood of an agent holds all the agents in the adjacent
+ * cells, wherever the swarm goes, plus the agents of the cells that
+ * share their slots (collisions), which are discarded by the
+ * Interaction as too far. The grid is filled from scratch at every
+ * step, in O(N), and the neighbors found are the same as without
+ * a grid as long as *cell_size* is not smaller than the range of
+ * the interaction.
+ *
+ * The cell size can be tuned by the Community to the range of
+ * the interaction (see Community::tune_grid), and the table has
+ * about twice as many slots as *max_agents*, so that collisions
+ * are rare. The space needed is that of a Grid. Note that the range
+ * of Topologic is that of the farthest k-th neighbor of all the
+ * agents, so a few agents far from the swarm make all the cells large.
+ *
+ * It is a separate class from Grid, with the same fill_grid and
+ * get_neighborhood methods, so that neither of them pays a virtual
+ * call per agent. The Community takes either (see setup_grid).
+ */
+class HashGrid {
+    public:
+        /* Construct a hash grid with cells of side *cs* for
+         * about *max_agents* agents. If *cs* <= 0 all the agents
+         * are in the same cell until the grid is tuned, which is
+         * needed with interactions whose range is only known after
+         * the first step, such as Topologic.
+         */
+        HashGrid(double cs, int max_agents) ;
+        /* Return the side of the cells. */
+        double get_cell_size() {return cell_size;} ;
+        /* Return the number of slots of the table. */
+        int get_table_size() {return num_slots;} ;
+        /* Set the side of the cells to *cs*. The grid must be filled again. */
+        void set_cell_size(double cs) {cell_size = cs;} ;
+        /* Set the side of the cells to the interaction *range*, and
+         * return the number of slots of the table. If *range* <= 0
+         * nothing changes.
+         */
+        int tune(double range, int num_agents) ;
+        /* Store in *ind* the coordinates of the cell that contains
+         * the position *pos*.
+         */
+        void grid_index(spp_real* pos , int *ind ) ;
+        /* Return the slot of the cell that contains *pos*. */
+        int  serial_index(spp_real* pos ) ;
+        /* Same as Grid::fill_grid, with the slots of the cells. */
+        void fill_grid(int num_agents, Agent* ags) ;
+        /* Same as Grid::get_neighborhood. */
+        Agent* get_neighborhood(Agent* ag, int* num_neis ) ;
+    protected:
+        /* Store in *adj* the (different) slots of the 3^DIM cells
+         * adjacent to the cell *ind*, and return how many there are.
+         */
+        int adjacent_slots(int* ind, int* adj) ;
+        /* Slot of the cell *ind*. */
+        int hash(int* ind) ;
+        double cell_size ;
+        /* Number of slots of the table, a power of 2. */
+        int num_slots ;
+        /* Copies of the agents of all the slots, as in Grid. */
+        Agent* grid ;
+        int capacity ;
+        int* first ;
+        int* occupation ;
+        /* Last call to adjacent_slots that used each slot,
+         * to skip the slots shared by two adjacent cells.
+         */
+        int* stamp ;
+        int current_stamp ;
+} ;
+
+/*
+ * Class with a field on a regular periodic mesh covering
+ * the computation box, and its Fourier transform.
+ * It is used to compute correlation functions and structure
+ * factors of large systems in O(M log M) operations, with
+ * *M* the number of mesh cells, instead of going through all
+ * the pairs of agents (see Community::correlation_histo_fft
+ * and Community::structure_factors).
+ *
+ * The box is divided in *size* cells PER DIMENSION, which
+ * must be a power of 2 for the radix-2 FFT. The cell *c*
+ * of the n-dimensional index (i,j) or (i,j,k) is
+ *      c = i*size + j   or   c = (i*size + j)*size + k
+ * in the arrays *re* and *im* with the real and imaginary
+ * parts of the field. The agents are deposited in the
+ * cell that contains them (nearest grid point), so the
+ * distances between agents are known up to one cell size.
+ *
+ * All the space, of order 2*size^DIM doubles, is allocated
+ * on construction.
+ */
+class Mesh{
+    public:
+        /* Construct the mesh with *size* cells per dimension
+         * in a box of size *L*. If *size* is not a power
+         * of 2 the next power of 2 is used, printing an
+         * error to stderr.
+         */
+        Mesh(int size, double L) ;
+        /* Return the number of cells per dimension. */
+        int get_size() {return size;} ;
+        /* Return the total number of cells. */
+        int get_num_cells() {return num_cells;} ;
+        /* Return the box size. */
+        double get_box_size() {return box_size;} ;
+        /* Return the size of a cell (in each dimension). */
+        double get_cell_size() {return cell_size;} ;
+        /* Return the cell containing the position *pos*. */
+        int cell(spp_real* pos) ;
+        /* Set the field to zero. */
+        void clear() ;
+        /* Add to the (real) field the weight of each of the *n*
+         * agents with positions *pos* in the cell containing it.
+         * The weight of agent *i* is w[i*stride], or 1 if *w*
+         * is NULL.
+         */
+        void deposit(int n, spp_real* pos, spp_real* w, int stride) ;
+        /* Same as deposit but spreading the weight of each agent
+         * over the 2^DIM cells closest to it (cloud in cell), in
+         * proportion to the overlap of a cell-sized box centered
+         * at the agent with each cell. The field is smoother, at
+         * the price of 2^DIM operations per agent.
+         */
+        void deposit_cic(int n, spp_real* pos, spp_real* w, int stride) ;
+        /* Fourier transform of the field, in place:
+         *      F(k) = sum_x F(x) exp(sign * 2 pi i k.x / size)
+         * with *sign* -1 (forward) or +1 (backward). It is not
+         * normalized: forward and then backward multiplies the
+         * field by the number of cells.
+         */
+        void fft(int sign) ;
+        /* Return the length of the shortest periodic displacement
+         * from the cell 0 to the cell *c*.
+         */
+        double distance(int c) ;
+        /* Return the modulus of the wave vector of the
+         * Fourier mode *c*, in units of 1/length.
+         */
+        double wavenumber(int c) ;
+        /* Write to *out* a binary frame with the fields *density*
+         * (num_cells values) and *velocity* (DIM values per cell,
+         * cell after cell) of the step *step*, as computed by
+         * Community::fields. The frame is, in the native byte order:
+         *      "SPPF"          4 chars
+         *      DIM, size       2 int (4 bytes each)
+         *      step            long int (8 bytes)
+         *      box size        double
+         *      density         num_cells float
+         *      velocity        DIM*num_cells float
+         * so the frames can be appended to the same file and read
+         * back, e.g. with numpy, knowing the size of each frame.
+         * Returns 0 on success, -1 if the writing failed.
+         */
+        int write_frame(FILE* out, long int step, double* density, double* velocity) ;
+        /* Real and imaginary parts of the field, num_cells each. */
+        double* re ;
+        double* im ;
+    protected:
+        /* Transform the *size* values of the line starting
+         * at cell *first* with cells *stride* apart.
+         */
+        void fft_line(int first, int stride, int sign) ;
+        int size ;
+        int num_cells ;
+        double box_size ;
+        double cell_size ;
+        /* Cosines and sines of 2 pi j / size for j < size/2, the
+         * bit reversed index of each j < size, and space for a line.
+         */
+        double* cos_table ;
+        double* sin_table ;
+        int* bitrev ;
+        double* line_re ;
+        double* line_im ;
+} ;
+
+class Grid ;
+class HashGrid ;
+class Mesh ;
+class Force ;
+
+/*
+ * Community class implemented to easily
+ * manage a collection of Agent instances.
+ * On one hand, this provides a cleaner
+ * interface for the user to interact with
+ * the ensamble of agents by calling the
+ * methods of Community instead of looping
+ * for each agent and computing global
+ * properties such as correlations or order
+ * parameter.
+ * On the other hand, this provides some
+ * performance improvements by making sure
+ * all the positions and velocities are
+ * aligned in a contiguos memory segment and
+ * using molecular dynamics-like tricks to
+ * speed up calculations by the use of a Grid
+ * so that only nearby agents are checked for
+ * neighborhood.
+ *
+ * The Community class manages several arrays
+ * of data but it does not allocate any space
+ * of order *nags* (some small arrays are
+ * allocated for temporary results).
+ * The user is responsible for all the space
+ * allocation, and can use the functions provided
+ * here to automatize this process.
+ *
+ */
+class Community{
+    public:
+        /* Construct the community class.
+         * Inputs:
+         *      nags = number of agents in
+         *      the community.
+         *      L = size of box, the same
+         *      in all directions (see the next
+         *      constructor for a rectangular box).
+         *      ags = pointer to the array storing
+         *      the *nags* Agent instances.
+         *      p = pointer to the array to store
+         *      the positions of agents
+         *      (size depens on DIM).
+         *      v = pointer to the array to store
+         *      the velocities of agents
+         *      (size depens on DIM).
+         */
+        Community(int nags , double L, Agent* ags , spp_real* p, spp_real* v) ;
+        /* Same for a rectangular (periodic) box with the DIM
+         * lengths *ls* along each dimension, e.g. an elongated
+         * box to study the bands of the Vicsek model.
+         * The geometry of the interactions (CartesianPeriodic)
+         * and the Grid must be built with the same lengths.
+         */
+        Community(int nags , double* ls, Agent* ags , spp_real* p, spp_real* v) ;
+        /* Return the pointer to the position array.
+         * The position of agent *i* corresponds to
+         * the values
+         *      get_pos()[i*DIM : i*DIM + DIM]
+         */
+        spp_real* get_pos() ;
+        void set_pos(spp_real* p) {pos=p;} ;
+        /* Return the pointer to the velocity array.
+         * The velocity of agent *i* corresponds to
+         * the values
+         *      get_pos()[i*DIM : i*DIM + DIM]
+         */
+        spp_real* get_vel() ;
+        void set_vel(spp_real* v) {vel=v;} ;
+        /* Return the pointer to the array of agents.*/
+        Agent* get_agents() ;
+        /* Return how many agents are in the community.*/
+        int get_num_agents() ;
+        /* Return box size (the largest length if the
+         * box is not cubic).
+         */
+        double get_box_size() ;
+        /* Return the pointer to the DIM box lengths. */
+        double* get_box_lengths() {return box_lengths;} ;
+        /* Return true if the box lengths are all the same. */
+        bool is_cubic() {return cubic;} ;
+        /* Store random values in the position array *pos*.
+         * The values for each dimension *d* are in the
+         * [0:box_lengths[d]] range.
+         */
+        void randomize_positions();
+        /* Distribute the agents in a regular grid.
+         * The spacing between agents is about the same in all
+         * dimensions: in a cubic box there are ceil(num_agents**(1/dim))
+         * agents per dimension, and in a rectangular box the number
+         * along each dimension is proportional to its length.
+         * If num_agents does not fill the grid, it will be
+         * incomplete and the density will not be constant.
+         */
+        void regular_positions();
+        /* Store random values in the velocity array *vel*.
+         * Each random velocity has fixed norm *v0*.
+         */
+        void randomize_directions(double v0) ;
+        /* Move all the agents during *dt* time, meaning
+         * pos += dt * vel
+         */
+        void move(double dt) ;
+        /* Move all the agents during *dt* time, assuming
+         * periodic boundary conditions in each direction.
+         * If image counters are set (see setup_images), they
+         * count how many times each agent crossed the box.
+         */
+        void periodic_move(double dt) ;
+        /* Set the boundaries along each dimension: *periodic[i]*
+         * 1 if the dimension *i* is periodic (the default) or 0 if
+         * the box has hard walls at 0 and box_lengths[i] along it,
+         * e.g. {1, 0} for a channel along x. They are used by
+         * walled_move and max_distance, and by the Grid (see
+         * setup_grid). The geometry of the interactions should
+         * have the same boundaries (see CartesianWalled).
+         */
+        void set_boundaries(int* periodic) ;
+        /* Return 1 if the dimension *d* is periodic, 0 if it has walls. */
+        int is_periodic(int d) {return periodic[d];} ;
+        /* Move all the agents during *dt* time with the boundaries
+         * set by set_boundaries: an agent that crosses a wall is
+         * reflected back into the box (specular reflection: its
+         * position is mirrored at the wall and its velocity along
+         * that dimension reversed), and along the periodic dimensions
+         * it moves as in periodic_move, counting the images if set.
+         */
+        void walled_move(double dt) ;
+        /* Start counting the periodic images crossed by each agent
+         * in periodic_move, so that the unwrapped positions
+         *      pos[i] + images[i] * box_lengths[i % DIM]
+         * are known, e.g. for the mean squared displacement.
+         * *img* is an array of num_agents * DIM ints provided by the
+         * user, set to zero here. Pass NULL to stop counting.
+         */
+        void setup_images(int* img) ;
+        /* Return the pointer to the image counters (NULL if not set). */
+        int* get_images() {return images;} ;
+        /* Store in *upos* (num_agents * DIM doubles) the unwrapped
+         * positions of the agents, or the positions in the box if the
+         * image counters are not set.
+         */
+        void unwrapped_positions(double* upos) ;
+        /* Sense the consensus velocities using
+         * each agent's behavior and store the
+         * result in *vel_sensed*.
+         * Calls Agent->behavior->sense_velocity
+         * and uses a Grid if setup. If using
+         * Grid, each call to this also fills the grid.
+         * Note: it is not safe to use the class'
+         * own *vel* as *vel_sensed*.
+         */
+        void sense_velocities(spp_real* vel_sensed) ;
+        /* Same as sense_velocities but calls the
+         * Agent->behavior->sense_nosiy_velocity
+         * method. If the behavior has separable noise
+         * (e.g. Vicsek_consensus), the noiseless velocities
+         * are sensed first and the noise is added with a
+         * single call to Behavior::add_noise for all
+         * the consecutive agents sharing that behavior.
+         * Note: it is not safe to use the class'
+         * own *vel* as *vel_sensed*.
+         */
+        void sense_noisy_velocities(spp_real* vel_sensed) ;
+        /* Store in *forces* the total force of *force* on each
+         * agent (num_agents * DIM values), using the Grid if set.
+         * The slots of the Grid must be at least as large as
+         * force->range(): with grid tuning (see set_grid_tuning)
+         * the range of the force is used by tune_grid from then on,
+         * otherwise tune the Grid by hand, e.g. calling
+         * tune_grid(force->range()).
+         * Used by the continuous-time integrators (see Langevin).
+         */
+        void sense_forces(Force* force, spp_real* forces) ;
+        /* Copy the values in *vel_sensed* to *vel*.
+         * This needs to be done separate from the sense_*
+         * method to make sure the velocities are
+         * updated synchronously.
+         */
+        void update_velocities(spp_real* vel_sensed) ;
+        /* Print the position and velocity of each
+         * agent to stdin. The format used is
+         * x    y   vz  vz                  (2D)
+         * x    y   z   vz  vy  vz          (3D)
+         * Prints two blank lines at the end.
+         */
+        void print_posvel() ;
+        /* Store the mean position (center of mass)
+         * of all the agents in *meanpos*.
+         */
+        void mean_position(double* meanpos) ;
+        /* Store the mean position (center of mass)
+         * of all the agents in *meanpos*. Takes
+         * into account the periodic boundary
+         * conditions to compute a "mean angular position".
+         * See https://en.wikipedia.org/wiki/Center_of_mass#Systems_with_periodic_boundary_conditions
+         */
+        void mean_periodic_position(double* meanpos) ;
+        /* Store the mean velocity
+         * of all the agents in *meanvel*.
+         * Return the norm^2 of the mean.
+         */
+        double mean_velocity(double* meanvel) ;
+        /* Return the order parameter of velocity alignment,
+         * defined as
+         *      op = sqrt{|(1/N)\sum_{i=0}^N v_i|^2} / v0
+         *  (the norm of the mean velocity divided by *v0*.)
+         *  If the norm of each velocity is =< v0, then the
+         *  order parameter is a number between 0 and 1.
+         *  The higher the order parameter, the more aligned
+         *  the agents are.
+         */
+        double order_parameter(double v0) ;
+        /* Compute the normalized fluctuations in velocity as defined in
+         *      PLoS Comput Biol 10, e1003697 (2014)
+         * The normalization assumes that all the agents have the same
+         * speed *v0* because it simplifies the normalization to
+         *      (1/N) sum_k |dv_k|^2 = <v^2> - <v>^2 = v0^2 - |V|^2 .
+         *
+         * The array *fluctuations* should be of size num_agents * dim,
+         * it can allocated with spp_community_alloc_space.
+         */
+        void velocity_fluctuations(spp_real* fluctuations, double v0) ;
+        /* Compute the correlations in velocity fluctuations in the system.
+         * Mathematical formulation based on the work by Attanasi et al. in
+         *      PLoS Comput Biol 10, e1003697 (2014)
+         *
+         * The function computes the total correlation *totalcorr* and the
+         * count of pairs of agents at a certain distance *count* separate
+         * instead of returning just *totalcorr/count* (Eq 2) to be able
+         * to compute correctly the cumulative correlation (Eq 3) and
+         * the susceptibility.
+         * The total correlation at the bin *i*, *totalcorr[i]*, corresponds
+         * to the sum of correlations between agents at a distance *r* such
+         * that
+         *      i * max_dist() / n_bins < r < (i+1) * max_dist() / n_bins
+         * The *count[i]* is the number of agents at such a distance from
+         * each other.
+         *
+         * WARNING: The normalizing factor *norm* assumes that all the agents
+         * have velocity with modulus *v0*.
+         */
+        void correlation_histo(int n_bins, double v0, double* totalcorr, int* count) ;
+        /* Approximate correlation_histo using the Mesh *mesh*, covering
+         * the same (periodic) box. The velocity fluctuations (see
+         * velocity_fluctuations) are deposited on the mesh and the sum
+         * of their products for all the pairs of cells is computed with
+         * FFTs, in O(M log M) for M cells instead of O(N^2). The distance
+         * between two agents is approximated by the distance between their
+         * cells, so the result is accurate for bins larger than a cell.
+         * The output is the same as in correlation_histo.
+         * The Mesh is cubic and periodic, so the box must be cubic
+         * with no walls too (as for structure_factors and fields);
+         * otherwise an error is printed and nothing is computed.
+         */
+        void correlation_histo_fft(int n_bins, double v0, Mesh* mesh, double* totalcorr, int* count) ;
+        /* Compute the density and velocity structure factors using *mesh*,
+         *      s_density[b] = < |rho(k)|^2 > / N
+         *      s_velocity[b] = < |u(k)|^2 > / N
+         * where rho(k) is the Fourier transform of the density and u(k)
+         * that of the velocity fluctuations (see velocity_fluctuations),
+         * averaged over the *num_modes[b]* wave vectors with modulus in the
+         * bin *b*, of width 2 pi / L centered at b * 2 pi / L. The values
+         * are accurate for wave numbers well below pi / (cell size).
+         */
+        void structure_factors(int n_bins, double v0, Mesh* mesh, double* s_density, double* s_velocity, int* num_modes) ;
+        /* Compute the coarse-grained density and velocity fields on the
+         * cells of *mesh*, e.g. to find the bands of the Vicsek model:
+         *      density[c] = number of agents per unit volume in cell *c*
+         *      velocity[c*DIM + d] = mean velocity along *d* in cell *c*
+         *          (0 in the empty cells)
+         * with *density* of size mesh->get_num_cells() and *velocity*
+         * DIM times larger. If *cic* is not 0 the agents are deposited
+         * with cloud in cell (see Mesh::deposit_cic) instead of in the
+         * cell containing them. The local polarization is the modulus of
+         * the velocity divided by the speed of the agents. The fields can
+         * be written with Mesh::write_frame.
+         */
+        void fields(Mesh* mesh, int cic, double* density, double* velocity) ;
+        /* Return the distance between the two farthest points in
+         * the computation box, with its boundaries (periodic by
+         * default, see set_boundaries).
+         */
+        double max_distance() ;
+        /* Build a "matrix" containing who is connected with whom.
+         * network[i][j] is a pointer to agent-i's j-th neighbor.
+         * num_neis contains the number of neighbors for each agent,
+         * so that the size of the array network[i] is num_neis[i].
+         * Both num_neis and network should be of length equal to
+         * the number of agents. The allocation for the network[i]
+         * arrays is done internally.
+         * Returns the total number of connexions (sum of num_neis).
+         */
+        int build_network(int* num_neis, Agent*** network) ;
+        /* Print the network obtained from build_network.
+         * Right now each agent is identified by its location
+         * in the *agents* array, i.e. something like
+         *       3 -- 7 ;
+         * means that the third agent is connected with the
+         * seventh.
+         */
+        void print_network(int* num_neis, Agent*** network) ;
+        /* Find the clusters (flocks) of the interaction network: two
+         * agents are in the same cluster if there is a path of neighbors
+         * between them, regardless of the direction of the links.
+         * Uses the Grid if set up, and a union-find structure so that
+         * the cost is that of finding the neighbors of every agent.
+         * Outputs:
+         *      labels[i] = cluster of agent *i*, numbered from 0 in
+         *          order of appearance, size num_agents.
+         *      sizes[c] = number of agents in the cluster *c*, the
+         *          array must be of size num_agents.
+         * Returns the number of clusters.
+         */
+        int clusters(int* labels, int* sizes) ;
+        /* Same as clusters() but linking the agents at a distance
+         * smaller or equal to *radius*, whatever their interaction.
+         * Uses cell lists of size >= *radius* built on the fly.
+         */
+        int clusters_metric(double radius, int* labels, int* sizes) ;
+        /* Store in *histo* (of size num_agents+1) the number of
+         * clusters of each size, from the *sizes* of the
+         * *num_clusters* clusters found by clusters().
+         */
+        void cluster_size_histo(int num_clusters, int* sizes, int* histo) ;
+        /* Start using a Grid to compute
+         * the neighbors of each agent.
+         * The Grid instance *g* has to
+         * be initialized by the user before
+         * calling this function. It gets the
+         * boundaries of the Community (see
+         * set_boundaries).
+         */
+        void setup_grid(Grid* g) ;
+        /* Same with a HashGrid, for agents in open space,
+         * in place of the Grid.
+         */
+        void setup_grid(HashGrid* g) ;
+        /* Choose the number of slots of the Grid from the range of
+         * the interactions of the agents (see Interaction::range),
+         * the largest one over all the interactions, and the number
+         * of agents (see Grid::tune). Return the number of slots, or
+         * 0 if there is no Grid. If the range of some interaction is
+         * not known (e.g. Topologic before the first step) the Grid
+         * is not changed. The slots are not smaller than the range of
+         * the last Force given to sense_forces either.
+         */
+        int tune_grid() ;
+        /* Same, with slots not smaller than *min_range* either
+         * (instead of the range of the Force).
+         */
+        int tune_grid(double min_range) ;
+        /* Call tune_grid() every *interval* times the grid is filled
+         * (0 to never do it, the default), and every time until the
+         * range of the interactions is known, so that the slots
+         * follow the interaction range as the density changes.
+         */
+        void set_grid_tuning(int interval) ;
+        /* Start bouncing the agents off the obstacles *obs* (see
+         * Obstacles::reflect) at the end of move, periodic_move and
+         * walled_move. Pass NULL to stop it. It builds the index of
+         * *obs* (see Obstacles::build). To also steer the agents
+         * away from them use a Vicsek_avoider behavior.
+         */
+        void setup_obstacles(Obstacles* obs) ;
+        /* Fill the grid calling its own
+         * fill_grid method, tuning it first
+         * if set (see set_grid_tuning). This method
+         * does NOT check that if grid has
+         * been setup or not.
+         */
+        void fill_grid() ;
+        /* Call Interaction::prepare (and set_grid with the
+         * Grid in use) for the interaction of every agent, once
+         * per consecutive group of agents sharing it. Called by
+         * the sense_* methods and build_network.
+         */
+        void prepare_interactions() ;
+        /* Print to *out* the time spent in each phase of the step
+         * (grid fill, sensing, neighbor search, noise, move and
+         * observables), the neighbors per search, and the time per
+         * step, counted since the last spp_profile_reset() in the
+         * thread running the community. Requires the library to be
+         * compiled with -DSPP_PROFILE (see profile.h).
+         */
+        void print_profile(FILE* out) ;
+        /* Same as print_profile but in one line of JSON. */
+        void dump_profile(FILE* out) ;
+    protected:
+        /* Number of agents. */
+        int num_agents ;
+        /* positions of the agents
+         *      Size: num_agents * DIM
+         */
+        spp_real* pos ;
+        /* velocities of the agents
+         *      Size: num_agents * DIM
+         */
+        spp_real* vel ;
+        /* Array of agents
+         *      Size: num_agents
+         */
+        Agent* agents ;
+        /* Set the box lengths to the DIM values *ls*,
+         * and *box_size* and *cubic* accordingly.
+         */
+        void set_box_lengths(double* ls) ;
+        /* Return 1 if the box is cubic and periodic along every
+         * dimension, as the Mesh, otherwise print an error for the
+         * method *name* and return 0.
+         */
+        int check_cubic(const char* name) ;
+        /* Box size, the largest of the box lengths. */
+        double box_size ;
+        /* Length of the box along each dimension,
+         * and whether they are all the same.
+         */
+        double box_lengths[SPP_MAX_DIM] ;
+        bool cubic ;
+        /* 1 if the dimension is periodic, 0 if it has walls,
+         * and whether all of them are periodic.
+         */
+        int periodic[SPP_MAX_DIM] ;
+        bool all_periodic ;
+        /* False by default. Turns to True
+         * when a Grid instance is inseted
+         * in Community through setup_grid().
+         */
+        bool use_grid ;
+        /* Grid instance to store the coarse
+         * location of each agent. See Grid
+         * documentation for more info.
+         * Is it initialized to NULL and can
+         * be set with setup_grid().
+         */
+        Grid* grid ;
+        /* HashGrid used instead of *grid* (only one of
+         * them is not NULL), see setup_grid().
+         */
+        HashGrid* hash_grid ;
+        /* Return the neighborhood of *ag* in the grid in use
+         * and store its size in *num_neis*.
+         */
+        Agent* get_neighborhood(Agent* ag, int* num_neis) ;
+        /* Fills of the grid between calls to tune_grid
+         * (0 = never), fills since the last call, and
+         * whether it found the range of the interactions.
+         */
+        int grid_tuning ;
+        int grid_fills ;
+        bool grid_tuned ;
+        /* Range of the last Force given to sense_forces,
+         * the smallest size of the slots for tune_grid.
+         */
+        double force_range ;
+        /* Number of times each agent crossed the box in each
+         * direction (positive when going up), or NULL.
+         *      Size: num_agents * DIM
+         */
+        int* images ;
+        /* Obstacles the agents bounce off, or NULL. */
+        Obstacles* obstacles ;
+        /* Reflect the agents that entered an obstacle, and bring
+         * those pushed out of the box back to it: wrapped around
+         * (counting the crossing in *images*) along the dimensions
+         * with *wrap[d]* 1, and kept inside the walls along the
+         * others. *wrap* is NULL in open space.
+         */
+        void collide_obstacles(int* wrap) ;
+} ;
+
+// Utils for automatization of the setup of a Community.
+
+/* Allocate space for storing a vector per agent,
+ * i.e. num_agents * DIM spp_reals, and return the
+ * pointer to the array.
+ */
+spp_real* spp_community_alloc_space(int num_agents) ;
+/* Allocate space for a vector of Agent instances
+ * and return the pointer to the array.
+ */
+Agent* spp_community_alloc_agents(int num_agents) ;
+/* Allocate space for a vector of Agent POINTERS
+ * and return the pointer to the array.
+ */
+Agent** spp_community_alloc_neighbors(int num_agents) ;
+/* Construct an array of *num_agents* Agents where
+ * each agent uses consequetive slots of pos (vel) to
+ * store its position (velocity). All the agents
+ * have the same behavior *behavior* and the same
+ * list to store pointers to neighbors *neis*.
+ *
+ * WARNING: All the agents sharing the same *neis*
+ * can yield to problems if paralelization is used.
+ *
+ * TODO add a spp_community_build_agents_parallel(...)
+ */
+Agent* spp_community_build_agents(int num_agents, spp_real* pos, spp_real* vel, Agent** neis, Behavior* behavior) ;
+/* Return a Community instance "ready to use" from scratch.
+ * Allocate the required space, initialize the agents
+ * and randomize their positions and velocities.
+ * The speed *speed* is only used to randomize velocities
+ * with a constant norm.
+ *
+ * Uses spp_community_alloc_neighbors and the returned Community
+ * is therefore not thread-safe for parallelization.
+ */
+Community spp_community_autostart(int num_agents, double speed, double box_size, Behavior* behavior) ;
+/* Same as spp_community_autostart for a
+ * rectangular box with the DIM lengths *box_lengths*.
+ */
+Community spp_community_autostart(int num_agents, double speed, double* box_lengths, Behavior* behavior) ;
+/* Free the space allocated by spp_community_autostart for *com*:
+ * its agents, positions, velocities and the list of neighbors
+ * they share. The Community must not be used afterwards.
+ */
+void spp_community_free(Community* com) ;
+
+class Force ;
+
+/*
+ * Abstract Langevin class used as a template for
+ * continuous-time models of active particles in the
+ * overdamped limit, integrated with the Euler-Maruyama
+ * scheme: each agent moves during a time step *dt* with
+ * the velocity
+ *      vel = prop + mobility * F + sqrt(2 diffusion / dt) xi
+ * where *prop* is its self-propulsion velocity, *F* the
+ * total force of the other agents (see Force), and *xi*
+ * a vector of independent normal random numbers (the
+ * translational noise). The update of the self-propulsion
+ * defines the model, and must be implemented in:
+ *
+ *      propel: advance the self-propulsion of all the
+ *          agents during a time *dt*.
+ *
+ * The Langevin instance works on a Community, whose Grid
+ * (if set) is used to compute the forces. The velocities
+ * are sensed and then updated and the agents moved with
+ * the methods of the Community, as in the Vicsek model:
+ *
+ *      lang.sense_velocities(dt, v2) ;
+ *      com.update_velocities(v2) ;
+ *      com.periodic_move(dt) ;
+ *
+ * The Behavior of the agents is not used.
+ */
+class Langevin {
+    public:
+        /* pure virtual, must be implemented */
+        virtual void propel(double dt) = 0 ;
+        /* Advance the self-propulsion during *dt* (propel),
+         * compute the forces and store in *vel_sensed* the
+         * velocity of each agent during the step (see above).
+         * The last loop runs over the num_agents * DIM
+         * components at once, so the compiler can vectorize it.
+         */
+        void sense_velocities(double dt, spp_real* vel_sensed) ;
+        /* Return the array with the self-propulsion velocity
+         * of each agent (num_agents * DIM values).
+         */
+        spp_real* get_propulsion() {return prop;} ;
+        /* Return the array with the force on each agent
+         * computed in the last call to sense_velocities.
+         */
+        spp_real* get_forces() {return forces;} ;
+        /* Return the norm of the mean self-propulsion
+         * divided by *v0*, the polarization of the swarm.
+         */
+        double order_parameter(double v0) ;
+    protected:
+        /* Set the common parameters and allocate the
+         * arrays, with the self-propulsion set to the
+         * current velocities of the agents of *com*.
+         */
+        void init(Community* com, Force* force, double mobility, double diffusion) ;
+        Community* com ;
+        Force* force ;
+        int num_agents ;
+        double mobility ;
+        /* Translational diffusion coefficient. */
+        double diffusion ;
+        /* self-propulsion, forces and random numbers
+         *      Size: num_agents * DIM
+         */
+        spp_real* prop ;
+        spp_real* forces ;
+        spp_real* xi ;
+} ;
+
+/*
+ * Active Brownian particles: each agent moves
+ * with a constant speed *v0* along its heading,
+ * which diffuses on the unit sphere with the
+ * rotational diffusion coefficient *d_rot*, so
+ * that the persistence time is 1/((DIM-1) d_rot).
+ * In 2D the heading turns by a normal random angle
+ * of variance 2 d_rot dt per step; in 3D it turns
+ * towards a random kick with normal components of
+ * that variance perpendicular to it, by the norm
+ * of the kick.
+ * The initial headings are those of the velocities
+ * of the agents.
+ */
+class ActiveBrownian : public Langevin {
+    public:
+        ActiveBrownian(Community* com, Force* force, double v0, double mobility, double d_rot, double diffusion) ;
+        /* Rotate the headings by the rotational diffusion. */
+        void propel(double dt) ;
+    protected:
+        double v0 ;
+        double d_rot ;
+} ;
+
+/*
+ * Active Ornstein-Uhlenbeck particles: the
+ * self-propulsion velocity of each agent is an
+ * Ornstein-Uhlenbeck process with persistence time
+ * *tau* and mean squared norm *v0*^2,
+ *      d prop = - prop dt / tau + v0 sqrt(2 / (DIM tau)) dW
+ * updated with its exact solution over each step, so
+ * that any *dt* can be used. The initial self-propulsion
+ * is the velocities of the agents.
+ */
+class ActiveOU : public Langevin {
+    public:
+        ActiveOU(Community* com, Force* force, double v0, double mobility, double tau, double diffusion) ;
+        /* Advance the Ornstein-Uhlenbeck processes. */
+        void propel(double dt) ;
+    protected:
+        double v0 ;
+        double tau ;
+} ;
+
+/*
+ * Alignment with all the agents of a Community, with a
+ * weight that decays as a power law of the distance *r*,
+ *      w(r) = (1 + r^2 / scale^2)^(-exponent/2)
+ * (the SPP_WEIGHT_POWER kernel of Vicsek_weighted). The
+ * velocity sensed by each agent is the weighted sum of
+ * the velocities of all the agents (itself included, with
+ * weight 1), re-scaled to have a *v0* norm.
+ *
+ * The sum over all the pairs is approximated with a
+ * Barnes-Hut tree, in O(N log N) operations: the agents
+ * are sorted in a tree of cells (quadtree in 2D, octree
+ * in 3D) with at most a few agents per leaf, and each
+ * cell keeps the mean position and the sum of the
+ * velocities of its agents. A cell of side *size* at a
+ * distance *d* from the agent whose
+ *      size < theta * d
+ * contributes the sum of its velocities times w(d) as
+ * a whole; otherwise its children are checked, down to
+ * the leaves, whose agents are added one by one. The
+ * error decreases with *theta* (0.5 is a usual value),
+ * and theta = 0 gives the exact sum, in O(N^2).
+ * The distances are those of *g*, the nearest image in
+ * a periodic box, and the tree is rebuilt at every call.
+ * Along the periodic dimensions of *g* (see
+ * Geometry::is_periodic) a cell that crosses the plane
+ * half a box away from the agent has agents with
+ * different nearest images: it is only taken as a whole
+ * if size < theta^2 * d, and never if it spans half a
+ * box, so that its error is of the same order as that
+ * of the other cells.
+ *
+ * The velocities are sensed and then updated with the
+ * methods of the Community, with the noise of the
+ * Behavior added in between, as in the Vicsek model:
+ *
+ *      align.sense_velocities(v2) ;
+ *      behavior.add_noise(num_agents, v2) ;
+ *      com.update_velocities(v2) ;
+ *      com.periodic_move(dt) ;
+ *
+ * The Interaction and Grid of the Community are not used.
+ */
+class LongRangeAlignment {
+    public:
+        LongRangeAlignment(Community* com, Geometry* g, double v0, double scale, double exponent, double theta) ;
+        /* Store in *vel_sensed* the velocity sensed by
+         * each agent (num_agents * DIM values).
+         */
+        void sense_velocities(spp_real* vel_sensed) ;
+        /* Set the opening parameter *theta*. */
+        void set_theta(double t) {theta = t;} ;
+        /* Return the mean number of terms (agents plus
+         * cells) summed per agent in the last call to
+         * sense_velocities, num_agents for the exact sum.
+         */
+        double mean_terms() {return (double) num_terms / num_agents;} ;
+        /* Return the number of cells of the last tree. */
+        int get_num_cells() {return num_cells;} ;
+    protected:
+        /* Build the tree with the current positions. */
+        void build() ;
+        /* Split cell *c* in its children, recursively. */
+        void split(int c, int depth) ;
+        /* Return a new cell with the *n* agents from
+         * *first* in *order*, of side *size*.
+         */
+        int new_cell(int first, int n, spp_real size) ;
+        /* Double the space for cells. */
+        void grow() ;
+        Community* com ;
+        Geometry* g ;
+        int num_agents ;
+        double v0 ;
+        double scale ;
+        double exponent ;
+        double theta ;
+        long num_terms ;
+        /* Agents sorted by cell: the agents of cell *c*
+         * are order[cell_first[c] : cell_first[c] + cell_n[c]]
+         *      Size: num_agents
+         */
+        int* order ;
+        /* Child of each agent of a cell being split,
+         * and the agents sorted by child.
+         *      Size: 2 * num_agents
+         */
+        int* scratch ;
+        /* Cells, with space for *max_cells*: first agent,
+         * number of agents, first child (children are
+         * consecutive, -1 for a leaf), number of children,
+         * side, corner (lowest coordinates), mean position
+         * and sum of the velocities of the agents.
+         */
+        int num_cells ;
+        int max_cells ;
+        int* cell_first ;
+        int* cell_n ;
+        int* cell_child ;
+        int* cell_nchild ;
+        spp_real* cell_size ;
+        spp_real* cell_corner ;
+        spp_real* cell_center ;
+        spp_real* cell_vel ;
+        /* First moment of the velocities, the sum over the
+         * agents of vel[d] * (pos[e] - center[e]), at d*DIM + e.
+         */
+        spp_real* cell_dip ;
+        /* Cells to check while walking the tree. */
+        int* stack ;
+} ;
+
+/* Kinds of events of an EventLog. */
+#define SPP_EVENT_KILL      0
+#define SPP_EVENT_FLEE      1
+#define SPP_EVENT_FLEEING   2
+#define SPP_EVENT_TARGET    3
+
+/*
+ * One record of an EventLog, 28 bytes in both 2D and 3D
+ * (x always has SPP_MAX_DIM floats):
+ *      type    SPP_EVENT_*
+ *      step    step set with EventLog::set_step
+ *      a, b    identifiers, depending on the type
+ *      x       a position (only DIM values are used)
+ */
+typedef struct {
+    int type ;
+    int step ;
+    int a ;
+    int b ;
+    float x[SPP_MAX_DIM] ;
+} spp_event ;
+
+/*
+ * Binary stream of the events of a HostileEnvironment
+ * (see HostileEnvironment::setup_events), with the
+ * agents identified by the index they had when the
+ * HostileEnvironment was created (see get_ids):
+ *      SPP_EVENT_KILL      a = predator, b = prey,
+ *          x = position of the prey when caught.
+ *      SPP_EVENT_FLEE      a = prey, b = closest predator
+ *          (-1 if there are none), x = position of the prey,
+ *          when the prey starts fleeing (it did not the
+ *          step before).
+ *      SPP_EVENT_FLEEING   a = number of fleeing preys,
+ *          b = number of preys, once per step.
+ *      SPP_EVENT_TARGET    a = predator, b = new prey,
+ *          x = position of the predator, when the
+ *          predator chases a different prey.
+ *
+ * The events are stored in a buffer of *capacity*
+ * records that is written to the file when full, so
+ * logging an event only copies one record. The stream
+ * starts with the header, in the native byte order,
+ *      "SPPE"          4 chars
+ *      DIM             int (4 bytes)
+ *      record size     int (4 bytes)
+ * followed by the records, which can be read with
+ * numpy as a structured array of 4 int32 and
+ * SPP_MAX_DIM float32 fields.
+ * Call flush() at the end to write the last events.
+ */
+class EventLog {
+    public:
+        /* Write the header to *out*, already open for
+         * writing, and allocate space for *capacity* events.
+         * If *out* is NULL an error is printed and the
+         * events are discarded (flush returns -1).
+         */
+        EventLog(FILE* out, int capacity) ;
+        /* Set the step of the next events. */
+        void set_step(int s) {step = s;} ;
+        /* Add an event, with *x* NULL to leave the position at 0. */
+        void add(int type, int a, int b, spp_real* x) ;
+        /* Write the events in the buffer to the file.
+         * Returns 0 on success, -1 if the writing failed.
+         */
+        int flush() ;
+        /* Return the number of events added. */
+        long get_num_events() {return num_events;} ;
+    protected:
+        FILE* out ;
+        int step ;
+        int capacity ;
+        int num_buffered ;
+        long num_events ;
+        spp_event* buffer ;
+} ;
+
+/*
+ * Extension of Community to handle
+ * systems containing two kinds of agents:
+ * predators and preys.
+ * The *ags* (preys) and the *preds* (predator)
+ * should have the appropiate behavior with
+ * sense_danger() for preys, and sense_victims()
+ * and hunt() for predators.
+ *
+ * This class is designed with a small number
+ * of predators in mind. It should work with
+ * any number of predators, but it does not
+ * implement the same performance improvements
+ * for large number of agents for the predators.
+ * TODO Test this with number of predators >1.
+ *
+ */
+class HostileEnvironment : public Community{
+    public:
+        /* Construct the HostileEnvironment class.
+         * Inputs:
+         *      nags = number of agents (preys)
+         *      in the community.
+         *      L = size of box. It is fixed
+         *      to be the same in all directions
+         *      for facilitating the use of a Grid.
+         *      ags = pointer to the array storing
+         *      the *nags* Agent instances (preys).
+         *      p = pointer to the array to store
+         *      the positions of agents
+         *      (size depens on DIM).
+         *      v = pointer to the array to store
+         *      the velocities of agents
+         *      (size depens on DIM).
+         *      npreds = number of agent predators
+         *      in the community.
+         *      ags = pointer to the array storing
+         *      the *npred* Agent instances
+         *      (predators).
+         */
+        HostileEnvironment(int nags , double L, Agent* ags , spp_real* p, spp_real* v, int npreds , Agent* preds) ;
+        /* Return the pointer to the array of agents (predators).*/
+        Agent* get_predators() ;
+        /* Same as Community::sense_velocity but also
+         * calls the sense_danger() method of *ags*.
+         * Returns the number of agents fleeing from
+         * a predator.
+         */
+        int sense_velocities_danger(spp_real* vel_sensed) ;
+        /* same as sense_velocities_danger() but using
+         * sense_noisy_velocity() instead of sense_velocity().
+         */
+        int sense_noisy_velocities_danger(spp_real* vel_sensed) ;
+        /* Move the predator towards the closest prey. If
+         * the predator can catch the prey, remove the prey
+         * from the community using the remove_dead() function.
+         * For some application, you may want to change this
+         * function so that it calls replace_dead() instead.
+         * Returns the number of agents removed.
+         */
+        int hunt(double dt) ;
+        /* Remove *ags[ia]* from the community. This function
+         * reduces *num_agents* by one and rearranges the agents
+         * in *ags*. The size of *ags* does not change.
+         */
+        virtual void remove_dead(int ia) ;
+        /* Replace *ags[ia]* by a new agent with consensus
+         * velocity, generated as far as possible from
+         * the dead one.
+         */
+        virtual void replace_dead(int ia) ;
+        /* Same as Community::print_posvel() but for
+         * the position and velocity of the predators.
+         */
+        void print_predators_posvel() ;
+        /* Log the kills, the fleeing preys and the changes
+         * of target of the predators in *events* (see
+         * EventLog), or stop logging if it is NULL.
+         */
+        void setup_events(EventLog* events) ;
+        /* Return the identifier of each prey: the index it
+         * had when the HostileEnvironment was created, which
+         * remove_dead keeps as the preys are rearranged.
+         * New preys of replace_dead get new identifiers.
+         *      Size: num_agents
+         */
+        int* get_ids() {return ids;} ;
+    protected:
+        /* Log the prey *ia* if it starts fleeing, given
+         * the result *fleeing* of its sense_danger. The
+         * predator it flees from is taken to be the
+         * closest one.
+         */
+        void log_flee(int ia, int fleeing) ;
+        /* Number of predators. */
+        int num_predators ;
+        /* Array of predator agents
+         *      Size: num_predators
+         */
+        Agent* predators ;
+        /* Identifier of each prey and the next new one. */
+        int* ids ;
+        int next_id ;
+        /* Events, or NULL. */
+        EventLog* events ;
+        /* Whether each prey fled in the last step, and
+         * the identifier of the prey chased by each
+         * predator (-1 for none), for the events.
+         */
+        char* fled ;
+        int* targets ;
+} ;
+
+/* Similar as spp_community_autostart.
+ * Return a HostileEnvironment instance "ready to use" from scratch.
+ * Allocate the required space, initialize the agents
+ * and randomize their positions and velocities.
+ * The speed *speed* is only used to randomize velocities
+ * with a constant norm.
+ * The predators start at a random position with 0 velocity.
+ *
+ * Uses spp_community_alloc_neighbors and the returned Community
+ * is therefore not thread-safe for parallelization.
+ */
+HostileEnvironment spp_hostile_autostart(int num_agents, double speed, double box_size, Behavior* agsbeh, int num_predators, Behavior* predsbeh) ;
+
+/*
+ * ReplicaCommunity class implemented to advance many
+ * independent replicas of a small system in lockstep.
+ * All the replicas have the same number of agents
+ * and follow the Vicsek model with metric interaction
+ * in a periodic box (see Vicsek_consensus and Metric),
+ * but each one has its own positions, velocities and
+ * stream of random numbers.
+ *
+ * The state is stored replica-interleaved: the
+ * component *d* of the position of agent *i* in
+ * replica *r* is
+ *      pos[(i*DIM + d)*num_replicas + r]
+ * so that every kernel that does the same for all the
+ * agents (normalization, noise, move, random numbers,
+ * order parameter, pair correlations) loops over the
+ * replicas in the innermost loop and is vectorized by
+ * the compiler, processing several replicas per vector
+ * instruction. The neighbors, which are different in
+ * each replica, are found with a cell list per replica
+ * when the box is at least three interaction radii long,
+ * and with a vectorized loop over all the pairs of
+ * all the replicas otherwise.
+ *
+ * The random numbers use the same generator as
+ * spp_random_uniform (shr3) with one state per replica,
+ * so they do NOT depend on spp_set_seed.
+ *
+ * As with Community, the user allocates the positions
+ * and velocities (see spp_replica_alloc_space). The
+ * cell lists and the temporary arrays for the noise,
+ * of order num_agents*num_replicas, are allocated on
+ * initialization.
+ */
+class ReplicaCommunity{
+    public:
+        /* Construct the batch of replicas.
+         * Inputs:
+         *      nags = number of agents in each replica.
+         *      nreps = number of replicas.
+         *      L = size of the (periodic) box.
+         *      p, v = arrays to store the positions
+         *      and velocities, of size nags*nreps*DIM
+         *      (see spp_replica_alloc_space).
+         *      r = radius of the metric interaction.
+         *      v0 = speed of the agents.
+         *      noise = noise of the Vicsek model, in [0:1].
+         */
+        ReplicaCommunity(int nags, int nreps, double L, spp_real* p, spp_real* v, double r, double v0, double noise) ;
+        /* Seed the random number generator of each replica
+         * with the *num_replicas* values in *seeds*. Two
+         * replicas with the same seed follow the same
+         * trajectory.
+         */
+        void set_seeds(long int* seeds) ;
+        /* Return the pointer to the position array. */
+        spp_real* get_pos() {return pos;} ;
+        /* Return the pointer to the velocity array. */
+        spp_real* get_vel() {return vel;} ;
+        /* Return how many agents are in each replica. */
+        int get_num_agents() {return num_agents;} ;
+        /* Return how many replicas there are. */
+        int get_num_replicas() {return num_replicas;} ;
+        /* Return box size. */
+        double get_box_size() {return box_size;} ;
+        /* Store random values in the [0:box_size] range
+         * in the position array *pos*.
+         */
+        void randomize_positions() ;
+        /* Store random velocities of norm *v0* and
+         * homogeneous angular distribution in *vel*.
+         */
+        void randomize_directions(double v0) ;
+        /* Move all the agents during *dt* time, assuming
+         * periodic boundary conditions in each direction.
+         * *dt* * *v0* must be smaller than the box size.
+         */
+        void periodic_move(double dt) ;
+        /* Sense the noisy velocities of the Vicsek model
+         * for every agent of every replica and store them
+         * in *vel_sensed* (same layout as *vel*).
+         * Note: it is not safe to use the class'
+         * own *vel* as *vel_sensed*.
+         */
+        void sense_noisy_velocities(spp_real* vel_sensed) ;
+        /* Copy the values in *vel_sensed* to *vel*. */
+        void update_velocities(spp_real* vel_sensed) ;
+        /* Store the mean velocity of each replica in *meanvel*,
+         * component *d* of replica *r* in meanvel[d*num_replicas + r].
+         * The size of *meanvel* must be DIM*num_replicas.
+         */
+        void mean_velocity(double* meanvel) ;
+        /* Store the order parameter of each replica
+         * (see Community::order_parameter) in *op*,
+         * of size num_replicas.
+         */
+        void order_parameter(double v0, double* op) ;
+        /* Compute the correlations in velocity fluctuations
+         * of each replica as in Community::correlation_histo.
+         * The histogram of replica *r* is stored in
+         *      totalcorr[r*n_bins : (r+1)*n_bins]
+         *      count[r*n_bins : (r+1)*n_bins]
+         * so both arrays must be of size n_bins*num_replicas.
+         */
+        void correlation_histo(int n_bins, double v0, double* totalcorr, int* count) ;
+        /* Return the distance between the two farthest points in
+         * the computation box with periodic boundary conditions.
+         */
+        double max_distance() ;
+    protected:
+        /* Fill *u* with *n* uniform random numbers
+         * in [0:1) for each replica, u[k*num_replicas + r]
+         * for replica *r*.
+         */
+        void random_uniform(int n, spp_real* u) ;
+        /* Sum the velocities of the neighbors of every
+         * agent into *vs* using the cell lists.
+         */
+        void sum_neighbors_cells(spp_real* vs) ;
+        /* Sum the velocities of the neighbors of every
+         * agent into *vs* checking all the pairs.
+         */
+        void sum_neighbors_pairs(spp_real* vs) ;
+        /* Normalize the velocities in *vs* to *v0*
+         * and rotate them by a random angle.
+         */
+        void add_noise(spp_real* vs) ;
+        int num_agents ;
+        int num_replicas ;
+        /* State, see layout above.
+         *      Size: num_agents * DIM * num_replicas
+         */
+        spp_real* pos ;
+        spp_real* vel ;
+        double box_size ;
+        /* Parameters of the Vicsek model. */
+        spp_real rad2 ;
+        double v0 ;
+        double noise ;
+        /* Random number generator state of each replica
+         * (32 bits, as in random.cpp).
+         */
+        unsigned int* jsr ;
+        /* Random angles and their sines and cosines,
+         *      Size: num_agents * num_replicas
+         * (*azi*, *cph* and *sph* only in 3D).
+         */
+        spp_real *ang, *cth, *sth ;
+        spp_real *azi, *cph, *sph ;
+        /* Cell lists, one per replica, with *ncells* cells
+         * per dimension (0 if not used) and *num_cells* in total.
+         * The agents in cell *c* of replica *r* are stored in
+         *      cell_agents[r*num_agents + k]
+         * for k in cell_start[r*(num_cells+1) + c] to
+         * cell_start[r*(num_cells+1) + c + 1] - 1.
+         */
+        int ncells ;
+        int num_cells ;
+        int* cell_start ;
+        int* cell_agents ;
+        int* agent_cell ;
+} ;
+
+/* Allocate space for storing a vector per agent and
+ * replica, i.e. num_agents * DIM * num_replicas
+ * spp_reals, and return the pointer to the array.
+ */
+spp_real* spp_replica_alloc_space(int num_agents, int num_replicas) ;
+
+/*
+ * Domain class with the agents in a slab of the periodic
+ * box, used by DomainCommunity (and DistributedCommunity)
+ * to split a very large swarm in pieces.
+ *
+ * The box is divided in *ncx* x *ncy* (x *ncz*) cells at
+ * least as large as the interaction range, and the domain
+ * owns the agents in the columns of cells cx0 <= cx < cx1
+ * (a slab along x). To find the neighbors of its agents
+ * it also keeps a copy of the agents in the column just
+ * before and after the slab (the halo), provided by the
+ * owners of those columns.
+ *
+ * Each step:
+ *      move() moves the agents and takes out of the slab
+ *          the ones that left it (to be given to the owner
+ *          of their new column with add_agents()).
+ *      sort_cells() sorts the agents by cell, after which
+ *          the agents of each column are contiguous (see
+ *          column_range()) and can be copied to the halo of
+ *          the neighbor domains with add_halo().
+ *      sense() senses the noisy velocities of all the
+ *          agents in the slab with the domain's Behavior,
+ *          using only the agents in the surrounding cells as
+ *          candidates, and updates the velocities.
+ *
+ * All the arrays are allocated by the domain and grow as
+ * needed, and every agent has an *id* that does not change
+ * when it moves from one domain to another.
+ */
+class Domain {
+    public:
+        Domain() {lx_of = NULL;} ;
+        /* Free the arrays allocated by setup. */
+        ~Domain() ;
+        /* Setup the domain owning the columns *cx0* to *cx1*-1
+         * out of *ncx*, with *ncy* (and *ncz*, 1 in 2D) cells
+         * in the other directions, in a periodic box of size *L*.
+         * The agents use the behavior *beh*, and space for
+         * *capacity* agents is allocated initially.
+         */
+        void setup(int cx0, int cx1, int ncx, int ncy, int ncz, double L, Behavior* beh, int capacity) ;
+        /* Add *n* agents to the slab, with positions *p*,
+         * velocities *v* and ids *id*.
+         */
+        void add_agents(int n, spp_real* p, spp_real* v, long int* id) ;
+        /* Add *n* agents with positions *p* and velocities *v*,
+         * all in the column *cx*, to the halo.
+         */
+        void add_halo(int cx, int n, spp_real* p, spp_real* v) ;
+        /* Move the agents during *dt* with periodic boundary
+         * conditions and move the agents that left the slab to
+         * the outgoing arrays *out_pos*, *out_vel*, *out_ids*,
+         * storing their new column in *out_col*.
+         */
+        void move(double dt) ;
+        /* Sort the agents of the slab by cell, and empty the halo. */
+        void sort_cells() ;
+        /* Store in *first* and *n* the range of agents of the
+         * column *cx* of the slab. Requires sort_cells().
+         */
+        void column_range(int cx, int* first, int* n) ;
+        /* Sense the noisy velocities of the agents of the slab
+         * and update their velocities.
+         */
+        void sense() ;
+        /* Add the sum of the velocities of the agents
+         * of the slab to *sum*.
+         */
+        void sum_velocity(double* sum) ;
+        /* Return the column of the position *p*. */
+        int column(spp_real* p) ;
+        /* Columns owned, cx0 <= cx < cx1. */
+        int cx0, cx1 ;
+        /* Stream of random numbers of the domain. */
+        spp_rng rng ;
+        /* Agents of the slab: positions, velocities and ids. */
+        int num_agents ;
+        spp_real* pos ;
+        spp_real* vel ;
+        long int* ids ;
+        /* Agents that left the slab in the last move(). */
+        int num_out ;
+        spp_real* out_pos ;
+        spp_real* out_vel ;
+        long int* out_ids ;
+        int* out_col ;
+    protected:
+        /* Return the local cell of the position *p*,
+         * or -1 if its column is not owned nor halo.
+         */
+        int local_cell(spp_real* p) ;
+        /* Make room for *n* agents in the slab,
+         * *nh* in the halo or *no* outgoing ones.
+         */
+        void grow(int n) ;
+        void grow_halo(int nh) ;
+        void grow_out(int no) ;
+        /* Gather the agents in the cells around the local cell
+         * *lc* into *cands*. Return how many.
+         */
+        int gather_candidates(int lc) ;
+        int ncx, ncy, ncz ;
+        double box_size ;
+        Behavior* beh ;
+        int capacity, halo_capacity, out_capacity ;
+        /* Local x-index of each column: 1..cx1-cx0 for the owned
+         * ones, 0 and cx1-cx0+1 for the halo columns before and
+         * after the slab, -1 for the rest.
+         */
+        int* lx_of ;
+        /* Number of local cells and for each one the first agent
+         * and how many, the agents of the slab first (indices
+         * < num_agents) followed by the halo.
+         */
+        int num_cells ;
+        int* cell_first ;
+        int* cell_num ;
+        /* Halo: positions and velocities. */
+        int num_halo ;
+        spp_real* halo_pos ;
+        spp_real* halo_vel ;
+        int* halo_cell ;
+        /* Scratch for the sorting, the cell of each agent
+         * and space for the sensed velocities.
+         */
+        spp_real *tmp_pos, *tmp_vel ;
+        long int* tmp_ids ;
+        int* agent_cell ;
+        spp_real* vel_sensed ;
+        /* Agents (slab and halo) pointing to pos/vel and halo_pos/halo_vel,
+         * candidates (copies) and space for the neighbors.
+         */
+        Agent* agents ;
+        Agent* cands ;
+        Agent** neis ;
+        int agents_capacity ;
+} ;
+
+/*
+ * DomainCommunity class implemented to simulate very large
+ * swarms on a shared memory machine. The periodic box is split
+ * along x in *num_domains* slabs (see Domain), each one owned by
+ * a worker thread that moves its agents, exchanges with the
+ * neighbor slabs the agents that cross the boundaries and the
+ * copies of the agents in the halo, and senses their velocities.
+ * The threads synchronize with barriers between these phases, so
+ * the result is the same as a synchronous update of all the agents.
+ *
+ * Each worker thread can be pinned to one core, and allocates and
+ * initializes the memory of its slab, so that with first-touch
+ * allocation the data lives in the memory node of the core that
+ * uses it.
+ *
+ * The geometry is CartesianPeriodic with box size *L*, and the
+ * interaction must have a finite *range*, e.g. the radius of a
+ * Metric interaction (for a Topologic one, a conservative bound of
+ * the distance to the k-th neighbor). Each domain needs its own
+ * Behavior, with its own Interaction, because some keep state
+ * while sensing (e.g. Topologic, which here does not reuse the
+ * neighbors between steps). The thread of each domain draws its
+ * random numbers from the stream of the domain (see spp_use_rng),
+ * seeded with *seed* plus the domain index.
+ *
+ * This class is not copyable. The destructor stops the threads
+ * and frees the slabs.
+ */
+class DomainCommunity {
+    public:
+        /* Create *num_domains* slabs and their threads for
+         * *num_agents* agents. *behaviors* must contain one
+         * Behavior per domain. If *pin* is not 0, the thread of
+         * domain d is pinned to core d (modulo the number of cores).
+         * The number of domains is reduced if the box has less than
+         * num_domains columns of cells.
+         */
+        DomainCommunity(int num_agents, double L, double range, int num_domains, Behavior** behaviors, long int seed, int pin) ;
+        ~DomainCommunity() ;
+        /* Place the agents randomly in the box, with random
+         * directions (see Behavior::randomize_velocity).
+         */
+        void randomize() ;
+        /* Set the positions and velocities of the agents from the
+         * arrays *pos* and *vel* of size num_agents*DIM. The agent
+         * stored in pos[i*DIM] has id *i*.
+         */
+        void load(spp_real* pos, spp_real* vel) ;
+        /* Store the positions and velocities of the agents in *pos*
+         * and *vel*, of size num_agents*DIM, ordered by id.
+         */
+        void gather(spp_real* pos, spp_real* vel) ;
+        /* Advance *num_steps* steps of *dt*, each of them equivalent
+         * to calling periodic_move, sense_noisy_velocities and
+         * update_velocities of a Community.
+         */
+        void run(int num_steps, double dt) ;
+        /* Store the mean velocity in *meanvel*.
+         * Return the norm^2 of the mean.
+         */
+        double mean_velocity(double* meanvel) ;
+        /* Return the order parameter (see Community::order_parameter). */
+        double order_parameter(double v0) ;
+        /* Return the number of agents in the whole box. */
+        int get_num_agents() {return num_agents;} ;
+        /* Return the number of domains. */
+        int get_num_domains() {return num_domains;} ;
+        /* Return the number of agents in the domain *d*. */
+        int get_domain_agents(int d) {return domains[d].num_agents;} ;
+        /* Return the box size. */
+        double get_box_size() {return box_size;} ;
+    protected:
+        /* Run the job *job_type* in all the domains and wait. */
+        void submit(int type) ;
+        /* What each worker thread does for the current job. */
+        void work(int d) ;
+        /* Wait until all the workers get here. */
+        void barrier() ;
+        int num_agents ;
+        int num_domains ;
+        double box_size ;
+        int ncx, ncy, ncz ;
+        /* Domain owning each column of cells. */
+        int* column_owner ;
+        Domain* domains ;
+        Behavior** behaviors ;
+        long int seed ;
+        int pin ;
+        /* Current job and its parameters. */
+        int job_type ;
+        int job_steps ;
+        double job_dt ;
+        spp_real* job_pos ;
+        spp_real* job_vel ;
+        double* partial_vel ;
+        /* Threads and synchronization (see domain_community.cpp). */
+        void* pool ;
+    private:
+        DomainCommunity(const DomainCommunity&) ;
+        DomainCommunity& operator=(const DomainCommunity&) ;
+} ;
+
+/* Maximum number of extra parameters per replica. */
+#define SPP_ENSEMBLE_MAX_PARAMS 16
+
+/*
+ * Replica class holding the parameters of one
+ * independent simulation of an Ensemble and the
+ * stream where it writes its results.
+ * The parameters are read from one line of the
+ * parameter file of the Ensemble, in the format
+ *      seed    num_agents    noise    [p0 p1 ...]
+ * where the optional *params* p0, p1, ... can be
+ * used for anything else that changes between
+ * replicas (speed, density, outdegree...).
+ */
+class Replica {
+    public:
+        /* Position of the replica in the parameter file
+         * (0 for the first one), used to name its output.
+         */
+        int id ;
+        /* Seed for the random number generator. */
+        long int seed ;
+        /* Stream of random numbers of the replica, seeded
+         * with *seed* and used by the thread running it.
+         */
+        spp_rng rng ;
+        /* Number of agents. */
+        int num_agents ;
+        /* Noise level. */
+        double noise ;
+        /* Extra parameters: *num_params* values in *params*. */
+        int num_params ;
+        double params[SPP_ENSEMBLE_MAX_PARAMS] ;
+        /* Stream where the replica writes its results,
+         * opened by Ensemble::run() before running it.
+         */
+        FILE* out ;
+} ;
+
+/* Function running the simulation of one replica.
+ * It is called from a worker thread, so it must only
+ * use its own Community, Behavior, Interaction and
+ * buffers (allocate them inside the function), and
+ * write to *rep->out* instead of stdout.
+ * When it is called, the spp_random_* functions of the
+ * thread already draw from *rep->rng*, seeded with
+ * *rep->seed*.
+ */
+typedef void (*spp_replica_function)(Replica* rep) ;
+
+/*
+ * Ensemble class implemented to run many independent
+ * simulations (replicas) with different parameters
+ * concurrently in a single process, instead of compiling
+ * and running one executable per set of parameters.
+ *
+ * The parameters are read at runtime from a text file
+ * with one replica per line (see Replica). Empty lines
+ * and lines starting with '#' are ignored.
+ * Each replica writes to its own file
+ *      <out_prefix><id>.res
+ * so that the results do not depend on the order in
+ * which the replicas are run.
+ *
+ * The replicas are run in a pool of threads, each thread
+ * taking the next replica not yet started when it finishes
+ * one, so that replicas of different cost are balanced.
+ * Each replica draws its random numbers from its own
+ * stream (see spp_use_rng) seeded with its seed, so that
+ * the result of a replica only depends on its parameters.
+ * The shared generator of spp_set_seed is not used.
+ * Programs using Ensemble must be linked with -pthread.
+ *
+ * This class is not copyable.
+ */
+class Ensemble {
+    public:
+        /* Read the parameters of the replicas from the
+         * file *param_file*. The output of replica i
+         * will be written to <out_prefix>i.res .
+         */
+        Ensemble(const char* param_file, const char* out_prefix) ;
+        ~Ensemble() ;
+        /* Return the number of replicas read. */
+        int get_num_replicas() ;
+        /* Return the pointer to the replica *i*. */
+        Replica* get_replica(int i) ;
+        /* Run *run_replica* for each replica using *num_threads*
+         * threads (<=0 to use as many as cores available) and
+         * wait for all of them to finish.
+         * Return the number of replicas run.
+         */
+        int run(spp_replica_function run_replica, int num_threads) ;
+    private:
+        /* Open the output of *rep*, make the thread use its
+         * random number stream and call *run_replica*.
+         * Return 1 if the replica was run.
+         */
+        int run_one(spp_replica_function run_replica, Replica* rep) ;
+        int num_replicas ;
+        Replica* replicas ;
+        char out_prefix[256] ;
+        Ensemble(const Ensemble&) ;
+        Ensemble& operator=(const Ensemble&) ;
+} ;
+
+class Community ;
+
+/* Maximum number of blocking levels (blocks of up to 2^(levels-1) values). */
+#define SPP_STATS_MAX_LEVELS 48
+/* Minimum number of blocks for a blocking level to be used for the error. */
+#define SPP_STATS_MIN_BLOCKS 32
+
+/*
+ * OnlineStats class implemented to analyze a time series, e.g.
+ * the order parameter, as it is produced, without storing it.
+ * Each call to add() costs O(1) for the moments and the blocking
+ * analysis and O(*max_lag*) for the autocorrelation.
+ *
+ * It keeps:
+ *      - The mean, variance and fourth moment, for the Binder
+ *      cumulant U = 1 - <x^4> / (3 <x^2>^2).
+ *      - The blocking analysis of Flyvbjerg and Petersen: at
+ *      level *l* the series is averaged in blocks of 2^l values,
+ *      and the naive error of the mean of the blocks grows with
+ *      *l* until the blocks are longer than the correlation time.
+ *      - The autocorrelation function up to *max_lag* steps, from
+ *      which the integrated autocorrelation time is computed with
+ *      the automatic window of Sokal (the sum is cut at the first
+ *      lag *M* with M >= 6 tau(M)).
+ *
+ * The error of the mean given by error() is the blocking estimate,
+ * which is valid even if the correlation time is longer than
+ * *max_lag*, so a run can be stopped when converged() is true.
+ */
+class OnlineStats {
+    public:
+        /* Create an empty series, keeping the autocorrelation
+         * function up to *max_lag* steps (0 to not compute it).
+         */
+        OnlineStats(int max_lag) ;
+        /* Add the value *x* to the series. */
+        void add(double x) ;
+        /* Remove all the values. */
+        void reset() ;
+        /* Return the number of values. */
+        long int get_count() {return count;} ;
+        /* Return the mean. */
+        double mean() ;
+        /* Return the variance (of the values, not of the mean). */
+        double variance() ;
+        /* Return the Binder cumulant 1 - <x^4> / (3 <x^2>^2). */
+        double binder_cumulant() ;
+        /* Return the error of the mean assuming that the
+         * values are uncorrelated, sqrt( variance / (count-1) ).
+         */
+        double naive_error() ;
+        /* Return the error of the mean from the blocking analysis:
+         * the largest error of the levels with at least
+         * SPP_STATS_MIN_BLOCKS blocks.
+         */
+        double error() ;
+        /* Return the number of blocking levels with at least two
+         * blocks, and the number of blocks and the error of the mean
+         * at the level *l*.
+         */
+        int num_levels() ;
+        long int block_count(int l) {return block_n[l];} ;
+        double block_error(int l) ;
+        /* Return the integrated autocorrelation time, in steps
+         * (0.5 for uncorrelated values). If the window does not
+         * fit in *max_lag*, the sum up to *max_lag* is returned
+         * (an underestimate).
+         */
+        double autocorrelation_time() ;
+        /* Return 1 if the error of the mean is smaller than
+         * *target_error* with enough blocks to trust it, 0 otherwise.
+         */
+        int converged(double target_error) ;
+        /* Print the mean, errors, Binder cumulant and autocorrelation
+         * time to *out*, as comments.
+         */
+        void print(FILE* out) ;
+    protected:
+        long int count ;
+        /* Sums of x-shift, (x-shift)^2, x^2 and x^4, with the
+         * first value as *shift* to avoid cancellations.
+         */
+        double shift ;
+        double sum1, sum2 ;
+        double sumx2, sumx4 ;
+        /* Blocking: for each level, the number of complete blocks,
+         * the sums of their means (minus shift) and squares, and the
+         * value waiting for its pair, if *block_pending*.
+         */
+        long int block_n[SPP_STATS_MAX_LEVELS] ;
+        double block_sum[SPP_STATS_MAX_LEVELS] ;
+        double block_sum2[SPP_STATS_MAX_LEVELS] ;
+        double block_wait[SPP_STATS_MAX_LEVELS] ;
+        int block_pending[SPP_STATS_MAX_LEVELS] ;
+        /* Autocorrelation: last *max_lag* values (minus shift)
+         * in a circular buffer and, for each lag *k*, the sum of
+         * the products of the values *k* steps apart.
+         */
+        int max_lag ;
+        double* history ;
+        double* lag_sum ;
+} ;
+
+/* Minimum number of batches to test for stationarity. */
+#define SPP_TRANSIENT_MIN_BATCHES 40
+/* Slope of the stationary part, in standard errors,
+ * above which there is still a drift.
+ */
+#define SPP_TRANSIENT_DRIFT_Z 2.0
+
+/*
+ * TransientDetector class implemented to find when a time series,
+ * e.g. the order parameter from the initial random configuration,
+ * becomes stationary, to end the transient instead of running a
+ * fixed number of steps.
+ *
+ * It uses the Marginal Standard Error Rule (MSER): the values are
+ * averaged in batches of *batch_size* steps, and the truncation point
+ * is the number of initial batches *d* that minimizes
+ *      SE(d) = sum_{j>d} (y_j - mean_d)^2 / (m-d)^2
+ * where *m* is the number of batches and mean_d the mean of the
+ * batches after *d*, searched for d <= m/2. The series is considered
+ * stationary once there is a truncation point in that range, from
+ * the MSER one on, after which a linear fit to the batches has a
+ * slope smaller than SPP_TRANSIENT_DRIFT_Z standard errors (the
+ * tail of a slow relaxation can fool MSER alone). The equilibration
+ * time is then that truncation point, in steps.
+ *
+ * It stores one value per batch, and each stationary() call is
+ * O(number of batches), so it should be called every few steps.
+ */
+class TransientDetector {
+    public:
+        /* Create an empty series with batches of
+         * *batch_size* values (5 for MSER-5).
+         */
+        TransientDetector(int batch_size) ;
+        ~TransientDetector() ;
+        /* Add the value *x* to the series. */
+        void add(double x) ;
+        /* Remove all the values. */
+        void reset() ;
+        /* Return the number of values. */
+        long int get_count() {return count;} ;
+        /* Return 1 if the series is stationary after the
+         * equilibration time, 0 if more values are needed.
+         */
+        int stationary() ;
+        /* Return the equilibration time, in steps, found by the
+         * last call to stationary() that returned 1 (-1 if none).
+         */
+        long int equilibration_time() ;
+    protected:
+        /* Return the MSER truncation point, in batches. */
+        int truncation() ;
+        /* Return 1 if the batches after *d* still drift. */
+        int drift(int d) ;
+        int batch_size ;
+        long int count ;
+        /* Sum of the values of the current batch. */
+        double batch_acc ;
+        /* Means of the complete batches. */
+        int num_batches ;
+        int capacity ;
+        double* batches ;
+        long int equilibration ;
+} ;
+
+/*
+ * MSDTracker class implemented to measure the mean squared
+ * displacement and the velocity autocorrelation of the agents
+ *      MSD(t)  = < |r_i(t0 + t) - r_i(t0)|^2 >
+ *      VACF(t) = < v_i(t0 + t) . v_i(t0) >
+ * averaged over the agents and over several time origins *t0*,
+ * while the simulation runs, without storing the trajectories.
+ * The positions are the unwrapped ones, so the Community must
+ * count the periodic images (see Community::setup_images).
+ *
+ * The lags, in calls to add(), are *num_lags* values spaced
+ * logarithmically between 1 and *max_lag*, so that both the
+ * ballistic and the diffusive regimes are resolved. A new time
+ * origin is taken every *origin_interval* calls, keeping at most
+ * *max_origins* of them; an origin is dropped once it is older than
+ * *max_lag*. Each add() costs O(max_origins), plus O(num_agents)
+ * for each origin at one of the lags.
+ *
+ * It stores 2 * max_origins * num_agents * DIM values, so it is
+ * better to choose origin_interval * max_origins >= max_lag.
+ */
+class MSDTracker {
+    public:
+        /* Create an empty tracker for *num_agents* agents (see above
+         * for the other parameters).
+         */
+        MSDTracker(int num_agents, int max_lag, int num_lags, int origin_interval, int max_origins) ;
+        /* Add the current unwrapped positions and velocities of
+         * the agents of *com*, which is one step (lag 1) after
+         * the previous call.
+         */
+        void add(Community* com) ;
+        /* Same as add but with the unwrapped positions *upos* and
+         * velocities *vel* (num_agents * DIM values each).
+         */
+        void add(double* upos, spp_real* vel) ;
+        /* Remove all the values and origins. */
+        void reset() ;
+        /* Return the number of lags (can be smaller than the
+         * *num_lags* requested as the lags are integers).
+         */
+        int get_num_lags() {return num_lags;} ;
+        /* Return the lag *k*, in calls to add(). */
+        int lag(int k) {return lags[k];} ;
+        /* Return the MSD and the VACF at the lag *k*
+         * (0 if there is no sample yet).
+         */
+        double msd(int k) ;
+        double vacf(int k) ;
+        /* Return the number of time origins averaged at the lag *k*. */
+        long int samples(int k) {return num_samples[k];} ;
+        /* Print a line per lag with the lag, MSD, VACF
+         * and number of samples to *out*.
+         */
+        void print(FILE* out) ;
+    protected:
+        int num_agents ;
+        int max_lag ;
+        int num_lags ;
+        int origin_interval ;
+        int max_origins ;
+        long int count ;
+        /* Lags and, for each age up to *max_lag*, the index
+         * of the lag (-1 if it is not one of the lags).
+         */
+        int* lags ;
+        int* lag_index ;
+        /* Sums over the origins of the MSD and VACF. */
+        double* msd_sum ;
+        double* vacf_sum ;
+        long int* num_samples ;
+        /* Time (call) of each origin, -1 if free, and
+         * the positions and velocities at that time.
+         */
+        long int* origin_time ;
+        double* origin_pos ;
+        double* origin_vel ;
+        /* Space for the unwrapped positions in add(Community*). */
+        double* upos_buffer ;
+} ;
+
+/*
+ * DistributedCommunity class implemented to simulate swarms too
+ * large for the memory of a single machine with MPI. The periodic
+ * box is split along x in one slab per rank (see Domain), and every
+ * step each rank moves its agents, sends the ones that leave its slab
+ * to the rank owning their new position, exchanges the halo with the
+ * ranks owning the neighbor columns of cells, and senses the velocities
+ * of its agents. The result is the same as with a Community or a
+ * DomainCommunity.
+ *
+ * All the ranks of MPI_COMM_WORLD take part, and every method is
+ * collective (must be called by all the ranks). MPI must be initialized
+ * before creating the class. The observables are reduced across the
+ * ranks, and every rank gets the result.
+ *
+ * The geometry is CartesianPeriodic with box size *L*, and the
+ * interaction must have a finite *range* (see DomainCommunity).
+ * The random number generator of each rank is seeded with *seed*
+ * plus the rank.
+ *
+ * This class is only available in the MPI libraries, see `make mpi`.
+ */
+class DistributedCommunity {
+    public:
+        /* Create the slab of this rank for a swarm of *num_agents*
+         * agents using *behavior*. If there are more ranks than
+         * columns of cells, the extra ranks own no agents.
+         */
+        DistributedCommunity(int num_agents, double L, double range, Behavior* behavior, long int seed) ;
+        /* Place the agents randomly in the box, with random
+         * directions (see Behavior::randomize_velocity).
+         */
+        void randomize() ;
+        /* Set the positions and velocities of the agents from the
+         * arrays *pos* and *vel* of size num_agents*DIM, which must
+         * be the same in all the ranks. The agent stored in pos[i*DIM]
+         * has id *i*.
+         */
+        void load(spp_real* pos, spp_real* vel) ;
+        /* Store the positions and velocities of all the agents in
+         * *pos* and *vel* of rank 0, of size num_agents*DIM, ordered
+         * by id. They are not used in the other ranks.
+         */
+        void gather(spp_real* pos, spp_real* vel) ;
+        /* Advance *num_steps* steps of *dt*, each of them equivalent
+         * to calling periodic_move, sense_noisy_velocities and
+         * update_velocities of a Community.
+         */
+        void run(int num_steps, double dt) ;
+        /* Store the mean velocity in *meanvel*.
+         * Return the norm^2 of the mean.
+         */
+        double mean_velocity(double* meanvel) ;
+        /* Return the order parameter (see Community::order_parameter). */
+        double order_parameter(double v0) ;
+        /* Compute the correlations in velocity fluctuations as in
+         * Community::correlation_histo, with the pairs of the agents
+         * whose id is a multiple of *stride* (1 for all the pairs),
+         * which takes O((N/stride)^2) operations. Each rank receives
+         * the sample of half of the other ranks, so that each pair
+         * of agents is counted once, and the histograms are then
+         * added up. The counts are long, since there can be more
+         * than 2^31 pairs per bin with all the agents.
+         */
+        void correlation_histo(int n_bins, double v0, double* totalcorr, long* count, int stride) ;
+        /* Return the distance between the two farthest points in
+         * the computation box with periodic boundary conditions.
+         */
+        double max_distance() ;
+        /* Return the number of agents in the whole box. */
+        int get_num_agents() {return num_agents;} ;
+        /* Return the number of agents in this rank. */
+        int get_local_agents() {return domain.num_agents;} ;
+        /* Return the rank and the number of ranks. */
+        int get_rank() {return rank;} ;
+        int get_num_ranks() {return num_ranks;} ;
+        /* Return the box size. */
+        double get_box_size() {return box_size;} ;
+    protected:
+        /* Send the agents that left the slab in the last move
+         * to their new owners and add the ones received.
+         */
+        void exchange_migrants() ;
+        /* Send the columns of the slab that are in the halo of
+         * other ranks and fill the halo with the ones received.
+         */
+        void exchange_halo() ;
+        /* Make room for *n* agents (DIM positions, DIM velocities
+         * and the id of each) in the send or receive buffers.
+         */
+        void grow_send(int n) ;
+        void grow_recv(int n) ;
+        int num_agents ;
+        double box_size ;
+        int ncx, ncy, ncz ;
+        int rank, num_ranks ;
+        /* First column of each rank (and ncx at the end),
+         * and the rank owning each column.
+         */
+        int* rank_cx0 ;
+        int* column_owner ;
+        Domain domain ;
+        Behavior* beh ;
+        /* Buffers and counts for the exchanges. */
+        int send_capacity, recv_capacity ;
+        spp_real *send_buf, *recv_buf ;
+        long int *send_ids, *recv_ids ;
+        int *send_counts, *send_displs, *recv_counts, *recv_displs ;
+} ;
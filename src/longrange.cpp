@@ -0,0 +1,303 @@
+#include "longrange.h"
+#include "profile.h"
+
+/* Largest number of agents in a leaf of the tree. */
+#define LONGRANGE_LEAF_SIZE 8
+/* Largest depth of the tree, reached only by agents
+ * closer than 2^-LONGRANGE_MAX_DEPTH times the size of
+ * the swarm, which are kept in a larger leaf.
+ */
+#define LONGRANGE_MAX_DEPTH 32
+/* Number of children of a cell. */
+#define LONGRANGE_NCHILD (1 << DIM)
+
+LongRangeAlignment::LongRangeAlignment(Community* c, Geometry* gg, double vzero, double sc, double ex, double t){
+    com = c ;
+    g = gg ;
+    v0 = vzero ;
+    scale = sc ;
+    exponent = ex ;
+    theta = t ;
+    num_terms = 0 ;
+    num_agents = com->get_num_agents() ;
+    order   = new int[num_agents > 0 ? num_agents : 1] ;
+    scratch = new int[num_agents > 0 ? 2 * num_agents : 1] ;
+    stack   = new int[(LONGRANGE_MAX_DEPTH + 1) * LONGRANGE_NCHILD + 1] ;
+    num_cells = 0 ;
+    max_cells = 0 ;
+    cell_first = NULL ;
+    this->grow() ;
+}
+
+void LongRangeAlignment::grow(){
+    int c, d ;
+    int mc = max_cells > 0 ? 2 * max_cells : num_agents / 2 + LONGRANGE_NCHILD + 1 ;
+    int* first  = new int[mc] ;
+    int* n      = new int[mc] ;
+    int* child  = new int[mc] ;
+    int* nchild = new int[mc] ;
+    spp_real* size   = new spp_real[mc] ;
+    spp_real* corner = new spp_real[mc * DIM] ;
+    spp_real* center = new spp_real[mc * DIM] ;
+    spp_real* vel    = new spp_real[mc * DIM] ;
+    spp_real* dip    = new spp_real[mc * DIM * DIM] ;
+    if(cell_first){
+        for(c=0; c<num_cells; c++){
+            first[c]  = cell_first[c] ;
+            n[c]      = cell_n[c] ;
+            child[c]  = cell_child[c] ;
+            nchild[c] = cell_nchild[c] ;
+            size[c]   = cell_size[c] ;
+            for(d=0; d<DIM; d++){
+                corner[c*DIM + d] = cell_corner[c*DIM + d] ;
+                center[c*DIM + d] = cell_center[c*DIM + d] ;
+                vel[c*DIM + d]    = cell_vel[c*DIM + d] ;
+            }
+            for(d=0; d<DIM*DIM; d++)
+                dip[c*DIM*DIM + d] = cell_dip[c*DIM*DIM + d] ;
+        }
+        delete[] cell_first ;
+        delete[] cell_n ;
+        delete[] cell_child ;
+        delete[] cell_nchild ;
+        delete[] cell_size ;
+        delete[] cell_corner ;
+        delete[] cell_center ;
+        delete[] cell_vel ;
+        delete[] cell_dip ;
+    }
+    cell_first  = first ;
+    cell_n      = n ;
+    cell_child  = child ;
+    cell_nchild = nchild ;
+    cell_size   = size ;
+    cell_corner = corner ;
+    cell_center = center ;
+    cell_vel    = vel ;
+    cell_dip    = dip ;
+    max_cells = mc ;
+}
+
+int LongRangeAlignment::new_cell(int first, int n, spp_real size){
+    if(num_cells == max_cells)
+        this->grow() ;
+    int c = num_cells ;
+    cell_first[c] = first ;
+    cell_n[c] = n ;
+    cell_child[c] = -1 ;
+    cell_nchild[c] = 0 ;
+    cell_size[c] = size ;
+    num_cells += 1 ;
+    return c ;
+}
+
+void LongRangeAlignment::build(){
+    int ia, d ;
+    spp_real lo[DIM], hi[DIM], size = 0.0 ;
+    spp_real* pos = com->get_pos() ;
+    num_cells = 0 ;
+    if(num_agents == 0)
+        return ;
+    for(d=0; d<DIM; d++){
+        lo[d] = pos[d] ;
+        hi[d] = pos[d] ;
+    }
+    for(ia=0; ia<num_agents; ia++){
+        order[ia] = ia ;
+        for(d=0; d<DIM; d++){
+            lo[d] = pos[ia*DIM + d] < lo[d] ? pos[ia*DIM + d] : lo[d] ;
+            hi[d] = pos[ia*DIM + d] > hi[d] ? pos[ia*DIM + d] : hi[d] ;
+        }
+    }
+    for(d=0; d<DIM; d++)
+        size = hi[d] - lo[d] > size ? hi[d] - lo[d] : size ;
+    /* slightly larger, so that all the agents are inside */
+    size = size > 0.0 ? 1.0001 * size : 1.0 ;
+    this->new_cell(0, num_agents, size) ;
+    for(d=0; d<DIM; d++)
+        cell_corner[d] = lo[d] ;
+    this->split(0, 0) ;
+}
+
+void LongRangeAlignment::split(int c, int depth){
+    int i, ia, d, e, o, k, ch, n = cell_n[c], first = cell_first[c] ;
+    int count[LONGRANGE_NCHILD], start[LONGRANGE_NCHILD] ;
+    spp_real half = 0.5 * cell_size[c] ;
+    spp_real* pos = com->get_pos() ;
+    spp_real* vel = com->get_vel() ;
+    int* code = scratch ;
+    int* sorted = scratch + num_agents ;
+
+    if(n <= LONGRANGE_LEAF_SIZE || depth >= LONGRANGE_MAX_DEPTH){
+        /* leaf: the sums of its agents */
+        for(d=0; d<DIM; d++){
+            cell_center[c*DIM + d] = 0.0 ;
+            cell_vel[c*DIM + d] = 0.0 ;
+        }
+        for(i=first; i<first+n; i++){
+            ia = order[i] ;
+            for(d=0; d<DIM; d++){
+                cell_center[c*DIM + d] += pos[ia*DIM + d] ;
+                cell_vel[c*DIM + d] += vel[ia*DIM + d] ;
+            }
+        }
+        for(d=0; d<DIM; d++)
+            cell_center[c*DIM + d] /= n ;
+        for(d=0; d<DIM*DIM; d++)
+            cell_dip[c*DIM*DIM + d] = 0.0 ;
+        for(i=first; i<first+n; i++){
+            ia = order[i] ;
+            for(d=0; d<DIM; d++)
+                for(e=0; e<DIM; e++)
+                    cell_dip[c*DIM*DIM + d*DIM + e] += vel[ia*DIM + d] * (pos[ia*DIM + e] - cell_center[c*DIM + e]) ;
+        }
+        return ;
+    }
+
+    /* Sort the agents by child, with a bit per dimension */
+    for(o=0; o<LONGRANGE_NCHILD; o++)
+        count[o] = 0 ;
+    for(i=0; i<n; i++){
+        ia = order[first + i] ;
+        o = 0 ;
+        for(d=0; d<DIM; d++)
+            o |= (pos[ia*DIM + d] >= cell_corner[c*DIM + d] + half) << d ;
+        code[i] = o ;
+        count[o] += 1 ;
+    }
+    start[0] = 0 ;
+    for(o=1; o<LONGRANGE_NCHILD; o++)
+        start[o] = start[o-1] + count[o-1] ;
+    for(i=0; i<n; i++)
+        sorted[start[code[i]]++] = order[first + i] ;
+    for(i=0; i<n; i++)
+        order[first + i] = sorted[i] ;
+
+    /* The non-empty children, consecutive */
+    k = first ;
+    for(o=0; o<LONGRANGE_NCHILD; o++){
+        if(count[o] > 0){
+            ch = this->new_cell(k, count[o], half) ;
+            for(d=0; d<DIM; d++)
+                cell_corner[ch*DIM + d] = cell_corner[c*DIM + d] + ((o >> d) & 1) * half ;
+            if(cell_child[c] < 0)
+                cell_child[c] = ch ;
+            cell_nchild[c] += 1 ;
+        }
+        k += count[o] ;
+    }
+
+    /* Split them and add up their sums */
+    for(d=0; d<DIM; d++){
+        cell_center[c*DIM + d] = 0.0 ;
+        cell_vel[c*DIM + d] = 0.0 ;
+    }
+    for(k=0; k<cell_nchild[c]; k++){
+        ch = cell_child[c] + k ;
+        this->split(ch, depth + 1) ;
+        for(d=0; d<DIM; d++){
+            cell_center[c*DIM + d] += cell_n[ch] * cell_center[ch*DIM + d] ;
+            cell_vel[c*DIM + d] += cell_vel[ch*DIM + d] ;
+        }
+    }
+    for(d=0; d<DIM; d++)
+        cell_center[c*DIM + d] /= n ;
+    /* the moments of the children, moved to the new center */
+    for(d=0; d<DIM*DIM; d++)
+        cell_dip[c*DIM*DIM + d] = 0.0 ;
+    for(k=0; k<cell_nchild[c]; k++){
+        ch = cell_child[c] + k ;
+        for(d=0; d<DIM; d++)
+            for(e=0; e<DIM; e++)
+                cell_dip[c*DIM*DIM + d*DIM + e] += cell_dip[ch*DIM*DIM + d*DIM + e]
+                    + cell_vel[ch*DIM + d] * (cell_center[ch*DIM + e] - cell_center[c*DIM + e]) ;
+    }
+}
+
+void LongRangeAlignment::sense_velocities(spp_real* vel_sensed){
+    int ia, ja, i, d, e, c, k, top, inside ;
+    int periodic[DIM] ;
+    spp_real dis[DIM], sum[DIM], half[DIM], lo, open, d2, w, wd, v2 ;
+    spp_real* pos = com->get_pos() ;
+    spp_real* vel = com->get_vel() ;
+    spp_real* p ;
+    const spp_real a = 1.0 / (scale * scale) ;
+    const spp_real b = -0.5 * exponent ;
+    const spp_real theta2 = theta * theta ;
+    const spp_real theta4 = theta2 * theta2 ;
+
+    SPP_PROFILE_START(t0) ;
+    for(d=0; d<DIM; d++){
+        periodic[d] = g->is_periodic(d) ;
+        half[d] = 0.5 * g->length(d) ;
+    }
+    this->build() ;
+    num_terms = 0 ;
+    for(ia=0; ia<num_agents; ia++){
+        p = pos + ia*DIM ;
+        for(d=0; d<DIM; d++)
+            sum[d] = 0.0 ;
+        stack[0] = 0 ;
+        top = 1 ;
+        while(top > 0){
+            c = stack[--top] ;
+            if(cell_child[c] < 0){
+                /* leaf: agent by agent */
+                for(i=cell_first[c]; i<cell_first[c]+cell_n[c]; i++){
+                    ja = order[i] ;
+                    w = pow(1 + a * g->distance2(p, pos + ja*DIM), b) ;
+                    for(d=0; d<DIM; d++)
+                        sum[d] += w * vel[ja*DIM + d] ;
+                }
+                num_terms += cell_n[c] ;
+                continue ;
+            }
+            g->displacement(p, cell_center + c*DIM, dis) ;
+            d2 = 0.0 ;
+            inside = 1 ;
+            open = theta2 ;
+            for(d=0; d<DIM; d++){
+                d2 += dis[d] * dis[d] ;
+                inside &= (p[d] >= cell_corner[c*DIM + d]) & (p[d] < cell_corner[c*DIM + d] + cell_size[c]) ;
+                /* A cell across the plane half a box away from the
+                 * agent has agents whose nearest image is not that
+                 * of its mean position: their distances are off by
+                 * up to its size, an error of first order in
+                 * size / d, so it is only taken as a whole if
+                 * size < theta^2 d, and never if it spans half a box.
+                 */
+                if(periodic[d]){
+                    lo = dis[d] - (cell_center[c*DIM + d] - cell_corner[c*DIM + d]) ;
+                    if(lo < -half[d] || lo + cell_size[c] > half[d])
+                        open = cell_size[c] < half[d] && open > 0.0 ? theta4 : 0.0 ;
+                }
+            }
+            if(!inside && cell_size[c] * cell_size[c] < open * d2){
+                /* far enough: the whole cell at its mean position,
+                 * plus the first order in the distance to it
+                 */
+                w = pow(1 + a * d2, b - 1) ;
+                wd = 2.0 * a * b * w ;
+                w *= 1 + a * d2 ;
+                for(d=0; d<DIM; d++){
+                    sum[d] += w * cell_vel[c*DIM + d] ;
+                    for(e=0; e<DIM; e++)
+                        sum[d] += wd * cell_dip[c*DIM*DIM + d*DIM + e] * dis[e] ;
+                }
+                num_terms += 1 ;
+            }else{
+                for(k=0; k<cell_nchild[c]; k++)
+                    stack[top++] = cell_child[c] + k ;
+            }
+        }
+        v2 = 0.0 ;
+        for(d=0; d<DIM; d++)
+            v2 += sum[d] * sum[d] ;
+        for(d=0; d<DIM; d++)
+            vel_sensed[ia*DIM + d] = sum[d] * v0 / sqrt(v2) ;
+    }
+    SPP_PROFILE_STOP(t0, SPP_PHASE_SENSE) ;
+    SPP_PROFILE_COUNT(searches, num_agents) ;
+    SPP_PROFILE_COUNT(candidates, (long int) num_agents * num_agents) ;
+    SPP_PROFILE_COUNT(neighbors, num_terms) ;
+}
@@ -0,0 +1,116 @@
+#include "community.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+/*
+ * Alignment with all the agents of a Community, with a
+ * weight that decays as a power law of the distance *r*,
+ *      w(r) = (1 + r^2 / scale^2)^(-exponent/2)
+ * (the SPP_WEIGHT_POWER kernel of Vicsek_weighted). The
+ * velocity sensed by each agent is the weighted sum of
+ * the velocities of all the agents (itself included, with
+ * weight 1), re-scaled to have a *v0* norm.
+ *
+ * The sum over all the pairs is approximated with a
+ * Barnes-Hut tree, in O(N log N) operations: the agents
+ * are sorted in a tree of cells (quadtree in 2D, octree
+ * in 3D) with at most a few agents per leaf, and each
+ * cell keeps the mean position and the sum of the
+ * velocities of its agents. A cell of side *size* at a
+ * distance *d* from the agent whose
+ *      size < theta * d
+ * contributes the sum of its velocities times w(d) as
+ * a whole; otherwise its children are checked, down to
+ * the leaves, whose agents are added one by one. The
+ * error decreases with *theta* (0.5 is a usual value),
+ * and theta = 0 gives the exact sum, in O(N^2).
+ * The distances are those of *g*, the nearest image in
+ * a periodic box, and the tree is rebuilt at every call.
+ * Along the periodic dimensions of *g* (see
+ * Geometry::is_periodic) a cell that crosses the plane
+ * half a box away from the agent has agents with
+ * different nearest images: it is only taken as a whole
+ * if size < theta^2 * d, and never if it spans half a
+ * box, so that its error is of the same order as that
+ * of the other cells.
+ *
+ * The velocities are sensed and then updated with the
+ * methods of the Community, with the noise of the
+ * Behavior added in between, as in the Vicsek model:
+ *
+ *      align.sense_velocities(v2) ;
+ *      behavior.add_noise(num_agents, v2) ;
+ *      com.update_velocities(v2) ;
+ *      com.periodic_move(dt) ;
+ *
+ * The Interaction and Grid of the Community are not used.
+ */
+class LongRangeAlignment {
+    public:
+        LongRangeAlignment(Community* com, Geometry* g, double v0, double scale, double exponent, double theta) ;
+        /* Store in *vel_sensed* the velocity sensed by
+         * each agent (num_agents * DIM values).
+         */
+        void sense_velocities(spp_real* vel_sensed) ;
+        /* Set the opening parameter *theta*. */
+        void set_theta(double t) {theta = t;} ;
+        /* Return the mean number of terms (agents plus
+         * cells) summed per agent in the last call to
+         * sense_velocities, num_agents for the exact sum.
+         */
+        double mean_terms() {return (double) num_terms / num_agents;} ;
+        /* Return the number of cells of the last tree. */
+        int get_num_cells() {return num_cells;} ;
+    protected:
+        /* Build the tree with the current positions. */
+        void build() ;
+        /* Split cell *c* in its children, recursively. */
+        void split(int c, int depth) ;
+        /* Return a new cell with the *n* agents from
+         * *first* in *order*, of side *size*.
+         */
+        int new_cell(int first, int n, spp_real size) ;
+        /* Double the space for cells. */
+        void grow() ;
+        Community* com ;
+        Geometry* g ;
+        int num_agents ;
+        double v0 ;
+        double scale ;
+        double exponent ;
+        double theta ;
+        long num_terms ;
+        /* Agents sorted by cell: the agents of cell *c*
+         * are order[cell_first[c] : cell_first[c] + cell_n[c]]
+         *      Size: num_agents
+         */
+        int* order ;
+        /* Child of each agent of a cell being split,
+         * and the agents sorted by child.
+         *      Size: 2 * num_agents
+         */
+        int* scratch ;
+        /* Cells, with space for *max_cells*: first agent,
+         * number of agents, first child (children are
+         * consecutive, -1 for a leaf), number of children,
+         * side, corner (lowest coordinates), mean position
+         * and sum of the velocities of the agents.
+         */
+        int num_cells ;
+        int max_cells ;
+        int* cell_first ;
+        int* cell_n ;
+        int* cell_child ;
+        int* cell_nchild ;
+        spp_real* cell_size ;
+        spp_real* cell_corner ;
+        spp_real* cell_center ;
+        spp_real* cell_vel ;
+        /* First moment of the velocities, the sum over the
+         * agents of vel[d] * (pos[e] - center[e]), at d*DIM + e.
+         */
+        spp_real* cell_dip ;
+        /* Cells to check while walking the tree. */
+        int* stack ;
+} ;
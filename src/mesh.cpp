@@ -0,0 +1,181 @@
+#include "mesh.h"
+
+Mesh::Mesh(int s, double L){
+    int j, k, bits ;
+    size = 1 ;
+    bits = 0 ;
+    while(size < s){
+        size *= 2 ;
+        bits += 1 ;
+    }
+    if(size != s)
+        fprintf(stderr,"libspp.Mesh: ERROR - The size %i is not a power of 2, using %i.\n", s, size) ;
+    box_size = L ;
+    cell_size = box_size / size ;
+    num_cells = 1 ;
+    for(j=0; j<DIM; j++)
+        num_cells *= size ;
+
+    re = new double[num_cells] ;
+    im = new double[num_cells] ;
+    this->clear() ;
+    cos_table = new double[size/2 + 1] ;
+    sin_table = new double[size/2 + 1] ;
+    for(j=0; j<size/2; j++){
+        cos_table[j] = cos(2.0 * M_PI * j / size) ;
+        sin_table[j] = sin(2.0 * M_PI * j / size) ;
+    }
+    bitrev = new int[size] ;
+    for(j=0; j<size; j++){
+        bitrev[j] = 0 ;
+        for(k=0; k<bits; k++)
+            if(j & (1 << k))
+                bitrev[j] |= 1 << (bits - 1 - k) ;
+    }
+    line_re = new double[size] ;
+    line_im = new double[size] ;
+}
+
+int Mesh::cell(spp_real* pos){
+    int d, i, c = 0 ;
+    for(d=0; d<DIM; d++){
+        i = (int) (pos[d] / cell_size) ;
+        i = i < 0 ? 0 : (i >= size ? size-1 : i) ;
+        c = c * size + i ;
+    }
+    return c ;
+}
+
+void Mesh::clear(){
+    for(int c=0; c<num_cells; c++){
+        re[c] = 0.0 ;
+        im[c] = 0.0 ;
+    }
+}
+
+void Mesh::deposit(int n, spp_real* pos, spp_real* w, int stride){
+    for(int i=0; i<n; i++)
+        re[this->cell(pos + i*DIM)] += w ? w[i*stride] : 1.0 ;
+}
+
+void Mesh::deposit_cic(int n, spp_real* pos, spp_real* w, int stride){
+    /* Along each dimension the agent is shared by the cell i0,
+     * with the fraction 1-f, and the next one (periodic), with f.
+     */
+    int i, d, corner, c ;
+    int ncorners = 1 << DIM ;
+    int lo[DIM], hi[DIM] ;
+    double f[DIM] ;
+    double x, a, wi ;
+    for(i=0; i<n; i++){
+        for(d=0; d<DIM; d++){
+            x = pos[i*DIM + d] / cell_size - 0.5 ;
+            lo[d] = (int) floor(x) ;
+            f[d] = x - lo[d] ;
+            lo[d] = ((lo[d] % size) + size) % size ;
+            hi[d] = lo[d] + 1 < size ? lo[d] + 1 : 0 ;
+        }
+        wi = w ? w[i*stride] : 1.0 ;
+        for(corner=0; corner<ncorners; corner++){
+            c = 0 ;
+            a = wi ;
+            for(d=0; d<DIM; d++){
+                if(corner & (1 << d)){
+                    c = c * size + hi[d] ;
+                    a *= f[d] ;
+                }else{
+                    c = c * size + lo[d] ;
+                    a *= 1.0 - f[d] ;
+                }
+            }
+            re[c] += a ;
+        }
+    }
+}
+
+void Mesh::fft_line(int first, int stride, int sign){
+    /* Iterative radix-2 Cooley-Tukey */
+    int j, len, half, step, k, a, b ;
+    double wr, wi, tr, ti ;
+    for(j=0; j<size; j++){
+        line_re[bitrev[j]] = re[first + j*stride] ;
+        line_im[bitrev[j]] = im[first + j*stride] ;
+    }
+    for(len=2; len<=size; len*=2){
+        half = len / 2 ;
+        step = size / len ;
+        for(j=0; j<size; j+=len){
+            for(k=0; k<half; k++){
+                wr = cos_table[k*step] ;
+                wi = sign * sin_table[k*step] ;
+                a = j + k ;
+                b = a + half ;
+                tr = wr * line_re[b] - wi * line_im[b] ;
+                ti = wr * line_im[b] + wi * line_re[b] ;
+                line_re[b] = line_re[a] - tr ;
+                line_im[b] = line_im[a] - ti ;
+                line_re[a] += tr ;
+                line_im[a] += ti ;
+            }
+        }
+    }
+    for(j=0; j<size; j++){
+        re[first + j*stride] = line_re[j] ;
+        im[first + j*stride] = line_im[j] ;
+    }
+}
+
+void Mesh::fft(int sign){
+    /* One dimension at a time: the lines along dimension
+     * *d* have cells size^(DIM-1-d) apart.
+     */
+    int d, c, stride = 1 ;
+    for(d=DIM-1; d>=0; d--){
+        for(c=0; c<num_cells; c++){
+            /* first cell of each line: index 0 along d */
+            if((c / stride) % size == 0)
+                this->fft_line(c, stride, sign) ;
+        }
+        stride *= size ;
+    }
+}
+
+double Mesh::distance(int c){
+    int d, i ;
+    double x, r2 = 0.0 ;
+    for(d=0; d<DIM; d++){
+        i = c % size ;
+        c /= size ;
+        i = i <= size/2 ? i : i - size ;
+        x = i * cell_size ;
+        r2 += x * x ;
+    }
+    return sqrt(r2) ;
+}
+
+double Mesh::wavenumber(int c){
+    /* Same periodic index, with 2 pi / L per unit */
+    return this->distance(c) * (2.0 * M_PI / box_size) / cell_size ;
+}
+
+int Mesh::write_frame(FILE* out, long int step, double* density, double* velocity){
+    int c, dim = DIM ;
+    long int nw = 0, nf = (long int) num_cells * (1 + DIM) ;
+    float* buf = new float[nf] ;
+    for(c=0; c<num_cells; c++)
+        buf[c] = (float) density[c] ;
+    for(c=0; c<num_cells*DIM; c++)
+        buf[num_cells + c] = (float) velocity[c] ;
+    nw += fwrite("SPPF", 1, 4, out) == 4 ;
+    nw += fwrite(&dim, sizeof(int), 1, out) ;
+    nw += fwrite(&size, sizeof(int), 1, out) ;
+    nw += fwrite(&step, sizeof(long int), 1, out) ;
+    nw += fwrite(&box_size, sizeof(double), 1, out) ;
+    nw += fwrite(buf, sizeof(float), nf, out) ;
+    delete[] buf ;
+    if(nw != 5 + nf){
+        fprintf(stderr,"libspp.Mesh: ERROR - Could not write the frame of step %li.\n", step) ;
+        return -1 ;
+    }
+    return 0 ;
+}
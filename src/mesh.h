@@ -0,0 +1,110 @@
+#include "precision.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+/*
+ * Class with a field on a regular periodic mesh covering
+ * the computation box, and its Fourier transform.
+ * It is used to compute correlation functions and structure
+ * factors of large systems in O(M log M) operations, with
+ * *M* the number of mesh cells, instead of going through all
+ * the pairs of agents (see Community::correlation_histo_fft
+ * and Community::structure_factors).
+ *
+ * The box is divided in *size* cells PER DIMENSION, which
+ * must be a power of 2 for the radix-2 FFT. The cell *c*
+ * of the n-dimensional index (i,j) or (i,j,k) is
+ *      c = i*size + j   or   c = (i*size + j)*size + k
+ * in the arrays *re* and *im* with the real and imaginary
+ * parts of the field. The agents are deposited in the
+ * cell that contains them (nearest grid point), so the
+ * distances between agents are known up to one cell size.
+ *
+ * All the space, of order 2*size^DIM doubles, is allocated
+ * on construction.
+ */
+class Mesh{
+    public:
+        /* Construct the mesh with *size* cells per dimension
+         * in a box of size *L*. If *size* is not a power
+         * of 2 the next power of 2 is used, printing an
+         * error to stderr.
+         */
+        Mesh(int size, double L) ;
+        /* Return the number of cells per dimension. */
+        int get_size() {return size;} ;
+        /* Return the total number of cells. */
+        int get_num_cells() {return num_cells;} ;
+        /* Return the box size. */
+        double get_box_size() {return box_size;} ;
+        /* Return the size of a cell (in each dimension). */
+        double get_cell_size() {return cell_size;} ;
+        /* Return the cell containing the position *pos*. */
+        int cell(spp_real* pos) ;
+        /* Set the field to zero. */
+        void clear() ;
+        /* Add to the (real) field the weight of each of the *n*
+         * agents with positions *pos* in the cell containing it.
+         * The weight of agent *i* is w[i*stride], or 1 if *w*
+         * is NULL.
+         */
+        void deposit(int n, spp_real* pos, spp_real* w, int stride) ;
+        /* Same as deposit but spreading the weight of each agent
+         * over the 2^DIM cells closest to it (cloud in cell), in
+         * proportion to the overlap of a cell-sized box centered
+         * at the agent with each cell. The field is smoother, at
+         * the price of 2^DIM operations per agent.
+         */
+        void deposit_cic(int n, spp_real* pos, spp_real* w, int stride) ;
+        /* Fourier transform of the field, in place:
+         *      F(k) = sum_x F(x) exp(sign * 2 pi i k.x / size)
+         * with *sign* -1 (forward) or +1 (backward). It is not
+         * normalized: forward and then backward multiplies the
+         * field by the number of cells.
+         */
+        void fft(int sign) ;
+        /* Return the length of the shortest periodic displacement
+         * from the cell 0 to the cell *c*.
+         */
+        double distance(int c) ;
+        /* Return the modulus of the wave vector of the
+         * Fourier mode *c*, in units of 1/length.
+         */
+        double wavenumber(int c) ;
+        /* Write to *out* a binary frame with the fields *density*
+         * (num_cells values) and *velocity* (DIM values per cell,
+         * cell after cell) of the step *step*, as computed by
+         * Community::fields. The frame is, in the native byte order:
+         *      "SPPF"          4 chars
+         *      DIM, size       2 int (4 bytes each)
+         *      step            long int (8 bytes)
+         *      box size        double
+         *      density         num_cells float
+         *      velocity        DIM*num_cells float
+         * so the frames can be appended to the same file and read
+         * back, e.g. with numpy, knowing the size of each frame.
+         * Returns 0 on success, -1 if the writing failed.
+         */
+        int write_frame(FILE* out, long int step, double* density, double* velocity) ;
+        /* Real and imaginary parts of the field, num_cells each. */
+        double* re ;
+        double* im ;
+    protected:
+        /* Transform the *size* values of the line starting
+         * at cell *first* with cells *stride* apart.
+         */
+        void fft_line(int first, int stride, int sign) ;
+        int size ;
+        int num_cells ;
+        double box_size ;
+        double cell_size ;
+        /* Cosines and sines of 2 pi j / size for j < size/2, the
+         * bit reversed index of each j < size, and space for a line.
+         */
+        double* cos_table ;
+        double* sin_table ;
+        int* bitrev ;
+        double* line_re ;
+        double* line_im ;
+} ;
@@ -0,0 +1,280 @@
+#include "obstacles.h"
+
+/* Maximum number of cells of the index. If the obstacles
+ * are spread over a region too large for cells of side
+ * *range*, larger cells are used.
+ */
+#define OBSTACLES_MAX_CELLS 4194304
+/* Maximum number of pushes out of overlapping obstacles in reflect. */
+#define OBSTACLES_MAX_PUSHES 64
+
+Obstacles::Obstacles(int mo, double r){
+    max_obstacles = mo > 0 ? mo : 1 ;
+    num_obstacles = 0 ;
+    range = r ;
+    kind   = new int[max_obstacles] ;
+    p0     = new double[max_obstacles * SPP_MAX_DIM] ;
+    p1     = new double[max_obstacles * SPP_MAX_DIM] ;
+    radius = new double[max_obstacles] ;
+    built = false ;
+    first = NULL ;
+    cell_obstacles = NULL ;
+}
+
+int Obstacles::add_sphere(double* center, double r){
+    /* a segment of null length */
+    int io = this->add_segment(center, center, r) ;
+    if(io >= 0)
+        kind[io] = SPP_OBSTACLE_SPHERE ;
+    return io ;
+}
+
+int Obstacles::add_box(double* lo, double* hi){
+    if(num_obstacles == max_obstacles){
+        fprintf(stderr,"libspp.Obstacles: ERROR - No space for more than %i obstacles.\n", max_obstacles) ;
+        return -1 ;
+    }
+    int io = num_obstacles ;
+    for(int d=0; d<DIM; d++){
+        p0[io*SPP_MAX_DIM + d] = lo[d] < hi[d] ? lo[d] : hi[d] ;
+        p1[io*SPP_MAX_DIM + d] = lo[d] < hi[d] ? hi[d] : lo[d] ;
+    }
+    kind[io] = SPP_OBSTACLE_BOX ;
+    radius[io] = 0.0 ;
+    num_obstacles += 1 ;
+    if(built)
+        this->build() ;
+    return io ;
+}
+
+int Obstacles::add_segment(double* a, double* b, double r){
+    if(num_obstacles == max_obstacles){
+        fprintf(stderr,"libspp.Obstacles: ERROR - No space for more than %i obstacles.\n", max_obstacles) ;
+        return -1 ;
+    }
+    int io = num_obstacles ;
+    for(int d=0; d<DIM; d++){
+        p0[io*SPP_MAX_DIM + d] = a[d] ;
+        p1[io*SPP_MAX_DIM + d] = b[d] ;
+    }
+    kind[io] = SPP_OBSTACLE_SEGMENT ;
+    radius[io] = r ;
+    num_obstacles += 1 ;
+    if(built)
+        this->build() ;
+    return io ;
+}
+
+void Obstacles::build(){
+    /*
+     * Each obstacle is listed in all the cells that overlap
+     * its bounding box widened by *range*, which contain all
+     * the points closer than *range* to it.
+     */
+    int io, d, c, n, total ;
+    int lo[DIM], hi[DIM], idx[DIM] ;
+    double blo[DIM], bhi[DIM], glo[DIM], ghi[DIM], w ;
+    double* boxes = new double[num_obstacles * 2 * DIM] ;
+    if(first){
+        delete[] first ;
+        delete[] cell_obstacles ;
+    }
+    for(d=0; d<DIM; d++){
+        glo[d] = 0.0 ;
+        ghi[d] = 0.0 ;
+    }
+    for(io=0; io<num_obstacles; io++){
+        for(d=0; d<DIM; d++){
+            blo[d] = p0[io*SPP_MAX_DIM + d] < p1[io*SPP_MAX_DIM + d] ? p0[io*SPP_MAX_DIM + d] : p1[io*SPP_MAX_DIM + d] ;
+            bhi[d] = p0[io*SPP_MAX_DIM + d] < p1[io*SPP_MAX_DIM + d] ? p1[io*SPP_MAX_DIM + d] : p0[io*SPP_MAX_DIM + d] ;
+            w = radius[io] + range ;
+            boxes[(io*2 + 0)*DIM + d] = blo[d] - w ;
+            boxes[(io*2 + 1)*DIM + d] = bhi[d] + w ;
+            if(io == 0 || blo[d] - w < glo[d])
+                glo[d] = blo[d] - w ;
+            if(io == 0 || bhi[d] + w > ghi[d])
+                ghi[d] = bhi[d] + w ;
+        }
+    }
+
+    /* Cells of side range, or larger if there are too many */
+    cell_size = range > 0.0 ? range : 1.0 ;
+    do{
+        total = 1 ;
+        for(d=0; d<DIM; d++){
+            origin[d] = glo[d] ;
+            ncells[d] = (int) ceil( (ghi[d] - glo[d]) / cell_size ) ;
+            ncells[d] = ncells[d] < 1 ? 1 : ncells[d] ;
+            total *= ncells[d] ;
+        }
+        if(total > OBSTACLES_MAX_CELLS)
+            cell_size *= pow( (double) total / OBSTACLES_MAX_CELLS , 1.0 / DIM ) * 1.01 ;
+    }while(total > OBSTACLES_MAX_CELLS) ;
+    if(num_obstacles == 0){
+        total = 0 ;
+        for(d=0; d<DIM; d++)
+            ncells[d] = 0 ;
+    }
+
+    /* Count the obstacles of each cell, and then list them */
+    first = new int[total + 1] ;
+    for(c=0; c<=total; c++)
+        first[c] = 0 ;
+    for(n=0; n<2; n++){
+        if(n == 1){
+            for(c=0; c<total; c++)
+                first[c+1] += first[c] ;
+            cell_obstacles = new int[first[total] > 0 ? first[total] : 1] ;
+        }
+        for(io=0; io<num_obstacles; io++){
+            for(d=0; d<DIM; d++){
+                lo[d] = (int) floor( (boxes[(io*2 + 0)*DIM + d] - origin[d]) / cell_size ) ;
+                hi[d] = (int) floor( (boxes[(io*2 + 1)*DIM + d] - origin[d]) / cell_size ) ;
+                lo[d] = lo[d] < 0 ? 0 : lo[d] ;
+                hi[d] = hi[d] < ncells[d] ? hi[d] : ncells[d] - 1 ;
+                idx[d] = lo[d] ;
+            }
+            /* all the cells from lo to hi */
+            while(idx[0] <= hi[0]){
+                c = 0 ;
+                for(d=0; d<DIM; d++)
+                    c = c * ncells[d] + idx[d] ;
+                if(n == 0)
+                    first[c+1] += 1 ;
+                else
+                    cell_obstacles[first[c]++] = io ;
+                for(d=DIM-1; d>=0; d--){
+                    idx[d] += 1 ;
+                    if(idx[d] <= hi[d] || d == 0)
+                        break ;
+                    idx[d] = lo[d] ;
+                }
+            }
+        }
+    }
+    /* the second pass moved each first[c] to first[c+1] */
+    for(c=total; c>0; c--)
+        first[c] = first[c-1] ;
+    first[0] = 0 ;
+    delete[] boxes ;
+    built = true ;
+}
+
+int Obstacles::cell(spp_real* pos) const {
+    int d, k, c = 0 ;
+    if(!built || num_obstacles == 0)
+        return -1 ;
+    for(d=0; d<DIM; d++){
+        k = (int) floor( (pos[d] - origin[d]) / cell_size ) ;
+        if(k < 0 || k >= ncells[d])
+            return -1 ;
+        c = c * ncells[d] + k ;
+    }
+    return c ;
+}
+
+double Obstacles::distance(int io, spp_real* pos, double* normal) const {
+    int d, m ;
+    double x[DIM], q[DIM], t, ab2, r2, dist ;
+    double* a = p0 + io*SPP_MAX_DIM ;
+    double* b = p1 + io*SPP_MAX_DIM ;
+    if(kind[io] == SPP_OBSTACLE_BOX){
+        /* q > 0 along the dimensions where pos is out of the box */
+        m = 0 ;
+        r2 = 0.0 ;
+        for(d=0; d<DIM; d++){
+            x[d] = pos[d] - 0.5 * (a[d] + b[d]) ;
+            q[d] = fabs(x[d]) - 0.5 * (b[d] - a[d]) ;
+            if(q[d] > q[m])
+                m = d ;
+            if(q[d] > 0.0)
+                r2 += q[d] * q[d] ;
+        }
+        if(q[m] > 0.0){
+            dist = sqrt(r2) ;
+            for(d=0; d<DIM; d++)
+                normal[d] = q[d] > 0.0 ? copysign(q[d] / dist, x[d]) : 0.0 ;
+            return dist ;
+        }
+        /* inside: out through the closest face */
+        for(d=0; d<DIM; d++)
+            normal[d] = d == m ? copysign(1.0, x[d]) : 0.0 ;
+        return q[m] ;
+    }
+    /* sphere or segment: distance to the closest point of a-b */
+    t = 0.0 ;
+    ab2 = 0.0 ;
+    for(d=0; d<DIM; d++){
+        t += (pos[d] - a[d]) * (b[d] - a[d]) ;
+        ab2 += (b[d] - a[d]) * (b[d] - a[d]) ;
+    }
+    t = ab2 > 0.0 ? t / ab2 : 0.0 ;
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t) ;
+    r2 = 0.0 ;
+    for(d=0; d<DIM; d++){
+        x[d] = pos[d] - (a[d] + t * (b[d] - a[d])) ;
+        r2 += x[d] * x[d] ;
+    }
+    dist = sqrt(r2) ;
+    for(d=0; d<DIM; d++)
+        normal[d] = dist > 0.0 ? x[d] / dist : (d == 0 ? 1.0 : 0.0) ;
+    return dist - radius[io] ;
+}
+
+double Obstacles::nearest(spp_real* pos, double* normal) const {
+    int k, d ;
+    double n[DIM], dist, dmin = range ;
+    int c = this->cell(pos) ;
+    for(d=0; d<DIM; d++)
+        normal[d] = 0.0 ;
+    if(c < 0)
+        return range ;
+    for(k=first[c]; k<first[c+1]; k++){
+        dist = this->distance(cell_obstacles[k], pos, n) ;
+        if(dist < dmin){
+            dmin = dist ;
+            for(d=0; d<DIM; d++)
+                normal[d] = n[d] ;
+        }
+    }
+    return dmin ;
+}
+
+int Obstacles::avoidance(spp_real* pos, double* dir) const {
+    int k, d, count = 0 ;
+    double n[DIM], dist ;
+    int c = this->cell(pos) ;
+    for(d=0; d<DIM; d++)
+        dir[d] = 0.0 ;
+    if(c < 0)
+        return 0 ;
+    for(k=first[c]; k<first[c+1]; k++){
+        dist = this->distance(cell_obstacles[k], pos, n) ;
+        if(dist < range){
+            for(d=0; d<DIM; d++)
+                dir[d] += n[d] * (range - dist) / range ;
+            count += 1 ;
+        }
+    }
+    return count ;
+}
+
+int Obstacles::reflect(spp_real* pos, spp_real* vel) const {
+    int d, push, inside = 0 ;
+    double n[DIM], dist, vn ;
+    for(push=0; push<OBSTACLES_MAX_PUSHES; push++){
+        dist = this->nearest(pos, n) ;
+        if(dist >= 0.0)
+            break ;
+        inside = 1 ;
+        vn = 0.0 ;
+        for(d=0; d<DIM; d++){
+            pos[d] -= dist * n[d] ;
+            vn += vel[d] * n[d] ;
+        }
+        if(vn < 0.0)
+            for(d=0; d<DIM; d++)
+                vel[d] -= 2.0 * vn * n[d] ;
+    }
+    return inside ;
+}
@@ -0,0 +1,115 @@
+#include "precision.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Kinds of obstacles. */
+#define SPP_OBSTACLE_SPHERE   0
+#define SPP_OBSTACLE_BOX      1
+#define SPP_OBSTACLE_SEGMENT  2
+
+/*
+ * Class with a set of static obstacles that the agents avoid
+ * (see Vicsek_avoider) and bounce off (see Community::setup_obstacles):
+ *      - spheres (circles in 2D) with a center and a radius,
+ *      - boxes aligned with the axes, with two opposite corners,
+ *      - thick segments (capsules), the points closer than a
+ *      radius to the segment between two points, e.g. walls
+ *      of any orientation.
+ *
+ * The obstacles are stored in a spatial index: a regular mesh of
+ * cells of side *range* (at least) covering all the obstacles,
+ * where each cell keeps the list of obstacles closer than *range*
+ * to some point of the cell. A query at a position only checks the
+ * obstacles of its cell, so its cost does not depend on the number
+ * of obstacles far from it, and positions farther than *range* from
+ * all the obstacles are answered without checking any.
+ * The index is built by build(), which Community::setup_obstacles
+ * and the Vicsek_avoider constructor call, and it is rebuilt by
+ * every obstacle added after that. The queries only read it, so
+ * they can be made from several threads at once. When the
+ * obstacles are used on their own, call build() after adding
+ * them: before it, the queries find no obstacle.
+ *
+ * The obstacles are not periodic: in a periodic box they are not
+ * seen through the boundaries, so they should not touch them.
+ */
+class Obstacles {
+    public:
+        /* Create an empty set with space for *max_obstacles*
+         * obstacles, that are queried up to a distance *range*
+         * (e.g. the distance at which the agents see them).
+         */
+        Obstacles(int max_obstacles, double range) ;
+        /* Add a sphere of radius *radius* centered at *center*.
+         * Return its index, or -1 if there is no space left.
+         */
+        int add_sphere(double* center, double radius) ;
+        /* Add the box with corners *lo* and *hi* (lo[i] < hi[i]).
+         * Return its index, or -1 if there is no space left.
+         */
+        int add_box(double* lo, double* hi) ;
+        /* Add the points closer than *radius* to the segment from
+         * *a* to *b*. Return its index, or -1 if there is no space left.
+         */
+        int add_segment(double* a, double* b, double radius) ;
+        /* Return the number of obstacles. */
+        int get_num_obstacles() {return num_obstacles;} ;
+        /* Return the query range. */
+        double get_range() {return range;} ;
+        /* Return the signed distance from *pos* to the surface of the
+         * obstacle *io* (negative inside it), and store in *normal*
+         * the unit vector pointing out of the obstacle at *pos*.
+         */
+        double distance(int io, spp_real* pos, double* normal) const ;
+        /* Return the signed distance from *pos* to the closest obstacle
+         * closer than *range*, storing its outward normal in *normal*,
+         * or return *range* with a null normal if there is none.
+         */
+        double nearest(spp_real* pos, double* normal) const ;
+        /* Store in *dir* the direction to avoid the obstacles closer
+         * than *range* to *pos*: the sum of their outward normals, each
+         * weighted by (range - distance) / range, which grows from 0
+         * at *range* to 1 at the surface. Return how many there are.
+         */
+        int avoidance(spp_real* pos, double* dir) const ;
+        /* If *pos* is inside an obstacle, move it to the surface
+         * along the outward normal and reflect the component of the
+         * velocity *vel* that goes into the obstacle (if any), keeping
+         * its norm. This is repeated while it is inside overlapping
+         * obstacles. Return 1 if it was inside an obstacle, 0 otherwise.
+         */
+        int reflect(spp_real* pos, spp_real* vel) const ;
+        /* Build the spatial index with the obstacles added so far.
+         * Once built, it is rebuilt when more obstacles are added.
+         */
+        void build() ;
+    protected:
+        /* Return the cell containing *pos*, or -1 if it is
+         * farther than *range* from all the obstacles or the
+         * index is not built.
+         */
+        int cell(spp_real* pos) const ;
+        int max_obstacles ;
+        int num_obstacles ;
+        double range ;
+        /* Kind of each obstacle (SPP_OBSTACLE_*), and its
+         * parameters: for a sphere the center and radius, for a
+         * box the corners lo and hi, and for a segment the ends a
+         * and b and the radius, SPP_MAX_DIM values each.
+         */
+        int* kind ;
+        double* p0 ;
+        double* p1 ;
+        double* radius ;
+        /* Index: *ncells* cells per dimension of side *cell_size*
+         * from *origin*, and the obstacles of cell *c* in
+         *      cell_obstacles[first[c] : first[c+1]]
+         */
+        bool built ;
+        double origin[SPP_MAX_DIM] ;
+        double cell_size ;
+        int ncells[SPP_MAX_DIM] ;
+        int* first ;
+        int* cell_obstacles ;
+} ;
@@ -0,0 +1,29 @@
+/*
+ * Floating point type used to store and operate on
+ * positions, velocities and distances in libspp.
+ *
+ * By default it is double. Compiling with -DSPP_SINGLE
+ * (and linking against libspp2df.a or libspp3df.a instead
+ * of libspp2d.a or libspp3d.a) switches it to float, which
+ * halves the memory used by the big arrays and doubles the
+ * number of values per SIMD instruction.
+ * Statistical quantities (means, order parameter,
+ * correlations) are accumulated in double in both cases.
+ *
+ * Arrays meant to be passed to the library should be
+ * declared as spp_real* (e.g. the result of
+ * spp_community_alloc_space) so that the same code compiles
+ * for both precisions.
+ */
+#ifdef SPP_SINGLE
+typedef float spp_real ;
+#else
+typedef double spp_real ;
+#endif
+
+/*
+ * Largest number of dimensions, to size the per-dimension
+ * arrays (e.g. the box lengths) of the classes declared in
+ * the headers, which must not depend on DIM.
+ */
+#define SPP_MAX_DIM 3
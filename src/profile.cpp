@@ -0,0 +1,63 @@
+#include "profile.h"
+#include <time.h>
+
+thread_local SppProfile spp_profile = SppProfile() ;
+
+static const char* phase_names[SPP_NUM_PHASES] = {
+    "grid_fill", "sense", "noise", "move", "observables"
+} ;
+
+int spp_profile_enabled(){
+#ifdef SPP_PROFILE
+    return 1 ;
+#else
+    return 0 ;
+#endif
+}
+
+double spp_profile_clock(){
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return ts.tv_sec + 1e-9 * ts.tv_nsec ;
+}
+
+void spp_profile_add(int phase, double t){
+    spp_profile.time[phase] += t ;
+    spp_profile.calls[phase] += 1 ;
+}
+
+void spp_profile_reset(){
+    spp_profile = SppProfile() ;
+}
+
+void spp_profile_print(FILE* out){
+    int p ;
+    double total = 0.0 ;
+    SppProfile* sp = &spp_profile ;
+    if(!spp_profile_enabled()){
+        fprintf(out, "# Profiling disabled (compile libspp with -DSPP_PROFILE)\n") ;
+        return ;
+    }
+    for(p=0; p<SPP_NUM_PHASES; p++)
+        total += sp->time[p] ;
+    fprintf(out, "# Phase         Time (s)      Calls      Fraction\n") ;
+    for(p=0; p<SPP_NUM_PHASES; p++)
+        fprintf(out, "# %-12s  %-12.6f  %-9li  %.4f\n", phase_names[p], sp->time[p], sp->calls[p],
+                total > 0.0 ? sp->time[p] / total : 0.0) ;
+    fprintf(out, "# %-12s  %-12.6f\n", "total", total) ;
+    fprintf(out, "# Neighbor searches   %li\n", sp->searches) ;
+    fprintf(out, "# Grid fills          %li\n", sp->grid_fills) ;
+    fprintf(out, "# Candidates/search   %f\n", sp->searches > 0 ? (double) sp->candidates / sp->searches : 0.0) ;
+    fprintf(out, "# Neighbors/search    %f\n", sp->searches > 0 ? (double) sp->neighbors / sp->searches : 0.0) ;
+    fprintf(out, "# Accepted fraction   %f\n", sp->candidates > 0 ? (double) sp->neighbors / sp->candidates : 0.0) ;
+}
+
+void spp_profile_dump(FILE* out){
+    int p ;
+    SppProfile* sp = &spp_profile ;
+    fprintf(out, "{\"enabled\": %i", spp_profile_enabled()) ;
+    for(p=0; p<SPP_NUM_PHASES; p++)
+        fprintf(out, ", \"%s\": {\"time\": %.9g, \"calls\": %li}", phase_names[p], sp->time[p], sp->calls[p]) ;
+    fprintf(out, ", \"candidates\": %li, \"neighbors\": %li, \"searches\": %li, \"grid_fills\": %li}\n",
+            sp->candidates, sp->neighbors, sp->searches, sp->grid_fills) ;
+}
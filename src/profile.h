@@ -0,0 +1,89 @@
+#include <stdio.h>
+
+/*
+ * Instrumentation of the hot paths of libspp, to know where the
+ * time of a step goes. It is compiled in only if the library is
+ * compiled with -DSPP_PROFILE (see the Makefile); otherwise the
+ * SPP_PROFILE_* macros are empty and cost nothing.
+ *
+ * The counters are per thread (like the stream of spp_use_rng),
+ * so a Community (or an Ensemble replica) counts the work done in
+ * the thread that runs it. The threads of DomainCommunity keep
+ * their own counters, not reported by the main thread.
+ *
+ * Phases timed (wall time, in seconds):
+ *      SPP_PHASE_GRID_FILL     Community::fill_grid
+ *      SPP_PHASE_SENSE         sensing the velocities (or the
+ *                              forces), including the neighbor
+ *                              search (but not the noise added
+ *                              in batches)
+ *      SPP_PHASE_NOISE         Behavior::add_noise
+ *      SPP_PHASE_MOVE          Community::move and periodic_move
+ *      SPP_PHASE_OBSERVABLES   order parameter, correlations,
+ *                              fields and clusters
+ * Each phase is timed as a whole, never per agent, so that
+ * reading the clock does not add to the time measured.
+ * The neighbor search is not timed apart from SENSE, since
+ * it is interleaved with the rest of the sensing.
+ *
+ * Counted:
+ *      searches        agents that sensed their neighbors
+ *      candidates      agents they checked, e.g. the agents
+ *                      in the neighborhood of the Grid
+ *      neighbors       neighbors accepted
+ *      grid_fills      Grid rebuilds
+ * The searches and candidates are counted by the sensing loops
+ * of Community (and of the domains of DomainCommunity), so they
+ * are right for any Behavior. The neighbors accepted are only
+ * known inside the behavior, and are counted by the behaviors
+ * of the library, by the forces in Community::sense_forces and
+ * by LongRangeAlignment (the terms summed, out of all the
+ * pairs). A Behavior defined outside the library does not count
+ * them. ReplicaCommunity is not instrumented.
+ */
+#define SPP_PHASE_GRID_FILL    0
+#define SPP_PHASE_SENSE        1
+#define SPP_PHASE_NOISE        2
+#define SPP_PHASE_MOVE         3
+#define SPP_PHASE_OBSERVABLES  4
+#define SPP_NUM_PHASES         5
+
+struct SppProfile {
+    double time[SPP_NUM_PHASES] ;
+    long int calls[SPP_NUM_PHASES] ;
+    long int candidates ;
+    long int neighbors ;
+    long int searches ;
+    long int grid_fills ;
+} ;
+
+/* Counters of this thread. */
+extern thread_local SppProfile spp_profile ;
+
+#ifdef SPP_PROFILE
+#define SPP_PROFILE_START(t) double t = spp_profile_clock()
+#define SPP_PROFILE_STOP(t, phase) spp_profile_add(phase, spp_profile_clock() - t)
+#define SPP_PROFILE_COUNT(counter, n) (spp_profile.counter += (n))
+#else
+#define SPP_PROFILE_START(t)
+#define SPP_PROFILE_STOP(t, phase)
+#define SPP_PROFILE_COUNT(counter, n)
+#endif
+
+/* Return 1 if the library was compiled with -DSPP_PROFILE. */
+int spp_profile_enabled() ;
+/* Return a monotonic wall time, in seconds. */
+double spp_profile_clock() ;
+/* Add the time *t* to the phase *phase*, and one call. */
+void spp_profile_add(int phase, double t) ;
+/* Set all the counters of this thread to zero. */
+void spp_profile_reset() ;
+/* Print the counters of this thread to *out* as a table of
+ * comments, with the time per phase, the fraction of the total,
+ * and the neighbors accepted per search and per candidate.
+ */
+void spp_profile_print(FILE* out) ;
+/* Print the counters of this thread to *out* in one line
+ * of JSON, for scripts.
+ */
+void spp_profile_dump(FILE* out) ;
@@ -22,22 +22,47 @@ uint32_t spp_seed ;
 uint32_t kn[128] ;
 double fn[128] ;
 double wn[128] ;
+int spp_tables_ready = 0 ;
+
+static_assert(sizeof(spp_rng) == sizeof(uint32_t), "spp_rng must hold the 32 bits of shr3") ;
+
+/* Stream used by the calling thread instead
+ * of the shared one, if not NULL (see spp_use_rng).
+ */
+thread_local uint32_t* spp_thread_seed_ptr = NULL ;
+
+static inline uint32_t* current_seed(){
+    return spp_thread_seed_ptr ? spp_thread_seed_ptr : spp_seed_ptr ;
+}
 
 void spp_set_seed(long int s){
     r4_nor_setup(kn, fn, wn);
+    spp_tables_ready = 1 ;
     spp_seed = (uint32_t) s ;
     spp_seed_ptr = &spp_seed ;
 }
 
+void spp_rng_seed(spp_rng* rng, long int s){
+    if(!spp_tables_ready){
+        r4_nor_setup(kn, fn, wn);
+        spp_tables_ready = 1 ;
+    }
+    *rng = (uint32_t) s ;
+}
+
+void spp_use_rng(spp_rng* rng){
+    spp_thread_seed_ptr = (uint32_t*) rng ;
+}
+
 double spp_random_normal(){
-    return r4_nor(spp_seed_ptr, kn, fn, wn) ;
+    return r4_nor(current_seed(), kn, fn, wn) ;
 }
 
 double spp_random_uniform(){
-    return r4_uni(spp_seed_ptr) ;
+    return r4_uni(current_seed()) ;
 }
 
-void spp_random_normal_vector(double* vec){
+void spp_random_normal_vector(spp_real* vec){
     /* Note that a vector whose components are
      * normally distributed has a normally distributed
      * norm and homogeneous angular distribution.
@@ -46,18 +71,20 @@ void spp_random_normal_vector(double* vec){
      * not have uniformly distributed norm.)
      */
     int i ;
+    uint32_t* seed = current_seed() ;
     for(i=0; i<DIM; i++)
-        vec[i] = r4_nor(spp_seed_ptr, kn, fn, wn) ;
+        vec[i] = r4_nor(seed, kn, fn, wn) ;
 }
 
-void spp_random_vector(double* vec, double norm){
+void spp_random_vector(spp_real* vec, double norm){
     /* To fix the norm, first generate a normally
      * distributed vector and then re-scale it.
      */
     int i ;
     double v2 = 0.0 ;
+    uint32_t* seed = current_seed() ;
     for(i=0; i<DIM; i++){
-        vec[i] = r4_nor(spp_seed_ptr, kn, fn, wn) ;
+        vec[i] = r4_nor(seed, kn, fn, wn) ;
         v2 += vec[i]*vec[i] ;
     }
     for(i=0; i<DIM; i++)
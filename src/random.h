@@ -1,3 +1,4 @@
+#include "precision.h"
 /* Interface to generate random numbers in libspp.
  * spp_set_seed must be called before getting random
  * numbers, or one will get a segmentation fault
@@ -21,8 +22,32 @@
  * up the random number generator.
  * This function must be called before
  * using any of the spp_random_*.
+ * The generator is shared by all the
+ * threads that do not use their own
+ * stream (see spp_use_rng).
  */
 void spp_set_seed(long int s) ;
+
+/* State of an independent stream of random
+ * numbers (the 32 bits of the shr3 generator),
+ * used to give each of several simulations run
+ * concurrently (e.g. the replicas of an Ensemble)
+ * its own sequence.
+ */
+typedef unsigned int spp_rng ;
+/* Seed the stream *rng* with *s*. The first call
+ * also does the pre-computation of spp_set_seed,
+ * which is shared by all the streams, so it must
+ * not run while other threads generate numbers.
+ */
+void spp_rng_seed(spp_rng* rng, long int s) ;
+/* Make the spp_random_* functions called from
+ * the calling thread draw from the stream *rng*,
+ * or from the shared generator again if *rng* is
+ * NULL (the default in every thread). A stream
+ * must only be used by one thread at a time.
+ */
+void spp_use_rng(spp_rng* rng) ;
 /* Return a normal (gaussian) random
  * number with mean 0 and standard deviation 1.
  * Requires the previous execution of spp_set_seed().
@@ -37,8 +62,8 @@ double spp_random_uniform() ;
  * i.i.d. random normal (gaussian) numbers
  * with mean 0 and standard deviation 1.
  */
-void spp_random_normal_vector(double* vec) ;
+void spp_random_normal_vector(spp_real* vec) ;
 /* Set the array *vec* to a random vector with
  * norm *norm* and homogeneous angular distribution.
  */
-void spp_random_vector(double* vec, double norm) ;
+void spp_random_vector(spp_real* vec, double norm) ;
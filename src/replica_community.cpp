@@ -0,0 +1,488 @@
+#include "replica_community.h"
+#include <math.h>
+#include <stdio.h>
+
+/* Minimal image of the difference *dx* of two coordinates
+ * in [0:l), written without rint so that it vectorizes.
+ */
+static inline spp_real min_image(spp_real dx, spp_real l, spp_real hl){
+    dx = dx >  hl ? dx - l : dx ;
+    dx = dx < -hl ? dx + l : dx ;
+    return dx ;
+}
+
+ReplicaCommunity::ReplicaCommunity(int nags, int nreps, double L, spp_real* p, spp_real* v, double r, double vzero, double ns){
+    int i ;
+    long int* seeds ;
+    num_agents = nags ;
+    num_replicas = nreps ;
+    box_size = L ;
+    pos = p ;
+    vel = v ;
+    rad2 = r*r ;
+    v0 = vzero ;
+    noise = ns ;
+
+    /* Default seeds, see set_seeds */
+    jsr = new unsigned int[num_replicas] ;
+    seeds = new long int[num_replicas] ;
+    for(i=0; i<num_replicas; i++)
+        seeds[i] = i + 1 ;
+    this->set_seeds(seeds) ;
+    delete[] seeds ;
+    ang = new spp_real[num_agents*num_replicas] ;
+    cth = new spp_real[num_agents*num_replicas] ;
+    sth = new spp_real[num_agents*num_replicas] ;
+#if DIM>2
+    azi = new spp_real[num_agents*num_replicas] ;
+    cph = new spp_real[num_agents*num_replicas] ;
+    sph = new spp_real[num_agents*num_replicas] ;
+#else
+    azi = cph = sph = NULL ;
+#endif
+
+    /* Cells at least as large as the radius, but not many
+     * more cells than agents.
+     */
+    ncells = (int) (box_size / r) ;
+    if(pow(ncells, DIM) > 4 * num_agents)
+        ncells = (int) pow(4 * num_agents, 1.0/DIM) ;
+    if(ncells < 3){
+        ncells = 0 ;
+        num_cells = 0 ;
+        cell_start = cell_agents = agent_cell = NULL ;
+    }else{
+        num_cells = 1 ;
+        for(i=0; i<DIM; i++)
+            num_cells *= ncells ;
+        cell_start  = new int[(num_cells+1) * num_replicas] ;
+        cell_agents = new int[num_agents * num_replicas] ;
+        agent_cell  = new int[num_agents] ;
+    }
+}
+
+void ReplicaCommunity::set_seeds(long int* seeds){
+    /* Scramble the seeds (murmur3 finalizer) so that
+     * consecutive seeds give unrelated streams.
+     */
+    unsigned int h ;
+    for(int r=0; r<num_replicas; r++){
+        h = (unsigned int) seeds[r] ^ (unsigned int) (seeds[r] >> 32) ;
+        h ^= h >> 16 ;
+        h *= 0x85ebca6b ;
+        h ^= h >> 13 ;
+        h *= 0xc2b2ae35 ;
+        h ^= h >> 16 ;
+        jsr[r] = h ? h : 0x9e3779b9 ;
+    }
+}
+
+void ReplicaCommunity::random_uniform(int n, spp_real* u){
+    /* Same shr3 step as r4_uni in random.cpp. Casting the sum to a
+     * signed integer is the same as the fmod(.., 1.0) done there,
+     * and vectorizes.
+     */
+    const int nr = num_replicas ;
+    unsigned int a, b ;
+    int k, r ;
+    for(k=0; k<n; k++){
+        for(r=0; r<nr; r++){
+            a = jsr[r] ;
+            b = a ^ (a << 13) ;
+            b = b ^ (b >> 17) ;
+            b = b ^ (b << 5) ;
+            jsr[r] = b ;
+            u[k*nr + r] = (int) (a + b) * (1.0 / 4294967296.0) + 0.5 ;
+        }
+    }
+}
+
+void ReplicaCommunity::randomize_positions(){
+    const spp_real l = box_size ;
+    int k ;
+    this->random_uniform(num_agents*DIM, pos) ;
+    for(k=0; k<num_agents*DIM*num_replicas; k++)
+        pos[k] *= l ;
+}
+
+void ReplicaCommunity::randomize_directions(double vzero){
+    const int nr = num_replicas ;
+    const spp_real speed = vzero ;
+    int i, r, k ;
+    this->random_uniform(num_agents, ang) ;
+    for(k=0; k<num_agents*nr; k++)
+        ang[k] *= 2.0 * M_PI ;
+#if DIM==2
+    for(i=0; i<num_agents; i++){
+        for(r=0; r<nr; r++){
+            vel[(2*i)*nr + r]   = speed * cos(ang[i*nr + r]) ;
+            vel[(2*i+1)*nr + r] = speed * sin(ang[i*nr + r]) ;
+        }
+    }
+#elif DIM>2
+    spp_real z, rho ;
+    /* Uniform z in [-1:1] and azimuth: uniform on the sphere */
+    this->random_uniform(num_agents, azi) ;
+    for(i=0; i<num_agents; i++){
+        for(r=0; r<nr; r++){
+            z = 2.0 * azi[i*nr + r] - 1.0 ;
+            rho = sqrt(1.0 - z*z) ;
+            vel[(3*i)*nr + r]   = speed * rho * cos(ang[i*nr + r]) ;
+            vel[(3*i+1)*nr + r] = speed * rho * sin(ang[i*nr + r]) ;
+            vel[(3*i+2)*nr + r] = speed * z ;
+        }
+    }
+#endif
+}
+
+void ReplicaCommunity::periodic_move(double dt){
+    const spp_real h = dt ;
+    const spp_real l = box_size ;
+    spp_real x ;
+    for(int k=0; k<num_agents*DIM*num_replicas; k++){
+        x = pos[k] + h * vel[k] ;
+        x = x <  0 ? x + l : x ;
+        x = x >= l ? x - l : x ;
+        pos[k] = x ;
+    }
+}
+
+void ReplicaCommunity::sense_noisy_velocities(spp_real* vel_sensed){
+    if(ncells > 0)
+        this->sum_neighbors_cells(vel_sensed) ;
+    else
+        this->sum_neighbors_pairs(vel_sensed) ;
+    this->add_noise(vel_sensed) ;
+}
+
+void ReplicaCommunity::sum_neighbors_pairs(spp_real* vs){
+    /*
+     * Every pair once, for all the replicas at the same time:
+     * the pair (i,j) is checked in every replica and the
+     * velocities are added where they are neighbors.
+     * Each agent is a neighbor of itself.
+     */
+    const int nr = num_replicas ;
+    const int stride = DIM * nr ;
+    const spp_real l = box_size ;
+    const spp_real hl = 0.5 * box_size ;
+    const spp_real r2 = rad2 ;
+    spp_real *xi, *xj, *vi, *vj, *si, *sj ;
+    spp_real dx ;
+    spp_real* m = new spp_real[nr] ;
+    int i, j, d, r ;
+
+    for(i=0; i<num_agents*stride; i++)
+        vs[i] = vel[i] ;
+    for(i=0; i<num_agents; i++){
+        xi = pos + i*stride ;
+        vi = vel + i*stride ;
+        si = vs + i*stride ;
+        for(j=i+1; j<num_agents; j++){
+            xj = pos + j*stride ;
+            vj = vel + j*stride ;
+            sj = vs + j*stride ;
+            /* distance2 first, then 1 (neighbors) or 0 */
+            for(r=0; r<nr; r++)
+                m[r] = 0.0 ;
+            for(d=0; d<DIM; d++){
+                for(r=0; r<nr; r++){
+                    dx = min_image(xj[d*nr + r] - xi[d*nr + r], l, hl) ;
+                    m[r] += dx * dx ;
+                }
+            }
+            for(r=0; r<nr; r++)
+                m[r] = m[r] <= r2 ? 1.0 : 0.0 ;
+            for(d=0; d<DIM; d++){
+                for(r=0; r<nr; r++){
+                    si[d*nr + r] += m[r] * vj[d*nr + r] ;
+                    sj[d*nr + r] += m[r] * vi[d*nr + r] ;
+                }
+            }
+        }
+    }
+    delete[] m ;
+}
+
+void ReplicaCommunity::sum_neighbors_cells(spp_real* vs){
+    /*
+     * The neighbors are different in each replica, so here
+     * each replica is done separately with its own cell list,
+     * built with a counting sort of the agents by cell.
+     */
+    const int nr = num_replicas ;
+    const int stride = DIM * nr ;
+    const spp_real l = box_size ;
+    const spp_real hl = 0.5 * box_size ;
+    const spp_real r2 = rad2 ;
+    const spp_real inv_cell = ncells / box_size ;
+    int r, i, j, d, c, k, kk, jc, jk ;
+    int ci[DIM], cj[DIM], off[DIM] ;
+    int* cs ;
+    int* ca ;
+    spp_real dx, d2 ;
+    spp_real acc[DIM] ;
+    spp_real *x, *xi ;
+
+    for(r=0; r<nr; r++){
+        cs = cell_start + r*(num_cells+1) ;
+        ca = cell_agents + r*num_agents ;
+        x = pos + r ;
+        /* Counting sort of the agents by cell */
+        for(c=0; c<=num_cells; c++)
+            cs[c] = 0 ;
+        for(i=0; i<num_agents; i++){
+            c = 0 ;
+            for(d=0; d<DIM; d++){
+                k = (int) (x[(i*DIM + d)*nr] * inv_cell) ;
+                c = c*ncells + (k < ncells ? k : ncells-1) ;
+            }
+            agent_cell[i] = c ;
+            cs[c+1] += 1 ;
+        }
+        for(c=0; c<num_cells; c++)
+            cs[c+1] += cs[c] ;
+        for(i=0; i<num_agents; i++){
+            ca[cs[agent_cell[i]]] = i ;
+            cs[agent_cell[i]] += 1 ;
+        }
+        for(c=num_cells; c>0; c--)
+            cs[c] = cs[c-1] ;
+        cs[0] = 0 ;
+
+        /* Sum over the 3^DIM cells around the cell of each agent */
+        for(c=0; c<num_cells; c++){
+            k = c ;
+            for(d=DIM-1; d>=0; d--){
+                ci[d] = k % ncells ;
+                k /= ncells ;
+            }
+            for(k=cs[c]; k<cs[c+1]; k++){
+                i = ca[k] ;
+                xi = x + i*stride ;
+                for(d=0; d<DIM; d++)
+                    acc[d] = 0.0 ;
+                for(d=0; d<DIM; d++)
+                    off[d] = -1 ;
+                for(;;){
+                    jc = 0 ;
+                    for(d=0; d<DIM; d++){
+                        cj[d] = (ci[d] + off[d] + ncells) % ncells ;
+                        jc = jc*ncells + cj[d] ;
+                    }
+                    for(jk=cs[jc]; jk<cs[jc+1]; jk++){
+                        j = ca[jk] ;
+                        d2 = 0.0 ;
+                        for(d=0; d<DIM; d++){
+                            dx = min_image(x[j*stride + d*nr] - xi[d*nr], l, hl) ;
+                            d2 += dx * dx ;
+                        }
+                        if(d2 <= r2){
+                            for(d=0; d<DIM; d++)
+                                acc[d] += vel[j*stride + d*nr + r] ;
+                        }
+                    }
+                    /* next offset in {-1,0,1}^DIM */
+                    for(kk=DIM-1; kk>=0 && off[kk]==1; kk--)
+                        off[kk] = -1 ;
+                    if(kk < 0)
+                        break ;
+                    off[kk] += 1 ;
+                }
+                for(d=0; d<DIM; d++)
+                    vs[i*stride + d*nr + r] = acc[d] ;
+            }
+        }
+    }
+}
+
+void ReplicaCommunity::add_noise(spp_real* vs){
+    const int nr = num_replicas ;
+    const int n = num_agents * nr ;
+    const spp_real speed = v0 ;
+    spp_real v2, f ;
+    int i, r, k ;
+    spp_real* s ;
+
+    /* Normalize to v0 */
+    for(i=0; i<num_agents; i++){
+        s = vs + i*DIM*nr ;
+        for(r=0; r<nr; r++){
+            v2 = 0.0 ;
+            for(k=0; k<DIM; k++)
+                v2 += s[k*nr + r] * s[k*nr + r] ;
+            f = speed / sqrt(v2) ;
+            for(k=0; k<DIM; k++)
+                s[k*nr + r] *= f ;
+        }
+    }
+
+    /* Random rotation, as in Vicsek_consensus::rotate_batch.
+     * The sin and cos loops are kept separate so that
+     * they are vectorized.
+     */
+    this->random_uniform(num_agents, ang) ;
+    for(k=0; k<n; k++)
+        ang[k] = noise * 2.0 * M_PI * (ang[k] - 0.5) ;
+    for(k=0; k<n; k++)
+        sth[k] = sin(ang[k]) ;
+    for(k=0; k<n; k++)
+        cth[k] = cos(ang[k]) ;
+#if DIM==2
+    spp_real vx, vy ;
+    for(i=0; i<num_agents; i++){
+        s = vs + i*2*nr ;
+        for(r=0; r<nr; r++){
+            k = i*nr + r ;
+            vx = s[r] ;
+            vy = s[nr + r] ;
+            s[r]      = cth[k] * vx - sth[k] * vy ;
+            s[nr + r] = sth[k] * vx + cth[k] * vy ;
+        }
+    }
+#elif DIM>2
+    spp_real ux, uy, uz, sign, a, b, e1x, e1y, e1z, e2x, e2y, e2z, px, py, pz ;
+    const spp_real one = 1.0 ;
+    this->random_uniform(num_agents, azi) ;
+    for(k=0; k<n; k++)
+        azi[k] *= 2.0 * M_PI ;
+    for(k=0; k<n; k++)
+        sph[k] = sin(azi[k]) ;
+    for(k=0; k<n; k++)
+        cph[k] = cos(azi[k]) ;
+    for(i=0; i<num_agents; i++){
+        s = vs + i*3*nr ;
+        for(r=0; r<nr; r++){
+            k = i*nr + r ;
+            /* Branchless orthonormal basis (e1,e2) perpendicular to u=v/v0,
+             * Duff et al. J. Comput. Graph. Tech. 6, 1 (2017).
+             */
+            ux = s[r] / speed ;
+            uy = s[nr + r] / speed ;
+            uz = s[2*nr + r] / speed ;
+            sign = copysign(one, uz) ;
+            a = -one / (sign + uz) ;
+            b = ux * uy * a ;
+            e1x = one + sign * ux * ux * a ;
+            e1y = sign * b ;
+            e1z = -sign * ux ;
+            e2x = b ;
+            e2y = sign + uy * uy * a ;
+            e2z = -uy ;
+            px = cph[k] * e1x + sph[k] * e2x ;
+            py = cph[k] * e1y + sph[k] * e2y ;
+            pz = cph[k] * e1z + sph[k] * e2z ;
+            s[r]        = cth[k] * s[r]        + sth[k] * speed * px ;
+            s[nr + r]   = cth[k] * s[nr + r]   + sth[k] * speed * py ;
+            s[2*nr + r] = cth[k] * s[2*nr + r] + sth[k] * speed * pz ;
+        }
+    }
+#endif
+}
+
+void ReplicaCommunity::update_velocities(spp_real* vel_sensed){
+    for(int k=0; k<num_agents*DIM*num_replicas; k++)
+        vel[k] = vel_sensed[k] ;
+}
+
+void ReplicaCommunity::mean_velocity(double* meanvel){
+    const int nr = num_replicas ;
+    int i, k ;
+    for(k=0; k<DIM*nr; k++)
+        meanvel[k] = 0.0 ;
+    for(i=0; i<num_agents; i++){
+        for(k=0; k<DIM*nr; k++)
+            meanvel[k] += vel[i*DIM*nr + k] ;
+    }
+    for(k=0; k<DIM*nr; k++)
+        meanvel[k] /= num_agents ;
+}
+
+void ReplicaCommunity::order_parameter(double vzero, double* op){
+    const int nr = num_replicas ;
+    double* mv = new double[DIM*nr] ;
+    int r, d ;
+    this->mean_velocity(mv) ;
+    for(r=0; r<nr; r++){
+        op[r] = 0.0 ;
+        for(d=0; d<DIM; d++)
+            op[r] += mv[d*nr + r] * mv[d*nr + r] ;
+        op[r] = sqrt(op[r]) / vzero ;
+    }
+    delete[] mv ;
+}
+
+void ReplicaCommunity::correlation_histo(int n_bins, double vzero, double* totalcorr, int* count){
+    /*
+     * Same as Community::correlation_histo, for every replica.
+     * The distance and the correlation of a pair are computed
+     * for all the replicas at once, and then added to the bin
+     * of each replica.
+     */
+    const int nr = num_replicas ;
+    const int stride = DIM * nr ;
+    const spp_real l = box_size ;
+    const spp_real hl = 0.5 * box_size ;
+    double bindist = n_bins / (this->max_distance() * 1.000001) ;
+    double* mv   = new double[DIM*nr] ;
+    double* norm = new double[nr] ;
+    double* corr = new double[nr] ;
+    int* bin = new int[nr] ;
+    spp_real *xi, *xj, *vi, *vj ;
+    spp_real dx, d2 ;
+    double c ;
+    int i, j, d, r ;
+
+    for(i=0; i<n_bins*nr; i++)
+        totalcorr[i] = 0.0 ;
+    for(i=0; i<n_bins*nr; i++)
+        count[i] = 0 ;
+
+    this->mean_velocity(mv) ;
+    for(r=0; r<nr; r++){
+        c = 0.0 ;
+        for(d=0; d<DIM; d++)
+            c += mv[d*nr + r] * mv[d*nr + r] ;
+        norm[r] = 1.0 / ( vzero * vzero - c ) ;
+    }
+
+    for(i=0; i<num_agents; i++){
+        xi = pos + i*stride ;
+        vi = vel + i*stride ;
+        for(j=i+1; j<num_agents; j++){
+            xj = pos + j*stride ;
+            vj = vel + j*stride ;
+            for(r=0; r<nr; r++){
+                d2 = 0.0 ;
+                c = 0.0 ;
+                for(d=0; d<DIM; d++){
+                    dx = min_image(xj[d*nr + r] - xi[d*nr + r], l, hl) ;
+                    d2 += dx * dx ;
+                    c += (vi[d*nr + r] - mv[d*nr + r]) * (vj[d*nr + r] - mv[d*nr + r]) ;
+                }
+                bin[r] = int( sqrt(d2) * bindist ) ;
+                corr[r] = c ;
+            }
+            for(r=0; r<nr; r++){
+                count[r*n_bins + bin[r]] += 1 ;
+                totalcorr[r*n_bins + bin[r]] += corr[r] ;
+            }
+        }
+    }
+    for(r=0; r<nr; r++){
+        for(i=0; i<n_bins; i++)
+            totalcorr[r*n_bins + i] *= norm[r] ;
+    }
+    delete[] mv ;
+    delete[] norm ;
+    delete[] corr ;
+    delete[] bin ;
+}
+
+double ReplicaCommunity::max_distance(){
+    return box_size * sqrt(DIM / 4.) ;
+}
+
+spp_real* spp_replica_alloc_space(int num_agents, int num_replicas){
+    return new spp_real[num_agents * DIM * num_replicas] ;
+}
@@ -0,0 +1,170 @@
+#include "precision.h"
+
+/*
+ * ReplicaCommunity class implemented to advance many
+ * independent replicas of a small system in lockstep.
+ * All the replicas have the same number of agents
+ * and follow the Vicsek model with metric interaction
+ * in a periodic box (see Vicsek_consensus and Metric),
+ * but each one has its own positions, velocities and
+ * stream of random numbers.
+ *
+ * The state is stored replica-interleaved: the
+ * component *d* of the position of agent *i* in
+ * replica *r* is
+ *      pos[(i*DIM + d)*num_replicas + r]
+ * so that every kernel that does the same for all the
+ * agents (normalization, noise, move, random numbers,
+ * order parameter, pair correlations) loops over the
+ * replicas in the innermost loop and is vectorized by
+ * the compiler, processing several replicas per vector
+ * instruction. The neighbors, which are different in
+ * each replica, are found with a cell list per replica
+ * when the box is at least three interaction radii long,
+ * and with a vectorized loop over all the pairs of
+ * all the replicas otherwise.
+ *
+ * The random numbers use the same generator as
+ * spp_random_uniform (shr3) with one state per replica,
+ * so they do NOT depend on spp_set_seed.
+ *
+ * As with Community, the user allocates the positions
+ * and velocities (see spp_replica_alloc_space). The
+ * cell lists and the temporary arrays for the noise,
+ * of order num_agents*num_replicas, are allocated on
+ * initialization.
+ */
+class ReplicaCommunity{
+    public:
+        /* Construct the batch of replicas.
+         * Inputs:
+         *      nags = number of agents in each replica.
+         *      nreps = number of replicas.
+         *      L = size of the (periodic) box.
+         *      p, v = arrays to store the positions
+         *      and velocities, of size nags*nreps*DIM
+         *      (see spp_replica_alloc_space).
+         *      r = radius of the metric interaction.
+         *      v0 = speed of the agents.
+         *      noise = noise of the Vicsek model, in [0:1].
+         */
+        ReplicaCommunity(int nags, int nreps, double L, spp_real* p, spp_real* v, double r, double v0, double noise) ;
+        /* Seed the random number generator of each replica
+         * with the *num_replicas* values in *seeds*. Two
+         * replicas with the same seed follow the same
+         * trajectory.
+         */
+        void set_seeds(long int* seeds) ;
+        /* Return the pointer to the position array. */
+        spp_real* get_pos() {return pos;} ;
+        /* Return the pointer to the velocity array. */
+        spp_real* get_vel() {return vel;} ;
+        /* Return how many agents are in each replica. */
+        int get_num_agents() {return num_agents;} ;
+        /* Return how many replicas there are. */
+        int get_num_replicas() {return num_replicas;} ;
+        /* Return box size. */
+        double get_box_size() {return box_size;} ;
+        /* Store random values in the [0:box_size] range
+         * in the position array *pos*.
+         */
+        void randomize_positions() ;
+        /* Store random velocities of norm *v0* and
+         * homogeneous angular distribution in *vel*.
+         */
+        void randomize_directions(double v0) ;
+        /* Move all the agents during *dt* time, assuming
+         * periodic boundary conditions in each direction.
+         * *dt* * *v0* must be smaller than the box size.
+         */
+        void periodic_move(double dt) ;
+        /* Sense the noisy velocities of the Vicsek model
+         * for every agent of every replica and store them
+         * in *vel_sensed* (same layout as *vel*).
+         * Note: it is not safe to use the class'
+         * own *vel* as *vel_sensed*.
+         */
+        void sense_noisy_velocities(spp_real* vel_sensed) ;
+        /* Copy the values in *vel_sensed* to *vel*. */
+        void update_velocities(spp_real* vel_sensed) ;
+        /* Store the mean velocity of each replica in *meanvel*,
+         * component *d* of replica *r* in meanvel[d*num_replicas + r].
+         * The size of *meanvel* must be DIM*num_replicas.
+         */
+        void mean_velocity(double* meanvel) ;
+        /* Store the order parameter of each replica
+         * (see Community::order_parameter) in *op*,
+         * of size num_replicas.
+         */
+        void order_parameter(double v0, double* op) ;
+        /* Compute the correlations in velocity fluctuations
+         * of each replica as in Community::correlation_histo.
+         * The histogram of replica *r* is stored in
+         *      totalcorr[r*n_bins : (r+1)*n_bins]
+         *      count[r*n_bins : (r+1)*n_bins]
+         * so both arrays must be of size n_bins*num_replicas.
+         */
+        void correlation_histo(int n_bins, double v0, double* totalcorr, int* count) ;
+        /* Return the distance between the two farthest points in
+         * the computation box with periodic boundary conditions.
+         */
+        double max_distance() ;
+    protected:
+        /* Fill *u* with *n* uniform random numbers
+         * in [0:1) for each replica, u[k*num_replicas + r]
+         * for replica *r*.
+         */
+        void random_uniform(int n, spp_real* u) ;
+        /* Sum the velocities of the neighbors of every
+         * agent into *vs* using the cell lists.
+         */
+        void sum_neighbors_cells(spp_real* vs) ;
+        /* Sum the velocities of the neighbors of every
+         * agent into *vs* checking all the pairs.
+         */
+        void sum_neighbors_pairs(spp_real* vs) ;
+        /* Normalize the velocities in *vs* to *v0*
+         * and rotate them by a random angle.
+         */
+        void add_noise(spp_real* vs) ;
+        int num_agents ;
+        int num_replicas ;
+        /* State, see layout above.
+         *      Size: num_agents * DIM * num_replicas
+         */
+        spp_real* pos ;
+        spp_real* vel ;
+        double box_size ;
+        /* Parameters of the Vicsek model. */
+        spp_real rad2 ;
+        double v0 ;
+        double noise ;
+        /* Random number generator state of each replica
+         * (32 bits, as in random.cpp).
+         */
+        unsigned int* jsr ;
+        /* Random angles and their sines and cosines,
+         *      Size: num_agents * num_replicas
+         * (*azi*, *cph* and *sph* only in 3D).
+         */
+        spp_real *ang, *cth, *sth ;
+        spp_real *azi, *cph, *sph ;
+        /* Cell lists, one per replica, with *ncells* cells
+         * per dimension (0 if not used) and *num_cells* in total.
+         * The agents in cell *c* of replica *r* are stored in
+         *      cell_agents[r*num_agents + k]
+         * for k in cell_start[r*(num_cells+1) + c] to
+         * cell_start[r*(num_cells+1) + c + 1] - 1.
+         */
+        int ncells ;
+        int num_cells ;
+        int* cell_start ;
+        int* cell_agents ;
+        int* agent_cell ;
+} ;
+
+/* Allocate space for storing a vector per agent and
+ * replica, i.e. num_agents * DIM * num_replicas
+ * spp_reals, and return the pointer to the array.
+ */
+spp_real* spp_replica_alloc_space(int num_agents, int num_replicas) ;
@@ -0,0 +1,398 @@
+#include "statistics.h"
+#include "community.h"
+#include <math.h>
+
+OnlineStats::OnlineStats(int ml){
+    max_lag = ml > 0 ? ml : 0 ;
+    history = NULL ;
+    if(max_lag > 0)
+        history = new double[max_lag] ;
+    lag_sum = new double[max_lag+1] ;
+    this->reset() ;
+}
+
+void OnlineStats::reset(){
+    int l ;
+    count = 0 ;
+    shift = 0.0 ;
+    sum1 = sum2 = sumx2 = sumx4 = 0.0 ;
+    for(l=0; l<SPP_STATS_MAX_LEVELS; l++){
+        block_n[l] = 0 ;
+        block_sum[l] = block_sum2[l] = block_wait[l] = 0.0 ;
+        block_pending[l] = 0 ;
+    }
+    for(l=0; l<=max_lag; l++)
+        lag_sum[l] = 0.0 ;
+}
+
+void OnlineStats::add(double x){
+    int k, l, kmax ;
+    double y, x2 ;
+    if(count == 0)
+        shift = x ;
+    y = x - shift ;
+    x2 = x * x ;
+    sum1 += y ;
+    sum2 += y * y ;
+    sumx2 += x2 ;
+    sumx4 += x2 * x2 ;
+
+    if(max_lag > 0){
+        /* history[t % max_lag] holds the value of step t,
+         * the loop is split where the buffer wraps around.
+         */
+        int now = count % max_lag ;
+        kmax = count < max_lag ? count : max_lag ;
+        for(k=1; k<=now && k<=kmax; k++)
+            lag_sum[k] += y * history[now - k] ;
+        for(k=now+1; k<=kmax; k++)
+            lag_sum[k] += y * history[now - k + max_lag] ;
+        history[now] = y ;
+    }
+    count += 1 ;
+
+    /* Each pair of blocks of level l is one block of level l+1 */
+    for(l=0; l<SPP_STATS_MAX_LEVELS; l++){
+        block_n[l] += 1 ;
+        block_sum[l] += y ;
+        block_sum2[l] += y * y ;
+        if(!block_pending[l]){
+            block_wait[l] = y ;
+            block_pending[l] = 1 ;
+            break ;
+        }
+        y = 0.5 * (block_wait[l] + y) ;
+        block_pending[l] = 0 ;
+    }
+}
+
+double OnlineStats::mean(){
+    if(count == 0)
+        return 0.0 ;
+    return shift + sum1 / count ;
+}
+
+double OnlineStats::variance(){
+    if(count == 0)
+        return 0.0 ;
+    double m = sum1 / count ;
+    return sum2 / count - m * m ;
+}
+
+double OnlineStats::binder_cumulant(){
+    if(count == 0 || sumx2 == 0.0)
+        return 0.0 ;
+    double m2 = sumx2 / count ;
+    return 1.0 - (sumx4 / count) / (3.0 * m2 * m2) ;
+}
+
+double OnlineStats::naive_error(){
+    return this->block_error(0) ;
+}
+
+double OnlineStats::block_error(int l){
+    long int n = block_n[l] ;
+    double m, var ;
+    if(n < 2)
+        return 0.0 ;
+    m = block_sum[l] / n ;
+    var = block_sum2[l] / n - m * m ;
+    return var > 0.0 ? sqrt(var / (n - 1)) : 0.0 ;
+}
+
+int OnlineStats::num_levels(){
+    int l = 0 ;
+    while(l < SPP_STATS_MAX_LEVELS && block_n[l] >= 2)
+        l++ ;
+    return l ;
+}
+
+double OnlineStats::error(){
+    /* The error grows with the block size until it reaches a
+     * plateau. Take the largest value with enough blocks.
+     */
+    double err = this->naive_error() ;
+    double e ;
+    for(int l=1; l<SPP_STATS_MAX_LEVELS && block_n[l] >= SPP_STATS_MIN_BLOCKS; l++){
+        e = this->block_error(l) ;
+        err = e > err ? e : err ;
+    }
+    return err ;
+}
+
+double OnlineStats::autocorrelation_time(){
+    int k, kmax ;
+    double m, c0, tau ;
+    if(max_lag == 0 || count < 2)
+        return 0.5 ;
+    m = sum1 / count ;
+    c0 = sum2 / count - m * m ;
+    if(c0 <= 0.0)
+        return 0.5 ;
+    tau = 0.5 ;
+    kmax = count - 1 < max_lag ? count - 1 : max_lag ;
+    for(k=1; k<=kmax; k++){
+        tau += (lag_sum[k] / (count - k) - m * m) / c0 ;
+        if(k >= 6.0 * tau)
+            break ;
+    }
+    return tau ;
+}
+
+int OnlineStats::converged(double target_error){
+    /* Enough blocks for the largest blocks used to be longer
+     * than the correlation time, and many correlation times.
+     */
+    if(block_n[0] < 2*SPP_STATS_MIN_BLOCKS)
+        return 0 ;
+    if(count < 100.0 * this->autocorrelation_time())
+        return 0 ;
+    return this->error() <= target_error ;
+}
+
+void OnlineStats::print(FILE* out){
+    fprintf(out, "# Values              %li\n", count) ;
+    fprintf(out, "# Mean                %f\n", this->mean()) ;
+    fprintf(out, "# Error (blocking)    %f\n", this->error()) ;
+    fprintf(out, "# Error (naive)       %f\n", this->naive_error()) ;
+    fprintf(out, "# Variance            %f\n", this->variance()) ;
+    fprintf(out, "# Binder cumulant     %f\n", this->binder_cumulant()) ;
+    fprintf(out, "# Autocorrelation     %f\n", this->autocorrelation_time()) ;
+}
+
+
+TransientDetector::TransientDetector(int bs){
+    batch_size = bs > 0 ? bs : 1 ;
+    capacity = 1024 ;
+    batches = new double[capacity] ;
+    this->reset() ;
+}
+
+TransientDetector::~TransientDetector(){
+    delete[] batches ;
+}
+
+void TransientDetector::reset(){
+    count = 0 ;
+    batch_acc = 0.0 ;
+    num_batches = 0 ;
+    equilibration = -1 ;
+}
+
+void TransientDetector::add(double x){
+    batch_acc += x ;
+    count += 1 ;
+    if(count % batch_size != 0)
+        return ;
+    if(num_batches == capacity){
+        double* tmp = new double[2*capacity] ;
+        for(int j=0; j<num_batches; j++)
+            tmp[j] = batches[j] ;
+        delete[] batches ;
+        batches = tmp ;
+        capacity *= 2 ;
+    }
+    batches[num_batches] = batch_acc / batch_size ;
+    num_batches += 1 ;
+    batch_acc = 0.0 ;
+}
+
+int TransientDetector::truncation(){
+    /* Sums of the batches after d, from the end, shifted by
+     * the last batch to avoid cancellations. Only the first
+     * half is searched (d <= m/2), as the few last batches
+     * can give a spuriously small SE.
+     */
+    int m = num_batches ;
+    int d, dbest = 0 ;
+    double y, s1 = 0.0, s2 = 0.0 ;
+    double se, sebest = HUGE_VAL ;
+    if(m < 2)
+        return 0 ;
+    for(d=m-1; d>=0; d--){
+        y = batches[d] - batches[m-1] ;
+        s1 += y ;
+        s2 += y * y ;
+        /* SE(d) with the batches d..m-1, i.e. d truncated */
+        if(2*d > m)
+            continue ;
+        se = (s2 - s1 * s1 / (m - d)) / ((double) (m - d) * (m - d)) ;
+        if(se <= sebest){
+            sebest = se ;
+            dbest = d ;
+        }
+    }
+    return dbest ;
+}
+
+int TransientDetector::drift(int d){
+    /* Fit a line to the batches after d and compare its slope
+     * with its error, computed from the residuals and corrected
+     * for the correlation between consecutive batches as in an
+     * AR(1) process.
+     */
+    int k = num_batches - d ;
+    int j ;
+    double xc = 0.5 * (k - 1) ;
+    double mean = 0.0, sxx = 0.0, sxy = 0.0, slope ;
+    double e, eprev = 0.0, var = 0.0, c1 = 0.0, r1, err2 ;
+    if(k < 4)
+        return 1 ;
+    for(j=0; j<k; j++)
+        mean += batches[d+j] ;
+    mean /= k ;
+    for(j=0; j<k; j++){
+        sxx += (j - xc) * (j - xc) ;
+        sxy += (j - xc) * (batches[d+j] - mean) ;
+    }
+    slope = sxy / sxx ;
+    for(j=0; j<k; j++){
+        e = batches[d+j] - mean - slope * (j - xc) ;
+        var += e * e ;
+        if(j > 0)
+            c1 += e * eprev ;
+        eprev = e ;
+    }
+    if(var <= 0.0)
+        return 0 ;
+    r1 = c1 / var ;
+    r1 = r1 < 0.0 ? 0.0 : (r1 > 0.95 ? 0.95 : r1) ;
+    err2 = var / (k - 2) / sxx * (1.0 + r1) / (1.0 - r1) ;
+    return slope * slope > SPP_TRANSIENT_DRIFT_Z * SPP_TRANSIENT_DRIFT_Z * err2 ;
+}
+
+int TransientDetector::stationary(){
+    /* Move the truncation point from the MSER one to later
+     * batches, in steps of m/20, while the rest still drifts.
+     */
+    int m = num_batches ;
+    int d, step ;
+    if(m < SPP_TRANSIENT_MIN_BATCHES)
+        return 0 ;
+    step = m / 20 > 1 ? m / 20 : 1 ;
+    for(d=this->truncation(); d<m/2; d+=step){
+        if(!this->drift(d)){
+            equilibration = (long int) d * batch_size ;
+            return 1 ;
+        }
+    }
+    return 0 ;
+}
+
+long int TransientDetector::equilibration_time(){
+    return equilibration ;
+}
+
+
+MSDTracker::MSDTracker(int n, int ml, int nl, int oi, int mo){
+    int k, l ;
+    num_agents = n ;
+    max_lag = ml > 1 ? ml : 1 ;
+    origin_interval = oi > 0 ? oi : 1 ;
+    max_origins = mo > 0 ? mo : 1 ;
+    nl = nl > 1 ? nl : 2 ;
+
+    /* Logarithmic lags, skipping the repeated integers */
+    lags = new int[nl] ;
+    lag_index = new int[max_lag + 1] ;
+    for(l=0; l<=max_lag; l++)
+        lag_index[l] = -1 ;
+    num_lags = 0 ;
+    for(k=0; k<nl; k++){
+        l = (int) floor(pow(max_lag, k / (nl - 1.0)) + 0.5) ;
+        l = l < 1 ? 1 : (l > max_lag ? max_lag : l) ;
+        if(lag_index[l] < 0){
+            lag_index[l] = num_lags ;
+            lags[num_lags] = l ;
+            num_lags += 1 ;
+        }
+    }
+
+    msd_sum = new double[num_lags] ;
+    vacf_sum = new double[num_lags] ;
+    num_samples = new long int[num_lags] ;
+    origin_time = new long int[max_origins] ;
+    origin_pos = new double[(long int) max_origins * num_agents * DIM] ;
+    origin_vel = new double[(long int) max_origins * num_agents * DIM] ;
+    upos_buffer = new double[num_agents * DIM] ;
+    this->reset() ;
+}
+
+void MSDTracker::reset(){
+    int k ;
+    count = 0 ;
+    for(k=0; k<num_lags; k++){
+        msd_sum[k] = 0.0 ;
+        vacf_sum[k] = 0.0 ;
+        num_samples[k] = 0 ;
+    }
+    for(k=0; k<max_origins; k++)
+        origin_time[k] = -1 ;
+}
+
+void MSDTracker::add(Community* com){
+    if(com->get_images() == NULL && count == 0)
+        fprintf(stderr,"libspp.MSDTracker: ERROR - The Community does not count the periodic images (see Community::setup_images).\n") ;
+    com->unwrapped_positions(upos_buffer) ;
+    this->add(upos_buffer, com->get_vel()) ;
+}
+
+void MSDTracker::add(double* upos, spp_real* vel){
+    int o, k, i, nd = num_agents * DIM ;
+    int free_slot = -1 ;
+    long int age ;
+    double dx, m, c ;
+    double *p0, *v0 ;
+    for(o=0; o<max_origins; o++){
+        if(origin_time[o] < 0){
+            free_slot = o ;
+            continue ;
+        }
+        age = count - origin_time[o] ;
+        if(age > max_lag){
+            origin_time[o] = -1 ;
+            free_slot = o ;
+            continue ;
+        }
+        k = lag_index[age] ;
+        if(k < 0)
+            continue ;
+        p0 = origin_pos + (long int) o * nd ;
+        v0 = origin_vel + (long int) o * nd ;
+        m = 0.0 ;
+        c = 0.0 ;
+        for(i=0; i<nd; i++){
+            dx = upos[i] - p0[i] ;
+            m += dx * dx ;
+            c += vel[i] * v0[i] ;
+        }
+        msd_sum[k] += m / num_agents ;
+        vacf_sum[k] += c / num_agents ;
+        num_samples[k] += 1 ;
+    }
+    /* New origin, if there is room for it */
+    if(count % origin_interval == 0 && free_slot >= 0){
+        p0 = origin_pos + (long int) free_slot * nd ;
+        v0 = origin_vel + (long int) free_slot * nd ;
+        for(i=0; i<nd; i++){
+            p0[i] = upos[i] ;
+            v0[i] = vel[i] ;
+        }
+        origin_time[free_slot] = count ;
+    }
+    count += 1 ;
+}
+
+double MSDTracker::msd(int k){
+    return num_samples[k] > 0 ? msd_sum[k] / num_samples[k] : 0.0 ;
+}
+
+double MSDTracker::vacf(int k){
+    return num_samples[k] > 0 ? vacf_sum[k] / num_samples[k] : 0.0 ;
+}
+
+void MSDTracker::print(FILE* out){
+    fprintf(out, "# Lag\tMSD\tVACF\tSamples\n") ;
+    for(int k=0; k<num_lags; k++)
+        fprintf(out, "%i\t%f\t%f\t%li\n", lags[k], this->msd(k), this->vacf(k), num_samples[k]) ;
+}
@@ -0,0 +1,251 @@
+#include "precision.h"
+#include <stdio.h>
+
+class Community ;
+
+/* Maximum number of blocking levels (blocks of up to 2^(levels-1) values). */
+#define SPP_STATS_MAX_LEVELS 48
+/* Minimum number of blocks for a blocking level to be used for the error. */
+#define SPP_STATS_MIN_BLOCKS 32
+
+/*
+ * OnlineStats class implemented to analyze a time series, e.g.
+ * the order parameter, as it is produced, without storing it.
+ * Each call to add() costs O(1) for the moments and the blocking
+ * analysis and O(*max_lag*) for the autocorrelation.
+ *
+ * It keeps:
+ *      - The mean, variance and fourth moment, for the Binder
+ *      cumulant U = 1 - <x^4> / (3 <x^2>^2).
+ *      - The blocking analysis of Flyvbjerg and Petersen: at
+ *      level *l* the series is averaged in blocks of 2^l values,
+ *      and the naive error of the mean of the blocks grows with
+ *      *l* until the blocks are longer than the correlation time.
+ *      - The autocorrelation function up to *max_lag* steps, from
+ *      which the integrated autocorrelation time is computed with
+ *      the automatic window of Sokal (the sum is cut at the first
+ *      lag *M* with M >= 6 tau(M)).
+ *
+ * The error of the mean given by error() is the blocking estimate,
+ * which is valid even if the correlation time is longer than
+ * *max_lag*, so a run can be stopped when converged() is true.
+ */
+class OnlineStats {
+    public:
+        /* Create an empty series, keeping the autocorrelation
+         * function up to *max_lag* steps (0 to not compute it).
+         */
+        OnlineStats(int max_lag) ;
+        /* Add the value *x* to the series. */
+        void add(double x) ;
+        /* Remove all the values. */
+        void reset() ;
+        /* Return the number of values. */
+        long int get_count() {return count;} ;
+        /* Return the mean. */
+        double mean() ;
+        /* Return the variance (of the values, not of the mean). */
+        double variance() ;
+        /* Return the Binder cumulant 1 - <x^4> / (3 <x^2>^2). */
+        double binder_cumulant() ;
+        /* Return the error of the mean assuming that the
+         * values are uncorrelated, sqrt( variance / (count-1) ).
+         */
+        double naive_error() ;
+        /* Return the error of the mean from the blocking analysis:
+         * the largest error of the levels with at least
+         * SPP_STATS_MIN_BLOCKS blocks.
+         */
+        double error() ;
+        /* Return the number of blocking levels with at least two
+         * blocks, and the number of blocks and the error of the mean
+         * at the level *l*.
+         */
+        int num_levels() ;
+        long int block_count(int l) {return block_n[l];} ;
+        double block_error(int l) ;
+        /* Return the integrated autocorrelation time, in steps
+         * (0.5 for uncorrelated values). If the window does not
+         * fit in *max_lag*, the sum up to *max_lag* is returned
+         * (an underestimate).
+         */
+        double autocorrelation_time() ;
+        /* Return 1 if the error of the mean is smaller than
+         * *target_error* with enough blocks to trust it, 0 otherwise.
+         */
+        int converged(double target_error) ;
+        /* Print the mean, errors, Binder cumulant and autocorrelation
+         * time to *out*, as comments.
+         */
+        void print(FILE* out) ;
+    protected:
+        long int count ;
+        /* Sums of x-shift, (x-shift)^2, x^2 and x^4, with the
+         * first value as *shift* to avoid cancellations.
+         */
+        double shift ;
+        double sum1, sum2 ;
+        double sumx2, sumx4 ;
+        /* Blocking: for each level, the number of complete blocks,
+         * the sums of their means (minus shift) and squares, and the
+         * value waiting for its pair, if *block_pending*.
+         */
+        long int block_n[SPP_STATS_MAX_LEVELS] ;
+        double block_sum[SPP_STATS_MAX_LEVELS] ;
+        double block_sum2[SPP_STATS_MAX_LEVELS] ;
+        double block_wait[SPP_STATS_MAX_LEVELS] ;
+        int block_pending[SPP_STATS_MAX_LEVELS] ;
+        /* Autocorrelation: last *max_lag* values (minus shift)
+         * in a circular buffer and, for each lag *k*, the sum of
+         * the products of the values *k* steps apart.
+         */
+        int max_lag ;
+        double* history ;
+        double* lag_sum ;
+} ;
+
+/* Minimum number of batches to test for stationarity. */
+#define SPP_TRANSIENT_MIN_BATCHES 40
+/* Slope of the stationary part, in standard errors,
+ * above which there is still a drift.
+ */
+#define SPP_TRANSIENT_DRIFT_Z 2.0
+
+/*
+ * TransientDetector class implemented to find when a time series,
+ * e.g. the order parameter from the initial random configuration,
+ * becomes stationary, to end the transient instead of running a
+ * fixed number of steps.
+ *
+ * It uses the Marginal Standard Error Rule (MSER): the values are
+ * averaged in batches of *batch_size* steps, and the truncation point
+ * is the number of initial batches *d* that minimizes
+ *      SE(d) = sum_{j>d} (y_j - mean_d)^2 / (m-d)^2
+ * where *m* is the number of batches and mean_d the mean of the
+ * batches after *d*, searched for d <= m/2. The series is considered
+ * stationary once there is a truncation point in that range, from
+ * the MSER one on, after which a linear fit to the batches has a
+ * slope smaller than SPP_TRANSIENT_DRIFT_Z standard errors (the
+ * tail of a slow relaxation can fool MSER alone). The equilibration
+ * time is then that truncation point, in steps.
+ *
+ * It stores one value per batch, and each stationary() call is
+ * O(number of batches), so it should be called every few steps.
+ */
+class TransientDetector {
+    public:
+        /* Create an empty series with batches of
+         * *batch_size* values (5 for MSER-5).
+         */
+        TransientDetector(int batch_size) ;
+        ~TransientDetector() ;
+        /* Add the value *x* to the series. */
+        void add(double x) ;
+        /* Remove all the values. */
+        void reset() ;
+        /* Return the number of values. */
+        long int get_count() {return count;} ;
+        /* Return 1 if the series is stationary after the
+         * equilibration time, 0 if more values are needed.
+         */
+        int stationary() ;
+        /* Return the equilibration time, in steps, found by the
+         * last call to stationary() that returned 1 (-1 if none).
+         */
+        long int equilibration_time() ;
+    protected:
+        /* Return the MSER truncation point, in batches. */
+        int truncation() ;
+        /* Return 1 if the batches after *d* still drift. */
+        int drift(int d) ;
+        int batch_size ;
+        long int count ;
+        /* Sum of the values of the current batch. */
+        double batch_acc ;
+        /* Means of the complete batches. */
+        int num_batches ;
+        int capacity ;
+        double* batches ;
+        long int equilibration ;
+} ;
+
+/*
+ * MSDTracker class implemented to measure the mean squared
+ * displacement and the velocity autocorrelation of the agents
+ *      MSD(t)  = < |r_i(t0 + t) - r_i(t0)|^2 >
+ *      VACF(t) = < v_i(t0 + t) . v_i(t0) >
+ * averaged over the agents and over several time origins *t0*,
+ * while the simulation runs, without storing the trajectories.
+ * The positions are the unwrapped ones, so the Community must
+ * count the periodic images (see Community::setup_images).
+ *
+ * The lags, in calls to add(), are *num_lags* values spaced
+ * logarithmically between 1 and *max_lag*, so that both the
+ * ballistic and the diffusive regimes are resolved. A new time
+ * origin is taken every *origin_interval* calls, keeping at most
+ * *max_origins* of them; an origin is dropped once it is older than
+ * *max_lag*. Each add() costs O(max_origins), plus O(num_agents)
+ * for each origin at one of the lags.
+ *
+ * It stores 2 * max_origins * num_agents * DIM values, so it is
+ * better to choose origin_interval * max_origins >= max_lag.
+ */
+class MSDTracker {
+    public:
+        /* Create an empty tracker for *num_agents* agents (see above
+         * for the other parameters).
+         */
+        MSDTracker(int num_agents, int max_lag, int num_lags, int origin_interval, int max_origins) ;
+        /* Add the current unwrapped positions and velocities of
+         * the agents of *com*, which is one step (lag 1) after
+         * the previous call.
+         */
+        void add(Community* com) ;
+        /* Same as add but with the unwrapped positions *upos* and
+         * velocities *vel* (num_agents * DIM values each).
+         */
+        void add(double* upos, spp_real* vel) ;
+        /* Remove all the values and origins. */
+        void reset() ;
+        /* Return the number of lags (can be smaller than the
+         * *num_lags* requested as the lags are integers).
+         */
+        int get_num_lags() {return num_lags;} ;
+        /* Return the lag *k*, in calls to add(). */
+        int lag(int k) {return lags[k];} ;
+        /* Return the MSD and the VACF at the lag *k*
+         * (0 if there is no sample yet).
+         */
+        double msd(int k) ;
+        double vacf(int k) ;
+        /* Return the number of time origins averaged at the lag *k*. */
+        long int samples(int k) {return num_samples[k];} ;
+        /* Print a line per lag with the lag, MSD, VACF
+         * and number of samples to *out*.
+         */
+        void print(FILE* out) ;
+    protected:
+        int num_agents ;
+        int max_lag ;
+        int num_lags ;
+        int origin_interval ;
+        int max_origins ;
+        long int count ;
+        /* Lags and, for each age up to *max_lag*, the index
+         * of the lag (-1 if it is not one of the lags).
+         */
+        int* lags ;
+        int* lag_index ;
+        /* Sums over the origins of the MSD and VACF. */
+        double* msd_sum ;
+        double* vacf_sum ;
+        long int* num_samples ;
+        /* Time (call) of each origin, -1 if free, and
+         * the positions and velocities at that time.
+         */
+        long int* origin_time ;
+        double* origin_pos ;
+        double* origin_vel ;
+        /* Space for the unwrapped positions in add(Community*). */
+        double* upos_buffer ;
+} ;